@@ -7,7 +7,64 @@
 
         // Number of previously fetched chunks that may be held in the cache.
         // Must be no less than 16.
-        "chunkCacheSize": 128
+        "chunkCacheSize": 128,
+
+        // Number of read buffers per query that may be in flight at once.
+        // While one buffer is being written to the client, the query keeps
+        // reading into the others.  A value of 1 reads in lockstep with the
+        // client.
+        //
+        // Default: 2.
+        "pipelineDepth": 2,
+
+        // Number of chunks that an indexed query may fetch and decode ahead
+        // of the data it is currently sending.  If 0, chunks are fetched only
+        // as they are needed.
+        //
+        // Default: 2.
+        "prefetch": 2,
+
+        // Memory, in megabytes, used to cache finished read responses so that
+        // repeated identical reads are served from memory.  If 0, responses
+        // are not cached.
+        //
+        // Default: 128.
+        "responseCacheMb": 128,
+
+        // Read output is coalesced into buffers of about this many kilobytes
+        // of uncompressed points, so sparse regions don't result in many tiny
+        // writes.  If 0, each chunk is sent as it is read.  May be lowered per
+        // request with the "batchKb" query parameter.
+        //
+        // Default: 1024.
+        "batchKb": 1024,
+
+        // Dense chunks are split into buffers of at most this many kilobytes
+        // of uncompressed points.  If 0, chunks are never split.  May be
+        // lowered per request with the "maxBatchKb" query parameter.
+        //
+        // Default: 4096.
+        "maxBatchKb": 4096,
+
+        // Admission control for reads.  Reads beyond these limits wait in a
+        // queue, smallest first, and reads beyond "maxQueuedReads" are
+        // rejected with a 503 and a Retry-After header.  The size of each
+        // read is estimated from the index hierarchy, in points, and a read
+        // larger than a point limit runs only alone.  Current usage is shown
+        // at /stats.  For each entry, 0 means no limit.
+        //
+        // Defaults: 64, 32, 512, 256, and 256.
+        "maxReads": 64,
+        "maxReadsPerResource": 32,
+        "maxReadMillionPoints": 512,
+        "maxResourceMillionPoints": 256,
+        "maxQueuedReads": 256,
+
+        // The estimated size of a queued read is halved for every this many
+        // seconds it waits, so large reads are not starved by smaller ones.
+        //
+        // Default: 5.
+        "queueAgingSeconds": 5
     },
 
     // Where to find unindexed pointcloud source files and indexed
@@ -30,10 +87,82 @@
     // Default: 30.
     "resourceTimeoutMinutes": 30,
 
+    // Memory budget, in megabytes, for open resources.  Each open resource
+    // holds its metadata, the base depths of its index, and its cached
+    // hierarchies.  When over budget, idle resources are closed, least
+    // recently used first, and are reopened on their next use.  Resources
+    // with queries in progress are never closed.  If set to 0, resources are
+    // only closed by the timeout above.
+    //
+    // Default: 1024.
+    "sessionCacheMb": 1024,
+
+    // Time, in seconds, for which a resource that wasn't found in any of the
+    // paths above is remembered as missing.  Requests for it during this time
+    // fail immediately rather than searching again.  If set to 0, every
+    // request searches.
+    //
+    // Default: 30.
+    "notFoundSeconds": 30,
+
+    // Optional cache of index chunks on local disk, beneath the in-memory
+    // chunk cache, which persists across restarts.  Chunks fetched through
+    // the arbiter drivers listed in "types" are stored as files in "path",
+    // which should be dedicated to this cache, up to a total of "maxMb".
+    // Least recently used chunks are evicted first.
+    //
+    // Chunks are assumed never to change, so clear this directory if an
+    // index is rebuilt in place.  Including "file" in the types allows a
+    // local directory to stand in for a remote one.
+    //
+    // For example:
+    //      {
+    //          "path": "/var/cache/greyhound",
+    //          "maxMb": 65536,
+    //          "types": ["s3", "http", "https"]
+    //      }
+    //
+    // Default: null (disabled).  Default types: ["s3", "http", "https"].
+    "diskCache": null,
+
+    // If set, each resource is preloaded in the background once it has been
+    // opened: its base depths, and its first "coldDepths" cold depths, whose
+    // chunks are then pinned in memory while the resource remains open.  The
+    // memory pinned per resource is reported by /stats, and counts towards
+    // "sessionCacheMb".  Preloads run one at a time on their own thread,
+    // apart from read prefetching.  Resources listed in "resources" are
+    // opened, and therefore preloaded, at startup.
+    //
+    // For example:
+    //      {
+    //          "coldDepths": 2,
+    //          "resources": ["autzen"]
+    //      }
+    //
+    // Default: null (disabled).
+    "preload": null,
+
+    // Fraction of completed reads whose phase timing is logged as a single
+    // line of JSON, for aggregation.  See the "timing" read option in the
+    // client documentation for the phases reported.  If 0, nothing is
+    // logged.
+    //
+    // Default: 0.
+    "readTimingSampleRate": 0,
+
     "http": {
         // Set to true to serve static files at /data/ for testing/verification.
         "enableStaticServe": true,
 
+        // Format of the request log, as accepted by the "morgan" module.  To
+        // record traffic for replay by controller/bench/load.js, include the
+        // time of each request, for example:
+        //
+        //      ":date[iso] :method :url :status :response-time ms"
+        //
+        // Default: "dev".
+        "logFormat": "dev",
+
         // HTTP headers to be applied to Greyhound responses.  Likely uses
         // include CORS settings and cache control.
         "headers": {
@@ -55,12 +184,24 @@
         "certFile": "/opt/keys/greyhound/cert.pem",
 
         // If null, no HTTPS interface will be supported.
-        "securePort": 443
+        "securePort": 443,
+
+        // Reads from slow clients are paused once this much response data is
+        // buffered on their sockets, and resumed when it has drained.
+        //
+        // Default: 8192.
+        "maxBufferedKb": 8192
     },
 
     "ws": {
         // If null, no websocket interface will be supported.
-        "port": 8989
+        "port": 8989,
+
+        // As above, for websocket clients.  Paused reads resume once half of
+        // this amount remains unsent.
+        //
+        // Default: 8192.
+        "maxBufferedKb": 8192
     },
 
     // Greyhound supports the use of an external authentication server to
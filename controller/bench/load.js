@@ -0,0 +1,619 @@
+// Replays a recorded log of Greyhound requests against a running server, and
+// reports throughput and latency histograms per endpoint and per resource.
+//
+// Run with:
+//      node load.js [options] <log>
+//
+// Options:
+//      --url <url>         Server to load.  Default: http://localhost:8080.
+//      --speed <x>         Replay requests at their recorded times, x times
+//                          as fast.  Requires a timed log.
+//      --rate <r>          Open loop: start r requests per second, whether
+//                          or not earlier ones have finished.
+//      --concurrency <n>   Closed loop: keep n requests in flight.  This is
+//                          the default, with n = 1.
+//      --duration <s>      Keep going for s seconds, repeating the log as
+//                          needed.  Default: a single pass of the log.
+//      --resource <name>   Send every request to this resource, to replay a
+//                          production log against a local index.
+//      --percentiles       Also print the full latency distribution of each
+//                          endpoint and resource.
+//      --json <file>       Also write all results, including histogram
+//                          buckets, as JSON.
+//
+// Each line of the log is one request, as any of:
+//
+//      - JSON, as {"time": <t>, "path": "/resource/<name>/read?..."}, or as
+//        {"time": <t>, "resource": <name>, "endpoint": "read",
+//        "query": "depthBegin=8&..."}, where the time is in seconds or is an
+//        ISO-8601 date.
+//      - Text containing a request path, such as lines logged by the HTTP
+//        interface.  A leading number is taken as a time in seconds, as is
+//        an ISO-8601 date such as the one logged by ":date[iso]", or a
+//        bracketed date as in "combined" log lines.
+//
+// Times are only needed for --speed, and are relative to the first request.
+// Lines which aren't requests for info, hierarchy, or read are skipped.
+//
+// For open loop and replayed runs, latency is measured from the time at
+// which each request was due to be sent, so that a server which falls
+// behind isn't flattered by the requests it delayed.
+//
+// See autzen.log for a repeatable benchmark against a local index.
+
+var
+    fs = require('fs'),
+    http = require('http'),
+    url = require('url');
+
+(function() {
+    'use strict';
+
+    var endpoints = ['info', 'hierarchy', 'read'];
+
+    var now = function() {
+        var t = process.hrtime();
+        return t[0] * 1e6 + t[1] / 1e3;
+    };
+
+    // Latency in microseconds, in log-linear buckets in the manner of
+    // HdrHistogram: each value is kept to within 1/64 of itself, from 1
+    // microsecond to hours, in a few thousand buckets at most.
+    var subBuckets = 64;
+
+    var Histogram = function() {
+        this.counts = [];
+        this.count = 0;
+        this.sum = 0;
+        this.max = 0;
+    };
+
+    Histogram.index = function(v) {
+        var shift = 0;
+        while (v >= 2 * subBuckets) {
+            v = Math.floor(v / 2);
+            ++shift;
+        }
+        return shift * subBuckets + v;
+    };
+
+    // The range of values counted in a bucket, as [low, high).
+    Histogram.range = function(i) {
+        if (i < 2 * subBuckets) return [i, i + 1];
+
+        var shift = Math.floor(i / subBuckets) - 1;
+        var low = (i - shift * subBuckets) * Math.pow(2, shift);
+        return [low, low + Math.pow(2, shift)];
+    };
+
+    Histogram.prototype.record = function(micros) {
+        var v = Math.max(Math.round(micros), 0);
+        var i = Histogram.index(v);
+
+        while (this.counts.length <= i) this.counts.push(0);
+        ++this.counts[i];
+
+        ++this.count;
+        this.sum += v;
+        this.max = Math.max(this.max, v);
+    };
+
+    // The value below which the fraction q of recorded values lie, reported
+    // as the middle of its bucket.
+    Histogram.prototype.quantile = function(q) {
+        if (!this.count) return 0;
+
+        var target = Math.max(Math.ceil(q * this.count), 1);
+        var seen = 0;
+
+        for (var i = 0; i < this.counts.length; ++i) {
+            seen += this.counts[i];
+            if (seen >= target) {
+                var r = Histogram.range(i);
+                return Math.min((r[0] + r[1] - 1) / 2, this.max);
+            }
+        }
+
+        return this.max;
+    };
+
+    Histogram.prototype.mean = function() {
+        return this.count ? this.sum / this.count : 0;
+    };
+
+    // Percentiles in the manner of HdrHistogram's percentile output, in
+    // steps which halve the distance to 100 every few lines, with the count
+    // of values at or below each.
+    Histogram.prototype.distribution = function() {
+        var result = [];
+        var ticks = 5;
+
+        var push = (q) => {
+            var value = q < 1 ? this.quantile(q) : this.max;
+            result.push({
+                percentile: q * 100,
+                value: value,
+                count: this.countBelow(value)
+            });
+        };
+
+        for (var half = 1; half <= 2 * this.count; half *= 2) {
+            var from = 1 - 1 / half;
+            var to = 1 - 1 / (2 * half);
+            for (var k = 0; k < ticks; ++k) {
+                push(from + (to - from) * k / ticks);
+            }
+        }
+
+        push(1);
+        return result;
+    };
+
+    Histogram.prototype.countBelow = function(value) {
+        var n = 0;
+        for (var i = 0; i < this.counts.length; ++i) {
+            if (Histogram.range(i)[0] > value) break;
+            n += this.counts[i];
+        }
+        return n;
+    };
+
+    Histogram.prototype.toJSON = function() {
+        var buckets = [];
+        this.counts.forEach((c, i) => {
+            if (c) buckets.push({ from: Histogram.range(i)[0], count: c });
+        });
+
+        return {
+            count: this.count,
+            mean: this.mean(),
+            p50: this.quantile(0.5),
+            p90: this.quantile(0.9),
+            p99: this.quantile(0.99),
+            p999: this.quantile(0.999),
+            max: this.max,
+            buckets: buckets
+        };
+    };
+
+    var Group = function(name) {
+        this.name = name;
+        this.requests = 0;
+        this.errors = 0;
+        this.bytes = 0;
+        this.latency = new Histogram();
+        this.ttfb = new Histogram();
+    };
+
+    Group.prototype.toJSON = function() {
+        return {
+            requests: this.requests,
+            errors: this.errors,
+            bytes: this.bytes,
+            latencyMicros: this.latency,
+            ttfbMicros: this.ttfb
+        };
+    };
+
+    var parseArgs = function(argv) {
+        var options = {
+            url: 'http://localhost:8080',
+            speed: 0,
+            rate: 0,
+            concurrency: 0,
+            duration: 0,
+            resource: null,
+            percentiles: false,
+            json: null,
+            log: null
+        };
+
+        for (var i = 0; i < argv.length; ++i) {
+            var arg = argv[i];
+            var key = arg.replace(/^--/, '');
+
+            if (arg == '--percentiles') options.percentiles = true;
+            else if (arg.indexOf('--') == 0 && options.hasOwnProperty(key)) {
+                if (i + 1 >= argv.length) return null;
+                var value = argv[++i];
+                options[key] = typeof options[key] == 'number' ?
+                    parseFloat(value) : value;
+                if (options[key] !== options[key]) return null;
+            }
+            else if (!options.log && arg.indexOf('--') != 0) options.log = arg;
+            else return null;
+        }
+
+        var modes = !!options.speed + !!options.rate + !!options.concurrency;
+        if (!options.log || modes > 1) return null;
+        if (!modes) options.concurrency = 1;
+
+        return options;
+    };
+
+    var months = [
+        'Jan', 'Feb', 'Mar', 'Apr', 'May', 'Jun',
+        'Jul', 'Aug', 'Sep', 'Oct', 'Nov', 'Dec'
+    ];
+
+    // Seconds, or null if no time is found.
+    var parseTime = function(line) {
+        var m;
+
+        if ((m = line.match(/^\s*(\d+(\.\d*)?)\s/))) {
+            return parseFloat(m[1]);
+        }
+
+        m = line.match(/\d{4}-\d\d-\d\dT\d\d:\d\d:\d\d(\.\d+)?(Z|[+-][\d:]+)?/);
+        if (m) return Date.parse(m[0]) / 1000;
+
+        m = line.match(
+            /\[(\d\d)\/(\w{3})\/(\d{4}):(\d\d):(\d\d):(\d\d) ([+-]\d{4})\]/);
+        if (m && months.indexOf(m[2]) != -1) {
+            return Date.parse(
+                m[3] + '-' +
+                ('0' + (months.indexOf(m[2]) + 1)).slice(-2) + '-' +
+                m[1] + 'T' + m[4] + ':' + m[5] + ':' + m[6] +
+                m[7].slice(0, 3) + ':' + m[7].slice(3)) / 1000;
+        }
+
+        return null;
+    };
+
+    var parsePath = function(path) {
+        var m = path.match(
+            /^\/resource\/(.+)\/(info|hierarchy|read)(\?[^\s]*)?$/);
+        if (!m) return null;
+
+        return {
+            resource: decodeURIComponent(m[1]),
+            endpoint: m[2],
+            query: m[3] ? m[3].slice(1) : ''
+        };
+    };
+
+    var parseLine = function(line) {
+        // Strip the colors of the "dev" log format.
+        line = line.replace(/\x1b\[[0-9;]*m/g, '').trim();
+        if (!line || line[0] == '#') return null;
+
+        var request = null;
+        var time = null;
+
+        if (line[0] == '{') {
+            var json = JSON.parse(line);
+
+            if (json.path) request = parsePath(json.path);
+            else if (json.resource && endpoints.indexOf(json.endpoint) != -1) {
+                request = {
+                    resource: json.resource,
+                    endpoint: json.endpoint,
+                    query: json.query || ''
+                };
+            }
+
+            if (typeof json.time == 'number') time = json.time;
+            else if (json.time) time = Date.parse(json.time) / 1000;
+        }
+        else {
+            var m = line.match(/(\/resource\/[^\s"]+)/);
+            if (m) request = parsePath(m[1]);
+            time = parseTime(line);
+        }
+
+        if (request) request.time = time;
+        return request;
+    };
+
+    var readLog = function(file) {
+        var requests = [];
+        var skipped = 0;
+
+        fs.readFileSync(file, 'utf8').split('\n').forEach((line, i) => {
+            try {
+                var request = parseLine(line);
+                if (request) requests.push(request);
+                else if (line.trim() && line.trim()[0] != '#') ++skipped;
+            }
+            catch (e) {
+                throw new Error(file + ':' + (i + 1) + ': ' + e.message);
+            }
+        });
+
+        if (skipped) console.log('Skipped', skipped, 'non-request lines');
+        return requests;
+    };
+
+    var Runner = function(options, requests) {
+        var target = url.parse(options.url);
+
+        this.options = options;
+        this.requests = requests;
+        this.host = target.hostname;
+        this.port = target.port || 80;
+        this.prefix = (target.pathname || '/').replace(/\/$/, '');
+        this.agent = new http.Agent({ keepAlive: true, maxSockets: Infinity });
+
+        this.groups = { };
+        this.total = new Group('total');
+        this.inFlight = 0;
+        this.maxInFlight = 0;
+        this.sent = 0;
+        this.start = 0;
+        this.end = 0;
+    };
+
+    Runner.prototype.group = function(name) {
+        if (!this.groups[name]) this.groups[name] = new Group(name);
+        return this.groups[name];
+    };
+
+    Runner.prototype.path = function(request) {
+        var resource = this.options.resource || request.resource;
+        return this.prefix + '/resource/' + encodeURI(resource) + '/' +
+            request.endpoint + (request.query ? '?' + request.query : '');
+    };
+
+    // Send a request, measuring its latency from the given time, and call
+    // back once its response has ended.
+    Runner.prototype.send = function(request, from, done) {
+        var self = this;
+        var resource = self.options.resource || request.resource;
+        var groups = [
+            self.total,
+            self.group('endpoint ' + request.endpoint),
+            self.group('resource ' + resource)
+        ];
+
+        var finished = false;
+
+        var finish = function(ok, bytes, ttfb) {
+            if (finished) return;
+            finished = true;
+
+            var latency = now() - from;
+            groups.forEach((g) => {
+                ++g.requests;
+                g.bytes += bytes;
+                if (ok) {
+                    g.latency.record(latency);
+                    g.ttfb.record(ttfb);
+                }
+                else ++g.errors;
+            });
+
+            --self.inFlight;
+            done();
+        };
+
+        ++self.sent;
+        ++self.inFlight;
+        self.maxInFlight = Math.max(self.maxInFlight, self.inFlight);
+
+        var req = http.get({
+            host: self.host,
+            port: self.port,
+            path: self.path(request),
+            agent: self.agent
+        }, (res) => {
+            var ttfb = now() - from;
+            var bytes = 0;
+
+            res.on('data', (data) => { bytes += data.length; });
+            res.on('end', () => finish(res.statusCode == 200, bytes, ttfb));
+            res.on('error', () => finish(false, bytes, ttfb));
+        });
+
+        req.on('error', () => finish(false, 0, 0));
+    };
+
+    // The request to send at position i, or null if we're done.
+    Runner.prototype.at = function(i) {
+        var n = this.requests.length;
+        var duration = this.options.duration * 1e6;
+
+        if (!duration && i >= n) return null;
+        if (duration && now() - this.start >= duration) return null;
+
+        return this.requests[i % n];
+    };
+
+    Runner.prototype.closedLoop = function(done) {
+        var self = this;
+        var next = 0;
+        var workers = self.options.concurrency;
+
+        var work = function() {
+            var request = self.at(next++);
+            if (request) self.send(request, now(), work);
+            else if (!--workers) done();
+        };
+
+        for (var i = 0; i < self.options.concurrency; ++i) work();
+    };
+
+    // Send requests at the times given by due(i), in microseconds from the
+    // start.
+    Runner.prototype.openLoop = function(due, done) {
+        var self = this;
+        var next = 0;
+        var issued = false;
+
+        var complete = function() {
+            if (issued && !self.inFlight) {
+                issued = false;
+                done();
+            }
+        };
+
+        var tick = function() {
+            var request;
+
+            while ((request = self.at(next))) {
+                var when = due(next);
+                var wait = when - (now() - self.start);
+
+                if (wait > 0) return setTimeout(tick, wait / 1e3);
+
+                ++next;
+                self.send(request, self.start + when, complete);
+            }
+
+            issued = true;
+            complete();
+        };
+
+        tick();
+    };
+
+    Runner.prototype.run = function(done) {
+        var self = this;
+        var options = self.options;
+        var requests = self.requests;
+
+        var finish = function() {
+            self.end = now();
+            self.agent.destroy();
+            done();
+        };
+
+        self.start = now();
+
+        if (options.concurrency) return self.closedLoop(finish);
+
+        if (options.rate) {
+            var interval = 1e6 / options.rate;
+            return self.openLoop((i) => i * interval, finish);
+        }
+
+        var first = requests[0].time;
+        var span = requests[requests.length - 1].time - first;
+
+        // When repeating the log, each pass follows the last after the
+        // average gap between its requests.
+        var gap = requests.length > 1 ? span / (requests.length - 1) : 1;
+        var period = span + gap;
+
+        self.openLoop((i) => {
+            var pass = Math.floor(i / requests.length);
+            var r = requests[i % requests.length];
+            return ((r.time - first) + pass * period) * 1e6 / options.speed;
+        }, finish);
+    };
+
+    var ms = (micros) => (micros / 1e3).toFixed(2);
+
+    var pad = function(s, n, left) {
+        s = String(s);
+        while (s.length < n) s = left ? s + ' ' : ' ' + s;
+        return s;
+    };
+
+    Runner.prototype.report = function() {
+        var seconds = (this.end - this.start) / 1e6;
+        var names = Object.keys(this.groups).sort();
+        var groups = [this.total].concat(names.map((n) => this.groups[n]));
+
+        console.log(
+            '\n' + this.sent + ' requests in ' + seconds.toFixed(2) + 's, ' +
+            this.maxInFlight + ' in flight at most\n');
+
+        var header = [
+            pad('', 28, true), pad('reqs', 8), pad('errs', 6),
+            pad('req/s', 9), pad('MB/s', 8),
+            pad('mean', 9), pad('p50', 9), pad('p90', 9), pad('p99', 9),
+            pad('p99.9', 9), pad('max', 9), pad('ttfb50', 9), pad('ttfb99', 9)
+        ];
+        console.log(header.join('') + '    (latencies in ms)');
+
+        groups.forEach((g) => {
+            var l = g.latency;
+            console.log([
+                pad(g.name, 28, true), pad(g.requests, 8), pad(g.errors, 6),
+                pad((g.requests / seconds).toFixed(1), 9),
+                pad((g.bytes / seconds / 1e6).toFixed(2), 8),
+                pad(ms(l.mean()), 9),
+                pad(ms(l.quantile(0.5)), 9),
+                pad(ms(l.quantile(0.9)), 9),
+                pad(ms(l.quantile(0.99)), 9),
+                pad(ms(l.quantile(0.999)), 9),
+                pad(ms(l.max), 9),
+                pad(ms(g.ttfb.quantile(0.5)), 9),
+                pad(ms(g.ttfb.quantile(0.99)), 9)
+            ].join(''));
+        });
+
+        if (!this.options.percentiles) return;
+
+        groups.forEach((g) => {
+            if (!g.latency.count) return;
+
+            console.log('\n' + g.name + '\n' +
+                pad('Value (ms)', 14) + pad('Percentile', 14) +
+                pad('Count', 10));
+
+            g.latency.distribution().forEach((d) => {
+                console.log(
+                    pad(ms(d.value), 14) +
+                    pad(d.percentile.toFixed(4), 14) +
+                    pad(d.count, 10));
+            });
+        });
+    };
+
+    Runner.prototype.toJSON = function() {
+        var groups = { };
+        Object.keys(this.groups).forEach((n) => {
+            groups[n] = this.groups[n].toJSON();
+        });
+
+        return {
+            options: this.options,
+            seconds: (this.end - this.start) / 1e6,
+            maxInFlight: this.maxInFlight,
+            total: this.total.toJSON(),
+            groups: groups
+        };
+    };
+
+    var options = parseArgs(process.argv.slice(2));
+
+    if (!options) {
+        console.log(
+            'Usage: node load.js [--url url] ' +
+            '[--speed x | --rate r | --concurrency n]\n' +
+            '       [--duration seconds] [--resource name] [--percentiles] ' +
+            '[--json file] <log>');
+        process.exit(1);
+    }
+
+    var requests = readLog(options.log);
+
+    if (!requests.length) {
+        console.log('No requests found in', options.log);
+        process.exit(1);
+    }
+
+    if (options.speed && requests.some((r) => r.time === null)) {
+        console.log('Replaying with --speed needs a time for every request');
+        process.exit(1);
+    }
+
+    // Lines may be out of order, for example if logged as responses finish.
+    if (options.speed) requests.sort((a, b) => a.time - b.time);
+
+    var runner = new Runner(options, requests);
+
+    runner.run(() => {
+        runner.report();
+
+        if (options.json) {
+            fs.writeFileSync(
+                options.json,
+                JSON.stringify(runner.toJSON(), null, 2) + '\n');
+        }
+
+        process.exit(runner.total.errors ? 2 : 0);
+    });
+})();
+
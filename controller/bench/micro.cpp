@@ -0,0 +1,370 @@
+// Microbenchmarks of the small pieces of work done for every request, each
+// run from 1 to N threads at once to show how they behave under contention:
+//
+//      - Acquiring and releasing an ItcBuffer.
+//      - Once::ensure, for an already-initialized session as on every create
+//        after the first, and for a fresh one.
+//      - Parsing a requested schema, as in ReadCommand's constructor.
+//      - Setting up a LazPerfCompressor, as in ReadQuery's constructor.
+//
+// Build and run with:
+//      make micro && ./micro [options]
+//
+// Options:
+//      -t <threads>    Maximum thread count, run in powers of two up to it.
+//                      Default: the number of cores.
+//      -s <seconds>    Duration of each run.  Default: 0.5.
+//      -f <filter>     Only run benchmarks whose names contain this.
+//      -o <file>       Also write results as JSON, in the format of Google
+//                      Benchmark's --benchmark_out, so builds may be compared
+//                      with its tools.
+//
+// Times are per operation: real time as seen by each thread, and CPU time
+// across all threads.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <pdal/Compression.hpp>
+
+#include <entwine/third/json/json.hpp>
+#include <entwine/types/schema.hpp>
+#include <entwine/util/compression.hpp>
+
+#include "util/buffer-pool.hpp"
+#include "util/once.hpp"
+
+namespace
+{
+    typedef std::chrono::steady_clock Clock;
+
+    // Operations run between checks of the clock.
+    const std::size_t batch(64);
+
+    // A schema typical of those requested by web clients.
+    const std::string schemaString(
+            "["
+                "{\"name\":\"X\",\"type\":\"floating\",\"size\":8},"
+                "{\"name\":\"Y\",\"type\":\"floating\",\"size\":8},"
+                "{\"name\":\"Z\",\"type\":\"floating\",\"size\":8},"
+                "{\"name\":\"Intensity\",\"type\":\"unsigned\",\"size\":2},"
+                "{\"name\":\"Classification\","
+                    "\"type\":\"unsigned\",\"size\":1},"
+                "{\"name\":\"Red\",\"type\":\"unsigned\",\"size\":2},"
+                "{\"name\":\"Green\",\"type\":\"unsigned\",\"size\":2},"
+                "{\"name\":\"Blue\",\"type\":\"unsigned\",\"size\":2}"
+            "]");
+
+    entwine::Schema parseSchema(const std::string& s)
+    {
+        Json::Reader reader;
+        Json::Value json;
+        reader.parse("{\"schema\":" + s + "}", json);
+
+        if (reader.getFormattedErrorMessages().size())
+        {
+            throw std::runtime_error("Could not parse schema");
+        }
+
+        return entwine::Schema(json["schema"]);
+    }
+
+    typedef std::function<void()> Op;
+
+    struct Benchmark
+    {
+        Benchmark(const std::string& name, std::function<Op()> setup)
+            : name(name)
+            , setup(setup)
+        { }
+
+        std::string name;
+
+        // Called before each run, returning the operation which every thread
+        // repeats, and which shares whatever state it captures.
+        std::function<Op()> setup;
+    };
+
+    std::vector<Benchmark> benchmarks()
+    {
+        std::vector<Benchmark> result;
+
+        result.emplace_back("ItcBufferPool/acquireRelease", []()->Op
+        {
+            // As many buffers as the addon.
+            std::shared_ptr<ItcBufferPool> pool(
+                    std::make_shared<ItcBufferPool>(1024));
+
+            return [pool]()->void
+            {
+                pool->release(pool->acquire());
+            };
+        });
+
+        result.emplace_back("Once/ensureDone", []()->Op
+        {
+            std::shared_ptr<Once> once(std::make_shared<Once>());
+            once->ensure([]()->void { });
+
+            return [once]()->void
+            {
+                once->ensure([]()->void { });
+            };
+        });
+
+        result.emplace_back("Once/ensureFresh", []()->Op
+        {
+            return []()->void
+            {
+                Once once;
+                once.ensure([]()->void { });
+            };
+        });
+
+        result.emplace_back("Schema/parse", []()->Op
+        {
+            return []()->void
+            {
+                const entwine::Schema schema(parseSchema(schemaString));
+                if (!schema.pointSize()) std::abort();
+            };
+        });
+
+        result.emplace_back("LazPerf/compressorSetup", []()->Op
+        {
+            std::shared_ptr<entwine::Schema> schema(
+                    std::make_shared<entwine::Schema>(
+                        parseSchema(schemaString)));
+
+            return [schema]()->void
+            {
+                entwine::CompressionStream stream;
+                pdal::LazPerfCompressor<entwine::CompressionStream> compressor(
+                        stream,
+                        schema->pdalLayout().dimTypes());
+
+                compressor.done();
+            };
+        });
+
+        return result;
+    }
+
+    std::uint64_t threadCpuNanos()
+    {
+        timespec t;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t);
+        return static_cast<std::uint64_t>(t.tv_sec) * 1000000000 + t.tv_nsec;
+    }
+
+    struct Result
+    {
+        Result()
+            : iterations(0)
+            , realTime(0)
+            , cpuTime(0)
+            , itemsPerSecond(0)
+        { }
+
+        std::uint64_t iterations;
+        double realTime;
+        double cpuTime;
+        double itemsPerSecond;
+    };
+
+    Result run(
+            const Benchmark& benchmark,
+            const std::size_t numThreads,
+            const double seconds)
+    {
+        const Op op(benchmark.setup());
+
+        std::atomic<std::size_t> ready(0);
+        std::atomic<bool> go(false);
+        std::vector<std::uint64_t> iterations(numThreads, 0);
+        std::vector<std::uint64_t> cpu(numThreads, 0);
+
+        Clock::time_point start;
+        const auto duration(
+                std::chrono::duration_cast<Clock::duration>(
+                    std::chrono::duration<double>(seconds)));
+
+        std::vector<std::thread> threads;
+
+        for (std::size_t t(0); t < numThreads; ++t)
+        {
+            threads.emplace_back([&, t]()->void
+            {
+                ++ready;
+                while (!go) std::this_thread::yield();
+
+                const std::uint64_t cpuStart(threadCpuNanos());
+                const Clock::time_point end(start + duration);
+                std::uint64_t n(0);
+
+                while (Clock::now() < end)
+                {
+                    for (std::size_t i(0); i < batch; ++i) op();
+                    n += batch;
+                }
+
+                iterations[t] = n;
+                cpu[t] = threadCpuNanos() - cpuStart;
+            });
+        }
+
+        while (ready < numThreads) std::this_thread::yield();
+
+        start = Clock::now();
+        go = true;
+
+        for (std::thread& thread : threads) thread.join();
+
+        const double elapsed(
+                std::chrono::duration<double>(Clock::now() - start).count());
+
+        Result result;
+
+        std::uint64_t cpuTotal(0);
+        for (std::size_t t(0); t < numThreads; ++t)
+        {
+            result.iterations += iterations[t];
+            cpuTotal += cpu[t];
+        }
+
+        const double perThread(
+                static_cast<double>(result.iterations) / numThreads);
+
+        result.realTime = elapsed * 1e9 / perThread;
+        result.cpuTime = static_cast<double>(cpuTotal) / result.iterations;
+        result.itemsPerSecond = result.iterations / elapsed;
+
+        return result;
+    }
+
+    Json::Value context(const std::size_t maxThreads)
+    {
+        const std::time_t now(std::time(nullptr));
+        char date[64];
+        std::strftime(date, sizeof(date), "%F %T", std::localtime(&now));
+
+        Json::Value json;
+        json["date"] = date;
+        json["num_cpus"] =
+            static_cast<Json::UInt64>(std::thread::hardware_concurrency());
+        json["max_threads"] = static_cast<Json::UInt64>(maxThreads);
+        json["executable"] = "micro";
+#ifdef NDEBUG
+        json["library_build_type"] = "release";
+#else
+        json["library_build_type"] = "debug";
+#endif
+
+        return json;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::size_t maxThreads(
+            std::max<std::size_t>(std::thread::hardware_concurrency(), 1));
+    double seconds(0.5);
+    std::string filter;
+    std::string out;
+
+    bool valid(argc % 2);
+
+    for (int i(1); valid && i + 1 < argc; i += 2)
+    {
+        const std::string flag(argv[i]);
+        const std::string value(argv[i + 1]);
+
+        if (flag == "-t") maxThreads = std::atol(value.c_str());
+        else if (flag == "-s") seconds = std::atof(value.c_str());
+        else if (flag == "-f") filter = value;
+        else if (flag == "-o") out = value;
+        else valid = false;
+    }
+
+    if (!valid || !maxThreads || seconds <= 0)
+    {
+        std::cout << "Usage: " << argv[0] <<
+            " [-t maxThreads] [-s seconds] [-f filter] [-o file]" << std::endl;
+        return 1;
+    }
+
+    std::vector<std::size_t> threadCounts;
+    for (std::size_t n(1); n < maxThreads; n *= 2) threadCounts.push_back(n);
+    threadCounts.push_back(maxThreads);
+
+    Json::Value json;
+    json["context"] = context(maxThreads);
+    json["benchmarks"] = Json::Value(Json::arrayValue);
+
+    std::cout <<
+        std::left << std::setw(44) << "Benchmark" <<
+        std::right << std::setw(14) << "Time (ns)" <<
+        std::setw(14) << "CPU (ns)" <<
+        std::setw(16) << "Iterations" <<
+        std::setw(14) << "Mops/s" << std::endl;
+
+    for (const Benchmark& benchmark : benchmarks())
+    {
+        if (benchmark.name.find(filter) == std::string::npos) continue;
+
+        for (const std::size_t numThreads : threadCounts)
+        {
+            const Result result(run(benchmark, numThreads, seconds));
+            const std::string name(
+                    benchmark.name + "/threads:" + std::to_string(numThreads));
+
+            std::cout << std::fixed << std::setprecision(1) <<
+                std::left << std::setw(44) << name <<
+                std::right << std::setw(14) << result.realTime <<
+                std::setw(14) << result.cpuTime <<
+                std::setw(16) << result.iterations <<
+                std::setw(14) << std::setprecision(3) <<
+                    result.itemsPerSecond / 1e6 << std::endl;
+
+            Json::Value entry;
+            entry["name"] = name;
+            entry["run_name"] = name;
+            entry["run_type"] = "iteration";
+            entry["threads"] = static_cast<Json::UInt64>(numThreads);
+            entry["iterations"] = static_cast<Json::UInt64>(result.iterations);
+            entry["real_time"] = result.realTime;
+            entry["cpu_time"] = result.cpuTime;
+            entry["time_unit"] = "ns";
+            entry["items_per_second"] = result.itemsPerSecond;
+
+            json["benchmarks"].append(entry);
+        }
+    }
+
+    if (!out.empty())
+    {
+        std::ofstream file(out, std::ios::trunc);
+        file << json.toStyledString();
+
+        if (!file)
+        {
+            std::cout << "Could not write " << out << std::endl;
+            return 1;
+        }
+    }
+
+    return 0;
+}
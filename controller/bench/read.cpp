@@ -0,0 +1,535 @@
+// End-to-end benchmark of the indexed read path without Node.  Builds a small
+// synthetic index, then runs concurrent bounds and depth queries against it
+// through Session and EntwineReadQuery, reading into pooled buffers as our
+// read commands do, for each compression mode and thread count.
+//
+// Build and run with:
+//      make read && ./read [options]
+//
+// Options:
+//      -p <points>     Number of synthetic points to index.  Default: 1000000.
+//      -t <threads>    Comma-separated thread counts.  Default: 1,2,4,8.
+//      -q <queries>    Queries per run.  Default: 256.
+//      -i <path>       Read an existing index rather than building one.
+//      -e <command>    Entwine executable with which to build our index.
+//                      Default: entwine.
+//
+// Chunks are read from local disk, and every query is run once beforehand to
+// warm the chunk cache, so this measures the cost of serving reads rather than
+// of fetching chunks.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <pdal/StageFactory.hpp>
+
+#include <entwine/reader/cache.hpp>
+#include <entwine/third/json/json.hpp>
+#include <entwine/types/bounds.hpp>
+#include <entwine/types/outer-scope.hpp>
+#include <entwine/types/point.hpp>
+#include <entwine/types/schema.hpp>
+
+#include "read-queries/base.hpp"
+#include "types/query-limits.hpp"
+#include "util/buffer-pool.hpp"
+#include "util/task-pool.hpp"
+
+#include "session.hpp"
+
+namespace
+{
+    typedef std::chrono::steady_clock Clock;
+
+    double secondsSince(const Clock::time_point start)
+    {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    struct Options
+    {
+        Options()
+            : numPoints(1000000)
+            , threads { 1, 2, 4, 8 }
+            , queries(256)
+            , index()
+            , entwine("entwine")
+        { }
+
+        std::size_t numPoints;
+        std::vector<std::size_t> threads;
+        std::size_t queries;
+        std::string index;
+        std::string entwine;
+    };
+
+    bool parse(const int argc, char** argv, Options& options)
+    {
+        for (int i(1); i + 1 < argc; i += 2)
+        {
+            const std::string flag(argv[i]);
+            const std::string value(argv[i + 1]);
+
+            if (flag == "-p") options.numPoints = std::atol(value.c_str());
+            else if (flag == "-q") options.queries = std::atol(value.c_str());
+            else if (flag == "-i") options.index = value;
+            else if (flag == "-e") options.entwine = value;
+            else if (flag == "-t")
+            {
+                options.threads.clear();
+
+                std::istringstream ss(value);
+                std::string count;
+
+                while (std::getline(ss, count, ','))
+                {
+                    options.threads.push_back(std::atol(count.c_str()));
+                }
+            }
+            else return false;
+        }
+
+        return
+            argc % 2 &&
+            options.numPoints &&
+            options.queries &&
+            !options.threads.empty() &&
+            std::all_of(
+                options.threads.begin(),
+                options.threads.end(),
+                [](const std::size_t n)->bool { return n > 0; });
+    }
+
+    template<typename T> void put(std::vector<char>& out, const T value)
+    {
+        const char* pos(reinterpret_cast<const char*>(&value));
+        out.insert(out.end(), pos, pos + sizeof(T));
+    }
+
+    // Write a LAS 1.2 file of point format 0 - simple enough to write by
+    // hand, and read by PDAL without any further dependencies.  Points lie on
+    // gently rolling terrain over a square kilometer, with some noise.
+    void writeLas(const std::string& path, const std::size_t numPoints)
+    {
+        const double scale(0.01);
+        const double size(1000);
+        const double relief(50);
+
+        std::vector<char> points;
+        points.reserve(numPoints * 20);
+
+        std::mt19937 gen(42);
+        std::uniform_real_distribution<double> coord(0, size);
+        std::normal_distribution<double> noise(0, 0.5);
+        std::uniform_int_distribution<int> intensity(0, 65535);
+
+        double zMin(relief * 2);
+        double zMax(-relief * 2);
+
+        for (std::size_t i(0); i < numPoints; ++i)
+        {
+            const double x(coord(gen));
+            const double y(coord(gen));
+            const double z(
+                    relief *
+                        std::sin(x / 97.0) * std::cos(y / 131.0) +
+                    noise(gen));
+
+            zMin = std::min(zMin, z);
+            zMax = std::max(zMax, z);
+
+            put<int32_t>(points, std::lround(x / scale));
+            put<int32_t>(points, std::lround(y / scale));
+            put<int32_t>(points, std::lround(z / scale));
+            put<uint16_t>(points, intensity(gen));
+            put<uint8_t>(points, 1 | (1 << 3));     // Return 1 of 1.
+            put<uint8_t>(points, 2);                // Ground.
+            put<int8_t>(points, 0);
+            put<uint8_t>(points, 0);
+            put<uint16_t>(points, 1);
+        }
+
+        std::vector<char> header;
+        header.insert(header.end(), { 'L', 'A', 'S', 'F' });
+        put<uint16_t>(header, 0);               // File source ID.
+        put<uint16_t>(header, 0);               // Global encoding.
+        header.resize(header.size() + 16, 0);   // GUID.
+        put<uint8_t>(header, 1);
+        put<uint8_t>(header, 2);
+        header.resize(header.size() + 64, 0);   // System and software.
+        put<uint16_t>(header, 1);               // Creation day and year.
+        put<uint16_t>(header, 2016);
+        put<uint16_t>(header, 227);             // Header size.
+        put<uint32_t>(header, 227);             // Offset to points.
+        put<uint32_t>(header, 0);               // VLRs.
+        put<uint8_t>(header, 0);                // Point format.
+        put<uint16_t>(header, 20);              // Point size.
+        put<uint32_t>(header, numPoints);
+        put<uint32_t>(header, numPoints);       // Points by return.
+        header.resize(header.size() + 16, 0);
+
+        for (std::size_t i(0); i < 3; ++i) put<double>(header, scale);
+        for (std::size_t i(0); i < 3; ++i) put<double>(header, 0);
+
+        put<double>(header, size);
+        put<double>(header, 0);
+        put<double>(header, size);
+        put<double>(header, 0);
+        put<double>(header, zMax);
+        put<double>(header, zMin);
+
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(header.data(), header.size());
+        file.write(points.data(), points.size());
+
+        if (!file) throw std::runtime_error("Could not write " + path);
+    }
+
+    struct Spec
+    {
+        Spec(const entwine::Bounds& bounds, std::size_t begin, std::size_t end)
+            : bounds(bounds)
+            , depthBegin(begin)
+            , depthEnd(end)
+        { }
+
+        entwine::Bounds bounds;
+        std::size_t depthBegin;
+        std::size_t depthEnd;
+    };
+
+    // A mix of what a progressive client asks for: coarse views of large
+    // areas, and detailed views of small ones.
+    std::vector<Spec> makeSpecs(
+            const entwine::Bounds& full,
+            const std::size_t numPoints,
+            const std::size_t count)
+    {
+        const std::size_t deepest(
+                std::ceil(std::log(numPoints) / std::log(4.0)) + 2);
+
+        std::mt19937 gen(7);
+        std::uniform_real_distribution<double> unit(0, 1);
+        std::uniform_int_distribution<std::size_t> level(0, 3);
+
+        std::vector<Spec> specs;
+
+        for (std::size_t i(0); i < count; ++i)
+        {
+            // Detail increases as area shrinks, by a factor of four per
+            // level.
+            const std::size_t l(level(gen));
+            const double fraction(1.0 / (1 << l));
+
+            const entwine::Point& min(full.min());
+            const entwine::Point& max(full.max());
+
+            const double w((max.x - min.x) * fraction);
+            const double h((max.y - min.y) * fraction);
+            const double x(min.x + (max.x - min.x - w) * unit(gen));
+            const double y(min.y + (max.y - min.y - h) * unit(gen));
+
+            const std::size_t end(deepest - 3 + l);
+
+            specs.emplace_back(
+                    entwine::Bounds(
+                        entwine::Point(x, y, min.z),
+                        entwine::Point(x + w, y + h, max.z)),
+                    end > 4 ? end - 4 : 0,
+                    end);
+        }
+
+        return specs;
+    }
+
+    struct Result
+    {
+        Result() : points(0), bytes(0), firstByte(0), latency(0) { }
+
+        std::uint64_t points;
+        std::uint64_t bytes;
+        double firstByte;
+        double latency;
+    };
+
+    Result run(
+            Session& session,
+            const Spec& spec,
+            const CompressionMode compress,
+            ItcBufferPool& pool,
+            const QueryLimits& limits)
+    {
+        Result result;
+        const Clock::time_point start(Clock::now());
+
+        std::shared_ptr<ReadQuery> query(
+                session.query(
+                    session.schema(),
+                    compress,
+                    0,
+                    entwine::Point(),
+                    &spec.bounds,
+                    spec.depthBegin,
+                    spec.depthEnd,
+                    limits));
+
+        query->batch(limits.batchBytes(), limits.maxBatchBytes());
+
+        std::shared_ptr<ItcBuffer> buffer(pool.acquire());
+
+        while (!query->done())
+        {
+            query->read(*buffer);
+
+            if (!result.bytes) result.firstByte = secondsSince(start);
+            result.bytes += buffer->size();
+        }
+
+        pool.release(buffer);
+
+        result.points = query->numPoints();
+        result.latency = secondsSince(start);
+
+        return result;
+    }
+
+    // In milliseconds.
+    double percentile(std::vector<double> values, const double q)
+    {
+        if (values.empty()) return 0;
+
+        std::sort(values.begin(), values.end());
+        const std::size_t i(
+                std::min<std::size_t>(q * values.size(), values.size() - 1));
+
+        return values[i] * 1000.0;
+    }
+
+    std::string name(const CompressionMode compress)
+    {
+        switch (compress)
+        {
+            case CompressionMode::None: return "none";
+            case CompressionMode::Stream: return "stream";
+            case CompressionMode::Blocks: return "blocks";
+        }
+
+        return "unknown";
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+
+    if (!parse(argc, argv, options))
+    {
+        std::cout << "Usage: " << argv[0] << " [-p points] [-t threads,...] "
+            "[-q queries] [-i index] [-e entwine]" << std::endl;
+        return 1;
+    }
+
+    // Our index is found by name within a search path, like any other.
+    std::string temp;
+    std::string index(options.index);
+
+    if (index.empty())
+    {
+        char dir[] = "/tmp/greyhound-bench-XXXXXX";
+        if (!mkdtemp(dir))
+        {
+            std::cout << "Could not create a temporary directory" << std::endl;
+            return 1;
+        }
+
+        temp = dir;
+        index = temp + "/index";
+
+        const std::string las(temp + "/points.las");
+        writeLas(las, options.numPoints);
+
+        const std::string command(
+                options.entwine + " build -i " + las + " -o " + index);
+
+        std::cout << "Building: " << command << std::endl;
+
+        if (std::system(command.c_str()))
+        {
+            std::cout << "Could not build index" << std::endl;
+            return 1;
+        }
+    }
+
+    while (index.size() > 1 && index.back() == '/') index.pop_back();
+
+    const std::size_t slash(index.rfind('/'));
+    const std::string path(
+            slash == std::string::npos ? "." : index.substr(0, slash));
+    const std::string resource(
+            slash == std::string::npos ? index : index.substr(slash + 1));
+
+    const std::size_t maxThreads(
+            *std::max_element(options.threads.begin(), options.threads.end()));
+    const std::size_t cores(
+            std::max<std::size_t>(std::thread::hardware_concurrency(), 1));
+
+    TaskPool compressionPool(cores);
+    TaskPool prefetchPool(std::max<std::size_t>(cores * 2, 8));
+    TaskPool discoveryPool(1);
+    TaskPool preloadPool(1);
+
+    ItcBufferPool itcBufferPool(maxThreads * 2);
+    const QueryLimits limits;
+
+    pdal::StageFactory stageFactory;
+    std::mutex factoryMutex;
+    entwine::OuterScope outerScope;
+    outerScope.getArbiter();
+
+    std::shared_ptr<entwine::Cache> cache(
+            std::make_shared<entwine::Cache>(1024));
+
+    std::shared_ptr<Session> session(
+            std::make_shared<Session>(
+                stageFactory,
+                factoryMutex,
+                compressionPool,
+                prefetchPool,
+                discoveryPool,
+                preloadPool));
+
+    if (!session->initialize(resource, { path }, outerScope, cache))
+    {
+        std::cout << "Could not open index at " << index << std::endl;
+        return 1;
+    }
+
+    Json::Reader reader;
+    Json::Value info;
+    reader.parse(session->info(), info, false);
+
+    const entwine::Bounds bounds(info["bounds"]);
+    const std::size_t numPoints(info["numPoints"].asUInt64());
+
+    const std::vector<Spec> specs(
+            makeSpecs(bounds, numPoints, options.queries));
+
+    // Warm the chunk cache.
+    for (const Spec& spec : specs)
+    {
+        run(*session, spec, CompressionMode::None, itcBufferPool, limits);
+    }
+
+    std::cout << "Points: " << numPoints << ", queries per run: " <<
+        specs.size() << std::endl;
+
+    std::cout <<
+        std::left << std::setw(8) << "Mode" <<
+        std::right << std::setw(8) << "Threads" <<
+        std::setw(10) << "Mpts/s" <<
+        std::setw(10) << "MB/s" <<
+        std::setw(11) << "TTFB p50" <<
+        std::setw(11) << "TTFB p99" <<
+        std::setw(11) << "Lat p50" <<
+        std::setw(11) << "Lat p99" <<
+        "   (milliseconds)" << std::endl;
+
+    for (const CompressionMode compress :
+            {
+                CompressionMode::None,
+                CompressionMode::Stream,
+                CompressionMode::Blocks
+            })
+    {
+        for (const std::size_t numThreads : options.threads)
+        {
+            std::vector<Result> results(specs.size());
+            std::atomic<std::size_t> next(0);
+            std::atomic<bool> failed(false);
+
+            const Clock::time_point start(Clock::now());
+
+            std::vector<std::thread> threads;
+
+            for (std::size_t t(0); t < numThreads; ++t)
+            {
+                threads.emplace_back([&]()->void
+                {
+                    std::size_t i(0);
+
+                    while ((i = next++) < specs.size())
+                    {
+                        try
+                        {
+                            results[i] = run(
+                                    *session,
+                                    specs[i],
+                                    compress,
+                                    itcBufferPool,
+                                    limits);
+                        }
+                        catch (const std::exception& e)
+                        {
+                            std::cout << "Query failed: " << e.what() <<
+                                std::endl;
+                            failed = true;
+                        }
+                    }
+                });
+            }
+
+            for (std::thread& thread : threads) thread.join();
+
+            const double elapsed(secondsSince(start));
+
+            if (failed) return 1;
+
+            std::uint64_t points(0);
+            std::uint64_t bytes(0);
+            std::vector<double> firstBytes;
+            std::vector<double> latencies;
+
+            for (const Result& result : results)
+            {
+                points += result.points;
+                bytes += result.bytes;
+                firstBytes.push_back(result.firstByte);
+                latencies.push_back(result.latency);
+            }
+
+            std::cout << std::fixed << std::setprecision(2) <<
+                std::left << std::setw(8) << name(compress) <<
+                std::right << std::setw(8) << numThreads <<
+                std::setw(10) << points / elapsed / 1000000.0 <<
+                std::setw(10) << bytes / elapsed / 1024.0 / 1024.0 <<
+                std::setw(11) << percentile(firstBytes, 0.5) <<
+                std::setw(11) << percentile(firstBytes, 0.99) <<
+                std::setw(11) << percentile(latencies, 0.5) <<
+                std::setw(11) << percentile(latencies, 0.99) << std::endl;
+        }
+    }
+
+    session.reset();
+
+    if (!temp.empty() && std::system(("rm -rf " + temp).c_str()))
+    {
+        std::cout << "Could not remove " << temp << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,413 @@
+// Compares generic per-dimension transcoding against our planned and
+// specialized paths for a handful of commonly requested schemas, and checks
+// both against the conversion PDAL performs when entwine writes points in a
+// requested schema, including its rounding of ties and its failures on values
+// out of range.
+//
+// Build and run with:
+//      make transcode && ./transcode [numPoints]
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "util/transcoder.hpp"
+
+namespace
+{
+    // A typical stored layout: X, Y, Z, Intensity, Red, Green, Blue,
+    // Classification, GpsTime.
+    const std::size_t nativeSize(41);
+
+    std::vector<char> makeNative(const std::size_t numPoints)
+    {
+        std::vector<char> data(numPoints * nativeSize);
+        std::mt19937 gen(42);
+        std::uniform_real_distribution<double> coord(-1000.0, 1000.0);
+        // Colors and intensities that fit in 8 bits, since some of our
+        // cases narrow them, which fails for larger values.
+        std::uniform_int_distribution<int> u16(0, 255);
+        std::uniform_int_distribution<int> u8(0, 255);
+
+        char* pos(data.data());
+
+        for (std::size_t i(0); i < numPoints; ++i)
+        {
+            for (std::size_t j(0); j < 3; ++j)
+            {
+                const double d(coord(gen));
+                std::memcpy(pos + j * 8, &d, 8);
+            }
+
+            for (std::size_t j(0); j < 4; ++j)
+            {
+                const uint16_t v(u16(gen));
+                std::memcpy(pos + 24 + j * 2, &v, 2);
+            }
+
+            pos[32] = static_cast<char>(u8(gen));
+
+            const double t(coord(gen) * 1000.0);
+            std::memcpy(pos + 33, &t, 8);
+
+            pos += nativeSize;
+        }
+
+        return data;
+    }
+
+    struct Case
+    {
+        std::string name;
+        std::size_t outSize;
+        std::vector<Transcoder::Field> fields;
+        double scale;
+    };
+
+    typedef Transcoder::Field F;
+
+    std::vector<Case> cases()
+    {
+        std::vector<Case> result;
+
+        result.push_back(Case {
+            "XYZ float, Intensity",
+            14,
+            {
+                F(ValueType::Double, 0, ValueType::Float, 0),
+                F(ValueType::Double, 8, ValueType::Float, 4),
+                F(ValueType::Double, 16, ValueType::Float, 8),
+                F(ValueType::Uint16, 24, ValueType::Uint16, 12)
+            },
+            1
+        });
+
+        result.push_back(Case {
+            "XYZ float, RGB uint8",
+            15,
+            {
+                F(ValueType::Double, 0, ValueType::Float, 0),
+                F(ValueType::Double, 8, ValueType::Float, 4),
+                F(ValueType::Double, 16, ValueType::Float, 8),
+                F(ValueType::Uint16, 26, ValueType::Uint8, 12),
+                F(ValueType::Uint16, 28, ValueType::Uint8, 13),
+                F(ValueType::Uint16, 30, ValueType::Uint8, 14)
+            },
+            1
+        });
+
+        result.push_back(Case {
+            "XYZ scaled int32, RGB",
+            18,
+            {
+                F(ValueType::Double, 0, ValueType::Int32, 0, true, 12.5),
+                F(ValueType::Double, 8, ValueType::Int32, 4, true, -3.25),
+                F(ValueType::Double, 16, ValueType::Int32, 8, true, 100),
+                F(ValueType::Uint16, 26, ValueType::Uint16, 12),
+                F(ValueType::Uint16, 28, ValueType::Uint16, 14),
+                F(ValueType::Uint16, 30, ValueType::Uint16, 16)
+            },
+            0.01
+        });
+
+        result.push_back(Case {
+            "XYZ scaled int32, mixed",
+            21,
+            {
+                F(ValueType::Double, 0, ValueType::Int32, 0, true),
+                F(ValueType::Double, 8, ValueType::Int32, 4, true),
+                F(ValueType::Double, 16, ValueType::Int32, 8, true),
+                F(ValueType::Uint8, 32, ValueType::Uint16, 12),
+                F(ValueType::Double, 33, ValueType::Float, 14),
+                F(ValueType::Uint16, 24, ValueType::Uint8, 18)
+            },
+            0.001
+        });
+
+        return result;
+    }
+
+    // PDAL's Utils::sround().
+    double sround(const double r)
+    {
+        return (r > 0.0) ? std::floor(r + 0.5) : std::ceil(r - 0.5);
+    }
+
+    // PDAL's Utils::numericCast(), from a double, which is how entwine hands
+    // each value to PDAL.  Returns false if the value is out of range.
+    template<typename Out> bool numericCast(double in, char* out)
+    {
+        if (std::is_integral<Out>::value) in = sround(in);
+
+        if (
+                !(in >= static_cast<double>(
+                    std::numeric_limits<Out>::lowest())) ||
+                !(in <= static_cast<double>(std::numeric_limits<Out>::max())))
+        {
+            return false;
+        }
+
+        const Out value(static_cast<Out>(in));
+        std::memcpy(out, &value, sizeof(Out));
+        return true;
+    }
+
+    double load(const ValueType type, const char* pos)
+    {
+        switch (type)
+        {
+            case ValueType::Uint8:
+                return *reinterpret_cast<const uint8_t*>(pos);
+            case ValueType::Uint16:
+            {
+                uint16_t v; std::memcpy(&v, pos, 2); return v;
+            }
+            case ValueType::Double:
+            {
+                double v; std::memcpy(&v, pos, 8); return v;
+            }
+            default:
+                throw std::runtime_error("Unsupported reference input");
+        }
+    }
+
+    bool store(const ValueType type, const double value, char* pos)
+    {
+        switch (type)
+        {
+            case ValueType::Uint8:  return numericCast<uint8_t>(value, pos);
+            case ValueType::Uint16: return numericCast<uint16_t>(value, pos);
+            case ValueType::Int32:  return numericCast<int32_t>(value, pos);
+            case ValueType::Float:  return numericCast<float>(value, pos);
+            case ValueType::Double: return numericCast<double>(value, pos);
+            default:
+                throw std::runtime_error("Unsupported reference output");
+        }
+    }
+
+    // Points as PDAL would produce them for entwine, or false if PDAL would
+    // fail to convert any value.
+    bool reference(
+            const std::vector<Transcoder::Field>& fields,
+            const double scale,
+            const char* in,
+            const std::size_t inSize,
+            const std::size_t numPoints,
+            char* out,
+            const std::size_t outSize)
+    {
+        std::memset(out, 0, numPoints * outSize);
+
+        for (std::size_t i(0); i < numPoints; ++i)
+        {
+            for (const Transcoder::Field& f : fields)
+            {
+                double value(load(f.inType, in + i * inSize + f.inPos));
+                if (f.scaled) value = (value - f.offset) / scale;
+
+                if (!store(f.outType, value, out + i * outSize + f.outPos))
+                {
+                    return false;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    // Transcode a few points with each of our paths, and compare the results
+    // against PDAL's, which must fail wherever ours do.
+    bool agrees(
+            const std::vector<Transcoder::Field>& fields,
+            const double scale,
+            const std::vector<double>& xyz,
+            const std::size_t outSize)
+    {
+        const std::size_t numPoints(xyz.size() / 3);
+        std::vector<char> native(numPoints * nativeSize, 0);
+
+        for (std::size_t i(0); i < numPoints; ++i)
+        {
+            std::memcpy(native.data() + i * nativeSize, &xyz[i * 3], 24);
+        }
+
+        const Transcoder transcoder(nativeSize, outSize, fields, scale);
+
+        std::vector<char> expected(numPoints * outSize);
+        const bool valid(
+                reference(
+                    fields,
+                    scale,
+                    native.data(),
+                    nativeSize,
+                    numPoints,
+                    expected.data(),
+                    outSize));
+
+        for (std::size_t generic(0); generic < 2; ++generic)
+        {
+            std::vector<char> actual(numPoints * outSize);
+
+            try
+            {
+                if (generic)
+                {
+                    transcoder.transcodeGeneric(
+                            native.data(),
+                            numPoints,
+                            actual.data());
+                }
+                else
+                {
+                    transcoder.transcode(
+                            native.data(),
+                            numPoints,
+                            actual.data());
+                }
+
+                if (!valid || actual != expected) return false;
+            }
+            catch (std::runtime_error&)
+            {
+                if (valid) return false;
+            }
+        }
+
+        return true;
+    }
+
+    // Values at the edges of PDAL's behavior, through the fast paths.
+    bool edges()
+    {
+        const double nan(std::numeric_limits<double>::quiet_NaN());
+
+        // Scaled by a half, these are ties, which are rounded away from zero.
+        const std::vector<double> ties
+        {
+            1.25, -1.25, 0.75,
+            0.25, -0.25, 0,
+            -0.0, 1073741823.75, -1073741824.25
+        };
+
+        const std::vector<Transcoder::Field> scaled
+        {
+            F(ValueType::Double, 0, ValueType::Int32, 0, true),
+            F(ValueType::Double, 8, ValueType::Int32, 4, true),
+            F(ValueType::Double, 16, ValueType::Int32, 8, true)
+        };
+
+        const std::vector<Transcoder::Field> floats
+        {
+            F(ValueType::Double, 0, ValueType::Float, 0),
+            F(ValueType::Double, 8, ValueType::Float, 4),
+            F(ValueType::Double, 16, ValueType::Float, 8)
+        };
+
+        return
+            agrees(scaled, 0.5, ties, 12) &&
+            agrees(scaled, 0.5, { 1, 2, 1073741824 }, 12) &&
+            agrees(scaled, 0.5, { 1, -1073741824.5, 3 }, 12) &&
+            agrees(scaled, 0.5, { 1, 2, nan }, 12) &&
+            agrees(floats, 1, { 1.5, -2.5, 1e38 }, 12) &&
+            agrees(floats, 1, { 1, 1e300, 3 }, 12) &&
+            agrees(floats, 1, { nan, 2, 3 }, 12);
+    }
+
+    template<typename F> double mpps(F f, const std::size_t numPoints)
+    {
+        // Take the best of a few runs.
+        double best(0);
+
+        for (std::size_t i(0); i < 5; ++i)
+        {
+            const auto start(std::chrono::steady_clock::now());
+            f();
+            const std::chrono::duration<double> elapsed(
+                    std::chrono::steady_clock::now() - start);
+
+            const double rate(numPoints / elapsed.count() / 1000000.0);
+            if (rate > best) best = rate;
+        }
+
+        return best;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const std::size_t numPoints(argc > 1 ? std::atol(argv[1]) : 4000000);
+    const std::vector<char> native(makeNative(numPoints));
+
+    std::cout << "Points: " << numPoints << std::endl;
+    std::cout <<
+        std::left << std::setw(26) << "Schema" <<
+        std::setw(22) << "Path" <<
+        std::right << std::setw(12) << "Generic" <<
+        std::setw(12) << "Compiled" <<
+        std::setw(10) << "Speedup" <<
+        "   (millions of points per second)" << std::endl;
+
+    int rc(0);
+
+    for (const Case& c : cases())
+    {
+        const Transcoder transcoder(nativeSize, c.outSize, c.fields, c.scale);
+
+        std::vector<char> generic(numPoints * c.outSize);
+        std::vector<char> compiled(numPoints * c.outSize);
+
+        const double g(mpps([&]()
+        {
+            transcoder.transcodeGeneric(
+                    native.data(),
+                    numPoints,
+                    generic.data());
+        }, numPoints));
+
+        const double p(mpps([&]()
+        {
+            transcoder.transcode(native.data(), numPoints, compiled.data());
+        }, numPoints));
+
+        std::vector<char> expected(numPoints * c.outSize);
+        const bool same(
+                generic == compiled &&
+                reference(
+                    c.fields,
+                    c.scale,
+                    native.data(),
+                    nativeSize,
+                    numPoints,
+                    expected.data(),
+                    c.outSize) &&
+                compiled == expected);
+
+        if (!same) rc = 1;
+
+        std::cout << std::fixed << std::setprecision(1) <<
+            std::left << std::setw(26) << c.name <<
+            std::setw(22) << transcoder.path() <<
+            std::right << std::setw(12) << g <<
+            std::setw(12) << p <<
+            std::setw(9) << p / g << "x" <<
+            (same ? "" : "   MISMATCH") << std::endl;
+    }
+
+    const bool edgesAgree(edges());
+    if (!edgesAgree) rc = 1;
+
+    std::cout << "Edge cases " <<
+        (edgesAgree ? "match PDAL" : "MISMATCH PDAL") << std::endl;
+
+    return rc;
+}
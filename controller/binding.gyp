@@ -14,10 +14,24 @@
                 './session/read-queries/entwine.cpp',
                 './session/read-queries/unindexed.cpp',
 
+                './session/types/query-limits.cpp',
                 './session/types/source-manager.cpp',
 
+                './session/util/binary-hierarchy.cpp',
+                './session/util/block-ring.cpp',
                 './session/util/buffer-pool.cpp',
-                './session/util/once.cpp'
+                './session/util/caching-driver.cpp',
+                './session/util/disk-cache.cpp',
+                './session/util/hierarchy-cache.cpp',
+                './session/util/histogram.cpp',
+                './session/util/once.cpp',
+                './session/util/prefetcher.cpp',
+                './session/util/read-cache.cpp',
+                './session/util/read-driver.cpp',
+                './session/util/read-scheduler.cpp',
+                './session/util/session-registry.cpp',
+                './session/util/task-pool.cpp',
+                './session/util/transcoder.cpp'
             ],
             'include_dirs': [
                 './session'
@@ -1,10 +1,8 @@
 var console = require('clim')(),
     querystring = require('querystring'),
-    Session = require('./build/Release/session').Bindings,
-    threads = Math.ceil(require('os').cpus().length * 1.2),
-
-    // resource name -> { session: session, accessed: Date }
-    resources = { };
+    addon = require('./build/Release/session'),
+    Session = addon.Bindings,
+    threads = Math.ceil(require('os').cpus().length * 1.2);
 
 (function() {
     'use strict';
@@ -22,9 +20,18 @@ var console = require('clim')(),
         }
 
         var chunkCacheSize = config.queryLimits.chunkCacheSize;
+        this.queryLimits = JSON.stringify(config.queryLimits);
         var timeoutMinutes = getTimeout(config.resourceTimeoutMinutes);
         var timeoutMs = timeoutMinutes * 60 * 1000;
         var a = JSON.stringify(this.config.arbiter) || '';
+        var sessionCacheMb = config.sessionCacheMb;
+        if (sessionCacheMb === undefined) sessionCacheMb = 1024;
+        var notFoundSeconds = config.notFoundSeconds;
+        if (notFoundSeconds === undefined) notFoundSeconds = 30;
+        var d = config.diskCache ? JSON.stringify(config.diskCache) : '';
+        var preload = config.preload || null;
+        var preloadDepths = preload ? (preload.coldDepths || 0) : -1;
+        this.timingSampleRate = config.readTimingSampleRate || 0;
 
         if (chunkCacheSize < 16) chunkCacheSize = 16;
         process.env.UV_THREADPOOL_SIZE = threads;
@@ -32,39 +39,29 @@ var console = require('clim')(),
         console.log('Using');
         console.log('\tChunk cache size:', chunkCacheSize);
         console.log('\tLibuv threadpool size:', threads);
+        console.log('\tSession cache size (MB):', sessionCacheMb);
+        if (d) console.log('\tDisk cache:', config.diskCache);
         console.log('Read paths:', this.config.paths);
 
+        // Sessions are shared between requests by the addon, which evicts
+        // idle ones to stay within its memory budget.  Each handle obtained
+        // here is good for a single command.
         this.getSession = (name, cb) => {
-            var session;
-            var now = new Date();
-
-            if (resources[name]) {
-                session = resources[name].session;
-            }
-            else {
-                session = new Session();
-                resources[name] = { session: session };
-            }
-
-            resources[name].accessed = now;
-
+            var session = new Session();
             var paths = this.config.paths;
 
-            // Call every time, even if this name was found in our session
-            // mapping, to ensure that initialization has finished before the
-            // session is used.
+            // Wait for initialization to finish, even if this resource is
+            // already open, before the session is used.
             try {
-                session.create(name, paths, chunkCacheSize, a, function(err) {
-                    if (err) {
-                        console.warn(name, 'could not be created');
-                        delete resources[name];
-                    }
-
-                    return cb(err, session);
-                });
+                session.create(
+                    name, paths, chunkCacheSize, a, sessionCacheMb,
+                    notFoundSeconds, d, preloadDepths,
+                    function(err) {
+                        if (err) console.warn(name, 'could not be created');
+                        return cb(err, session);
+                    });
             }
             catch (e) {
-                delete resources[name];
                 console.warn('Caught exception in CREATE:', e);
 
                 return cb(this.error(500, 'Unknown error during create'));
@@ -72,19 +69,23 @@ var console = require('clim')(),
         };
 
         var clean = () => {
-            var now = new Date();
-
-            Object.keys(resources).forEach((name) => {
-                if (now - resources[name].accessed > timeoutMs) {
-                    console.log('Purging', name);
-                    delete resources[name];
-                }
-            });
-
+            addon.sweep(timeoutMinutes * 60);
             setTimeout(clean, timeoutMs);
         };
 
-        setTimeout(clean, timeoutMs);
+        if (timeoutMs) setTimeout(clean, timeoutMs);
+
+        // Open these resources now, which preloads them.  Their handles
+        // aren't needed, so these sessions are evictable as soon as their
+        // preloading is done.
+        if (preload && preload.resources) {
+            preload.resources.forEach((name) => {
+                this.getSession(name, (err, session) => {
+                    if (!err) console.log('Preloading', name);
+                    if (session) session.release();
+                });
+            });
+        }
     };
 
     Controller.prototype.info = function(resource, cb) {
@@ -101,32 +102,125 @@ var console = require('clim')(),
         console.log('controller::read');
 
         var schema = query.schema;
-        var compress =
-            query.hasOwnProperty('compress') &&
-            query.compress.toLowerCase() == 'true';
+        // Either a single laz-perf stream, or independently compressed
+        // blocks which may be compressed in parallel.
+        var compress = 'none';
+        if (query.hasOwnProperty('compress')) {
+            var c = query.compress.toLowerCase();
+            if (c == 'true') compress = 'stream';
+            else if (c == 'blocks') compress = 'blocks';
+        }
         var normalize =
             query.hasOwnProperty('normalize') &&
             query.normalize.toLowerCase() == 'true';
         var scale = query.hasOwnProperty('scale') ? parseFloat(query.scale) : 0;
         var offset = query.hasOwnProperty('offset') ? query.offset : null;
+        var limits = this.batchLimits(query.batchKb, query.maxBatchKb);
+        var start = process.hrtime();
 
         // Simplify our query decision tree for later.
         delete query.schema;
         delete query.compress;
         delete query.scale;
         delete query.offset;
+        delete query.batchKb;
+        delete query.maxBatchKb;
 
-        this.getSession(resource, function(err, session) {
+        this.getSession(resource, (err, session) => {
             if (err) return onInit(err);
 
-            var initCb = (err) => onInit(err);
-            var dataCb = (err, data, done) => onData(err, data, done);
+            var createMicros = this.since(start);
+
+            // Handed to onInit so callers can apply backpressure.
+            var read = null;
+
+            var initCb = (err) => onInit(err, err ? undefined : read);
+
+            // The final chunk comes with the timing of each phase of this
+            // read, to which we add the time taken to open its resource.
+            var dataCb = (err, data, done, t) => {
+                var timing = t ? JSON.parse(t) : undefined;
+
+                if (timing) {
+                    timing.createMicros = createMicros;
+                    timing.totalMicros += createMicros;
+                }
 
-            session.read(
-                schema, compress, scale, offset, query, initCb, dataCb);
+                return onData(err, data, done, timing);
+            };
+
+            var readId = session.read(
+                schema, compress, scale, offset, limits, query, initCb, dataCb);
+
+            if (readId !== undefined) {
+                read = {
+                    readId: readId,
+                    pause: () => session.pause(readId),
+                    resume: () => session.resume(readId),
+                    cancel: () => session.cancel(readId)
+                };
+            }
         });
     };
 
+    // Per-request batch sizes may only lower those of our configuration, so
+    // clients can't force overly large buffers.
+    Controller.prototype.batchLimits = function(batchKb, maxBatchKb) {
+        if (batchKb === undefined && maxBatchKb === undefined) {
+            return this.queryLimits;
+        }
+
+        var limits = JSON.parse(this.queryLimits);
+        var lower = (key, raw, fallback) => {
+            var value = parseInt(raw);
+            var configured =
+                limits.hasOwnProperty(key) ? limits[key] : fallback;
+
+            if (isNaN(value) || value < 0) return;
+
+            // A maximum of zero means unlimited.
+            if (key == 'maxBatchKb' && !value) value = configured;
+            if (configured && value > configured) value = configured;
+            limits[key] = value;
+        };
+
+        if (batchKb !== undefined) lower('batchKb', batchKb, 1024);
+        if (maxBatchKb !== undefined) lower('maxBatchKb', maxBatchKb, 4096);
+
+        return JSON.stringify(limits);
+    };
+
+    // Microseconds elapsed since a process.hrtime() timestamp.
+    Controller.prototype.since = function(start) {
+        var elapsed = process.hrtime(start);
+        return Math.round(elapsed[0] * 1e6 + elapsed[1] / 1e3);
+    };
+
+    // Called by our interfaces once a read is complete, with its timing as
+    // given to onData plus their own writeMicros.  A sample of reads is
+    // logged as single-line JSON for aggregation.
+    Controller.prototype.logTiming = function(resource, timing) {
+        var rate = this.timingSampleRate;
+        if (!timing || !rate || Math.random() >= rate) return;
+
+        console.log(JSON.stringify({
+            event: 'read',
+            resource: resource,
+            timing: timing
+        }));
+    };
+
+    // Return the storage of a chunk given to onData to the addon's pool once
+    // it has been written.  The chunk must not be used afterward.  Chunks
+    // which are never recycled are returned once they're garbage collected.
+    Controller.prototype.recycle = function(data) {
+        addon.recycle(data);
+    };
+
+    Controller.prototype.stats = function() {
+        return JSON.parse(addon.stats());
+    };
+
     Controller.prototype.hierarchy = function(resource, query, cb) {
         console.log('controller::hierarchy');
 
@@ -134,9 +228,18 @@ var console = require('clim')(),
             query.hasOwnProperty('vertical') &&
             query.vertical.toLowerCase() == 'true';
 
+        // Binary hierarchies arrive as a Buffer, which is passed along as-is.
+        query.binary =
+            query.hasOwnProperty('format') &&
+            query.format.toLowerCase() == 'binary';
+
+        delete query.format;
+
         this.getSession(resource, (err, session) => {
             if (err) cb(err);
             else session.hierarchy(query, (err, string) => {
+                if (query.binary) return cb(err, string);
+
                 try {
                     return cb(null, JSON.parse(string));
                 }
@@ -18,6 +18,31 @@ http.globalAgent.maxSockets = 1024;
 (function() {
     'use strict';
 
+    // Read phases, in the order in which they occur, as named in the timing
+    // given to our read callback.
+    var phases = [
+        'create', 'queue', 'query', 'read', 'chunk', 'transcode', 'compress',
+        'pending', 'deliver', 'write', 'total'
+    ];
+
+    // Format a read's timing as a Server-Timing header value, with durations
+    // in milliseconds and counts as descriptions.
+    var serverTiming = function(timing) {
+        var metrics = phases
+            .filter((p) => timing.hasOwnProperty(p + 'Micros'))
+            .map((p) => p + ';dur=' + (timing[p + 'Micros'] / 1000).toFixed(3));
+
+        ['points', 'bytes', 'chunks'].forEach((c) => {
+            if (timing.hasOwnProperty(c)) {
+                metrics.push(c + ';desc=' + timing[c]);
+            }
+        });
+
+        if (timing.cached) metrics.push('cached');
+
+        return metrics.join(', ');
+    };
+
     var HttpHandler = function(controller, port, securePort, creds) {
         this.controller = controller;
         this.port = port;
@@ -25,13 +50,14 @@ http.globalAgent.maxSockets = 1024;
         this.creds = creds;
         this.config = this.controller.config;
         this.httpConfig = this.config.http || { };
+        this.maxBuffered = (this.httpConfig.maxBufferedKb || 8192) * 1024;
         this.auths = { };
     }
 
     HttpHandler.prototype.start = function(creds) {
         var app = express();
 
-        app.use(morgan('dev'));
+        app.use(morgan(this.httpConfig.logFormat || 'dev'));
         app.use(bodyParser.json());
         app.use(bodyParser.urlencoded({ extended: true }));
         app.use(cookieParser());
@@ -87,6 +113,7 @@ http.globalAgent.maxSockets = 1024;
 
     HttpHandler.prototype.registerCommands = function(app) {
         var controller = this.controller;
+        var maxBuffered = this.maxBuffered;
 
         if (this.config.auth) {
             console.log('Proxying auth requests to', this.config.auth.path);
@@ -164,37 +191,101 @@ http.globalAgent.maxSockets = 1024;
         });
 
         app.get('/resource/:resource(*)/read', function(req, res) {
-            // Terminate query on socket hangup.
+            // Terminate query on socket hangup, even if it's paused.
             var keepGoing = true;
-            req.on('close', () => keepGoing = false);
+            var read = null;
+            req.on('close', () => {
+                keepGoing = false;
+                if (read) read.cancel();
+            });
+
+            var buffered = () => res.socket ? res.socket.bufferSize : 0;
+
+            // If requested, the timing of each phase of this read is sent as
+            // a Server-Timing trailer.
+            var sendTiming =
+                req.query.hasOwnProperty('timing') &&
+                req.query.timing.toLowerCase() == 'true';
+            delete req.query.timing;
+
+            // Time spent paused while the client drained our writes.
+            var writeMicros = 0;
 
             controller.read(
                 req.params.resource,
                 req.query,
-                function(err) {
-                    if (err) return res.json(err.code || 500, err.message);
+                function(err, r) {
+                    if (err) {
+                        if (err.retryAfter) {
+                            res.header('Retry-After', err.retryAfter);
+                        }
+                        return res.json(err.code || 500, err.message);
+                    }
+                    read = r;
                     res.header('Content-Type', 'application/octet-stream');
+                    if (sendTiming) res.header('Trailer', 'Server-Timing');
                 },
-                function(err, data, done) {
+                function(err, data, done, timing) {
                     if (err) {
-                        console.error('Encountered data error');
+                        console.error('Encountered data error:', err.message);
+
+                        // Once our response has begun, its status can't
+                        // change, so cut it short rather than ending it
+                        // cleanly, letting the client know it's incomplete.
+                        if (res.headersSent) return res.destroy();
                         return res.status(err.code || 500).json(err.message);
                     }
 
-                    res.write(data);
-                    if (done) res.end();
+                    // Our chunk's storage is reused once it's been written.
+                    var written =
+                        res.write(data, () => controller.recycle(data));
+
+                    // If the client isn't keeping up, stop reading until our
+                    // writes have drained, rather than buffering the rest of
+                    // the response in memory.
+                    if (!written && !done && buffered() > maxBuffered) {
+                        var paused = process.hrtime();
+                        read.pause();
+                        res.once('drain', () => {
+                            writeMicros += controller.since(paused);
+                            read.resume();
+                        });
+                    }
+
+                    if (done) {
+                        if (timing) {
+                            timing.writeMicros = writeMicros;
+                            controller.logTiming(req.params.resource, timing);
+
+                            if (sendTiming) {
+                                res.addTrailers({
+                                    'Server-Timing': serverTiming(timing)
+                                });
+                            }
+                        }
+
+                        res.end();
+                    }
 
                     return keepGoing;
                 }
             );
         });
 
+        app.get('/stats', function(req, res) {
+            return res.json(controller.stats());
+        });
+
         app.get('/resource/:resource(*)/hierarchy', function(req, res) {
             var resource = req.params.resource;
             var query = req.query;
 
             controller.hierarchy(resource, query, (err, data) => {
                 if (err) return res.status(err.code || 500).json(err.message);
+                else if (Buffer.isBuffer(data)) {
+                    res.header('Content-Type', 'application/octet-stream');
+                    return res.send(data);
+                }
                 else return res.json(data);
             });
         });
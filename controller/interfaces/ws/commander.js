@@ -42,6 +42,7 @@ var _ = require('lodash');
                             command: msg.command,
                             status: 0,
                             message: err.message,
+                            retryAfter: err.retryAfter,
                         });
                     }
                     else {
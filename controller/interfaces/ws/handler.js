@@ -46,6 +46,16 @@ var
     }
 
     var registerCommands = function(controller, commander, ws) {
+        var wsConfig = controller.config.ws || { };
+        var maxBuffered = (wsConfig.maxBufferedKb || 8192) * 1024;
+
+        // Reads in progress on this socket, by ID.
+        var reads = { };
+
+        ws.on('close', () => {
+            Object.keys(reads).forEach((readId) => reads[readId].cancel());
+        });
+
         commander.on('info', function(msg, cb) {
             controller.info(msg.resource, cb);
         });
@@ -60,20 +70,77 @@ var
             delete params.summary;
 
             var readId;
+            var read = null;
+
+            // Bytes handed to the socket but not yet sent.
+            var unsent = 0;
+            var paused = null;
+
+            // Time spent paused while the socket caught up.
+            var writeMicros = 0;
 
             controller.read(
                 pipeline,
                 params,
                 function(err, res) {
-                    if (!err) readId = res.readId;
-                    numBytes[readId] = 0;
-                    cb(err, res);
+                    if (!err) {
+                        read = res;
+                        readId = res.readId;
+                        reads[readId] = read;
+                        numBytes[readId] = 0;
+                    }
+                    cb(err, err ? undefined : { readId: readId });
                 },
-                function(err, data, done) {
-                    if (err) console.log('TODO - handle data error in READ');
+                function(err, data, done, timing) {
+                    // A failure partway through ends this read, since
+                    // nothing more will follow.
+                    if (err) {
+                        delete reads[readId];
+                        delete numBytes[readId];
+
+                        if (ws.readyState == ws.OPEN) {
+                            ws.send(JSON.stringify({
+                                'command':  'read',
+                                'status':   0,
+                                'readId':   readId,
+                                'message':  err.message
+                            }));
+                        }
+
+                        return false;
+                    }
+
+                    if (ws.readyState != ws.OPEN) {
+                        controller.recycle(data);
+                        return false;
+                    }
 
                     numBytes[readId] += data.length;
-                    ws.send(data, { binary: true });
+                    unsent += data.length;
+
+                    ws.send(data, { binary: true }, () => {
+                        unsent -= data.length;
+                        controller.recycle(data);
+
+                        if (paused && unsent <= maxBuffered / 2) {
+                            writeMicros += controller.since(paused);
+                            paused = null;
+                            read.resume();
+                        }
+                    });
+
+                    // Stop reading until the socket catches up.
+                    if (!done && !paused && unsent > maxBuffered) {
+                        paused = process.hrtime();
+                        read.pause();
+                    }
+
+                    if (done) delete reads[readId];
+
+                    if (done && timing) {
+                        timing.writeMicros = writeMicros;
+                        controller.logTiming(pipeline, timing);
+                    }
 
                     if (done && summary) {
                         ws.send(
@@ -81,7 +148,8 @@ var
                                 'command':  'summary',
                                 'status':   1,
                                 'readId':   readId,
-                                'numBytes': numBytes[readId]
+                                'numBytes': numBytes[readId],
+                                'timing':   timing
                             }),
                             null,
                             function() {
@@ -0,0 +1,635 @@
+#include "connection.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include <sys/epoll.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "util/buffer-pool.hpp"
+
+#include "event-loop.hpp"
+#include "server.hpp"
+#include "websocket.hpp"
+
+namespace
+{
+    // Websocket commands are small JSON objects.
+    const std::size_t maxMessageBytes(1024 * 1024);
+
+    // Pipelined requests beyond this are refused.
+    const std::size_t maxInputBytes(HttpRequest::maxHeadBytes * 2);
+
+    const std::size_t maxSegments(64);
+    const std::size_t readBytes(64 * 1024);
+
+    std::string hex(const std::size_t value)
+    {
+        std::ostringstream ss;
+        ss << std::hex << value;
+        return ss.str();
+    }
+}
+
+const char* Connection::Segment::begin() const
+{
+    return buffer ? buffer->data() : data.data();
+}
+
+std::size_t Connection::Segment::size() const
+{
+    return buffer ? buffer->size() : data.size();
+}
+
+Connection::Connection(
+        const int fd,
+        EventLoop& loop,
+        ItcBufferPool& itcBufferPool)
+    : m_fd(fd)
+    , m_loop(loop)
+    , m_itcBufferPool(itcBufferPool)
+    , m_server(nullptr)
+    , m_in()
+    , m_skip(0)
+    , m_busy(false)
+    , m_requestLine()
+    , m_requestStart()
+    , m_code(0)
+    , m_sent(0)
+    , m_minorVersion(1)
+    , m_keepAlive(true)
+    , m_chunked(false)
+    , m_webSocket(false)
+    , m_messageOpcode(WebSocket::Continuation)
+    , m_message()
+    , m_out()
+    , m_offset(0)
+    , m_unsent(0)
+    , m_writable(false)
+    , m_closeWhenFlushed(false)
+    , m_below()
+    , m_onClose()
+    , m_nextCloseId(0)
+{ }
+
+Connection::~Connection()
+{
+    if (m_fd >= 0) ::close(m_fd);
+
+    for (Segment& segment : m_out)
+    {
+        if (segment.buffer) m_itcBufferPool.release(segment.buffer);
+    }
+}
+
+void Connection::start(Server& server)
+{
+    m_server = &server;
+
+    // Our handler keeps us alive until we're closed.
+    std::shared_ptr<Connection> self(shared_from_this());
+    m_loop.add(m_fd, EPOLLIN, [self](std::uint32_t events)->void
+    {
+        self->handle(events);
+    });
+}
+
+void Connection::handle(const std::uint32_t events)
+{
+    if (closed()) return;
+
+    if (events & (EPOLLERR | EPOLLHUP))
+    {
+        close();
+        return;
+    }
+
+    if (events & EPOLLOUT) flush();
+    if (events & EPOLLIN && !closed()) receive();
+}
+
+void Connection::receive()
+{
+    char data[readBytes];
+
+    while (true)
+    {
+        const ssize_t n(::read(m_fd, data, readBytes));
+
+        if (n > 0)
+        {
+            // Once we're closing, input is discarded.
+            if (!m_closeWhenFlushed) m_in.append(data, n);
+        }
+        else if (!n)
+        {
+            close();
+            return;
+        }
+        else if (errno == EINTR)
+        {
+            continue;
+        }
+        else if (errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            break;
+        }
+        else
+        {
+            close();
+            return;
+        }
+    }
+
+    if (m_in.size() > (m_webSocket ? maxMessageBytes + 16 : maxInputBytes))
+    {
+        if (m_webSocket) closeWebSocket(1009);
+        else close();
+        return;
+    }
+
+    process();
+}
+
+void Connection::process()
+{
+    while (!closed() && (m_webSocket ? processWebSocket() : processHttp()))
+    { }
+}
+
+bool Connection::processHttp()
+{
+    if (m_busy || m_closeWhenFlushed) return false;
+
+    // We only serve GET requests, so any body is ignored.
+    const std::size_t skipped(std::min(m_skip, m_in.size()));
+    m_in.erase(0, skipped);
+    m_skip -= skipped;
+
+    if (m_skip || m_in.empty()) return false;
+
+    HttpRequest request;
+    std::size_t consumed(0);
+
+    const HttpRequest::Parse parse(request.parse(m_in, consumed));
+    if (parse == HttpRequest::Parse::Incomplete) return false;
+
+    m_busy = true;
+    m_requestStart = std::chrono::steady_clock::now();
+
+    if (parse == HttpRequest::Parse::Invalid)
+    {
+        m_requestLine = "Invalid request";
+        m_minorVersion = 1;
+        m_keepAlive = false;
+
+        respond(400, Headers());
+        return false;
+    }
+
+    m_in.erase(0, consumed);
+    m_skip = request.bodyBytes();
+    m_requestLine = request.method() + " " + request.target();
+    m_minorVersion = request.minorVersion();
+    m_keepAlive = request.keepAlive();
+
+    if (request.upgrade()) upgrade(request);
+    else m_server->request(shared_from_this(), request);
+
+    return true;
+}
+
+void Connection::upgrade(const HttpRequest& request)
+{
+    const std::string key(request.header("sec-websocket-key"));
+
+    if (
+            request.method() != "GET" ||
+            key.empty() ||
+            request.header("sec-websocket-version") != "13")
+    {
+        m_keepAlive = false;
+        respond(400, Headers());
+        return;
+    }
+
+    queue(
+            HttpResponse::statusLine(101) +
+            "Upgrade: websocket\r\n"
+            "Connection: Upgrade\r\n"
+            "Sec-WebSocket-Accept: " + WebSocket::accept(key) + "\r\n"
+            "\r\n");
+
+    m_code = 101;
+    m_sent = 0;
+    m_skip = 0;
+    m_keepAlive = true;
+    m_webSocket = true;
+
+    finishResponse();
+}
+
+bool Connection::processWebSocket()
+{
+    if (m_closeWhenFlushed || m_in.empty()) return false;
+
+    WebSocket::Frame frame;
+    std::size_t consumed(0);
+
+    const WebSocket::Parse parse(
+            WebSocket::parse(m_in, maxMessageBytes, frame, consumed));
+
+    if (parse == WebSocket::Parse::Incomplete) return false;
+
+    if (parse == WebSocket::Parse::Invalid)
+    {
+        closeWebSocket(1002);
+        return false;
+    }
+
+    m_in.erase(0, consumed);
+
+    switch (frame.opcode)
+    {
+        case WebSocket::Ping:
+        {
+            queue(
+                    WebSocket::header(WebSocket::Pong, frame.payload.size()) +
+                    frame.payload);
+            flush();
+            return true;
+        }
+        case WebSocket::Pong:
+        {
+            return true;
+        }
+        case WebSocket::Close:
+        {
+            // Echo our client's status code, and we're done.
+            const std::string payload(frame.payload.substr(0, 2));
+
+            queue(
+                    WebSocket::header(WebSocket::Close, payload.size()) +
+                    payload);
+
+            m_closeWhenFlushed = true;
+            flush();
+            return false;
+        }
+        case WebSocket::Text:
+        case WebSocket::Binary:
+        {
+            if (m_messageOpcode != WebSocket::Continuation)
+            {
+                closeWebSocket(1002);
+                return false;
+            }
+
+            m_messageOpcode = frame.opcode;
+            m_message = frame.payload;
+            break;
+        }
+        case WebSocket::Continuation:
+        {
+            if (m_messageOpcode == WebSocket::Continuation)
+            {
+                closeWebSocket(1002);
+                return false;
+            }
+
+            if (m_message.size() + frame.payload.size() > maxMessageBytes)
+            {
+                closeWebSocket(1009);
+                return false;
+            }
+
+            m_message += frame.payload;
+            break;
+        }
+        default:
+        {
+            closeWebSocket(1002);
+            return false;
+        }
+    }
+
+    if (frame.fin)
+    {
+        std::string message;
+        message.swap(m_message);
+        m_messageOpcode = WebSocket::Continuation;
+
+        m_server->message(shared_from_this(), message);
+    }
+
+    return true;
+}
+
+void Connection::respond(
+        const int code,
+        const Headers& headers,
+        const std::string& body)
+{
+    if (closed()) return;
+
+    std::string head(HttpResponse::statusLine(code, m_minorVersion));
+
+    for (const auto& header : headers)
+    {
+        head += header.first + ": " + header.second + "\r\n";
+    }
+
+    head += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+
+    if (!m_keepAlive) head += "Connection: close\r\n";
+    else if (!m_minorVersion) head += "Connection: keep-alive\r\n";
+
+    queue(head + "\r\n" + body);
+
+    m_code = code;
+    m_sent = body.size();
+
+    finishResponse();
+}
+
+void Connection::beginResponse(const int code, const Headers& headers)
+{
+    if (closed()) return;
+
+    // HTTP/1.0 clients can't take chunked responses, so theirs end when we
+    // close.
+    m_chunked = m_minorVersion > 0;
+    if (!m_chunked) m_keepAlive = false;
+
+    std::string head(HttpResponse::statusLine(code, m_minorVersion));
+
+    for (const auto& header : headers)
+    {
+        head += header.first + ": " + header.second + "\r\n";
+    }
+
+    if (m_chunked) head += "Transfer-Encoding: chunked\r\n";
+    if (!m_keepAlive) head += "Connection: close\r\n";
+
+    queue(head + "\r\n");
+
+    m_code = code;
+    m_sent = 0;
+}
+
+void Connection::sendChunk(std::shared_ptr<ItcBuffer> buffer)
+{
+    const std::size_t size(buffer->size());
+
+    // An empty chunk would end our response.
+    if (closed() || !size)
+    {
+        m_itcBufferPool.release(buffer);
+        return;
+    }
+
+    m_sent += size;
+
+    if (m_chunked) queue(hex(size) + "\r\n");
+    queue(buffer);
+    if (m_chunked) queue(std::string("\r\n"));
+
+    flush();
+}
+
+void Connection::endResponse()
+{
+    if (closed()) return;
+
+    if (m_chunked) queue(std::string("0\r\n\r\n"));
+    finishResponse();
+}
+
+void Connection::abortResponse()
+{
+    if (closed()) return;
+
+    m_chunked = false;
+    m_keepAlive = false;
+    finishResponse();
+}
+
+void Connection::finishResponse()
+{
+    const double ms(
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - m_requestStart).count() /
+            1000.0);
+
+    std::cout << m_requestLine << " " << m_code << " " <<
+        std::fixed << std::setprecision(3) << ms << " ms - " << m_sent <<
+        std::endl;
+
+    m_busy = false;
+    if (!m_keepAlive) m_closeWhenFlushed = true;
+
+    flush();
+
+    // Serve any pipelined requests once we've unwound.
+    if (!closed() && !m_in.empty())
+    {
+        std::shared_ptr<Connection> self(shared_from_this());
+        m_loop.post([self]()->void { self->process(); });
+    }
+}
+
+void Connection::sendText(const std::string& text)
+{
+    if (closed() || m_closeWhenFlushed) return;
+
+    queue(WebSocket::header(WebSocket::Text, text.size()) + text);
+    flush();
+}
+
+void Connection::sendBinary(std::shared_ptr<ItcBuffer> buffer)
+{
+    if (closed() || m_closeWhenFlushed)
+    {
+        m_itcBufferPool.release(buffer);
+        return;
+    }
+
+    queue(WebSocket::header(WebSocket::Binary, buffer->size()));
+    queue(buffer);
+    flush();
+}
+
+void Connection::closeWebSocket(const int code)
+{
+    if (closed() || m_closeWhenFlushed) return;
+
+    std::string payload;
+    payload.push_back(static_cast<char>((code >> 8) & 0xFF));
+    payload.push_back(static_cast<char>(code & 0xFF));
+
+    queue(WebSocket::header(WebSocket::Close, payload.size()) + payload);
+
+    m_closeWhenFlushed = true;
+    flush();
+}
+
+void Connection::whenBelow(const std::size_t bytes, std::function<void()> f)
+{
+    if (closed()) return;
+
+    if (m_unsent <= bytes) f();
+    else m_below.emplace_back(bytes, f);
+}
+
+std::size_t Connection::onClose(std::function<void()> f)
+{
+    const std::size_t id(m_nextCloseId++);
+    m_onClose[id] = f;
+    return id;
+}
+
+void Connection::forget(const std::size_t id)
+{
+    m_onClose.erase(id);
+}
+
+void Connection::queue(std::string data)
+{
+    if (closed()) return;
+
+    m_unsent += data.size();
+    m_out.emplace_back(std::move(data));
+}
+
+void Connection::queue(std::shared_ptr<ItcBuffer> buffer)
+{
+    if (closed())
+    {
+        m_itcBufferPool.release(buffer);
+        return;
+    }
+
+    m_unsent += buffer->size();
+    m_out.emplace_back(buffer);
+}
+
+void Connection::flush()
+{
+    if (closed()) return;
+
+    iovec iov[maxSegments];
+
+    while (!m_out.empty())
+    {
+        std::size_t count(0);
+
+        for (
+                auto it(m_out.begin());
+                it != m_out.end() && count < maxSegments;
+                ++it, ++count)
+        {
+            const std::size_t offset(count ? 0 : m_offset);
+            iov[count].iov_base = const_cast<char*>(it->begin() + offset);
+            iov[count].iov_len = it->size() - offset;
+        }
+
+        const ssize_t n(::writev(m_fd, iov, count));
+
+        if (n < 0)
+        {
+            if (errno == EINTR) continue;
+
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                watch(true);
+                break;
+            }
+
+            close();
+            return;
+        }
+
+        std::size_t written(n);
+        m_unsent -= written;
+
+        // Written buffers go straight back to their pool.
+        while (!m_out.empty() && written >= m_out.front().size() - m_offset)
+        {
+            written -= m_out.front().size() - m_offset;
+            m_offset = 0;
+
+            if (m_out.front().buffer)
+            {
+                m_itcBufferPool.release(m_out.front().buffer);
+            }
+
+            m_out.pop_front();
+        }
+
+        m_offset += written;
+    }
+
+    if (m_out.empty()) watch(false);
+
+    if (!m_below.empty())
+    {
+        std::vector<std::function<void()>> ready;
+
+        auto it(m_below.begin());
+        while (it != m_below.end())
+        {
+            if (m_unsent <= it->first)
+            {
+                ready.push_back(it->second);
+                it = m_below.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+
+        for (const auto& f : ready) f();
+    }
+
+    if (m_out.empty() && m_closeWhenFlushed) close();
+}
+
+void Connection::watch(const bool writable)
+{
+    if (closed() || writable == m_writable) return;
+
+    m_writable = writable;
+    m_loop.modify(m_fd, EPOLLIN | (writable ? EPOLLOUT : 0));
+}
+
+void Connection::close()
+{
+    if (closed()) return;
+
+    // Removing our handler may drop the last reference to us otherwise.
+    std::shared_ptr<Connection> self(shared_from_this());
+
+    m_loop.remove(m_fd);
+    ::close(m_fd);
+    m_fd = -1;
+
+    for (Segment& segment : m_out)
+    {
+        if (segment.buffer) m_itcBufferPool.release(segment.buffer);
+    }
+
+    m_out.clear();
+    m_unsent = 0;
+    m_below.clear();
+
+    std::map<std::size_t, std::function<void()>> onClose;
+    onClose.swap(m_onClose);
+
+    for (const auto& p : onClose) p.second();
+}
+
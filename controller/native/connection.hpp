@@ -0,0 +1,149 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "http.hpp"
+
+class EventLoop;
+class ItcBuffer;
+class ItcBufferPool;
+class Server;
+
+// A client socket, serving HTTP/1.x requests one at a time until it is
+// upgraded to a websocket.  Responses are queued as a list of segments,
+// either owned strings or pooled buffers handed to us by a read, and written
+// with writev.  Pooled buffers are released once written, so their data is
+// never copied on its way to the socket.
+//
+// Connections are shared by their event loop handler, which holds them until
+// they are closed, and by any commands they're waiting on.  Everything here
+// must be called from the event loop.
+class Connection : public std::enable_shared_from_this<Connection>
+{
+public:
+    typedef std::vector<std::pair<std::string, std::string>> Headers;
+
+    Connection(int fd, EventLoop& loop, ItcBufferPool& itcBufferPool);
+    ~Connection();
+
+    // Begin serving requests to our server.
+    void start(Server& server);
+
+    // HTTP responses, one per request.  Either respond with a complete body,
+    // or begin a response and send its body in chunks.
+    void respond(
+            int code,
+            const Headers& headers,
+            const std::string& body = std::string());
+
+    void beginResponse(int code, const Headers& headers);
+    void sendChunk(std::shared_ptr<ItcBuffer> buffer);
+    void endResponse();
+
+    // Cut a chunked response short, so our client sees it as truncated.
+    void abortResponse();
+
+    // Websocket messages, once upgraded.
+    void sendText(const std::string& text);
+    void sendBinary(std::shared_ptr<ItcBuffer> buffer);
+
+    // Close a websocket with a status code.
+    void closeWebSocket(int code);
+
+    // Bytes queued but not yet written to our socket.
+    std::size_t unsent() const { return m_unsent; }
+
+    // Call f once no more than this many bytes are unsent.
+    void whenBelow(std::size_t bytes, std::function<void()> f);
+
+    // Call f when we are closed, unless forgotten.  Returns an ID with which
+    // to forget it.
+    std::size_t onClose(std::function<void()> f);
+    void forget(std::size_t id);
+
+    bool closed() const { return m_fd < 0; }
+    void close();
+
+private:
+    void handle(std::uint32_t events);
+    void receive();
+
+    // Handle whatever input we have, as far as we can.
+    void process();
+    bool processHttp();
+    bool processWebSocket();
+
+    void upgrade(const HttpRequest& request);
+    void finishResponse();
+
+    void queue(std::string data);
+    void queue(std::shared_ptr<ItcBuffer> buffer);
+    void flush();
+    void watch(bool writable);
+
+    struct Segment
+    {
+        explicit Segment(std::string data)
+            : data(std::move(data))
+            , buffer()
+        { }
+
+        explicit Segment(std::shared_ptr<ItcBuffer> buffer)
+            : data()
+            , buffer(buffer)
+        { }
+
+        const char* begin() const;
+        std::size_t size() const;
+
+        std::string data;
+        std::shared_ptr<ItcBuffer> buffer;
+    };
+
+    int m_fd;
+    EventLoop& m_loop;
+    ItcBufferPool& m_itcBufferPool;
+    Server* m_server;
+
+    std::string m_in;
+
+    // Body bytes of the current request still to be skipped.
+    std::size_t m_skip;
+
+    // Our current request, if one is being served.
+    bool m_busy;
+    std::string m_requestLine;
+    std::chrono::steady_clock::time_point m_requestStart;
+    int m_code;
+    std::size_t m_sent;
+    int m_minorVersion;
+    bool m_keepAlive;
+    bool m_chunked;
+
+    bool m_webSocket;
+    int m_messageOpcode;
+    std::string m_message;
+
+    std::deque<Segment> m_out;
+    std::size_t m_offset;
+    std::size_t m_unsent;
+    bool m_writable;
+    bool m_closeWhenFlushed;
+
+    std::vector<std::pair<std::size_t, std::function<void()>>> m_below;
+    std::map<std::size_t, std::function<void()>> m_onClose;
+    std::size_t m_nextCloseId;
+
+    // Disallow copy/assignment.
+    Connection(const Connection&);
+    Connection& operator=(const Connection&);
+};
+
@@ -0,0 +1,178 @@
+#include "event-loop.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+namespace
+{
+    const std::size_t maxEvents(256);
+
+    std::runtime_error error(const std::string& what)
+    {
+        return std::runtime_error(what + ": " + std::strerror(errno));
+    }
+}
+
+EventLoop::EventLoop()
+    : m_epoll(epoll_create1(EPOLL_CLOEXEC))
+    , m_wake(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+    , m_handlers()
+    , m_timers()
+    , m_posted()
+    , m_mutex()
+    , m_stop(false)
+{
+    if (m_epoll < 0 || m_wake < 0) throw error("Could not create event loop");
+
+    add(m_wake, EPOLLIN, [this](std::uint32_t)->void
+    {
+        std::uint64_t count(0);
+        if (::read(m_wake, &count, sizeof(count)) < 0 && errno != EAGAIN)
+        {
+            throw error("Could not read wake count");
+        }
+
+        runPosted();
+    });
+}
+
+EventLoop::~EventLoop()
+{
+    for (const int timer : m_timers) ::close(timer);
+    ::close(m_wake);
+    ::close(m_epoll);
+}
+
+void EventLoop::add(const int fd, const std::uint32_t events, Handler handler)
+{
+    epoll_event event;
+    std::memset(&event, 0, sizeof(event));
+    event.events = events;
+    event.data.fd = fd;
+
+    if (epoll_ctl(m_epoll, EPOLL_CTL_ADD, fd, &event) < 0)
+    {
+        throw error("Could not watch file descriptor");
+    }
+
+    m_handlers[fd] = std::make_shared<Handler>(handler);
+}
+
+void EventLoop::modify(const int fd, const std::uint32_t events)
+{
+    epoll_event event;
+    std::memset(&event, 0, sizeof(event));
+    event.events = events;
+    event.data.fd = fd;
+
+    if (epoll_ctl(m_epoll, EPOLL_CTL_MOD, fd, &event) < 0)
+    {
+        throw error("Could not modify file descriptor");
+    }
+}
+
+void EventLoop::remove(const int fd)
+{
+    epoll_ctl(m_epoll, EPOLL_CTL_DEL, fd, nullptr);
+    m_handlers.erase(fd);
+}
+
+void EventLoop::post(std::function<void()> task)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    const bool wake(m_posted.empty());
+    m_posted.push_back(task);
+    lock.unlock();
+
+    // If tasks were already waiting, the loop has already been woken.
+    if (wake)
+    {
+        const std::uint64_t one(1);
+        if (::write(m_wake, &one, sizeof(one)) < 0 && errno != EAGAIN)
+        {
+            throw error("Could not wake event loop");
+        }
+    }
+}
+
+void EventLoop::every(
+        const std::uint64_t milliseconds,
+        std::function<void()> task)
+{
+    const int timer(
+            timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC));
+    if (timer < 0) throw error("Could not create timer");
+
+    itimerspec spec;
+    spec.it_interval.tv_sec = milliseconds / 1000;
+    spec.it_interval.tv_nsec = (milliseconds % 1000) * 1000000;
+    spec.it_value = spec.it_interval;
+
+    if (timerfd_settime(timer, 0, &spec, nullptr) < 0)
+    {
+        ::close(timer);
+        throw error("Could not set timer");
+    }
+
+    m_timers.push_back(timer);
+
+    add(timer, EPOLLIN, [timer, task](std::uint32_t)->void
+    {
+        std::uint64_t expirations(0);
+        if (::read(timer, &expirations, sizeof(expirations)) > 0) task();
+    });
+}
+
+void EventLoop::run()
+{
+    std::vector<epoll_event> events(maxEvents);
+
+    while (!m_stop)
+    {
+        const int n(epoll_wait(m_epoll, events.data(), events.size(), -1));
+
+        if (n < 0)
+        {
+            if (errno == EINTR) continue;
+            throw error("Could not wait for events");
+        }
+
+        for (int i(0); i < n && !m_stop; ++i)
+        {
+            // A handler may remove itself, or others, while we're running
+            // this batch.  A descriptor that is closed and then reused
+            // within the batch may see a stale event, which its new handler
+            // sees as a spurious wakeup.
+            auto it(m_handlers.find(events[i].data.fd));
+            if (it == m_handlers.end()) continue;
+
+            const std::shared_ptr<Handler> handler(it->second);
+            (*handler)(events[i].events);
+        }
+    }
+}
+
+void EventLoop::stop()
+{
+    m_stop = true;
+    post([]()->void { });
+}
+
+void EventLoop::runPosted()
+{
+    std::vector<std::function<void()>> tasks;
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    tasks.swap(m_posted);
+    lock.unlock();
+
+    for (const auto& task : tasks) task();
+}
+
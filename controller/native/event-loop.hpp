@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// A single-threaded, level-triggered epoll loop.  Watched file descriptors
+// have their handlers called from run() with their ready events.  Any thread
+// may post tasks, which run on the loop between polls, in order.
+//
+// Everything but post() and stop() must be called from the loop's thread, or
+// before it runs.
+class EventLoop
+{
+public:
+    typedef std::function<void(std::uint32_t events)> Handler;
+
+    EventLoop();
+    ~EventLoop();
+
+    void add(int fd, std::uint32_t events, Handler handler);
+    void modify(int fd, std::uint32_t events);
+
+    // Stop watching a file descriptor, which is not closed.  Its handler is
+    // destroyed once it is no longer running.
+    void remove(int fd);
+
+    void post(std::function<void()> task);
+
+    // Call a task every interval, for as long as the loop runs.
+    void every(std::uint64_t milliseconds, std::function<void()> task);
+
+    // Returns once stop() has been called.
+    void run();
+    void stop();
+
+private:
+    void runPosted();
+
+    const int m_epoll;
+
+    // Written by post() and stop() to wake the loop.
+    const int m_wake;
+
+    std::unordered_map<int, std::shared_ptr<Handler>> m_handlers;
+    std::vector<int> m_timers;
+
+    std::vector<std::function<void()>> m_posted;
+    std::mutex m_mutex;
+
+    std::atomic<bool> m_stop;
+
+    // Disallow copy/assignment.
+    EventLoop(const EventLoop&);
+    EventLoop& operator=(const EventLoop&);
+};
+
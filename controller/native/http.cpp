@@ -0,0 +1,225 @@
+#include "http.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+
+namespace
+{
+    std::string lower(std::string s)
+    {
+        std::transform(s.begin(), s.end(), s.begin(), ::tolower);
+        return s;
+    }
+
+    std::string trim(const std::string& s)
+    {
+        const std::size_t begin(s.find_first_not_of(" \t"));
+        if (begin == std::string::npos) return std::string();
+
+        const std::size_t end(s.find_last_not_of(" \t"));
+        return s.substr(begin, end - begin + 1);
+    }
+
+    // True if a comma-separated header value contains a token.
+    bool hasToken(const std::string& value, const std::string& token)
+    {
+        std::size_t pos(0);
+
+        while (pos <= value.size())
+        {
+            std::size_t end(value.find(',', pos));
+            if (end == std::string::npos) end = value.size();
+
+            if (lower(trim(value.substr(pos, end - pos))) == token) return true;
+            pos = end + 1;
+        }
+
+        return false;
+    }
+
+    int hex(const char c)
+    {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+}
+
+HttpRequest::HttpRequest()
+    : m_method()
+    , m_target()
+    , m_path()
+    , m_query(Json::objectValue)
+    , m_headers()
+    , m_minorVersion(1)
+    , m_bodyBytes(0)
+{ }
+
+HttpRequest::Parse HttpRequest::parse(
+        const std::string& data,
+        std::size_t& consumed)
+{
+    const std::size_t end(data.find("\r\n\r\n"));
+
+    if (end == std::string::npos)
+    {
+        return data.size() < maxHeadBytes ? Parse::Incomplete : Parse::Invalid;
+    }
+
+    if (end + 4 > maxHeadBytes) return Parse::Invalid;
+
+    // Request line.
+    std::size_t lineEnd(data.find("\r\n"));
+    const std::string line(data.substr(0, lineEnd));
+
+    const std::size_t a(line.find(' '));
+    const std::size_t b(line.rfind(' '));
+    if (a == std::string::npos || a == b) return Parse::Invalid;
+
+    m_method = line.substr(0, a);
+    m_target = line.substr(a + 1, b - a - 1);
+
+    const std::string version(line.substr(b + 1));
+    if (version == "HTTP/1.1") m_minorVersion = 1;
+    else if (version == "HTTP/1.0") m_minorVersion = 0;
+    else return Parse::Invalid;
+
+    if (m_target.empty() || m_target[0] != '/') return Parse::Invalid;
+
+    // Headers.
+    std::size_t pos(lineEnd + 2);
+
+    while (pos < end + 2)
+    {
+        lineEnd = data.find("\r\n", pos);
+        const std::string header(data.substr(pos, lineEnd - pos));
+        pos = lineEnd + 2;
+
+        const std::size_t colon(header.find(':'));
+        if (colon == std::string::npos || !colon) return Parse::Invalid;
+
+        std::string& value(m_headers[lower(header.substr(0, colon))]);
+        const std::string v(trim(header.substr(colon + 1)));
+
+        // Repeated headers are equivalent to a comma-separated list.
+        value = value.empty() ? v : value + ", " + v;
+    }
+
+    if (!header("transfer-encoding").empty()) return Parse::Invalid;
+
+    const std::string length(header("content-length"));
+    if (!length.empty())
+    {
+        char* endPtr(nullptr);
+        m_bodyBytes = std::strtoull(length.c_str(), &endPtr, 10);
+        if (*endPtr) return Parse::Invalid;
+    }
+
+    parseTarget();
+
+    consumed = end + 4;
+    return Parse::Done;
+}
+
+std::string HttpRequest::header(const std::string& name) const
+{
+    auto it(m_headers.find(lower(name)));
+    return it != m_headers.end() ? it->second : std::string();
+}
+
+bool HttpRequest::keepAlive() const
+{
+    const std::string connection(header("connection"));
+
+    if (m_minorVersion) return !hasToken(connection, "close");
+    else return hasToken(connection, "keep-alive");
+}
+
+bool HttpRequest::upgrade() const
+{
+    return
+        hasToken(header("connection"), "upgrade") &&
+        lower(header("upgrade")) == "websocket";
+}
+
+void HttpRequest::parseTarget()
+{
+    const std::size_t q(m_target.find('?'));
+    m_path = decode(m_target.substr(0, q));
+
+    if (q == std::string::npos) return;
+
+    const std::string query(m_target.substr(q + 1));
+    std::size_t pos(0);
+
+    // As with Express, repeated keys take their last value.
+    while (pos < query.size())
+    {
+        std::size_t end(query.find('&', pos));
+        if (end == std::string::npos) end = query.size();
+
+        const std::string pair(query.substr(pos, end - pos));
+        const std::size_t eq(pair.find('='));
+
+        if (!pair.empty())
+        {
+            const std::string key(decode(pair.substr(0, eq), true));
+            const std::string value(
+                    eq == std::string::npos ?
+                        std::string() : decode(pair.substr(eq + 1), true));
+
+            if (!key.empty()) m_query[key] = value;
+        }
+
+        pos = end + 1;
+    }
+}
+
+std::string HttpRequest::decode(const std::string& s, const bool plus)
+{
+    std::string result;
+    result.reserve(s.size());
+
+    for (std::size_t i(0); i < s.size(); ++i)
+    {
+        if (s[i] == '%' && i + 2 < s.size() &&
+                hex(s[i + 1]) >= 0 && hex(s[i + 2]) >= 0)
+        {
+            result.push_back(
+                    static_cast<char>(hex(s[i + 1]) * 16 + hex(s[i + 2])));
+            i += 2;
+        }
+        else if (plus && s[i] == '+') result.push_back(' ');
+        else result.push_back(s[i]);
+    }
+
+    return result;
+}
+
+const char* HttpResponse::reason(const int code)
+{
+    switch (code)
+    {
+        case 101: return "Switching Protocols";
+        case 200: return "OK";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 413: return "Payload Too Large";
+        case 426: return "Upgrade Required";
+        case 431: return "Request Header Fields Too Large";
+        case 500: return "Internal Server Error";
+        case 503: return "Service Unavailable";
+        default: return "Unknown";
+    }
+}
+
+std::string HttpResponse::statusLine(const int code, const int minorVersion)
+{
+    return
+        "HTTP/1." + std::to_string(minorVersion) + " " +
+        std::to_string(code) + " " + reason(code) + "\r\n";
+}
+
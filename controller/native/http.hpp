@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <string>
+
+#include <entwine/third/json/json.hpp>
+
+// The head of an HTTP/1.x request.  We only serve GET requests, and their
+// upgrades to websockets, so any body is skipped.
+class HttpRequest
+{
+public:
+    enum class Parse
+    {
+        Done,
+        Incomplete,
+        Invalid
+    };
+
+    HttpRequest();
+
+    // Parse a request head from the beginning of data.  If done, consumed is
+    // set to the length of the head.
+    Parse parse(const std::string& data, std::size_t& consumed);
+
+    const std::string& method() const { return m_method; }
+    const std::string& target() const { return m_target; }
+
+    // Decoded path, and query parameters as strings, from our target.
+    const std::string& path() const { return m_path; }
+    const Json::Value& query() const { return m_query; }
+
+    // Empty if missing.  Names are case-insensitive.
+    std::string header(const std::string& name) const;
+
+    int minorVersion() const { return m_minorVersion; }
+
+    // True if the connection should stay open after our response.
+    bool keepAlive() const;
+
+    // True if this is a websocket handshake.
+    bool upgrade() const;
+
+    // Length of a body following our head.
+    std::size_t bodyBytes() const { return m_bodyBytes; }
+
+    // Percent-decode, with '+' as a space if plus is set.
+    static std::string decode(const std::string& s, bool plus = false);
+
+    // Heads are limited to this size.
+    static const std::size_t maxHeadBytes = 64 * 1024;
+
+private:
+    void parseTarget();
+
+    std::string m_method;
+    std::string m_target;
+    std::string m_path;
+    Json::Value m_query;
+    std::map<std::string, std::string> m_headers;
+    int m_minorVersion;
+    std::size_t m_bodyBytes;
+};
+
+class HttpResponse
+{
+public:
+    static const char* reason(int code);
+
+    // The status line of a response, including its line ending.
+    static std::string statusLine(int code, int minorVersion = 1);
+};
+
@@ -0,0 +1,103 @@
+// Native Greyhound server, serving the HTTP routes and websocket commands of
+// the Node server without going through V8.  Deployments which need the auth
+// proxy, HTTPS, or static files must use the Node server.
+//
+// Build and run from the repository root with:
+//      make -C controller/native && controller/native/greyhound-native [config]
+//
+// The configuration defaults to config.json, or config.defaults.json if that
+// doesn't exist, as for the Node server.
+
+#include <csignal>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include <curl/curl.h>
+
+#include <entwine/third/json/json.hpp>
+
+#include "server.hpp"
+
+namespace
+{
+    bool exists(const std::string& path)
+    {
+        return std::ifstream(path).good();
+    }
+
+    Json::Value readConfig(const std::string& path)
+    {
+        std::ifstream file(path);
+        if (!file.good()) throw std::runtime_error("Could not open " + path);
+
+        std::ostringstream ss;
+        ss << file.rdbuf();
+
+        // Our configuration may contain comments.
+        Json::Reader reader;
+        Json::Value json;
+
+        if (!reader.parse(ss.str(), json, false))
+        {
+            throw std::runtime_error(
+                    "Bad config " + path + ": " +
+                    reader.getFormattedErrorMessages());
+        }
+
+        return json;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::string path(argc > 1 ? argv[1] : "config.json");
+
+    if (argc <= 1 && !exists(path))
+    {
+        std::cout << "Using default config" << std::endl;
+        path = "config.defaults.json";
+    }
+
+    // Writes to closed sockets are reported as errors instead.
+    std::signal(SIGPIPE, SIG_IGN);
+
+    // Block these before any threads are started, so only ours sees them.
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    curl_global_init(CURL_GLOBAL_ALL);
+
+    int result(0);
+
+    try
+    {
+        Server server(readConfig(path));
+
+        std::thread([&server, signals]()->void
+        {
+            int signal(0);
+            sigwait(&signals, &signal);
+
+            std::cout << "Stopping" << std::endl;
+            server.stop();
+        }).detach();
+
+        server.run();
+    }
+    catch (const std::exception& e)
+    {
+        std::cout << "Error: " << e.what() << std::endl;
+        result = 1;
+    }
+
+    curl_global_cleanup();
+    return result;
+}
+
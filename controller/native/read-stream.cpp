@@ -0,0 +1,88 @@
+#include "read-stream.hpp"
+
+#include "event-loop.hpp"
+
+ReadStream::ReadStream(
+        std::shared_ptr<Session> session,
+        EventLoop& loop,
+        ItcBufferPool& itcBufferPool,
+        ReadCache& readCache,
+        TaskPool& readPool,
+        ReadScheduler& readScheduler,
+        const QueryLimits& limits,
+        Params params,
+        InitCb initCb,
+        DataCb dataCb)
+    : m_loop(loop)
+    , m_initCb(initCb)
+    , m_dataCb(dataCb)
+    , m_driver(
+            std::make_shared<ReadDriver>(
+                session,
+                itcBufferPool,
+                readCache,
+                readPool,
+                readScheduler,
+                limits,
+                std::move(params),
+                *this))
+    , m_self()
+{ }
+
+void ReadStream::start()
+{
+    m_self = shared_from_this();
+    m_driver->start();
+}
+
+void ReadStream::resume()
+{
+    m_driver->resume();
+    reap();
+}
+
+void ReadStream::cancel()
+{
+    m_driver->cancel();
+    reap();
+}
+
+void ReadStream::wake()
+{
+    // We hold ourselves until our driver is complete, so we're still alive.
+    std::shared_ptr<ReadStream> self(shared_from_this());
+    m_loop.post([self]()->void { self->service(); });
+}
+
+void ReadStream::service()
+{
+    m_driver->service();
+    reap();
+}
+
+void ReadStream::reap()
+{
+    // If our consumer calls back into us during a delivery, the outer
+    // delivery sees to this.
+    if (!m_driver->delivering() && m_driver->complete()) m_self.reset();
+}
+
+void ReadStream::status(
+        const int code,
+        const std::string& message,
+        const std::size_t retryAfter)
+{
+    m_initCb(code, message, retryAfter);
+}
+
+bool ReadStream::data(std::shared_ptr<ItcBuffer> buffer, const bool done)
+{
+    return m_dataCb(buffer, done);
+}
+
+void ReadStream::error(int, const std::string&)
+{
+    // Our response has already begun, so a failure can only cut it short,
+    // which our consumer sees as a truncated response.
+    m_dataCb(std::shared_ptr<ItcBuffer>(), true);
+}
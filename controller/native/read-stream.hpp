@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "types/query-limits.hpp"
+#include "util/read-cache.hpp"
+#include "util/read-driver.hpp"
+
+class EventLoop;
+class ItcBuffer;
+class ItcBufferPool;
+class ReadScheduler;
+class Session;
+class TaskPool;
+
+// Streams a read to the native server's event loop, as ReadCommand does for
+// JS-land.  The read itself is driven by a ReadDriver, whose chunks are
+// delivered from the event loop to our callbacks.
+//
+// Streams are shared by the event loop tasks which deliver their chunks, and
+// hold themselves until their driver is complete.
+class ReadStream
+    : public ReadDriver::Sink
+    , public std::enable_shared_from_this<ReadStream>
+{
+public:
+    typedef ReadDriver::Params Params;
+
+    // Called from the event loop with our status once our query is built,
+    // or has failed.  Unless the code is 200, nothing more is called.  The
+    // retry delay is in seconds, and is zero if unknown.
+    typedef std::function<void(
+            int code,
+            const std::string& message,
+            std::size_t retryAfter)> InitCb;
+
+    // Called from the event loop with each chunk, in order, which now
+    // belongs to the callee.  The last has done set.  If reading fails after
+    // our status was given, the last is null instead, and our consumer must
+    // cut its response short.  Returns false if our consumer has gone away,
+    // in which case we are cancelled.
+    typedef std::function<bool(
+            std::shared_ptr<ItcBuffer> buffer,
+            bool done)> DataCb;
+
+    ReadStream(
+            std::shared_ptr<Session> session,
+            EventLoop& loop,
+            ItcBufferPool& itcBufferPool,
+            ReadCache& readCache,
+            TaskPool& readPool,
+            ReadScheduler& readScheduler,
+            const QueryLimits& limits,
+            Params params,
+            InitCb initCb,
+            DataCb dataCb);
+
+    // Begin running on the read pool.
+    void start();
+
+    // Flow control, from the event loop only.  Resuming or cancelling
+    // delivers whatever was held.
+    void pause() { m_driver->pause(); }
+    void resume();
+    void cancel();
+
+private:
+    virtual void wake();
+    virtual void status(
+            int code,
+            const std::string& message,
+            std::size_t retryAfter);
+    virtual bool data(std::shared_ptr<ItcBuffer> buffer, bool done);
+    virtual void error(int code, const std::string& message);
+
+    // From the event loop.  Let ourselves go once our driver is complete.
+    void service();
+    void reap();
+
+    EventLoop& m_loop;
+    InitCb m_initCb;
+    DataCb m_dataCb;
+    std::shared_ptr<ReadDriver> m_driver;
+
+    // Holds us from start() until our driver is complete.
+    std::shared_ptr<ReadStream> m_self;
+
+    // Disallow copy/assignment.
+    ReadStream(const ReadStream&);
+    ReadStream& operator=(const ReadStream&);
+};
@@ -0,0 +1,1114 @@
+#include "server.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <pdal/StageFactory.hpp>
+
+#include <entwine/reader/cache.hpp>
+#include <entwine/third/arbiter/arbiter.hpp>
+#include <entwine/types/bounds.hpp>
+
+#include "session.hpp"
+#include "util/caching-driver.hpp"
+#include "util/disk-cache.hpp"
+#include "util/read-cache.hpp"
+#include "util/read-scheduler.hpp"
+#include "util/session-registry.hpp"
+
+#include "http.hpp"
+
+namespace
+{
+    const std::size_t numBuffers(1024);
+
+    // Driver types whose fetches are instrumented, and whose chunks are
+    // cached on disk if we have a disk cache, if not configured.
+    const std::vector<std::string> defaultCachedTypes { "s3", "http", "https" };
+
+    std::size_t manyThreads()
+    {
+        return std::max<std::size_t>(
+                std::thread::hardware_concurrency() * 2,
+                8);
+    }
+
+    std::string toString(const Json::Value& json)
+    {
+        Json::FastWriter writer;
+        std::string s(writer.write(json));
+        if (!s.empty() && s.back() == '\n') s.pop_back();
+        return s;
+    }
+
+    std::string lower(std::string s)
+    {
+        std::transform(s.begin(), s.end(), s.begin(), ::tolower);
+        return s;
+    }
+
+    // Query values are strings over HTTP, but may be any JSON over our
+    // websocket, so accept either for structured values.
+    Json::Value parse(const Json::Value& value)
+    {
+        if (!value.isString()) return value;
+
+        Json::Reader reader;
+        Json::Value json;
+        if (!reader.parse(value.asString(), json, false)) return Json::Value();
+        return json;
+    }
+
+    // As JS-land's parseFloat, and V8's Uint32Value, but treating anything
+    // unparseable as zero.
+    double toDouble(const Json::Value& value)
+    {
+        if (value.isNumeric()) return value.asDouble();
+        if (value.isString()) return std::strtod(value.asCString(), nullptr);
+        return 0;
+    }
+
+    std::size_t toIndex(const Json::Value& value)
+    {
+        return std::max(toDouble(value), 0.0);
+    }
+
+    bool isTrue(const Json::Value& value)
+    {
+        if (value.isBool()) return value.asBool();
+        return value.isString() && lower(value.asString()) == "true";
+    }
+
+    entwine::Point toPoint(const Json::Value& value)
+    {
+        const Json::Value json(parse(value));
+
+        if (json.isArray() && json.size() == 3)
+        {
+            return entwine::Point(
+                    json[0].asDouble(),
+                    json[1].asDouble(),
+                    json[2].asDouble());
+        }
+
+        std::cout << "Invalid point in query" << std::endl;
+        return entwine::Point(0, 0, 0);
+    }
+
+    entwine::Bounds toBounds(const Json::Value& value)
+    {
+        try
+        {
+            return entwine::Bounds(parse(value));
+        }
+        catch (...)
+        {
+            std::cout << "Invalid Bounds in query." << std::endl;
+            return entwine::Bounds();
+        }
+    }
+
+    Json::Value command(const std::string& name, const int status)
+    {
+        Json::Value json;
+        json["command"] = name;
+        json["status"] = status;
+        return json;
+    }
+
+    // Ties a read to its connection, for flow control and cancellation.
+    struct Reading
+    {
+        Reading()
+            : stream()
+            , closeId(0)
+            , paused(false)
+            , numBytes(0)
+        { }
+
+        std::weak_ptr<ReadStream> stream;
+        std::size_t closeId;
+        bool paused;
+        std::size_t numBytes;
+    };
+
+    // Stop reading until our connection has sent all but resumeBytes.
+    void pause(
+            std::shared_ptr<Reading> reading,
+            Connection& connection,
+            const std::size_t resumeBytes)
+    {
+        std::shared_ptr<ReadStream> stream(reading->stream.lock());
+        if (reading->paused || !stream) return;
+
+        reading->paused = true;
+        stream->pause();
+
+        connection.whenBelow(resumeBytes, [reading, stream]()->void
+        {
+            reading->paused = false;
+            stream->resume();
+        });
+    }
+
+    // Cancel our read if our connection closes first.
+    void watch(std::shared_ptr<Reading> reading, Connection& connection)
+    {
+        std::shared_ptr<ReadStream> stream(reading->stream.lock());
+        reading->closeId = connection.onClose([stream]()->void
+        {
+            stream->cancel();
+        });
+    }
+}
+
+Server::Server(const Json::Value& config)
+    : m_config(config)
+    , m_limitsJson(config["queryLimits"])
+    , m_limits(m_limitsJson)
+    , m_paths(
+            [&config]()->std::vector<std::string>
+            {
+                std::vector<std::string> paths;
+                for (const Json::Value& path : config["paths"])
+                {
+                    paths.push_back(path.asString());
+                }
+                return paths;
+            }())
+    , m_headers()
+    , m_httpMaxBuffered(
+            config["http"].get("maxBufferedKb", 8192).asUInt64() * 1024)
+    , m_wsMaxBuffered(
+            config["ws"].get("maxBufferedKb", 8192).asUInt64() * 1024)
+    , m_timeoutMinutes(config.get("resourceTimeoutMinutes", 30).asUInt64())
+    , m_preloadColdDepths(
+            config["preload"].isObject() ?
+                config["preload"].get("coldDepths", 0).asInt() : -1)
+    , m_itcBufferPool(numBuffers)
+    , m_stageFactory(new pdal::StageFactory())
+    , m_factoryMutex()
+    , m_outerScope()
+    , m_cache()
+    , m_diskCache()
+    , m_remoteArbiter()
+    , m_sessionRegistry()
+    , m_readCache(new ReadCache(m_limits.responseCacheBytes()))
+    , m_readScheduler(new ReadScheduler(m_limits))
+    , m_loop()
+    , m_listeners()
+    , m_nextReadId(0)
+    , m_compressionPool(
+            std::max<std::size_t>(std::thread::hardware_concurrency(), 1))
+    , m_prefetchPool(manyThreads())
+    , m_readPool(manyThreads())
+    , m_discoveryPool(manyThreads())
+    , m_preloadPool(1)
+    , m_commandPool(
+            std::max<std::size_t>(
+                std::thread::hardware_concurrency() * 1.2 + 1, 4))
+{
+    if (config["auth"].isObject())
+    {
+        throw std::runtime_error(
+                "Auth is not supported by the native server - "
+                "use the Node server instead");
+    }
+
+    const std::size_t chunkCacheSize(
+            std::max<std::size_t>(
+                m_limitsJson.get("chunkCacheSize", 32).asUInt64(), 16));
+    const double sessionCacheMb(config.get("sessionCacheMb", 1024).asDouble());
+    const std::size_t notFoundSeconds(
+            config.get("notFoundSeconds", 30).asUInt64());
+
+    std::cout << "Using" << std::endl;
+    std::cout << "\tChunk cache size: " << chunkCacheSize << std::endl;
+    std::cout << "\tSession cache size (MB): " << sessionCacheMb << std::endl;
+
+    m_cache.reset(new entwine::Cache(chunkCacheSize));
+
+    m_sessionRegistry.reset(
+            new SessionRegistry(
+                std::max(sessionCacheMb, 0.0) * 1024 * 1024,
+                notFoundSeconds,
+                [this]()->std::shared_ptr<Session>
+                {
+                    return std::make_shared<Session>(
+                        *m_stageFactory,
+                        m_factoryMutex,
+                        m_compressionPool,
+                        m_prefetchPool,
+                        m_discoveryPool,
+                        m_preloadPool);
+                }));
+
+    // Set up our disk cache first, so if it can't be used, nothing has been
+    // configured without it.
+    std::vector<std::string> cachedTypes(defaultCachedTypes);
+    const Json::Value& diskJson(config["diskCache"]);
+
+    if (diskJson.isObject())
+    {
+        std::cout << "\tDisk cache: " << toString(diskJson) << std::endl;
+
+        if (diskJson.isMember("types"))
+        {
+            cachedTypes.clear();
+
+            for (const Json::Value& type : diskJson["types"])
+            {
+                cachedTypes.push_back(type.asString());
+            }
+        }
+
+        m_diskCache.reset(
+                new DiskCache(
+                    diskJson["path"].asString(),
+                    diskJson["maxMb"].asDouble() * 1024 * 1024));
+    }
+
+    const Json::Value& arbiterJson(config["arbiter"]);
+
+    if (arbiterJson.isNull())
+    {
+        m_outerScope.getArbiter();
+        m_remoteArbiter.reset(new entwine::arbiter::Arbiter());
+    }
+    else
+    {
+        std::cout << "Using custom arbiter configuration" << std::endl;
+        m_outerScope.getArbiter(arbiterJson);
+        m_remoteArbiter.reset(new entwine::arbiter::Arbiter(arbiterJson));
+    }
+
+    // As our bindings do, route our outer scope's fetches through drivers
+    // which count and time them, and which keep chunks in our disk cache.
+    for (const std::string& type : cachedTypes)
+    {
+        try
+        {
+            const entwine::arbiter::Driver& inner(
+                    m_remoteArbiter->getDriver(type + "://"));
+
+            m_outerScope.getArbiterPtr()->addDriver(
+                    type,
+                    std::unique_ptr<entwine::arbiter::Driver>(
+                        new CachingDriver(inner, m_diskCache.get())));
+        }
+        catch (const std::runtime_error& e)
+        {
+            std::cout << "\tNot wrapping " << type << " driver: " <<
+                e.what() << std::endl;
+        }
+    }
+
+    for (const auto& key : config["http"]["headers"].getMemberNames())
+    {
+        m_headers.emplace_back(
+                key,
+                config["http"]["headers"][key].asString());
+    }
+
+    m_headers.emplace_back("X-powered-by", "Hobu, Inc.");
+
+    std::cout << "Read paths:";
+    for (const std::string& path : m_paths) std::cout << " " << path;
+    std::cout << std::endl;
+}
+
+Server::~Server()
+{
+    for (const int fd : m_listeners) ::close(fd);
+}
+
+void Server::run()
+{
+    const int httpPort(m_config["http"].get("port", 0).asInt());
+    const int wsPort(m_config["ws"].get("port", 0).asInt());
+
+    if (m_config["http"].get("securePort", 0).asInt())
+    {
+        std::cout << "HTTPS is not supported by the native server" <<
+            std::endl;
+    }
+
+    // Both ports serve both interfaces, so a shared port is only bound once.
+    if (httpPort) listen(httpPort);
+    if (wsPort && wsPort != httpPort) listen(wsPort);
+
+    if (m_listeners.empty()) throw std::runtime_error("No ports configured");
+
+    if (m_timeoutMinutes)
+    {
+        const std::size_t seconds(m_timeoutMinutes * 60);
+        m_loop.every(seconds * 1000, [this, seconds]()->void
+        {
+            evictSessions(seconds);
+        });
+    }
+
+    // Open these resources now, which preloads them.  Their sessions are
+    // evictable as soon as their preloading is done.
+    for (const Json::Value& name : m_config["preload"]["resources"])
+    {
+        const std::string resource(name.asString());
+
+        open(resource, [resource](
+                    int code,
+                    const std::string&,
+                    std::shared_ptr<Session>)->void
+        {
+            if (code == 200)
+            {
+                std::cout << "Preloading " << resource << std::endl;
+            }
+        });
+    }
+
+    m_loop.run();
+}
+
+void Server::listen(const int port)
+{
+    const int fd(
+            socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0));
+    if (fd < 0) throw std::runtime_error("Could not create socket");
+
+    const int on(1);
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+    sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+
+    if (
+            ::bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address))
+                < 0 ||
+            ::listen(fd, SOMAXCONN) < 0)
+    {
+        ::close(fd);
+        throw std::runtime_error(
+                "Could not listen on port " + std::to_string(port) + ": " +
+                std::strerror(errno));
+    }
+
+    m_listeners.push_back(fd);
+    m_loop.add(fd, EPOLLIN, [this, fd](std::uint32_t)->void { accept(fd); });
+
+    std::cout << "Native server running on port " << port << std::endl;
+}
+
+void Server::accept(const int listener)
+{
+    while (true)
+    {
+        const int fd(
+                accept4(
+                    listener,
+                    nullptr,
+                    nullptr,
+                    SOCK_NONBLOCK | SOCK_CLOEXEC));
+
+        if (fd < 0)
+        {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+            {
+                std::cout << "Accept failed: " << std::strerror(errno) <<
+                    std::endl;
+            }
+
+            return;
+        }
+
+        // Our writes are already coalesced, so don't hold them back.
+        const int on(1);
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+        std::make_shared<Connection>(fd, m_loop, m_itcBufferPool)->start(*this);
+    }
+}
+
+void Server::open(const std::string& name, OpenCb cb)
+{
+    // Don't search again for a resource we've just failed to find.
+    if (m_sessionRegistry->missing(name))
+    {
+        cb(404, "Not found", std::shared_ptr<Session>());
+        return;
+    }
+
+    std::shared_ptr<Session> session(m_sessionRegistry->get(name));
+
+    // If this resource has been evicted, its search starts wherever it was
+    // found.
+    const std::string hint(m_sessionRegistry->hint(name));
+
+    m_commandPool.add([this, name, hint, session, cb]()->void
+    {
+        int code(200);
+        std::string message;
+
+        try
+        {
+            if (!session->initialize(
+                        name,
+                        m_paths,
+                        m_outerScope,
+                        m_cache,
+                        hint))
+            {
+                code = 404;
+                message = "Not found";
+            }
+        }
+        catch (const std::runtime_error& e)
+        {
+            code = 500;
+            message = e.what();
+        }
+        catch (const std::bad_alloc&)
+        {
+            code = 500;
+            message = "Bad alloc";
+        }
+        catch (...)
+        {
+            code = 500;
+            message = "Unknown error";
+        }
+
+        m_loop.post([this, name, session, code, message, cb]()->void
+        {
+            // Don't hang on to resources that failed to open, and make room
+            // for those that did.
+            if (code == 404)
+            {
+                std::cout << name << " could not be created" << std::endl;
+                m_sessionRegistry->miss(name, session);
+            }
+            else if (code != 200)
+            {
+                std::cout << name << " could not be created" << std::endl;
+                m_sessionRegistry->erase(name, session);
+            }
+            else
+            {
+                if (m_preloadColdDepths >= 0)
+                {
+                    session->preload(m_preloadColdDepths);
+                }
+
+                evictSessions();
+            }
+
+            cb(code, message, code == 200 ? session : nullptr);
+        });
+    });
+}
+
+void Server::evictSessions(const std::size_t maxIdleSeconds)
+{
+    // Responses for evicted resources may be stale once they are reopened.
+    for (const std::string& name : m_sessionRegistry->sweep(maxIdleSeconds))
+    {
+        std::cout << "Evicted " << name << std::endl;
+        m_readCache->purge(name);
+    }
+}
+
+Connection::Headers Server::headers(const std::string& contentType) const
+{
+    Connection::Headers result(m_headers);
+    if (!contentType.empty()) result.emplace_back("Content-Type", contentType);
+    return result;
+}
+
+void Server::request(
+        std::shared_ptr<Connection> connection,
+        const HttpRequest& request)
+{
+    if (request.method() == "OPTIONS")
+    {
+        connection->respond(200, headers(""));
+        return;
+    }
+
+    if (request.method() != "GET")
+    {
+        Connection::Headers h(headers(""));
+        h.emplace_back("Allow", "GET, OPTIONS");
+        connection->respond(405, h);
+        return;
+    }
+
+    const std::string& path(request.path());
+
+    if (path == "/")
+    {
+        connection->respond(
+                200,
+                headers("text/html; charset=utf-8"),
+                "Hobu, Inc. point distribution server");
+        return;
+    }
+
+    // As /resource/:resource(*)/:call, where resources may contain slashes.
+    const std::string prefix("/resource/");
+    const std::size_t slash(path.rfind('/'));
+
+    if (path.compare(0, prefix.size(), prefix) || slash <= prefix.size())
+    {
+        error(connection, 404, "Not found");
+        return;
+    }
+
+    const std::string name(
+            path.substr(prefix.size(), slash - prefix.size()));
+    const std::string call(path.substr(slash + 1));
+
+    if (call == "info") info(connection, name);
+    else if (call == "read") read(connection, name, request.query());
+    else if (call == "hierarchy") hierarchy(connection, name, request.query());
+    else error(connection, 404, "Not found");
+}
+
+void Server::error(
+        std::shared_ptr<Connection> connection,
+        const int code,
+        const std::string& message,
+        const std::size_t retryAfter)
+{
+    Connection::Headers h(headers("application/json; charset=utf-8"));
+    if (retryAfter) h.emplace_back("Retry-After", std::to_string(retryAfter));
+
+    connection->respond(code, h, toString(Json::Value(message)));
+}
+
+void Server::info(
+        std::shared_ptr<Connection> connection,
+        const std::string& name)
+{
+    open(name, [this, connection](
+                int code,
+                const std::string& message,
+                std::shared_ptr<Session> session)->void
+    {
+        if (code != 200) return error(connection, code, message);
+
+        connection->respond(
+                200,
+                headers("application/json; charset=utf-8"),
+                session->info());
+    });
+}
+
+void Server::hierarchy(
+        std::shared_ptr<Connection> connection,
+        const std::string& name,
+        Json::Value query)
+{
+    open(name, [this, connection, query](
+                int code,
+                const std::string& message,
+                std::shared_ptr<Session> session)->void
+    {
+        if (code != 200) return error(connection, code, message);
+
+        const entwine::Bounds bounds(toBounds(query["bounds"]));
+
+        if (
+                !query.isMember("depthBegin") ||
+                !query.isMember("depthEnd") ||
+                !query.isMember("bounds") ||
+                !bounds.exists())
+        {
+            std::cout << "Bad hierarchy command" << std::endl;
+            return error(connection, 400, "Invalid hierarchy query parameters");
+        }
+
+        const std::size_t depthBegin(toIndex(query["depthBegin"]));
+        const std::size_t depthEnd(toIndex(query["depthEnd"]));
+        const bool vertical(isTrue(query["vertical"]));
+        const bool binary(
+                query["format"].isString() &&
+                lower(query["format"].asString()) == "binary");
+
+        m_commandPool.add([=]()->void
+        {
+            std::string result;
+            bool ok(true);
+
+            try
+            {
+                result = session->hierarchy(
+                        bounds,
+                        depthBegin,
+                        depthEnd,
+                        vertical,
+                        binary);
+            }
+            catch (...)
+            {
+                ok = false;
+            }
+
+            m_loop.post([=]()->void
+            {
+                if (!ok)
+                {
+                    return error(connection, 500, "Error during hierarchy");
+                }
+
+                connection->respond(
+                        200,
+                        headers(
+                            binary ?
+                                "application/octet-stream" :
+                                "application/json; charset=utf-8"),
+                        result);
+            });
+        });
+    });
+}
+
+void Server::parseRead(
+        const Session& session,
+        Json::Value& query,
+        ReadStream::Params& params,
+        QueryLimits& limits) const
+{
+    // As controller.js.
+    if (query.isMember("schema"))
+    {
+        const Json::Value schema(parse(query["schema"]));
+        if (!schema.isArray()) throw std::runtime_error("Invalid schema");
+
+        params.schema = entwine::Schema(schema);
+    }
+    else
+    {
+        params.schema = session.schema();
+    }
+
+    const Json::Value& compress(query["compress"]);
+
+    if (compress.isBool() && compress.asBool())
+    {
+        params.compress = CompressionMode::Stream;
+    }
+    else if (compress.isString())
+    {
+        const std::string c(lower(compress.asString()));
+        if (c == "true") params.compress = CompressionMode::Stream;
+        else if (c == "blocks") params.compress = CompressionMode::Blocks;
+    }
+
+    params.scale = toDouble(query["scale"]);
+    if (query.isMember("offset")) params.offset = toPoint(query["offset"]);
+
+    // Per-request batch sizes may only lower those of our configuration, so
+    // clients can't force overly large buffers.
+    Json::Value limitsJson(m_limitsJson);
+
+    auto lowerLimit([&](
+                const std::string& key,
+                const std::size_t fallback)->void
+    {
+        if (!query.isMember(key)) return;
+
+        const Json::Value& raw(query[key]);
+        if (!raw.isNumeric() && !raw.isString()) return;
+
+        const double requested(toDouble(raw));
+        if (requested < 0) return;
+
+        const std::size_t configured(
+                limitsJson.get(key, static_cast<Json::UInt64>(fallback))
+                    .asUInt64());
+        std::size_t value(requested);
+
+        // A maximum of zero means unlimited.
+        if (key == "maxBatchKb" && !value) value = configured;
+        if (configured && value > configured) value = configured;
+        limitsJson[key] = static_cast<Json::UInt64>(value);
+    });
+
+    lowerLimit("batchKb", 1024);
+    lowerLimit("maxBatchKb", 4096);
+
+    limits = QueryLimits(limitsJson);
+
+    const std::vector<std::string> known {
+        "schema", "compress", "scale", "offset", "batchKb", "maxBatchKb"
+    };
+
+    for (const std::string& key : known) query.removeMember(key);
+
+    // As ReadCommand.
+    if (
+            query.isMember("depth") ||
+            query.isMember("depthBegin") ||
+            query.isMember("depthEnd"))
+    {
+        params.indexed = true;
+        params.depthBegin = toIndex(query["depthBegin"]);
+        params.depthEnd = toIndex(query["depthEnd"]);
+
+        if (params.depthBegin || params.depthEnd)
+        {
+            query.removeMember("depthBegin");
+            query.removeMember("depthEnd");
+        }
+        else if (query.isMember("depth"))
+        {
+            params.depthBegin = toIndex(query["depth"]);
+            params.depthEnd = params.depthBegin + 1;
+
+            query.removeMember("depth");
+        }
+
+        if (query.isMember("bounds"))
+        {
+            params.bounds.reset(
+                    new entwine::Bounds(toBounds(query["bounds"])));
+        }
+
+        query.removeMember("bounds");
+    }
+
+    // Unknown parameters.  Note that isMember() may have added nulls.
+    for (const std::string& key : query.getMemberNames())
+    {
+        if (!query[key].isNull())
+        {
+            throw std::runtime_error("Invalid read query parameters");
+        }
+    }
+}
+
+std::shared_ptr<ReadStream> Server::stream(
+        std::shared_ptr<Session> session,
+        ReadStream::Params params,
+        const QueryLimits& limits,
+        ReadStream::InitCb initCb,
+        ReadStream::DataCb dataCb)
+{
+    return std::make_shared<ReadStream>(
+            session,
+            m_loop,
+            m_itcBufferPool,
+            *m_readCache,
+            m_readPool,
+            *m_readScheduler,
+            limits,
+            std::move(params),
+            initCb,
+            dataCb);
+}
+
+void Server::read(
+        std::shared_ptr<Connection> connection,
+        const std::string& name,
+        Json::Value query)
+{
+    // Server-Timing trailers are only sent by the Node server.
+    query.removeMember("timing");
+
+    open(name, [this, connection, query](
+                int code,
+                const std::string& message,
+                std::shared_ptr<Session> session) mutable->void
+    {
+        if (code != 200) return error(connection, code, message);
+
+        ReadStream::Params params;
+        QueryLimits limits;
+
+        try
+        {
+            parseRead(*session, query, params, limits);
+        }
+        catch (const std::exception& e)
+        {
+            std::cout << "Bad read command" << std::endl;
+            return error(connection, 400, e.what());
+        }
+
+        const std::size_t maxBuffered(m_httpMaxBuffered);
+        std::shared_ptr<Reading> reading(std::make_shared<Reading>());
+
+        auto initCb([this, connection, reading](
+                    int code,
+                    const std::string& message,
+                    std::size_t retryAfter)->void
+        {
+            if (code != 200)
+            {
+                connection->forget(reading->closeId);
+                return error(connection, code, message, retryAfter);
+            }
+
+            connection->beginResponse(
+                    200,
+                    headers("application/octet-stream"));
+        });
+
+        auto dataCb([this, connection, reading, maxBuffered](
+                    std::shared_ptr<ItcBuffer> buffer,
+                    bool done)->bool
+        {
+            if (connection->closed())
+            {
+                if (buffer) m_itcBufferPool.release(buffer);
+                return false;
+            }
+
+            if (!buffer)
+            {
+                std::cout << "Encountered data error" << std::endl;
+                connection->forget(reading->closeId);
+                connection->abortResponse();
+                return true;
+            }
+
+            connection->sendChunk(buffer);
+
+            if (done)
+            {
+                connection->forget(reading->closeId);
+                connection->endResponse();
+            }
+            else if (connection->unsent() > maxBuffered)
+            {
+                // Resume once our writes have drained.
+                pause(reading, *connection, 0);
+            }
+
+            return true;
+        });
+
+        std::shared_ptr<ReadStream> s(
+                stream(session, std::move(params), limits, initCb, dataCb));
+
+        reading->stream = s;
+        watch(reading, *connection);
+        s->start();
+    });
+}
+
+void Server::message(
+        std::shared_ptr<Connection> connection,
+        const std::string& message)
+{
+    Json::Reader reader;
+    Json::Value json;
+
+    if (!reader.parse(message, json, false) || !json.isObject())
+    {
+        Json::Value reply;
+        reply["status"] = 0;
+        reply["message"] = "Couldn't parse command";
+        connection->sendText(toString(reply));
+        return;
+    }
+
+    const std::string name(
+            json["command"].isString() ? json["command"].asString() : "");
+
+    if (name.empty())
+    {
+        Json::Value reply;
+        reply["status"] = 0;
+        reply["message"] = "Unknown command";
+        connection->sendText(toString(reply));
+        return;
+    }
+
+    if (name == "info") wsInfo(connection, json);
+    else if (name == "read") wsRead(connection, json);
+    else
+    {
+        std::cout << "Improper configuration: " << name << std::endl;
+
+        Json::Value reply;
+        reply["status"] = 0;
+        connection->sendText(toString(reply));
+    }
+}
+
+void Server::wsInfo(std::shared_ptr<Connection> connection, Json::Value msg)
+{
+    if (!msg["resource"].isString())
+    {
+        Json::Value reply(command("info", 0));
+        reply["message"] = "\t'name' must be a string";
+        connection->sendText(toString(reply));
+        return;
+    }
+
+    open(msg["resource"].asString(), [connection](
+                int code,
+                const std::string& message,
+                std::shared_ptr<Session> session)->void
+    {
+        Json::Value reply(command("info", 0));
+
+        if (code == 200)
+        {
+            Json::Reader reader;
+            if (reader.parse(session->info(), reply, false))
+            {
+                reply["command"] = "info";
+                reply["status"] = 1;
+            }
+            else
+            {
+                reply = command("info", 0);
+                reply["message"] = "Error parsing info";
+            }
+        }
+        else
+        {
+            reply["message"] = message;
+        }
+
+        connection->sendText(toString(reply));
+    });
+}
+
+void Server::wsRead(std::shared_ptr<Connection> connection, Json::Value msg)
+{
+    auto fail([connection](
+                const std::string& message,
+                std::size_t retryAfter)->void
+    {
+        Json::Value reply(command("read", 0));
+        reply["message"] = message;
+        if (retryAfter)
+        {
+            reply["retryAfter"] = static_cast<Json::UInt64>(retryAfter);
+        }
+
+        connection->sendText(toString(reply));
+    });
+
+    if (!msg["resource"].isString())
+    {
+        fail("\t'name' must be a string", 0);
+        return;
+    }
+
+    const std::string name(msg["resource"].asString());
+    const bool summary(isTrue(msg["summary"]));
+
+    msg.removeMember("command");
+    msg.removeMember("resource");
+    msg.removeMember("summary");
+
+    open(name, [this, connection, msg, summary, fail](
+                int code,
+                const std::string& message,
+                std::shared_ptr<Session> session) mutable->void
+    {
+        if (code != 200) return fail(message, 0);
+
+        ReadStream::Params params;
+        QueryLimits limits;
+
+        try
+        {
+            parseRead(*session, msg, params, limits);
+        }
+        catch (const std::exception& e)
+        {
+            std::cout << "Bad read command" << std::endl;
+            return fail(e.what(), 0);
+        }
+
+        const std::uint64_t readId(++m_nextReadId);
+        const std::size_t maxBuffered(m_wsMaxBuffered);
+        std::shared_ptr<Reading> reading(std::make_shared<Reading>());
+
+        auto initCb([connection, reading, readId, fail](
+                    int code,
+                    const std::string& message,
+                    std::size_t retryAfter)->void
+        {
+            if (code != 200)
+            {
+                connection->forget(reading->closeId);
+                return fail(message, retryAfter);
+            }
+
+            Json::Value reply(command("read", 1));
+            reply["readId"] = static_cast<Json::UInt64>(readId);
+            connection->sendText(toString(reply));
+        });
+
+        auto dataCb([this, connection, reading, readId, summary, maxBuffered](
+                    std::shared_ptr<ItcBuffer> buffer,
+                    bool done)->bool
+        {
+            if (connection->closed())
+            {
+                if (buffer) m_itcBufferPool.release(buffer);
+                return false;
+            }
+
+            if (!buffer)
+            {
+                std::cout << "Encountered data error" << std::endl;
+                connection->forget(reading->closeId);
+                connection->closeWebSocket(1011);
+                return true;
+            }
+
+            reading->numBytes += buffer->size();
+            connection->sendBinary(buffer);
+
+            if (done)
+            {
+                connection->forget(reading->closeId);
+
+                if (summary)
+                {
+                    Json::Value reply(command("summary", 1));
+                    reply["readId"] = static_cast<Json::UInt64>(readId);
+                    reply["numBytes"] =
+                        static_cast<Json::UInt64>(reading->numBytes);
+                    connection->sendText(toString(reply));
+                }
+            }
+            else if (connection->unsent() > maxBuffered)
+            {
+                // Resume once the socket has caught up.
+                pause(reading, *connection, maxBuffered / 2);
+            }
+
+            return true;
+        });
+
+        std::shared_ptr<ReadStream> s(
+                stream(session, std::move(params), limits, initCb, dataCb));
+
+        reading->stream = s;
+        watch(reading, *connection);
+        s->start();
+    });
+}
+
@@ -0,0 +1,171 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <entwine/third/json/json.hpp>
+#include <entwine/types/outer-scope.hpp>
+
+#include "types/query-limits.hpp"
+#include "util/buffer-pool.hpp"
+#include "util/task-pool.hpp"
+
+#include "connection.hpp"
+#include "event-loop.hpp"
+#include "read-stream.hpp"
+
+namespace pdal
+{
+    class StageFactory;
+}
+
+namespace entwine
+{
+    class Cache;
+
+    namespace arbiter
+    {
+        class Arbiter;
+    }
+}
+
+class DiskCache;
+class HttpRequest;
+class ReadCache;
+class ReadScheduler;
+class Session;
+class SessionRegistry;
+
+// Serves the routes of interfaces/http and the commands of interfaces/ws
+// straight from our sessions, without going through JS-land.  A single
+// event loop thread handles all sockets, while opening resources, building
+// hierarchies, and reading run on our pools.
+//
+// Configured from the same JSON as the Node server, of which it shares the
+// resource handling of our bindings.
+class Server
+{
+public:
+    explicit Server(const Json::Value& config);
+    ~Server();
+
+    // Listen on our configured ports, and serve until stopped.
+    void run();
+
+    // May be called from any thread.
+    void stop() { m_loop.stop(); }
+
+    // From our connections.
+    void request(
+            std::shared_ptr<Connection> connection,
+            const HttpRequest& request);
+
+    void message(
+            std::shared_ptr<Connection> connection,
+            const std::string& message);
+
+private:
+    // Called from the event loop with a session, if code is 200, which is
+    // held for a single command.
+    typedef std::function<void(
+            int code,
+            const std::string& message,
+            std::shared_ptr<Session> session)> OpenCb;
+
+    void listen(int port);
+    void accept(int fd);
+
+    void open(const std::string& name, OpenCb cb);
+    void evictSessions(std::size_t maxIdleSeconds = 0);
+
+    void info(std::shared_ptr<Connection> connection, const std::string& name);
+
+    void read(
+            std::shared_ptr<Connection> connection,
+            const std::string& name,
+            Json::Value query);
+
+    void hierarchy(
+            std::shared_ptr<Connection> connection,
+            const std::string& name,
+            Json::Value query);
+
+    void error(
+            std::shared_ptr<Connection> connection,
+            int code,
+            const std::string& message,
+            std::size_t retryAfter = 0);
+
+    void wsInfo(std::shared_ptr<Connection> connection, Json::Value command);
+    void wsRead(std::shared_ptr<Connection> connection, Json::Value command);
+
+    // Parse read parameters from a query as controller.js and ReadCommand
+    // would, consuming those it knows.  Throws std::runtime_error if they
+    // are invalid.
+    void parseRead(
+            const Session& session,
+            Json::Value& query,
+            ReadStream::Params& params,
+            QueryLimits& limits) const;
+
+    std::shared_ptr<ReadStream> stream(
+            std::shared_ptr<Session> session,
+            ReadStream::Params params,
+            const QueryLimits& limits,
+            ReadStream::InitCb initCb,
+            ReadStream::DataCb dataCb);
+
+    Connection::Headers headers(const std::string& contentType) const;
+
+    const Json::Value m_config;
+    const Json::Value m_limitsJson;
+    const QueryLimits m_limits;
+    const std::vector<std::string> m_paths;
+    Connection::Headers m_headers;
+    const std::size_t m_httpMaxBuffered;
+    const std::size_t m_wsMaxBuffered;
+    const std::size_t m_timeoutMinutes;
+    int m_preloadColdDepths;
+
+    ItcBufferPool m_itcBufferPool;
+
+    std::unique_ptr<pdal::StageFactory> m_stageFactory;
+    std::mutex m_factoryMutex;
+    entwine::OuterScope m_outerScope;
+    std::shared_ptr<entwine::Cache> m_cache;
+
+    std::unique_ptr<DiskCache> m_diskCache;
+    std::unique_ptr<entwine::arbiter::Arbiter> m_remoteArbiter;
+
+    std::unique_ptr<SessionRegistry> m_sessionRegistry;
+    std::unique_ptr<ReadCache> m_readCache;
+    std::unique_ptr<ReadScheduler> m_readScheduler;
+
+    // Our connections, and the reads they hold, are destroyed with our loop,
+    // so it goes after everything they use.
+    EventLoop m_loop;
+    std::vector<int> m_listeners;
+    std::uint64_t m_nextReadId;
+
+    // Declared last so their threads are joined before anything they use
+    // is destroyed.
+    TaskPool m_compressionPool;
+    TaskPool m_prefetchPool;
+    TaskPool m_readPool;
+    TaskPool m_discoveryPool;
+    TaskPool m_preloadPool;
+
+    // Opening resources and building hierarchies, as the libuv threadpool
+    // does for the Node server.
+    TaskPool m_commandPool;
+
+    // Disallow copy/assignment.
+    Server(const Server&);
+    Server& operator=(const Server&);
+};
+
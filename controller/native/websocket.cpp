@@ -0,0 +1,218 @@
+#include "websocket.hpp"
+
+#include <algorithm>
+
+namespace
+{
+    // SHA-1, which the handshake requires.  Not for anything secret.
+    std::string sha1(const std::string& message)
+    {
+        std::uint32_t h[5] =
+        {
+            0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0
+        };
+
+        std::string data(message);
+        const std::uint64_t bits(static_cast<std::uint64_t>(data.size()) * 8);
+
+        data.push_back(static_cast<char>(0x80));
+        while (data.size() % 64 != 56) data.push_back(0);
+        for (int i(7); i >= 0; --i)
+        {
+            data.push_back(static_cast<char>((bits >> (i * 8)) & 0xFF));
+        }
+
+        auto rotate([](std::uint32_t v, int n)->std::uint32_t
+        {
+            return (v << n) | (v >> (32 - n));
+        });
+
+        for (std::size_t block(0); block < data.size(); block += 64)
+        {
+            std::uint32_t w[80];
+
+            for (std::size_t i(0); i < 16; ++i)
+            {
+                const unsigned char* p(
+                        reinterpret_cast<const unsigned char*>(
+                            data.data() + block + i * 4));
+
+                w[i] =
+                    (static_cast<std::uint32_t>(p[0]) << 24) |
+                    (static_cast<std::uint32_t>(p[1]) << 16) |
+                    (static_cast<std::uint32_t>(p[2]) << 8) |
+                    static_cast<std::uint32_t>(p[3]);
+            }
+
+            for (std::size_t i(16); i < 80; ++i)
+            {
+                w[i] = rotate(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+            }
+
+            std::uint32_t a(h[0]), b(h[1]), c(h[2]), d(h[3]), e(h[4]);
+
+            for (std::size_t i(0); i < 80; ++i)
+            {
+                std::uint32_t f(0), k(0);
+
+                if (i < 20)
+                {
+                    f = (b & c) | (~b & d);
+                    k = 0x5A827999;
+                }
+                else if (i < 40)
+                {
+                    f = b ^ c ^ d;
+                    k = 0x6ED9EBA1;
+                }
+                else if (i < 60)
+                {
+                    f = (b & c) | (b & d) | (c & d);
+                    k = 0x8F1BBCDC;
+                }
+                else
+                {
+                    f = b ^ c ^ d;
+                    k = 0xCA62C1D6;
+                }
+
+                const std::uint32_t t(rotate(a, 5) + f + e + k + w[i]);
+                e = d;
+                d = c;
+                c = rotate(b, 30);
+                b = a;
+                a = t;
+            }
+
+            h[0] += a;
+            h[1] += b;
+            h[2] += c;
+            h[3] += d;
+            h[4] += e;
+        }
+
+        std::string digest;
+        for (std::size_t i(0); i < 5; ++i)
+        {
+            for (int j(3); j >= 0; --j)
+            {
+                digest.push_back(static_cast<char>((h[i] >> (j * 8)) & 0xFF));
+            }
+        }
+
+        return digest;
+    }
+
+    std::string base64(const std::string& data)
+    {
+        static const char* chars(
+                "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz"
+                "0123456789+/");
+
+        std::string result;
+
+        for (std::size_t i(0); i < data.size(); i += 3)
+        {
+            const std::size_t n(std::min<std::size_t>(data.size() - i, 3));
+            std::uint32_t v(0);
+
+            for (std::size_t j(0); j < 3; ++j)
+            {
+                v <<= 8;
+                if (j < n) v |= static_cast<unsigned char>(data[i + j]);
+            }
+
+            for (std::size_t j(0); j < 4; ++j)
+            {
+                result.push_back(
+                        j <= n ? chars[(v >> (18 - j * 6)) & 0x3F] : '=');
+            }
+        }
+
+        return result;
+    }
+
+    const std::string guid("258EAFA5-E914-47DA-95CA-C5AB0DC85B11");
+}
+
+std::string WebSocket::accept(const std::string& key)
+{
+    return base64(sha1(key + guid));
+}
+
+WebSocket::Parse WebSocket::parse(
+        const std::string& data,
+        const std::size_t maxPayload,
+        Frame& frame,
+        std::size_t& consumed)
+{
+    if (data.size() < 2) return Parse::Incomplete;
+
+    const unsigned char* p(reinterpret_cast<const unsigned char*>(data.data()));
+
+    // Extensions are never negotiated, so reserved bits must be clear.
+    if (p[0] & 0x70) return Parse::Invalid;
+    if (!(p[1] & 0x80)) return Parse::Invalid;
+
+    frame.fin = p[0] & 0x80;
+    frame.opcode = p[0] & 0x0F;
+
+    std::size_t pos(2);
+    std::uint64_t size(p[1] & 0x7F);
+
+    if (size == 126 || size == 127)
+    {
+        const std::size_t bytes(size == 126 ? 2 : 8);
+        if (data.size() < pos + bytes) return Parse::Incomplete;
+
+        size = 0;
+        for (std::size_t i(0); i < bytes; ++i) size = (size << 8) | p[pos++];
+    }
+
+    // Control frames may not be fragmented or large.
+    if (frame.opcode & 0x8 && (!frame.fin || size > 125))
+    {
+        return Parse::Invalid;
+    }
+
+    if (size > maxPayload) return Parse::Invalid;
+    if (data.size() < pos + 4 + size) return Parse::Incomplete;
+
+    const unsigned char* mask(p + pos);
+    pos += 4;
+
+    frame.payload.assign(data, pos, size);
+    for (std::size_t i(0); i < size; ++i) frame.payload[i] ^= mask[i % 4];
+
+    consumed = pos + size;
+    return Parse::Done;
+}
+
+std::string WebSocket::header(const int opcode, const std::size_t size)
+{
+    std::string result;
+    result.push_back(static_cast<char>(0x80 | opcode));
+
+    if (size < 126)
+    {
+        result.push_back(static_cast<char>(size));
+    }
+    else if (size <= 0xFFFF)
+    {
+        result.push_back(static_cast<char>(126));
+        result.push_back(static_cast<char>((size >> 8) & 0xFF));
+        result.push_back(static_cast<char>(size & 0xFF));
+    }
+    else
+    {
+        const std::uint64_t s(size);
+        result.push_back(static_cast<char>(127));
+        for (int i(7); i >= 0; --i)
+        {
+            result.push_back(static_cast<char>((s >> (i * 8)) & 0xFF));
+        }
+    }
+
+    return result;
+}
+
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// The parts of RFC 6455 that we need as a server: the opening handshake,
+// and framing.
+class WebSocket
+{
+public:
+    enum Opcode
+    {
+        Continuation = 0x0,
+        Text = 0x1,
+        Binary = 0x2,
+        Close = 0x8,
+        Ping = 0x9,
+        Pong = 0xA
+    };
+
+    struct Frame
+    {
+        Frame() : fin(false), opcode(Continuation), payload() { }
+
+        bool fin;
+        int opcode;
+
+        // Unmasked.
+        std::string payload;
+    };
+
+    enum class Parse
+    {
+        Done,
+        Incomplete,
+        Invalid
+    };
+
+    // The Sec-WebSocket-Accept value answering a client's Sec-WebSocket-Key.
+    static std::string accept(const std::string& key);
+
+    // Parse a client frame from the beginning of data.  Client frames must
+    // be masked, and their payloads may not exceed maxPayload.  If done,
+    // consumed is set to the length of the frame.
+    static Parse parse(
+            const std::string& data,
+            std::size_t maxPayload,
+            Frame& frame,
+            std::size_t& consumed);
+
+    // The header of an unmasked, final server frame with a payload of the
+    // given size, which follows it.
+    static std::string header(int opcode, std::size_t size);
+};
+
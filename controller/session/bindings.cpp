@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <atomic>
 #include <thread>
 #include <sstream>
 
@@ -5,6 +7,7 @@
 #include <unistd.h>
 
 #include <curl/curl.h>
+#include <node_buffer.h>
 
 #include <pdal/PointLayout.hpp>
 #include <pdal/StageFactory.hpp>
@@ -22,8 +25,17 @@
 #include "commands/create.hpp"
 #include "commands/hierarchy.hpp"
 #include "commands/read.hpp"
+#include "read-queries/entwine.hpp"
+#include "types/query-limits.hpp"
 #include "util/buffer-pool.hpp"
+#include "util/caching-driver.hpp"
+#include "util/disk-cache.hpp"
+#include "util/histogram.hpp"
 #include "util/once.hpp"
+#include "util/read-cache.hpp"
+#include "util/read-scheduler.hpp"
+#include "util/session-registry.hpp"
+#include "util/task-pool.hpp"
 
 #include "bindings.hpp"
 
@@ -44,6 +56,30 @@ namespace
     const std::size_t numBuffers = 1024;
     ItcBufferPool itcBufferPool(numBuffers);
 
+    // Block compression is CPU-bound.
+    TaskPool compressionPool(
+            std::max<std::size_t>(std::thread::hardware_concurrency(), 1));
+
+    // Chunk prefetching is mostly spent waiting on remote fetches, so use
+    // more threads than we have cores.
+    TaskPool prefetchPool(
+            std::max<std::size_t>(std::thread::hardware_concurrency() * 2, 8));
+
+    // Reads are advanced in short steps, and never wait on JS-land, so this
+    // pool is mostly occupied with decoding and compression.  Reads may still
+    // wait on chunk fetches, so allow some more threads than we have cores.
+    TaskPool readPool(
+            std::max<std::size_t>(std::thread::hardware_concurrency() * 2, 8));
+
+    // Resources are searched for across all paths at once, and each probe is
+    // spent waiting on remote metadata.
+    TaskPool discoveryPool(
+            std::max<std::size_t>(std::thread::hardware_concurrency() * 2, 8));
+
+    // Preloads warm the chunk cache one resource at a time, so they never
+    // compete with reads for prefetch threads.
+    TaskPool preloadPool(1);
+
     std::mutex factoryMutex;
     std::unique_ptr<pdal::StageFactory> stageFactory(new pdal::StageFactory());
 
@@ -78,7 +114,87 @@ namespace
 
     std::mutex initMutex;
 
-    void initConfigurable(std::size_t maxCacheSize, std::string a)
+    std::unique_ptr<SessionRegistry> sessionRegistry;
+
+    // An optional local tier for remote chunks, below the in-memory cache.
+    std::unique_ptr<DiskCache> diskCache;
+
+    // Owns the drivers which fetch for our disk cache, since those of our
+    // outer scope are replaced by caching ones.
+    std::unique_ptr<entwine::arbiter::Arbiter> remoteArbiter;
+
+    // Number of cold depths to preload for each resource, or negative to
+    // disable preloading.
+    int preloadColdDepths(-1);
+
+    // Hierarchy commands queued or running.
+    std::atomic<std::size_t> hierarchyCommands(0);
+
+    // Driver types whose fetches are instrumented, and whose chunks are
+    // cached on disk if we have a disk cache, if not configured.
+    const std::vector<std::string> defaultCachedTypes { "s3", "http", "https" };
+
+    Json::Value parseConfig(const std::string& s, const std::string& name)
+    {
+        Json::Reader r;
+        Json::Value json;
+
+        if (!r.parse(s, json, false))
+        {
+            throw std::runtime_error(
+                    "Bad " + name + " config entry:" +
+                    r.getFormattedErrorMessages());
+        }
+
+        return json;
+    }
+
+    // Route the files fetched by our outer scope's arbiter through drivers
+    // which count and time them, and which keep chunks in our disk cache if
+    // we have one.  Must be called before any endpoints are created from it,
+    // since they refer to its drivers.
+    void wrapDrivers(
+            const Json::Value& arbiterJson,
+            const std::vector<std::string>& types)
+    {
+        remoteArbiter.reset(
+                arbiterJson.isNull() ?
+                    new entwine::arbiter::Arbiter() :
+                    new entwine::arbiter::Arbiter(arbiterJson));
+
+        for (const std::string& type : types)
+        {
+            try
+            {
+                const entwine::arbiter::Driver& inner(
+                        remoteArbiter->getDriver(type + "://"));
+
+                outerScope.getArbiterPtr()->addDriver(
+                        type,
+                        std::unique_ptr<entwine::arbiter::Driver>(
+                            new CachingDriver(inner, diskCache.get())));
+
+                if (diskCache)
+                {
+                    std::cout << "\tCaching " << type << " chunks on disk" <<
+                        std::endl;
+                }
+            }
+            catch (const std::runtime_error& e)
+            {
+                std::cout << "\tNot wrapping " << type << " driver: " <<
+                    e.what() << std::endl;
+            }
+        }
+    }
+
+    void initConfigurable(
+            std::size_t maxCacheSize,
+            std::string a,
+            std::size_t maxSessionBytes,
+            std::size_t missingSeconds,
+            std::string d,
+            int preloadDepths)
     {
         std::lock_guard<std::mutex> lock(initMutex);
 
@@ -89,28 +205,281 @@ namespace
             cache.reset(new entwine::Cache(maxCacheSize));
         }
 
+        if (!sessionRegistry)
+        {
+            preloadColdDepths = preloadDepths;
+
+            sessionRegistry.reset(
+                    new SessionRegistry(
+                        maxSessionBytes,
+                        missingSeconds,
+                        []()->std::shared_ptr<Session>
+                        {
+                            return std::make_shared<Session>(
+                                *stageFactory,
+                                factoryMutex,
+                                compressionPool,
+                                prefetchPool,
+                                discoveryPool,
+                                preloadPool);
+                        }));
+        }
+
         if (!outerScope.getArbiterPtr())
         {
+            // Set up our disk cache first, so if it can't be used, nothing
+            // has been configured without it.
+            std::vector<std::string> cachedTypes(defaultCachedTypes);
+
+            if (!d.empty() && !diskCache)
+            {
+                const Json::Value json(parseConfig(d, "disk cache"));
+                const std::size_t maxBytes(
+                        json["maxMb"].asDouble() * 1024 * 1024);
+
+                if (json.isMember("types"))
+                {
+                    cachedTypes.clear();
+
+                    for (const Json::Value& type : json["types"])
+                    {
+                        cachedTypes.push_back(type.asString());
+                    }
+                }
+
+                diskCache.reset(
+                        new DiskCache(json["path"].asString(), maxBytes));
+            }
+
+            Json::Value json;
+
             if (a.empty())
             {
                 outerScope.getArbiter();
             }
             else
             {
-                Json::Reader r;
-                Json::Value json;
-
-                if (!r.parse(a, json, false))
-                {
-                    throw std::runtime_error(
-                            "Bad arbiter config entry:" +
-                            r.getFormattedErrorMessages());
-                }
+                json = parseConfig(a, "arbiter");
 
                 std::cout << "Using custom arbiter configuration" << std::endl;
                 outerScope.getArbiter(json);
             }
+
+            wrapDrivers(json, cachedTypes);
+        }
+    }
+
+    // Sized by the first query limits we see, since they all come from the
+    // same configuration.
+    std::unique_ptr<ReadCache> readCache;
+
+    ReadCache& getReadCache(const QueryLimits& limits)
+    {
+        std::lock_guard<std::mutex> lock(initMutex);
+
+        if (!readCache)
+        {
+            readCache.reset(new ReadCache(limits.responseCacheBytes()));
+        }
+
+        return *readCache;
+    }
+
+    void purgeReadCache(const std::string& name)
+    {
+        std::lock_guard<std::mutex> lock(initMutex);
+        if (readCache) readCache->purge(name);
+    }
+
+    // Responses for evicted resources may be stale once they are reopened.
+    void evictSessions(std::size_t maxIdleSeconds = 0)
+    {
+        for (const std::string& name : sessionRegistry->sweep(maxIdleSeconds))
+        {
+            std::cout << "Evicted " << name << std::endl;
+            purgeReadCache(name);
+        }
+    }
+
+    // Like our read cache, configured by the first query limits we see.
+    std::unique_ptr<ReadScheduler> readScheduler;
+
+    ReadScheduler& getReadScheduler(const QueryLimits& limits)
+    {
+        std::lock_guard<std::mutex> lock(initMutex);
+
+        if (!readScheduler) readScheduler.reset(new ReadScheduler(limits));
+
+        return *readScheduler;
+    }
+
+    // Statistics, for our stats binding.  Counters which are totals since
+    // startup are cheap enough to be always on.
+
+    Json::Value toJson(const Histogram::Snapshot& snapshot)
+    {
+        Json::Value json;
+
+        json["count"] = static_cast<Json::UInt64>(snapshot.count);
+        json["totalMicros"] = static_cast<Json::UInt64>(snapshot.totalMicros);
+        json["maxMicros"] = static_cast<Json::UInt64>(snapshot.maxMicros);
+        json["p50Micros"] = static_cast<Json::UInt64>(snapshot.quantile(0.5));
+        json["p90Micros"] = static_cast<Json::UInt64>(snapshot.quantile(0.9));
+        json["p99Micros"] = static_cast<Json::UInt64>(snapshot.quantile(0.99));
+
+        // Only the buckets which have been hit, by their upper bounds.
+        Json::Value& buckets(json["buckets"]);
+
+        for (std::size_t i(0); i < Histogram::numBuckets; ++i)
+        {
+            if (!snapshot.buckets[i]) continue;
+
+            const std::string bound(
+                    i < Histogram::numBuckets - 1 ?
+                        std::to_string(Histogram::upperMicros(i)) :
+                        "inf");
+
+            buckets[bound] = static_cast<Json::UInt64>(snapshot.buckets[i]);
+        }
+
+        return json;
+    }
+
+    Json::Value toJson(const ItcBufferPool::Stats& stats)
+    {
+        Json::Value json;
+
+        json["acquires"] = static_cast<Json::UInt64>(stats.acquires);
+        json["waits"] = static_cast<Json::UInt64>(stats.waits);
+        json["timeouts"] = static_cast<Json::UInt64>(stats.timeouts);
+        json["waitMicros"] = static_cast<Json::UInt64>(stats.waitMicros);
+        json["bytesRetained"] = static_cast<Json::UInt64>(stats.bytesRetained);
+        json["inUse"] = static_cast<Json::UInt64>(stats.inUse);
+        json["peakInUse"] = static_cast<Json::UInt64>(stats.peakInUse);
+        json["numBuffers"] = static_cast<Json::UInt64>(stats.numBuffers);
+
+        return json;
+    }
+
+    Json::Value toJson(const CachingDriver::Stats& stats)
+    {
+        Json::Value json;
+
+        json["chunks"] = static_cast<Json::UInt64>(stats.chunkFetches);
+        json["pinHits"] = static_cast<Json::UInt64>(stats.pinHits);
+        json["diskHits"] = static_cast<Json::UInt64>(stats.diskHits);
+        json["fetches"] = static_cast<Json::UInt64>(stats.fetches);
+        json["fetchedBytes"] = static_cast<Json::UInt64>(stats.fetchedBytes);
+        json["fetchTimes"] = toJson(stats.fetchTimes);
+
+        return json;
+    }
+
+    Json::Value toJson(const TaskPool& pool)
+    {
+        Json::Value json;
+
+        json["threads"] = static_cast<Json::UInt64>(pool.numThreads());
+        json["queued"] = static_cast<Json::UInt64>(pool.queued());
+
+        return json;
+    }
+
+    Json::Value toJson(const HierarchyCache::Stats& stats)
+    {
+        Json::Value json;
+
+        json["hits"] = static_cast<Json::UInt64>(stats.hits);
+        json["truncatedHits"] = static_cast<Json::UInt64>(stats.truncatedHits);
+        json["subtreeHits"] = static_cast<Json::UInt64>(stats.subtreeHits);
+        json["misses"] = static_cast<Json::UInt64>(stats.misses);
+        json["evictions"] = static_cast<Json::UInt64>(stats.evictions);
+        json["estimatedBytes"] = static_cast<Json::UInt64>(stats.bytes);
+        json["maxBytes"] = static_cast<Json::UInt64>(stats.maxBytes);
+
+        return json;
+    }
+
+    Json::Value toJson(const SessionRegistry::Stats& stats)
+    {
+        Json::Value json;
+
+        json["sessions"] = static_cast<Json::UInt64>(stats.sessions);
+        json["active"] = static_cast<Json::UInt64>(stats.active);
+        json["bytes"] = static_cast<Json::UInt64>(stats.bytes);
+        json["maxBytes"] = static_cast<Json::UInt64>(stats.maxBytes);
+        json["pinnedBytes"] = static_cast<Json::UInt64>(stats.pinnedBytes);
+        json["opens"] = static_cast<Json::UInt64>(stats.opens);
+        json["reopens"] = static_cast<Json::UInt64>(stats.reopens);
+        json["evictions"] = static_cast<Json::UInt64>(stats.evictions);
+        json["missing"] = static_cast<Json::UInt64>(stats.missing);
+        json["missingHits"] = static_cast<Json::UInt64>(stats.missingHits);
+        json["hierarchyCache"] = toJson(stats.hierarchy);
+
+        for (const auto& p : stats.resources)
+        {
+            const SessionRegistry::Resource& resource(p.second);
+            Json::Value& r(json["resources"][p.first]);
+
+            r["estimatedBytes"] = static_cast<Json::UInt64>(resource.bytes);
+            r["pinnedBytes"] = static_cast<Json::UInt64>(resource.pinnedBytes);
+            r["active"] = resource.active;
         }
+
+        return json;
+    }
+
+    Json::Value toJson(const ReadCache::Stats& stats)
+    {
+        Json::Value json;
+
+        json["hits"] = static_cast<Json::UInt64>(stats.hits);
+        json["misses"] = static_cast<Json::UInt64>(stats.misses);
+        json["inserts"] = static_cast<Json::UInt64>(stats.inserts);
+        json["evictions"] = static_cast<Json::UInt64>(stats.evictions);
+        json["bytes"] = static_cast<Json::UInt64>(stats.bytes);
+        json["entries"] = static_cast<Json::UInt64>(stats.entries);
+        json["maxBytes"] = static_cast<Json::UInt64>(stats.maxBytes);
+
+        for (const auto& p : stats.resourceBytes)
+        {
+            json["resourceBytes"][p.first] =
+                static_cast<Json::UInt64>(p.second);
+        }
+
+        return json;
+    }
+
+    Json::Value toJson(const DiskCache::Stats& stats)
+    {
+        Json::Value json;
+
+        json["hits"] = static_cast<Json::UInt64>(stats.hits);
+        json["misses"] = static_cast<Json::UInt64>(stats.misses);
+        json["inserts"] = static_cast<Json::UInt64>(stats.inserts);
+        json["evictions"] = static_cast<Json::UInt64>(stats.evictions);
+        json["bytes"] = static_cast<Json::UInt64>(stats.bytes);
+        json["entries"] = static_cast<Json::UInt64>(stats.entries);
+        json["maxBytes"] = static_cast<Json::UInt64>(stats.maxBytes);
+
+        return json;
+    }
+
+    Json::Value toJson(const ReadScheduler::Stats& stats)
+    {
+        Json::Value json;
+
+        json["admitted"] = static_cast<Json::UInt64>(stats.admitted);
+        json["deferred"] = static_cast<Json::UInt64>(stats.deferred);
+        json["rejected"] = static_cast<Json::UInt64>(stats.rejected);
+        json["waitMicros"] = static_cast<Json::UInt64>(stats.waitMicros);
+        json["maxWaitMicros"] = static_cast<Json::UInt64>(stats.maxWaitMicros);
+        json["running"] = static_cast<Json::UInt64>(stats.running);
+        json["runningPoints"] = static_cast<Json::UInt64>(stats.runningPoints);
+        json["queued"] = static_cast<Json::UInt64>(stats.queued);
+        json["peakQueued"] = static_cast<Json::UInt64>(stats.peakQueued);
+
+        return json;
     }
 }
 
@@ -127,7 +496,7 @@ namespace ghEnv
 Persistent<Function> Bindings::constructor;
 
 Bindings::Bindings()
-    : m_session(new Session(*stageFactory, factoryMutex))
+    : m_session()
     , m_itcBufferPool(itcBufferPool)
 {
     ghEnv::curlOnce.ensure([]()->void {
@@ -150,13 +519,75 @@ void Bindings::init(v8::Handle<v8::Object> exports)
 
     NODE_SET_PROTOTYPE_METHOD(tpl, "construct", construct);
     NODE_SET_PROTOTYPE_METHOD(tpl, "create",    create);
-    NODE_SET_PROTOTYPE_METHOD(tpl, "destroy",   destroy);
+    NODE_SET_PROTOTYPE_METHOD(tpl, "release",   release);
     NODE_SET_PROTOTYPE_METHOD(tpl, "info",      info);
     NODE_SET_PROTOTYPE_METHOD(tpl, "read",      read);
     NODE_SET_PROTOTYPE_METHOD(tpl, "hierarchy", hierarchy);
+    NODE_SET_PROTOTYPE_METHOD(tpl, "pause",     pause);
+    NODE_SET_PROTOTYPE_METHOD(tpl, "resume",    resume);
+    NODE_SET_PROTOTYPE_METHOD(tpl, "cancel",    cancel);
 
     constructor.Reset(isolate, tpl->GetFunction());
     exports->Set(String::NewFromUtf8(isolate, "Bindings"), tpl->GetFunction());
+
+    NODE_SET_METHOD(exports, "recycle", recycle);
+    NODE_SET_METHOD(exports, "stats", stats);
+    NODE_SET_METHOD(exports, "sweep", sweep);
+}
+
+std::shared_ptr<Session> Bindings::lease()
+{
+    if (!m_session) throw std::runtime_error("Session has not been created");
+
+    std::shared_ptr<Session> session;
+    session.swap(m_session);
+    return session;
+}
+
+void Bindings::sweep(const FunctionCallbackInfo<Value>& args)
+{
+    Isolate* isolate(args.GetIsolate());
+    HandleScope scope(isolate);
+
+    if (!args[0]->IsNumber()) throw std::runtime_error("Invalid idle time");
+
+    if (sessionRegistry) evictSessions(args[0]->IntegerValue());
+}
+
+void Bindings::stats(const FunctionCallbackInfo<Value>& args)
+{
+    Isolate* isolate(args.GetIsolate());
+    HandleScope scope(isolate);
+
+    Json::Value json;
+
+    json["buffers"] = toJson(itcBufferPool.stats());
+    json["chunks"]["reads"] = toJson(EntwineReadQuery::readTimes().snapshot());
+    json["chunks"]["fetches"] = toJson(CachingDriver::stats());
+
+    json["commands"]["reads"] =
+        static_cast<Json::UInt64>(ReadCommand::count());
+    json["commands"]["hierarchy"] =
+        static_cast<Json::UInt64>(hierarchyCommands.load());
+
+    json["pools"]["read"] = toJson(readPool);
+    json["pools"]["prefetch"] = toJson(prefetchPool);
+    json["pools"]["compression"] = toJson(compressionPool);
+    json["pools"]["discovery"] = toJson(discoveryPool);
+    json["pools"]["preload"] = toJson(preloadPool);
+
+    std::unique_lock<std::mutex> lock(initMutex);
+
+    if (sessionRegistry) json["sessions"] = toJson(sessionRegistry->stats());
+    if (readCache) json["readCache"] = toJson(readCache->stats());
+    if (diskCache) json["diskCache"] = toJson(diskCache->stats());
+    if (readScheduler) json["reads"] = toJson(readScheduler->stats());
+
+    lock.unlock();
+
+    Json::FastWriter writer;
+    args.GetReturnValue().Set(
+            String::NewFromUtf8(isolate, writer.write(json).c_str()));
 }
 
 void Bindings::construct(const FunctionCallbackInfo<Value>& args)
@@ -186,17 +617,21 @@ void Bindings::create(const FunctionCallbackInfo<Value>& args)
 
     Bindings* obj = ObjectWrap::Unwrap<Bindings>(args.Holder());
 
-    if (args.Length() != 5)
+    if (args.Length() != 9)
     {
         throw std::runtime_error("Wrong number of arguments to create");
     }
 
     std::size_t i(0);
-    const auto& nameArg (args[i++]);
-    const auto& pathsArg(args[i++]);
-    const auto& cacheArg(args[i++]);
-    const auto& arbArg  (args[i++]);
-    const auto& cbArg   (args[i++]);
+    const auto& nameArg     (args[i++]);
+    const auto& pathsArg    (args[i++]);
+    const auto& cacheArg    (args[i++]);
+    const auto& arbArg      (args[i++]);
+    const auto& sessionsArg (args[i++]);
+    const auto& missingArg  (args[i++]);
+    const auto& diskArg     (args[i++]);
+    const auto& preloadArg  (args[i++]);
+    const auto& cbArg       (args[i++]);
 
     std::string errMsg("");
 
@@ -221,18 +656,51 @@ void Bindings::create(const FunctionCallbackInfo<Value>& args)
     }
 
     const std::string name(*v8::String::Utf8Value(nameArg->ToString()));
-    const std::vector<std::string> paths(parsePathList(isolate, pathsArg));
+    std::vector<std::string> paths(parsePathList(isolate, pathsArg));
     const std::size_t maxCacheSize(cacheArg->IntegerValue());
     const std::string arbiterCfg(*v8::String::Utf8Value(arbArg->ToString()));
+    const std::size_t maxSessionBytes(
+            std::max<double>(sessionsArg->NumberValue(), 0) * 1024 * 1024);
+    const std::size_t missingSeconds(
+            std::max<double>(missingArg->NumberValue(), 0));
+    const std::string diskCfg(*v8::String::Utf8Value(diskArg->ToString()));
+    const int preloadDepths(
+            preloadArg->IsNumber() ? preloadArg->IntegerValue() : -1);
+
+    initConfigurable(
+            maxCacheSize,
+            arbiterCfg,
+            maxSessionBytes,
+            missingSeconds,
+            diskCfg,
+            preloadDepths);
+
+    // Don't search again for a resource we've just failed to find.
+    if (sessionRegistry->missing(name))
+    {
+        Status status(404, "Not found");
+        const unsigned argc = 1;
+        Local<Value> argv[argc] = { status.toObject(isolate) };
+
+        Local<Function> local(Local<Function>::New(isolate, callback));
+
+        local->Call(isolate->GetCurrentContext()->Global(), argc, argv);
+        callback.Reset();
+        return;
+    }
 
-    initConfigurable(maxCacheSize, arbiterCfg);
+    // Held until this handle issues its command, so it can't be evicted in
+    // the meantime.
+    obj->m_session = sessionRegistry->get(name);
 
-    // Store everything we'll need to perform initialization.
+    // Store everything we'll need to perform initialization.  If this
+    // resource has been evicted, its search starts wherever it was found.
     uv_work_t* req(new uv_work_t);
     req->data = new CreateData(
             obj->m_session,
             name,
             paths,
+            sessionRegistry->hint(name),
             outerScope,
             cache,
             std::move(callback));
@@ -250,7 +718,8 @@ void Bindings::create(const FunctionCallbackInfo<Value>& args)
                         createData->name,
                         createData->paths,
                         createData->outerScope,
-                        createData->cache))
+                        createData->cache,
+                        createData->hint))
                 {
                     createData->status.set(404, "Not found");
                 }
@@ -263,6 +732,26 @@ void Bindings::create(const FunctionCallbackInfo<Value>& args)
 
             CreateData* createData(static_cast<CreateData*>(req->data));
 
+            // Don't hang on to resources that failed to open, and make room
+            // for those that did.
+            if (createData->status.code() == 404)
+            {
+                sessionRegistry->miss(createData->name, createData->session);
+            }
+            else if (!createData->status.ok())
+            {
+                sessionRegistry->erase(createData->name, createData->session);
+            }
+            else
+            {
+                if (preloadColdDepths >= 0)
+                {
+                    createData->session->preload(preloadColdDepths);
+                }
+
+                evictSessions();
+            }
+
             const unsigned argc = 1;
             Local<Value> argv[argc] = { createData->status.toObject(isolate) };
 
@@ -278,7 +767,7 @@ void Bindings::create(const FunctionCallbackInfo<Value>& args)
     );
 }
 
-void Bindings::destroy(const FunctionCallbackInfo<Value>& args)
+void Bindings::release(const FunctionCallbackInfo<Value>& args)
 {
     Isolate* isolate(args.GetIsolate());
     HandleScope scope(isolate);
@@ -293,7 +782,7 @@ void Bindings::info(const FunctionCallbackInfo<Value>& args)
     HandleScope scope(isolate);
     Bindings* obj = ObjectWrap::Unwrap<Bindings>(args.Holder());
 
-    const std::string info(obj->m_session->info());
+    const std::string info(obj->lease()->info());
     args.GetReturnValue().Set(String::NewFromUtf8(isolate, info.c_str()));
 }
 
@@ -302,12 +791,14 @@ void Bindings::read(const FunctionCallbackInfo<Value>& args)
     Isolate* isolate(args.GetIsolate());
     HandleScope scope(isolate);
     Bindings* obj = ObjectWrap::Unwrap<Bindings>(args.Holder());
+    const std::shared_ptr<Session> session(obj->lease());
 
     std::size_t i(0);
     const auto& schemaArg   (args[i++]);
     const auto& compressArg (args[i++]);
     const auto& scaleArg    (args[i++]);
     const auto& offsetArg   (args[i++]);
+    const auto& limitsArg   (args[i++]);
     const auto& queryArg    (args[i++]);
     const auto& initCbArg   (args[i++]);
     const auto& dataCbArg   (args[i++]);
@@ -316,8 +807,9 @@ void Bindings::read(const FunctionCallbackInfo<Value>& args)
 
     if (!schemaArg->IsString() && !schemaArg->IsUndefined())
         errMsg += "\t'schema' must be a string or undefined";
-    if (!compressArg->IsBoolean())  errMsg += "\t'compress' must be a boolean";
+    if (!compressArg->IsString())   errMsg += "\t'compress' must be a string";
     if (!scaleArg->IsNumber())      errMsg += "\t'scale' must be a number";
+    if (!limitsArg->IsString())     errMsg += "\t'limits' must be a string";
     if (!queryArg->IsObject())      errMsg += "\tInvalid query type";
     if (!initCbArg->IsFunction())   throw std::runtime_error("Invalid initCb");
     if (!dataCbArg->IsFunction())   throw std::runtime_error("Invalid dataCb");
@@ -327,11 +819,39 @@ void Bindings::read(const FunctionCallbackInfo<Value>& args)
                 *v8::String::Utf8Value(schemaArg->ToString()) :
                 "");
 
-    const bool compress(compressArg->BooleanValue());
+    const std::string compressString(
+            compressArg->IsString() ?
+                *v8::String::Utf8Value(compressArg->ToString()) :
+                "none");
+
+    CompressionMode compress(CompressionMode::None);
+
+    if (compressString == "stream") compress = CompressionMode::Stream;
+    else if (compressString == "blocks") compress = CompressionMode::Blocks;
+    else if (compressString != "none")
+    {
+        errMsg += "\t'compress' must be 'none', 'stream', or 'blocks'";
+    }
+
     const double scale(scaleArg->NumberValue());
     const entwine::Point offset(parsePoint(offsetArg));
     Local<Object> query(queryArg->ToObject());
 
+    QueryLimits limits;
+
+    if (errMsg.empty())
+    {
+        try
+        {
+            limits = QueryLimits::parse(
+                    *v8::String::Utf8Value(limitsArg->ToString()));
+        }
+        catch (const std::runtime_error& e)
+        {
+            errMsg += std::string("\t") + e.what();
+        }
+    }
+
     UniquePersistent<Function> initCb(
             isolate,
             Local<Function>::Cast(initCbArg));
@@ -354,8 +874,12 @@ void Bindings::read(const FunctionCallbackInfo<Value>& args)
     ReadCommand* readCommand(
             ReadCommand::create(
                 isolate,
-                obj->m_session,
+                session,
                 obj->m_itcBufferPool,
+                getReadCache(limits),
+                readPool,
+                getReadScheduler(limits),
+                limits,
                 schemaString,
                 compress,
                 scale,
@@ -366,84 +890,65 @@ void Bindings::read(const FunctionCallbackInfo<Value>& args)
 
     if (!readCommand) return;
 
-    // Store our read command where our worker functions can access it.
-    uv_work_t* req(new uv_work_t);
-    req->data = readCommand;
+    // Read points on our own pool rather than the libuv threadpool, which is
+    // left free for short-lived commands.
+    readCommand->start();
 
-    // Read points asynchronously.
-    uv_queue_work(
-        uv_default_loop(),
-        req,
-        (uv_work_cb)([](uv_work_t* req)->void
-        {
-            ReadCommand* readCommand(static_cast<ReadCommand*>(req->data));
+    // The ID of this read, for flow control.
+    args.GetReturnValue().Set(
+            Number::New(isolate, static_cast<double>(readCommand->id())));
+}
 
-            // Run the query.  This will ensure indexing if needed, and
-            // will obtain everything needed to start streaming binary
-            // data to the client.
-            readCommand->safe([readCommand]()->void
-            {
-                try
-                {
-                    readCommand->run();
-                }
-                catch (entwine::InvalidQuery& e)
-                {
-                    readCommand->status.set(400, e.what());
-                }
-                catch (WrongQueryType& e)
-                {
-                    readCommand->status.set(400, e.what());
-                }
-                catch (...)
-                {
-                    readCommand->status.set(500, "Error during query");
-                }
-            });
+void Bindings::pause(const FunctionCallbackInfo<Value>& args)
+{
+    Isolate* isolate(args.GetIsolate());
+    HandleScope scope(isolate);
 
-            // Call initial informative callback.  If status is no good, we're
-            // done here - don't continue for data.
-            readCommand->doCb(readCommand->initAsync());
-            if (!readCommand->status.ok()) { return; }
+    if (!args[0]->IsNumber()) throw std::runtime_error("Invalid read ID");
 
-            readCommand->safe([readCommand]()->void
-            {
-                readCommand->acquire();
+    ReadCommand* readCommand(
+            ReadCommand::find(args[0]->IntegerValue()));
 
-                try
-                {
-                    do
-                    {
-                        readCommand->read();
-                        readCommand->doCb(readCommand->dataAsync());
-                    }
-                    while (!readCommand->done() && readCommand->status.ok());
-                }
-                catch (std::runtime_error& e)
-                {
-                    readCommand->status.set(500, e.what());
-                }
-                catch (...)
-                {
-                    readCommand->status.set(500, "Error during query");
-                }
-            });
-        }),
-        (uv_after_work_cb)([](uv_work_t* req, int status)->void
-        {
-            Isolate* isolate(Isolate::GetCurrent());
-            HandleScope scope(isolate);
-            ReadCommand* readCommand(static_cast<ReadCommand*>(req->data));
+    if (readCommand) readCommand->pause();
+}
 
-            if (readCommand->terminate())
-            {
-                std::cout << "Read was successfully terminated" << std::endl;
-            }
+void Bindings::resume(const FunctionCallbackInfo<Value>& args)
+{
+    Isolate* isolate(args.GetIsolate());
+    HandleScope scope(isolate);
 
-            delete readCommand;
-            delete req;
-        })
-    );
+    if (!args[0]->IsNumber()) throw std::runtime_error("Invalid read ID");
+
+    ReadCommand* readCommand(
+            ReadCommand::find(args[0]->IntegerValue()));
+
+    if (readCommand) readCommand->resume();
+}
+
+void Bindings::cancel(const FunctionCallbackInfo<Value>& args)
+{
+    Isolate* isolate(args.GetIsolate());
+    HandleScope scope(isolate);
+
+    if (!args[0]->IsNumber()) throw std::runtime_error("Invalid read ID");
+
+    ReadCommand* readCommand(
+            ReadCommand::find(args[0]->IntegerValue()));
+
+    if (readCommand) readCommand->cancel();
+}
+
+void Bindings::recycle(const FunctionCallbackInfo<Value>& args)
+{
+    Isolate* isolate(args.GetIsolate());
+    HandleScope scope(isolate);
+
+    if (!node::Buffer::HasInstance(args[0]))
+    {
+        throw std::runtime_error("Invalid buffer");
+    }
+
+    ReadCommand::recycle(node::Buffer::Data(args[0]));
 }
 
 void Bindings::hierarchy(const FunctionCallbackInfo<Value>& args)
@@ -451,6 +956,7 @@ void Bindings::hierarchy(const FunctionCallbackInfo<Value>& args)
     Isolate* isolate(args.GetIsolate());
     HandleScope scope(isolate);
     Bindings* obj = ObjectWrap::Unwrap<Bindings>(args.Holder());
+    const std::shared_ptr<Session> session(obj->lease());
 
     std::size_t i(0);
     const auto& queryArg(args[i++]);
@@ -478,7 +984,7 @@ void Bindings::hierarchy(const FunctionCallbackInfo<Value>& args)
     HierarchyCommand* hierarchyCommand(
             HierarchyCommand::create(
                 isolate,
-                obj->m_session,
+                session,
                 query,
                 std::move(cb)));
 
@@ -488,6 +994,8 @@ void Bindings::hierarchy(const FunctionCallbackInfo<Value>& args)
     uv_work_t* req(new uv_work_t);
     req->data = hierarchyCommand;
 
+    ++hierarchyCommands;
+
     // Read points asynchronously.
     uv_queue_work(
         uv_default_loop(),
@@ -516,13 +1024,28 @@ void Bindings::hierarchy(const FunctionCallbackInfo<Value>& args)
             HierarchyCommand* command(
                 static_cast<HierarchyCommand*>(req->data));
 
+            --hierarchyCommands;
+
+            const std::string& result(command->result());
+
+            // Binary results go straight to JS-land as a Buffer.
+            Local<Value> data(
+                    command->binary() ?
+                        Local<Value>(
+                            node::Buffer::Copy(
+                                isolate,
+                                result.data(),
+                                result.size()).ToLocalChecked()) :
+                        Local<Value>(
+                            String::NewFromUtf8(isolate, result.c_str())));
+
             const unsigned argc = 2;
             Local<Value> argv[argc] =
             {
                 command->status.ok() ?
                     Local<Value>::New(isolate, Null(isolate)) : // err
                     command->status.toObject(isolate),
-                String::NewFromUtf8(isolate, command->result().c_str())
+                data
             };
 
             Local<Function> local(Local<Function>::New(isolate, command->cb()));
@@ -30,11 +30,33 @@ private:
     static void construct(const Args& args);
 
     static void create(const Args& args);
-    static void destroy(const Args& args);
+
+    // Give up this handle's session without issuing a command.
+    static void release(const Args& args);
+
     static void info(const Args& args);
     static void read(const Args& args);
     static void hierarchy(const Args& args);
 
+    // Flow control for a read, by the ID returned from read().
+    static void pause(const Args& args);
+    static void resume(const Args& args);
+    static void cancel(const Args& args);
+
+    // Return a buffer given to a read's data callback to our pool once it
+    // has been written, rather than waiting for it to be garbage collected.
+    static void recycle(const Args& args);
+
+    // Process-wide statistics, as stringified JSON.
+    static void stats(const Args& args);
+
+    // Evict sessions idle for longer than the given number of seconds.
+    static void sweep(const Args& args);
+
+    // Each handle is created for a single command, which takes over its
+    // session.
+    std::shared_ptr<Session> lease();
+
     std::shared_ptr<Session> m_session;
     ItcBufferPool& m_itcBufferPool;
 };
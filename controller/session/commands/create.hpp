@@ -16,12 +16,14 @@ struct CreateData : public Background
             std::shared_ptr<Session> session,
             std::string name,
             const std::vector<std::string>& paths,
+            std::string hint,
             entwine::OuterScope& outerScope,
             std::shared_ptr<entwine::Cache> cache,
             v8::UniquePersistent<v8::Function> callback)
         : session(session)
         , name(name)
         , paths(paths)
+        , hint(hint)
         , outerScope(outerScope)
         , cache(cache)
         , callback(std::move(callback))
@@ -36,6 +38,7 @@ struct CreateData : public Background
     const std::shared_ptr<Session> session;
     const std::string name;
     const std::vector<std::string> paths;
+    const std::string hint;
     entwine::OuterScope& outerScope;
     std::shared_ptr<entwine::Cache> cache;
 
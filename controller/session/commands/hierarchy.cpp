@@ -12,12 +12,14 @@ HierarchyCommand::HierarchyCommand(
         std::size_t depthBegin,
         std::size_t depthEnd,
         bool vertical,
+        bool binary,
         v8::UniquePersistent<v8::Function> cb)
     : m_session(session)
     , m_bounds(bounds)
     , m_depthBegin(depthBegin)
     , m_depthEnd(depthEnd)
     , m_vertical(vertical)
+    , m_binary(binary)
     , m_result()
     , m_cb(std::move(cb))
 { }
@@ -31,7 +33,8 @@ void HierarchyCommand::run()
             m_bounds,
             m_depthBegin,
             m_depthEnd,
-            m_vertical);
+            m_vertical,
+            m_binary);
 }
 
 HierarchyCommand* HierarchyCommand::create(
@@ -41,11 +44,13 @@ HierarchyCommand* HierarchyCommand::create(
         v8::UniquePersistent<v8::Function> cb)
 {
     HierarchyCommand* command(nullptr);
+    std::string error("Invalid hierarchy query parameters");
 
     const auto depthBeginSymbol(toSymbol(isolate, "depthBegin"));
     const auto depthEndSymbol(toSymbol(isolate, "depthEnd"));
     const auto boundsSymbol(toSymbol(isolate, "bounds"));
     const auto verticalSymbol(toSymbol(isolate, "vertical"));
+    const auto binarySymbol(toSymbol(isolate, "binary"));
 
     if (
             query->HasOwnProperty(depthBeginSymbol) &&
@@ -63,7 +68,16 @@ HierarchyCommand* HierarchyCommand::create(
                 query->HasOwnProperty(verticalSymbol) &&
                 query->Get(verticalSymbol)->BooleanValue());
 
-        if (bounds.exists())
+        const bool binary(
+                query->HasOwnProperty(binarySymbol) &&
+                query->Get(binarySymbol)->BooleanValue());
+
+        // Vertical hierarchies aren't trees, so they can't be encoded.
+        if (vertical && binary)
+        {
+            error = "Binary hierarchies may not be vertical";
+        }
+        else if (bounds.exists())
         {
             command = new HierarchyCommand(
                     session,
@@ -71,6 +85,7 @@ HierarchyCommand* HierarchyCommand::create(
                     depthBegin,
                     depthEnd,
                     vertical,
+                    binary,
                     std::move(cb));
         }
     }
@@ -78,7 +93,7 @@ HierarchyCommand* HierarchyCommand::create(
     if (!command)
     {
         std::cout << "Bad hierarchy command" << std::endl;
-        Status status(400, std::string("Invalid hierarchy query parameters"));
+        Status status(400, error);
         const unsigned argc = 1;
         Local<Value> argv[argc] = { status.toObject(isolate) };
 
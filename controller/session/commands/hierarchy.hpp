@@ -15,6 +15,7 @@ public:
             std::size_t depthBegin,
             std::size_t depthEnd,
             bool vertical,
+            bool binary,
             v8::UniquePersistent<v8::Function> cb);
 
     virtual ~HierarchyCommand();
@@ -26,7 +27,8 @@ public:
             v8::UniquePersistent<v8::Function> cb);
 
     void run();
-    std::string result() const { return m_result; }
+    const std::string& result() const { return m_result; }
+    bool binary() const { return m_binary; }
     v8::UniquePersistent<v8::Function>& cb() { return m_cb; }
 
 private:
@@ -35,6 +37,7 @@ private:
     const std::size_t m_depthBegin;
     const std::size_t m_depthEnd;
     const bool m_vertical;
+    const bool m_binary;
 
     std::string m_result;
 
@@ -1,56 +1,39 @@
-#include <node_buffer.h>
+#include <map>
 
-#include <pdal/PointLayout.hpp>
+#include <node_buffer.h>
 
-#include <entwine/types/dim-info.hpp>
-#include <entwine/types/point.hpp>
+#include <entwine/third/json/json.hpp>
+#include <entwine/types/bounds.hpp>
 #include <entwine/types/schema.hpp>
 
 #include "session.hpp"
 
+#include "commands/background.hpp"
 #include "commands/read.hpp"
+#include "util/buffer-pool.hpp"
 
 using namespace v8;
 
 namespace
 {
+    // Live commands by ID, so JS-land may control them.  Only accessed from
+    // the event loop.
+    std::map<std::uint64_t, ReadCommand*> registry;
+    std::uint64_t nextId(1);
+
     std::size_t isEmpty(v8::Local<v8::Object> object)
     {
         return object->GetOwnPropertyNames()->Length() == 0;
     }
-}
 
-ReadCommand::ReadCommand(
-        std::shared_ptr<Session> session,
-        ItcBufferPool& itcBufferPool,
-        const bool compress,
-        const double scale,
-        const entwine::Point& offset,
-        const std::string schemaString,
-        v8::UniquePersistent<v8::Function> initCb,
-        v8::UniquePersistent<v8::Function> dataCb)
-    : m_session(session)
-    , m_itcBufferPool(itcBufferPool)
-    , m_itcBuffer()
-    , m_compress(compress)
-    , m_scale(scale)
-    , m_offset(offset)
-    , m_schema(schemaString.empty() ?
-            session->schema() : entwine::Schema(schemaString))
-    , m_numSent(0)
-    , m_initAsync(new uv_async_t())
-    , m_dataAsync(new uv_async_t())
-    , m_initCb(std::move(initCb))
-    , m_dataCb(std::move(dataCb))
-    , m_wait(false)
-    , m_terminate(false)
-{
-    if (schemaString.empty())
-    {
-        m_schema = session->schema();
-    }
-    else
+    // The requested schema, or the native schema of our resource if none was
+    // requested.
+    entwine::Schema parseSchema(
+            const Session& session,
+            const std::string& schemaString)
     {
+        if (schemaString.empty()) return session.schema();
+
         Json::Reader reader;
         Json::Value jsonSchema;
         reader.parse("{\"schema\":" + schemaString + "}", jsonSchema);
@@ -61,218 +44,296 @@ ReadCommand::ReadCommand(
             throw std::runtime_error("Could not parse requested schema");
         }
 
-        m_schema = entwine::Schema(jsonSchema["schema"]);
+        return entwine::Schema(jsonSchema["schema"]);
     }
 
+    // Keeps a handed-off ItcBuffer alive until V8 is done with its storage.
+    struct HandOff
+    {
+        HandOff(
+                v8::Isolate* isolate,
+                ItcBufferPool& itcBufferPool,
+                std::shared_ptr<ItcBuffer> itcBuffer)
+            : isolate(isolate)
+            , itcBufferPool(itcBufferPool)
+            , itcBuffer(itcBuffer)
+            , size(itcBuffer->size())
+        { }
+
+        v8::Isolate* isolate;
+        ItcBufferPool& itcBufferPool;
+        std::shared_ptr<ItcBuffer> itcBuffer;
+        const std::size_t size;
+    };
+
+    // Handed-off buffers whose storage is still out of the pool, by the
+    // address of their data.  Only accessed from the event loop.
+    std::map<const char*, HandOff*> handOffs;
+
+    // Return a handed-off buffer's storage to the pool, once only, leaving
+    // the hand-off itself to be deleted when its Node buffer is collected.
+    void reclaim(HandOff* handOff)
+    {
+        handOffs.erase(handOff->itcBuffer->data());
+
+        handOff->isolate->AdjustAmountOfExternalAllocatedMemory(
+                -static_cast<int64_t>(handOff->size));
+
+        handOff->itcBufferPool.release(handOff->itcBuffer);
+        handOff->itcBuffer.reset();
+    }
+
+    // Called on the main thread when the external Node buffer is collected.
+    void freeHandOff(char* data, void* hint)
+    {
+        HandOff* handOff(static_cast<HandOff*>(hint));
+        if (handOff->itcBuffer) reclaim(handOff);
+        delete handOff;
+    }
+}
+
+ReadCommand::ReadCommand(
+        std::shared_ptr<Session> session,
+        ItcBufferPool& itcBufferPool,
+        ReadCache& readCache,
+        TaskPool& readPool,
+        ReadScheduler& readScheduler,
+        const QueryLimits& limits,
+        ReadDriver::Params params,
+        v8::UniquePersistent<v8::Function> initCb,
+        v8::UniquePersistent<v8::Function> dataCb)
+    : m_itcBufferPool(itcBufferPool)
+    , m_id(nextId++)
+    , m_async(new uv_async_t())
+    , m_initCb(std::move(initCb))
+    , m_dataCb(std::move(dataCb))
+    , m_driver(
+            std::make_shared<ReadDriver>(
+                session,
+                itcBufferPool,
+                readCache,
+                readPool,
+                readScheduler,
+                limits,
+                std::move(params),
+                *this))
+{
     // This allows us to unwrap our own ReadCommand during async CBs.
-    m_initAsync->data = this;
-    m_dataAsync->data = this;
+    m_async->data = this;
+
+    uv_async_init(
+        uv_default_loop(),
+        m_async,
+        ([](uv_async_t* async)->void
+        {
+            Isolate* isolate(Isolate::GetCurrent());
+            HandleScope scope(isolate);
+            ReadCommand* readCommand(static_cast<ReadCommand*>(async->data));
 
-    registerInitCb();
-    registerDataCb();
+            readCommand->m_driver->service();
+            readCommand->reap();
+        })
+    );
+
+    registry[m_id] = this;
 }
 
 ReadCommand::~ReadCommand()
 {
-    getBufferPool().release(getBuffer());
-
-    uv_handle_t* initAsync(reinterpret_cast<uv_handle_t*>(m_initAsync));
-    uv_handle_t* dataAsync(reinterpret_cast<uv_handle_t*>(m_dataAsync));
+    registry.erase(m_id);
 
-    uv_close_cb closeCallback(
+    uv_close(
+        reinterpret_cast<uv_handle_t*>(m_async),
         (uv_close_cb)([](uv_handle_t* async)->void
         {
             delete async;
         })
     );
 
-    uv_close(initAsync, closeCallback);
-    uv_close(dataAsync, closeCallback);
-
     m_initCb.Reset();
     m_dataCb.Reset();
 }
 
-void ReadCommand::registerInitCb()
+v8::MaybeLocal<v8::Object> ReadCommand::handOff(
+        v8::Isolate* isolate,
+        std::shared_ptr<ItcBuffer> itcBuffer)
 {
-    uv_async_init(
-        uv_default_loop(),
-        m_initAsync,
-        ([](uv_async_t* async)->void
-        {
-            Isolate* isolate(Isolate::GetCurrent());
-            HandleScope scope(isolate);
-            ReadCommand* readCommand(static_cast<ReadCommand*>(async->data));
+    if (!itcBuffer->size())
+    {
+        m_itcBufferPool.release(itcBuffer);
+        return node::Buffer::New(isolate, 0);
+    }
 
-            const unsigned argc = 1;
-            Local<Value> argv[argc] =
-            {
-                readCommand->status.ok() ?
-                    Local<Value>::New(isolate, Null(isolate)) : // err
-                    readCommand->status.toObject(isolate)
-            };
+    HandOff* hint(new HandOff(isolate, m_itcBufferPool, itcBuffer));
 
-            Local<Function> local(Local<Function>::New(
-                    isolate,
-                    readCommand->initCb()));
+    MaybeLocal<Object> buffer(
+            node::Buffer::New(
+                isolate,
+                itcBuffer->data(),
+                itcBuffer->size(),
+                freeHandOff,
+                hint));
 
-            local->Call(isolate->GetCurrentContext()->Global(), argc, argv);
-            readCommand->notifyCb();
-        })
-    );
+    if (buffer.IsEmpty())
+    {
+        delete hint;
+        buffer = node::Buffer::Copy(
+                isolate,
+                itcBuffer->data(),
+                itcBuffer->size());
+
+        m_itcBufferPool.release(itcBuffer);
+        return buffer;
+    }
+
+    handOffs[itcBuffer->data()] = hint;
+
+    // Let V8 know about the memory it now owns so that collection of spent
+    // buffers keeps pace with the data we're streaming.
+    isolate->AdjustAmountOfExternalAllocatedMemory(itcBuffer->size());
+
+    return buffer;
 }
 
-void ReadCommand::registerDataCb()
+bool ReadCommand::recycle(const char* data)
 {
-    uv_async_init(
-        uv_default_loop(),
-        m_dataAsync,
-        ([](uv_async_t* async)->void
-        {
-            Isolate* isolate(Isolate::GetCurrent());
-            HandleScope scope(isolate);
-            ReadCommand* readCommand(static_cast<ReadCommand*>(async->data));
+    auto it(handOffs.find(data));
+    if (it == handOffs.end()) return false;
 
-            if (readCommand->status.ok())
-            {
-                /*
-
-                Ideally we'd pass kgFunction as arg 4 of this callback,
-                allowing JS-land to asyncly call us as long as their keepGoing
-                logic is truthy.  For now we'll make JS return a value from
-                their onData function, since we can't capture state with this
-                method.
-
-                auto keepGoingCb([](const FunctionCallbackInfo<Value>& args)
-                {
-                    std::cout << "Got keep going signal!" << std::endl;
-                });
-
-                Local<FunctionTemplate> kgTemplate(
-                        FunctionTemplate::New(isolate, keepGoingCb));
-                Local<Function> kgFunction(kgTemplate->GetFunction());
-                */
-
-                MaybeLocal<Object> buffer(
-                        node::Buffer::Copy(
-                            isolate,
-                            readCommand->getBuffer()->data(),
-                            readCommand->getBuffer()->size()));
-
-                const unsigned argc = 3;
-                Local<Value>argv[argc] =
-                {
-                    Local<Value>::New(isolate, Null(isolate)),
-                    Local<Value>::New(isolate, buffer.ToLocalChecked()),
-                    Local<Value>::New(
-                            isolate,
-                            Number::New(isolate, readCommand->done()))
-                };
-
-                Local<Function> local(Local<Function>::New(
-                        isolate,
-                        readCommand->dataCb()));
-
-                Local<Value> keepGoing =
-                    local->Call(
-                            isolate->GetCurrentContext()->Global(),
-                            argc,
-                            argv);
-
-                readCommand->terminate(!keepGoing->BooleanValue());
-            }
-            else
-            {
-                const unsigned argc = 1;
-                Local<Value> argv[argc] =
-                    { readCommand->status.toObject(isolate) };
-
-                Local<Function> local(Local<Function>::New(
-                        isolate,
-                        readCommand->dataCb()));
-
-                local->Call(isolate->GetCurrentContext()->Global(), argc, argv);
-            }
-
-            readCommand->notifyCb();
-        })
-    );
+    reclaim(it->second);
+    return true;
 }
 
-ReadCommandUnindexed::ReadCommandUnindexed(
-        std::shared_ptr<Session> session,
-        ItcBufferPool& itcBufferPool,
-        bool compress,
-        const std::string schemaString,
-        v8::UniquePersistent<v8::Function> initCb,
-        v8::UniquePersistent<v8::Function> dataCb)
-    : ReadCommand(
-            session,
-            itcBufferPool,
-            compress,
-            0,
-            entwine::Point(),
-            schemaString,
-            std::move(initCb),
-            std::move(dataCb))
-{ }
+ReadCommand* ReadCommand::find(const std::uint64_t id)
+{
+    auto it(registry.find(id));
+    return it != registry.end() ? it->second : nullptr;
+}
 
-ReadCommandQuadIndex::ReadCommandQuadIndex(
-        std::shared_ptr<Session> session,
-        ItcBufferPool& itcBufferPool,
-        bool compress,
-        double scale,
-        const entwine::Point& offset,
-        const std::string schemaString,
-        std::unique_ptr<entwine::Bounds> bounds,
-        std::size_t depthBegin,
-        std::size_t depthEnd,
-        v8::UniquePersistent<v8::Function> initCb,
-        v8::UniquePersistent<v8::Function> dataCb)
-    : ReadCommand(
-            session,
-            itcBufferPool,
-            compress,
-            scale,
-            offset,
-            schemaString,
-            std::move(initCb),
-            std::move(dataCb))
-    , m_bounds(std::move(bounds))
-    , m_depthBegin(depthBegin)
-    , m_depthEnd(depthEnd)
-{ }
+std::size_t ReadCommand::count()
+{
+    return registry.size();
+}
+
+void ReadCommand::resume()
+{
+    m_driver->resume();
+    reap();
+}
+
+void ReadCommand::cancel()
+{
+    m_driver->cancel();
+    reap();
+}
 
-void ReadCommandUnindexed::query()
+void ReadCommand::reap()
 {
-    m_readQuery = m_session->query(m_schema, m_compress);
+    if (!m_driver->delivering() && m_driver->complete()) delete this;
 }
 
-void ReadCommandQuadIndex::query()
+void ReadCommand::wake()
 {
-    m_readQuery = m_session->query(
-            m_schema,
-            m_compress,
-            m_scale,
-            m_offset,
-            m_bounds.get(),
-            m_depthBegin,
-            m_depthEnd);
+    uv_async_send(m_async);
+}
+
+void ReadCommand::status(
+        const int code,
+        const std::string& message,
+        const std::size_t retryAfter)
+{
+    Isolate* isolate(Isolate::GetCurrent());
+
+    Status status(code, message);
+    status.setRetryAfter(retryAfter);
+
+    const unsigned argc = 1;
+    Local<Value> argv[argc] = { status.toObject(isolate) };
+
+    Local<Function> local(Local<Function>::New(isolate, m_initCb));
+    local->Call(isolate->GetCurrentContext()->Global(), argc, argv);
+}
+
+bool ReadCommand::data(std::shared_ptr<ItcBuffer> itcBuffer, const bool done)
+{
+    Isolate* isolate(Isolate::GetCurrent());
+
+    /*
+
+    Ideally we'd pass kgFunction as arg 4 of this callback, allowing
+    JS-land to asyncly call us as long as their keepGoing logic is truthy.
+    For now we'll make JS return a value from their onData function, since
+    we can't capture state with this method.
+
+    auto keepGoingCb([](const FunctionCallbackInfo<Value>& args)
+    {
+        std::cout << "Got keep going signal!" << std::endl;
+    });
+
+    Local<FunctionTemplate> kgTemplate(
+            FunctionTemplate::New(isolate, keepGoingCb));
+    Local<Function> kgFunction(kgTemplate->GetFunction());
+    */
+
+    // Our final chunk carries our timing along with it.
+    Local<Value> timingValue(Undefined(isolate));
+    if (done)
+    {
+        timingValue = String::NewFromUtf8(
+                isolate,
+                m_driver->timing(*itcBuffer).c_str());
+    }
+
+    MaybeLocal<Object> buffer(handOff(isolate, itcBuffer));
+
+    const unsigned argc = 4;
+    Local<Value>argv[argc] =
+    {
+        Local<Value>::New(isolate, Null(isolate)),
+        Local<Value>::New(isolate, buffer.ToLocalChecked()),
+        Local<Value>::New(isolate, Number::New(isolate, done)),
+        timingValue
+    };
+
+    Local<Function> local(Local<Function>::New(isolate, m_dataCb));
+
+    Local<Value> keepGoing =
+        local->Call(isolate->GetCurrentContext()->Global(), argc, argv);
+
+    return keepGoing->BooleanValue();
+}
+
+void ReadCommand::error(const int code, const std::string& message)
+{
+    Isolate* isolate(Isolate::GetCurrent());
+
+    Status status(code, message);
+
+    const unsigned argc = 1;
+    Local<Value> argv[argc] = { status.toObject(isolate) };
+
+    Local<Function> local(Local<Function>::New(isolate, m_dataCb));
+    local->Call(isolate->GetCurrentContext()->Global(), argc, argv);
 }
 
 ReadCommand* ReadCommand::create(
         Isolate* isolate,
         std::shared_ptr<Session> session,
         ItcBufferPool& itcBufferPool,
+        ReadCache& readCache,
+        TaskPool& readPool,
+        ReadScheduler& readScheduler,
+        const QueryLimits& limits,
         const std::string schemaString,
-        bool compress,
+        CompressionMode compress,
         double scale,
         const entwine::Point& offset,
         v8::Local<v8::Object> query,
         v8::UniquePersistent<v8::Function> initCb,
         v8::UniquePersistent<v8::Function> dataCb)
 {
-    ReadCommand* readCommand(nullptr);
+    ReadDriver::Params params;
+    bool valid(false);
 
     const auto depthSymbol(toSymbol(isolate, "depth"));
     const auto depthBeginSymbol(toSymbol(isolate, "depthBegin"));
@@ -305,44 +366,26 @@ ReadCommand* ReadCommand::create(
             query->Delete(depthSymbol);
         }
 
-        std::unique_ptr<entwine::Bounds> bounds;
-
         if (query->HasOwnProperty(boundsSymbol))
         {
-            bounds.reset(
+            params.bounds.reset(
                     new entwine::Bounds(parseBounds(query->Get(boundsSymbol))));
         }
 
         query->Delete(boundsSymbol);
 
-        if (isEmpty(query))
-        {
-            readCommand = new ReadCommandQuadIndex(
-                    session,
-                    itcBufferPool,
-                    compress,
-                    scale,
-                    offset,
-                    schemaString,
-                    std::move(bounds),
-                    depthBegin,
-                    depthEnd,
-                    std::move(initCb),
-                    std::move(dataCb));
-        }
+        params.indexed = true;
+        params.depthBegin = depthBegin;
+        params.depthEnd = depthEnd;
+
+        valid = isEmpty(query);
     }
-    else if (isEmpty(query))
+    else
     {
-        readCommand = new ReadCommandUnindexed(
-                session,
-                itcBufferPool,
-                compress,
-                schemaString,
-                std::move(initCb),
-                std::move(dataCb));
+        valid = isEmpty(query);
     }
 
-    if (!readCommand)
+    if (!valid)
     {
         std::cout << "Bad read command" << std::endl;
         Status status(400, std::string("Invalid read query parameters"));
@@ -351,8 +394,23 @@ ReadCommand* ReadCommand::create(
 
         Local<Function> local(Local<Function>::New(isolate, initCb));
         local->Call(isolate->GetCurrentContext()->Global(), argc, argv);
+
+        return nullptr;
     }
 
-    return readCommand;
-}
+    params.schema = parseSchema(*session, schemaString);
+    params.compress = compress;
+    params.scale = scale;
+    params.offset = offset;
 
+    return new ReadCommand(
+            session,
+            itcBufferPool,
+            readCache,
+            readPool,
+            readScheduler,
+            limits,
+            std::move(params),
+            std::move(initCb),
+            std::move(dataCb));
+}
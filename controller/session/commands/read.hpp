@@ -1,35 +1,39 @@
 #pragma once
 
+#include <cstdint>
 #include <memory>
-#include <vector>
-#include <mutex>
+#include <string>
 
 #include <node.h>
 #include <uv.h>
 #include <v8.h>
 
-#include <pdal/Dimension.hpp>
-#include <entwine/types/bounds.hpp>
-#include <entwine/types/schema.hpp>
+#include <entwine/types/point.hpp>
 
-#include "commands/background.hpp"
 #include "read-queries/base.hpp"
-#include "util/buffer-pool.hpp"
+#include "types/query-limits.hpp"
+#include "util/read-cache.hpp"
+#include "util/read-driver.hpp"
 
 class ItcBufferPool;
 class ItcBuffer;
+class ReadScheduler;
 class Session;
+class TaskPool;
 
-class ReadCommand : public Background
+// Streams a read to JS-land.  The read itself is driven by a ReadDriver,
+// whose chunks are handed off to JS-land from the event loop without copies.
+class ReadCommand : public ReadDriver::Sink
 {
 public:
     ReadCommand(
             std::shared_ptr<Session> session,
             ItcBufferPool& itcBufferPool,
-            bool compress,
-            double scale,
-            const entwine::Point& offset,
-            std::string schemaString,
+            ReadCache& readCache,
+            TaskPool& readPool,
+            ReadScheduler& readScheduler,
+            const QueryLimits& limits,
+            ReadDriver::Params params,
             v8::UniquePersistent<v8::Function> initCb,
             v8::UniquePersistent<v8::Function> dataCb);
     virtual ~ReadCommand();
@@ -38,110 +42,84 @@ public:
             v8::Isolate* isolate,
             std::shared_ptr<Session> session,
             ItcBufferPool& itcBufferPool,
+            ReadCache& readCache,
+            TaskPool& readPool,
+            ReadScheduler& readScheduler,
+            const QueryLimits& limits,
             std::string schemaString,
-            bool compress,
+            CompressionMode compress,
             double scale,
             const entwine::Point& offset,
             v8::Local<v8::Object> query,
             v8::UniquePersistent<v8::Function> initCb,
             v8::UniquePersistent<v8::Function> dataCb);
 
-    void registerInitCb();
-    void registerDataCb();
-
-    void read() { m_readQuery->read(*m_itcBuffer); }
-    void run() { query(); }
+    // Begin running this command on the read pool.  The command advances in
+    // short steps, none of which wait on JS-land: while the maximum number
+    // of buffers are in flight, it is parked without holding a thread, and
+    // is resumed by the event loop as buffers are consumed.  Once complete,
+    // the command is deleted by the event loop.
+    void start() { m_driver->start(); }
 
-    std::shared_ptr<ItcBuffer> getBuffer() { return m_itcBuffer; }
-    ItcBufferPool& getBufferPool() { return m_itcBufferPool; }
+    // The remainder of our public interface is only for use from the event
+    // loop.
 
-    bool done() const { return terminate() || m_readQuery->done(); }
-    bool terminate() const { return m_terminate; }
-    void terminate(bool val) { m_terminate = val; }
+    std::uint64_t id() const { return m_id; }
 
-    void acquire() { m_itcBuffer = m_itcBufferPool.acquire(); }
-    v8::UniquePersistent<v8::Function>& initCb() { return m_initCb; }
-    v8::UniquePersistent<v8::Function>& dataCb() { return m_dataCb; }
+    // Find a live command by ID, or null if it has completed.
+    static ReadCommand* find(std::uint64_t id);
 
-    uv_async_t* initAsync() { return m_initAsync; }
-    uv_async_t* dataAsync() { return m_dataAsync; }
+    // Number of live commands.
+    static std::size_t count();
 
-    void doCb(uv_async_t* async)
-    {
-        m_wait = true;
-        uv_async_send(async);
-        std::unique_lock<std::mutex> lock(m_mutex);
-        m_cv.wait(lock, [this]()->bool { return !m_wait; });
-    }
+    // Flow control from JS-land.  While paused, produced buffers are held
+    // rather than delivered, and once the pipeline is full, reading is
+    // parked until we are resumed.  Resuming or cancelling may complete, and
+    // therefore delete, this command.
+    void pause() { m_driver->pause(); }
+    void resume();
+    void cancel();
 
-    void notifyCb() {
-        std::unique_lock<std::mutex> lock(m_mutex);
-        m_wait = false;
-        lock.unlock();
-        m_cv.notify_all();
-    }
+    // Return the storage of a handed-off buffer, given its data, to the pool
+    // once JS-land has finished writing it.  The Node buffer must not be used
+    // afterward.  Returns false if the data isn't that of a handed-off buffer
+    // still out of the pool.
+    static bool recycle(const char* data);
 
-protected:
-    virtual void query() = 0;
-
-    std::shared_ptr<Session> m_session;
+private:
+    // Called from any thread by our driver.
+    virtual void wake();
+
+    // Called from the event loop by our driver.
+    virtual void status(
+            int code,
+            const std::string& message,
+            std::size_t retryAfter);
+    virtual bool data(std::shared_ptr<ItcBuffer> buffer, bool done);
+    virtual void error(int code, const std::string& message);
+
+    // Delete this command once its driver is complete.  If JS-land calls
+    // back into us during a delivery, the outer delivery sees to this.
+    void reap();
+
+    // Wrap a buffer as a Node buffer without copying.  Ownership of the
+    // ItcBuffer moves to V8 - it is returned to the pool by recycle(), or
+    // failing that when the Node buffer is garbage collected.
+    v8::MaybeLocal<v8::Object> handOff(
+            v8::Isolate* isolate,
+            std::shared_ptr<ItcBuffer> itcBuffer);
 
     ItcBufferPool& m_itcBufferPool;
-    std::shared_ptr<ItcBuffer> m_itcBuffer;
-    const bool m_compress;
-    const double m_scale;
-    const entwine::Point m_offset;
-    entwine::Schema m_schema;
-    std::size_t m_numSent;
-    std::shared_ptr<ReadQuery> m_readQuery;
-
-    uv_async_t* m_initAsync;
-    uv_async_t* m_dataAsync;
+    const std::uint64_t m_id;
+
+    uv_async_t* m_async;
     v8::UniquePersistent<v8::Function> m_initCb;
     v8::UniquePersistent<v8::Function> m_dataCb;
 
-    std::mutex m_mutex;
-    std::condition_variable m_cv;
-    bool m_wait;
-    bool m_terminate;
-};
-
-class ReadCommandUnindexed : public ReadCommand
-{
-public:
-    ReadCommandUnindexed(
-            std::shared_ptr<Session> session,
-            ItcBufferPool& itcBufferPool,
-            bool compress,
-            std::string schemaString,
-            v8::UniquePersistent<v8::Function> initCb,
-            v8::UniquePersistent<v8::Function> dataCb);
-
-private:
-    virtual void query();
-};
-
-class ReadCommandQuadIndex : public ReadCommand
-{
-public:
-    ReadCommandQuadIndex(
-            std::shared_ptr<Session> session,
-            ItcBufferPool& itcBufferPool,
-            bool compress,
-            double scale,
-            const entwine::Point& offset,
-            std::string schemaString,
-            std::unique_ptr<entwine::Bounds> bounds,
-            std::size_t depthBegin,
-            std::size_t depthEnd,
-            v8::UniquePersistent<v8::Function> initCb,
-            v8::UniquePersistent<v8::Function> dataCb);
-
-protected:
-    virtual void query();
+    // Declared last, since it refers to us as its sink.
+    std::shared_ptr<ReadDriver> m_driver;
 
-    const std::unique_ptr<entwine::Bounds> m_bounds;
-    const std::size_t m_depthBegin;
-    const std::size_t m_depthEnd;
+    // Disallow copy/assignment.
+    ReadCommand(const ReadCommand&);
+    ReadCommand& operator=(const ReadCommand&);
 };
-
@@ -1,13 +1,17 @@
 #pragma once
 
+#include <cstddef>
 #include <string>
 #include <node.h>
 
 class Status
 {
 public:
-    Status() : m_code(200), m_message() { }
-    Status(int code, std::string message) : m_code(code), m_message(message)
+    Status() : m_code(200), m_message(), m_retryAfter(0) { }
+    Status(int code, std::string message)
+        : m_code(code)
+        , m_message(message)
+        , m_retryAfter(0)
     { }
 
     void set(int code, const std::string& message)
@@ -16,6 +20,9 @@ public:
         m_message = message;
     }
 
+    // Seconds after which a failed request may be retried, if known.
+    void setRetryAfter(std::size_t seconds) { m_retryAfter = seconds; }
+
     int code() const { return m_code; }
 
     bool ok() const { return m_code == 200; }
@@ -37,6 +44,13 @@ public:
                     v8::String::NewFromUtf8(isolate, "message"),
                     v8::String::NewFromUtf8(isolate, m_message.c_str()));
 
+            if (m_retryAfter)
+            {
+                obj->Set(
+                        v8::String::NewFromUtf8(isolate, "retryAfter"),
+                        v8::Integer::New(isolate, m_retryAfter));
+            }
+
             return obj;
         }
     }
@@ -44,5 +58,6 @@ public:
 private:
     int m_code;
     std::string m_message;
+    std::size_t m_retryAfter;
 };
 
@@ -1,16 +1,66 @@
 #include "read-queries/base.hpp"
 
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <limits>
+#include <mutex>
+
 #include <entwine/types/schema.hpp>
 
 #include "util/buffer-pool.hpp"
+#include "util/task-pool.hpp"
+
+namespace
+{
+    // Small enough that a typical chunk is split across several blocks, but
+    // large enough to keep per-block compressor setup and framing cheap.
+    const std::size_t blockPoints(16384);
+
+    typedef std::unique_ptr<std::vector<char>> Block;
+
+    typedef std::chrono::steady_clock Clock;
+
+    std::uint64_t microsSince(const Clock::time_point start)
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+                Clock::now() - start).count();
+    }
+
+    Block compressBlock(
+            const char* data,
+            const std::size_t size,
+            const std::vector<pdal::DimType>& dimTypes)
+    {
+        entwine::CompressionStream stream;
+        pdal::LazPerfCompressor<entwine::CompressionStream> compressor(
+                stream,
+                dimTypes);
+
+        compressor.compress(data, size);
+        compressor.done();
+
+        return stream.data();
+    }
+
+    void pushU32(std::vector<char>& out, const uint32_t value)
+    {
+        const char* pos(reinterpret_cast<const char*>(&value));
+        out.insert(out.end(), pos, pos + sizeof(uint32_t));
+    }
+}
 
 ReadQuery::ReadQuery(
         const entwine::Schema& schema,
-        const bool compress,
+        const CompressionMode compress,
+        TaskPool& compressionPool,
         const std::size_t index)
-    : m_compressionStream(0)
+    : m_compression(compress)
+    , m_compressionPool(compressionPool)
+    , m_compressionStream(0)
     , m_compressor(
-            compress ?
+            compress == CompressionMode::Stream ?
                 new pdal::LazPerfCompressor<entwine::CompressionStream>(
                     m_compressionStream,
                     schema.pdalLayout().dimTypes()) :
@@ -18,38 +68,200 @@ ReadQuery::ReadQuery(
     , m_compressionOffset(0)
     , m_schema(schema)
     , m_done(false)
+    , m_batchTarget(0)
+    , m_batchMax(0)
+    , m_pending()
+    , m_pendingPos(0)
+    , m_batch()
+    , m_sourceDone(false)
+    , m_timing()
 { }
 
+void ReadQuery::batch(const std::size_t targetBytes, const std::size_t maxBytes)
+{
+    m_batchTarget = targetBytes;
+    m_batchMax = maxBytes;
+}
+
 void ReadQuery::read(ItcBuffer& buffer)
 {
     if (m_done) throw std::runtime_error("Tried to call read() after done");
 
     buffer.resize(0);
-    m_done = readSome(buffer);
 
-    std::cout << "Read " << buffer.size() << " bytes.  Done? " << m_done <<
-        std::endl;
+    const Clock::time_point start(Clock::now());
+    m_done = m_batchTarget || m_batchMax ? readBatch(buffer) : readSome(buffer);
+    m_timing.readMicros += microsSince(start);
 
-    if (compress())
+    const Clock::time_point compressStart(Clock::now());
+
+    if (m_compression == CompressionMode::Stream)
     {
         m_compressor->compress(buffer.data(), buffer.size());
         if (m_done) m_compressor->done();
         compressionSwap(buffer);
     }
+    else if (m_compression == CompressionMode::Blocks)
+    {
+        compressBlocks(buffer);
+    }
+
+    if (compress()) m_timing.compressMicros += microsSince(compressStart);
 
     if (m_done)
     {
-        std::cout << "Done.  NP: " << numPoints() << std::endl;
         const uint32_t points(numPoints());
         const char* pos(reinterpret_cast<const char*>(&points));
         buffer.push(pos, sizeof(uint32_t));
     }
 }
 
+bool ReadQuery::readBatch(ItcBuffer& buffer)
+{
+    const std::size_t pointSize(m_schema.pointSize());
+
+    // Round to whole points, producing at least one point per read.
+    const std::size_t target(m_batchTarget / pointSize * pointSize);
+    const std::size_t max(
+            m_batchMax ?
+                std::max<std::size_t>(m_batchMax / pointSize, 1) * pointSize :
+                std::numeric_limits<std::size_t>::max());
+
+    std::vector<char>& out(buffer.vecRef());
+
+    while (true)
+    {
+        const std::size_t available(m_pending.size() - m_pendingPos);
+
+        if (available)
+        {
+            const std::size_t size(std::min(available, max - out.size()));
+
+            if (out.empty() && !m_pendingPos && size == available)
+            {
+                // The common case where a chunk fits entirely - no copy.
+                out.swap(m_pending);
+                m_pending.clear();
+            }
+            else
+            {
+                const char* pos(m_pending.data() + m_pendingPos);
+                out.insert(out.end(), pos, pos + size);
+                m_pendingPos += size;
+            }
+
+            if (m_pendingPos == m_pending.size())
+            {
+                m_pending.clear();
+                m_pendingPos = 0;
+            }
+        }
+
+        if (
+                m_sourceDone ||
+                out.size() >= max ||
+                (out.size() && out.size() >= target))
+        {
+            break;
+        }
+
+        // Our subclass fills the buffer itself, so read into it with our
+        // batch so far swapped out of the way.
+        m_batch.swap(out);
+        out.clear();
+        m_sourceDone = readSome(buffer);
+        m_pending.swap(out);
+        m_pendingPos = 0;
+        out.swap(m_batch);
+        m_batch.clear();
+    }
+
+    return m_sourceDone && m_pending.empty();
+}
+
 void ReadQuery::compressionSwap(ItcBuffer& buffer)
 {
     std::unique_ptr<std::vector<char>> compressed(m_compressionStream.data());
-    buffer.resize(0);
-    buffer.push(compressed->data(), compressed->size());
+    buffer.vecRef().swap(*compressed);
 }
 
+void ReadQuery::compressBlocks(ItcBuffer& buffer)
+{
+    const std::size_t pointSize(m_schema.pointSize());
+    const std::size_t numPoints(buffer.size() / pointSize);
+    const std::size_t numBlocks((numPoints + blockPoints - 1) / blockPoints);
+    const std::vector<pdal::DimType> dimTypes(m_schema.pdalLayout().dimTypes());
+
+    std::vector<Block> blocks(numBlocks);
+    std::vector<std::exception_ptr> errors(numBlocks);
+
+    const char* data(buffer.data());
+
+    auto compress([&](const std::size_t i)->void
+    {
+        const std::size_t begin(i * blockPoints);
+        const std::size_t count(std::min(blockPoints, numPoints - begin));
+
+        try
+        {
+            blocks[i] = compressBlock(
+                    data + begin * pointSize,
+                    count * pointSize,
+                    dimTypes);
+        }
+        catch (...)
+        {
+            errors[i] = std::current_exception();
+        }
+    });
+
+    // Farm out all but the first block, which we'll compress ourselves while
+    // we wait.
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::size_t outstanding(numBlocks ? numBlocks - 1 : 0);
+
+    for (std::size_t i(1); i < numBlocks; ++i)
+    {
+        m_compressionPool.add([&, i]()->void
+        {
+            compress(i);
+
+            // Notify while locked, since our waiter's stack frame may go
+            // away as soon as it sees the final decrement.
+            std::lock_guard<std::mutex> lock(mutex);
+            --outstanding;
+            cv.notify_all();
+        });
+    }
+
+    if (numBlocks) compress(0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait(lock, [&outstanding]()->bool { return !outstanding; });
+    lock.unlock();
+
+    for (const auto& error : errors)
+    {
+        if (error) std::rethrow_exception(error);
+    }
+
+    std::size_t total(0);
+    for (const auto& block : blocks)
+    {
+        total += 2 * sizeof(uint32_t) + block->size();
+    }
+
+    std::vector<char> framed;
+    framed.reserve(total + sizeof(uint32_t));
+
+    for (std::size_t i(0); i < numBlocks; ++i)
+    {
+        const std::size_t begin(i * blockPoints);
+        pushU32(framed, std::min(blockPoints, numPoints - begin));
+        pushU32(framed, blocks[i]->size());
+        framed.insert(framed.end(), blocks[i]->begin(), blocks[i]->end());
+    }
+
+    buffer.vecRef().swap(framed);
+}
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <cstdint>
 #include <memory>
+#include <vector>
 
 #include <pdal/Dimension.hpp>
 #include <pdal/Compression.hpp>
@@ -14,26 +16,86 @@ namespace entwine
 }
 
 class ItcBuffer;
+class TaskPool;
+
+enum class CompressionMode
+{
+    // Raw points in the requested schema.
+    None,
+
+    // A single laz-perf stream spanning the entire response.
+    Stream,
+
+    // Independently compressed laz-perf blocks, each preceded by its point
+    // count and its compressed size as 32-bit unsigned integers.  Blocks are
+    // compressed in parallel.
+    Blocks
+};
 
 class ReadQuery
 {
 public:
+    // Time spent producing our output so far, in microseconds.
+    struct Timing
+    {
+        Timing()
+            : readMicros(0)
+            , compressMicros(0)
+            , chunkMicros(0)
+            , transcodeMicros(0)
+        { }
+
+        // Waiting on points from our subclass in read().  With prefetching,
+        // this is only the part of fetching and transcoding that wasn't
+        // hidden behind our consumer.
+        std::uint64_t readMicros;
+        std::uint64_t compressMicros;
+
+        // Reading chunks from an index, and converting them to the requested
+        // schema, whether or not our consumer waited for them.
+        std::uint64_t chunkMicros;
+        std::uint64_t transcodeMicros;
+    };
+
     ReadQuery(
             const entwine::Schema& schema,
-            bool compress,
+            CompressionMode compress,
+            TaskPool& compressionPool,
             std::size_t index = 0);
     virtual ~ReadQuery() { if (m_compressor) m_compressor->done(); }
 
     void read(ItcBuffer& buffer);
-    bool compress() const { return m_compressor.get() != 0; }
+
+    // Coalesce the output of readSome() so that each read produces about
+    // targetBytes of uncompressed points, and split it so that none produces
+    // more than maxBytes.  Buffers are only split at point boundaries.  If
+    // both are zero, which is the default, each read produces the output of
+    // a single readSome().
+    void batch(std::size_t targetBytes, std::size_t maxBytes);
+
+    bool compress() const { return m_compression != CompressionMode::None; }
     bool done() const { return m_done; }
     virtual uint64_t numPoints() const = 0;
 
+    // Only valid between calls to read().
+    virtual Timing timing() const { return m_timing; }
+
+    // Called from any thread when the consumer of this query has gone away,
+    // so any work being done ahead of the consumer may be abandoned.
+    virtual void cancel() { }
+
 protected:
     // Must return true if done, else false.
     virtual bool readSome(ItcBuffer& buffer) = 0;
 
+    // Fill the buffer according to our batch sizes.  Returns true if done.
+    bool readBatch(ItcBuffer& buffer);
+
     void compressionSwap(ItcBuffer& buffer);
+    void compressBlocks(ItcBuffer& buffer);
+
+    const CompressionMode m_compression;
+    TaskPool& m_compressionPool;
 
     entwine::CompressionStream m_compressionStream;
     std::unique_ptr<pdal::LazPerfCompressor<
@@ -42,5 +104,17 @@ protected:
 
     const entwine::Schema& m_schema;
     bool m_done;
+
+    std::size_t m_batchTarget;
+    std::size_t m_batchMax;
+
+    // Output of readSome() not yet consumed by readBatch(), beginning at
+    // m_pendingPos.
+    std::vector<char> m_pending;
+    std::size_t m_pendingPos;
+    std::vector<char> m_batch;
+    bool m_sourceDone;
+
+    Timing m_timing;
 };
 
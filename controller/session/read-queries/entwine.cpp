@@ -1,30 +1,134 @@
 #include "read-queries/entwine.hpp"
 
+#include <chrono>
+
 #include <entwine/reader/query.hpp>
 #include <entwine/tree/clipper.hpp>
 #include <entwine/types/schema.hpp>
 
 #include "util/buffer-pool.hpp"
+#include "util/histogram.hpp"
+#include "util/prefetcher.hpp"
+#include "util/transcoder.hpp"
 
 EntwineReadQuery::EntwineReadQuery(
         const entwine::Schema& schema,
-        bool compress,
-        std::unique_ptr<entwine::Query> query)
-    : ReadQuery(schema, compress)
-    , m_query(std::move(query))
-{ }
+        CompressionMode compress,
+        std::vector<std::unique_ptr<entwine::Query>> queries,
+        std::unique_ptr<Transcoder> transcoder,
+        TaskPool& compressionPool,
+        TaskPool& prefetchPool,
+        const std::size_t prefetch)
+    : ReadQuery(schema, compress, compressionPool)
+    , m_slices()
+    , m_transcoder(std::move(transcoder))
+    , m_current(0)
+    , m_chunkMicros(0)
+    , m_transcodeMicros(0)
+    , m_prefetcher()
+{
+    // Fetches refer to their slices, so these must never move.
+    m_slices.reserve(queries.size());
+    for (auto& query : queries) m_slices.emplace_back(std::move(query));
+
+    if (prefetch)
+    {
+        // A slice may select nothing at all.
+        std::vector<bool> done;
+        for (const Slice& slice : m_slices) done.push_back(slice.query->done());
+
+        m_prefetcher.reset(
+                new Prefetcher(
+                    prefetchPool,
+                    done,
+                    prefetch,
+                    [this](std::size_t i, std::vector<char>& data)->bool
+                    {
+                        next(m_slices[i], data);
+                        return m_slices[i].query->done();
+                    }));
+    }
+}
 
 EntwineReadQuery::~EntwineReadQuery()
 { }
 
+void EntwineReadQuery::cancel()
+{
+    if (m_prefetcher) m_prefetcher->cancel();
+}
+
+ReadQuery::Timing EntwineReadQuery::timing() const
+{
+    Timing timing(m_timing);
+    timing.chunkMicros = m_chunkMicros.load(std::memory_order_relaxed);
+    timing.transcodeMicros = m_transcodeMicros.load(std::memory_order_relaxed);
+    return timing;
+}
+
 bool EntwineReadQuery::readSome(ItcBuffer& buffer)
 {
-    m_query->next(buffer.vecRef());
-    return m_query->done();
+    if (m_prefetcher) return m_prefetcher->next(buffer.vecRef());
+
+    while (
+            m_current < m_slices.size() &&
+            m_slices[m_current].query->done())
+    {
+        ++m_current;
+    }
+
+    if (m_current < m_slices.size())
+    {
+        next(m_slices[m_current], buffer.vecRef());
+        if (m_slices[m_current].query->done()) ++m_current;
+    }
+
+    return m_current == m_slices.size();
 }
 
 std::uint64_t EntwineReadQuery::numPoints() const
 {
-    return m_query->numPoints();
+    std::uint64_t points(0);
+    for (const Slice& slice : m_slices) points += slice.query->numPoints();
+    return points;
+}
+
+Histogram& EntwineReadQuery::readTimes()
+{
+    static Histogram histogram;
+    return histogram;
 }
 
+void EntwineReadQuery::next(Slice& slice, std::vector<char>& data)
+{
+    typedef std::chrono::steady_clock Clock;
+
+    const Clock::time_point start(Clock::now());
+
+    if (m_transcoder)
+    {
+        slice.raw.clear();
+        slice.query->next(slice.raw);
+    }
+    else
+    {
+        slice.query->next(data);
+    }
+
+    const Clock::time_point read(Clock::now());
+
+    if (m_transcoder) m_transcoder->transcode(slice.raw, data);
+
+    const Clock::time_point end(Clock::now());
+
+    readTimes().record(read - start);
+
+    m_chunkMicros.fetch_add(
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                read - start).count(),
+            std::memory_order_relaxed);
+    m_transcodeMicros.fetch_add(
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                end - read).count(),
+            std::memory_order_relaxed);
+}
@@ -1,5 +1,10 @@
 #pragma once
 
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
 #include <entwine/reader/reader.hpp>
 
 #include "read-queries/base.hpp"
@@ -10,20 +15,73 @@ namespace entwine
     class Schema;
 }
 
+class Histogram;
+class Prefetcher;
+class TaskPool;
+class Transcoder;
+
 class EntwineReadQuery : public ReadQuery
 {
 public:
+    // Our read is made up of one or more queries over consecutive slices of
+    // its depth range, whose points are produced in the order given.
+    //
+    // If prefetch is non-zero, up to that many chunks are fetched ahead of
+    // the consumer on the given pool, with the queries of separate slices
+    // fetched concurrently.  Otherwise, each chunk is fetched synchronously
+    // by readSome().
+    //
+    // If a transcoder is given, the queries produce points in its input
+    // layout, which are converted to the requested schema as they are
+    // fetched.
     EntwineReadQuery(
             const entwine::Schema& schema,
-            bool compress,
-            std::unique_ptr<entwine::Query> query);
+            CompressionMode compress,
+            std::vector<std::unique_ptr<entwine::Query>> queries,
+            std::unique_ptr<Transcoder> transcoder,
+            TaskPool& compressionPool,
+            TaskPool& prefetchPool,
+            std::size_t prefetch);
 
     ~EntwineReadQuery();
 
+    virtual void cancel() override;
+    virtual Timing timing() const override;
+
+    // Time taken to read each chunk from the index, whether or not it had to
+    // be fetched, across all queries.
+    static Histogram& readTimes();
+
 private:
+    struct Slice
+    {
+        explicit Slice(std::unique_ptr<entwine::Query> query)
+            : query(std::move(query))
+            , raw()
+        { }
+
+        std::unique_ptr<entwine::Query> query;
+
+        // Untranscoded points.  Only one fetch per slice runs at a time.
+        std::vector<char> raw;
+    };
+
     virtual bool readSome(ItcBuffer& buffer) override;
     virtual uint64_t numPoints() const override;
 
-    std::unique_ptr<entwine::Query> m_query;
-};
+    // Read the next chunk of a slice in the requested schema.
+    void next(Slice& slice, std::vector<char>& data);
+
+    std::vector<Slice> m_slices;
+    std::unique_ptr<Transcoder> m_transcoder;
 
+    // Index of the slice being read when not prefetching.
+    std::size_t m_current;
+
+    // Fetches may run concurrently with calls to timing().
+    std::atomic<std::uint64_t> m_chunkMicros;
+    std::atomic<std::uint64_t> m_transcodeMicros;
+
+    // Fetches refer to everything above, so this must be destroyed first.
+    std::unique_ptr<Prefetcher> m_prefetcher;
+};
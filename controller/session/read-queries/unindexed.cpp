@@ -1,114 +1,124 @@
-/*
 #include "read-queries/unindexed.hpp"
 
+#include <pdal/PointView.hpp>
 #include <pdal/Reader.hpp>
-#include <pdal/StageFactory.hpp>
 
-#include <entwine/types/linking-point-view.hpp>
 #include <entwine/types/schema.hpp>
 #include <entwine/types/simple-point-table.hpp>
-#include <entwine/types/single-point-table.hpp>
 
 #include "types/source-manager.hpp"
+#include "util/buffer-pool.hpp"
 
 namespace
 {
-    const std::size_t chunkSize(65536);
-    pdal::StageFactory stageFactory;
+    // Matches the block size of blocks-compressed output, so that each of
+    // our blocks is compressed as one.
+    const std::size_t blockPoints(16384);
+
+    // Blocks read ahead of our consumer.  Along with the block being filled
+    // in our table, this bounds the memory held by each query.
+    const std::size_t ringSlots(4);
+
+    // Thrown through our reader to stop it once our consumer is gone.
+    struct Cancelled { };
 }
 
 UnindexedReadQuery::UnindexedReadQuery(
         const entwine::Schema& schema,
-        bool compress,
+        const CompressionMode compress,
+        TaskPool& compressionPool,
         SourceManager& sourceManager)
-    : ReadQuery(schema, compress, false)
+    : ReadQuery(schema, compress, compressionPool)
     , m_reader(sourceManager.createReader())
-    , m_numPoints(sourceManager.numPoints())
-    , m_hasChunk(false)
-    , m_producerIndex(0)
-    , m_consumerIndex(0)
     , m_table(new entwine::SimplePointTable(schema))
-    , m_schema(schema)
-    , m_mutex()
+    , m_tablePoints(0)
+    , m_block()
+    , m_ring(ringSlots)
+    , m_error()
+    , m_numPoints(0)
     , m_executor()
 {
-    m_reader->setReadCb([this](pdal::PointView& view, pdal::PointId id)
+    m_reader->setReadCb([this](pdal::PointView&, pdal::PointId)->void
     {
-        addPoint(view, id);
+        addPoint();
     });
 
     m_reader->prepare(*m_table);
 
-    m_executor = std::thread([this]()
-    {
-        m_reader->execute(*m_table);
-    });
+    m_executor = std::thread([this]()->void { produce(); });
 }
 
 UnindexedReadQuery::~UnindexedReadQuery()
 {
+    // Our consumer may not have drained the ring, so unblock our producer
+    // before waiting for it.
+    m_ring.cancel();
     m_executor.join();
 }
 
-void UnindexedReadQuery::readPoint(char* pos, const entwine::Schema&)
+void UnindexedReadQuery::cancel()
+{
+    m_ring.cancel();
+}
+
+bool UnindexedReadQuery::readSome(ItcBuffer& buffer)
 {
-    if (!m_hasChunk)
+    std::vector<char>& data(buffer.vecRef());
+
+    if (!m_ring.pop(data))
     {
-        // Wait for data to be produced.
-        std::unique_lock<std::mutex> lock(m_mutex);
-        m_cv.wait(lock, [this]()->bool { return m_hasChunk; });
+        if (m_ring.exhausted() && m_error) std::rethrow_exception(m_error);
+        return true;
     }
 
-    const std::size_t pointSize(m_schema.pointSize());
-    std::memcpy(
-            pos,
-            m_table->data().data() + m_consumerIndex * pointSize,
-            pointSize);
+    m_numPoints += data.size() / m_schema.pointSize();
 
-    // The point table might contain more than one point for dimension-oriented
-    // readers.  Don't clear and notify the producer until all are consumed.
-    if (++m_consumerIndex == m_table->size())
-    {
-        m_table->clear();
-        m_hasChunk = false;
-        m_consumerIndex = 0;
+    // If our producer failed, let our next read report it.
+    return m_ring.exhausted() && !m_error;
+}
 
-        m_cv.notify_one();
-    }
+uint64_t UnindexedReadQuery::numPoints() const
+{
+    return m_numPoints;
 }
 
-void UnindexedReadQuery::addPoint(pdal::PointView& view, pdal::PointId id)
+void UnindexedReadQuery::produce()
 {
-    if (id % 1000000 == 0)
-        std::cout << id << "/" << m_numPoints << std::endl;
-
-    // Wait until all in-progress points are written to the table.
-    if (
-            id + 1 == m_numPoints ||
-            (id + 1 - m_producerIndex == m_table->size() &&
-                    m_table->data().size() >= chunkSize))
+    try
     {
-        m_hasChunk = true;
-        m_producerIndex += m_table->size();
-
-        // Notify the consumer that there is data ready.
-        m_cv.notify_one();
-
-        // Block production by the executor thread until all current data is
-        // consumed.
-        std::unique_lock<std::mutex> lock(m_mutex);
-        m_cv.wait(lock, [this]()->bool { return !m_hasChunk; });
+        m_reader->execute(*m_table);
+        if (m_table->size()) flush();
+    }
+    catch (const Cancelled&)
+    {
+        // Our consumer has gone away.
+    }
+    catch (...)
+    {
+        m_error = std::current_exception();
     }
+
+    m_ring.finish();
 }
 
-bool UnindexedReadQuery::eof() const
+void UnindexedReadQuery::addPoint()
 {
-    return index() == m_numPoints;
+    // A dimension-oriented reader may have added more points to our table
+    // than it has completed, so wait until all of them are complete.
+    if (++m_tablePoints >= blockPoints && m_tablePoints == m_table->size())
+    {
+        flush();
+    }
 }
 
-std::size_t UnindexedReadQuery::numPoints() const
+void UnindexedReadQuery::flush()
 {
-    return m_numPoints;
+    const char* data(m_table->data().data());
+    m_block.assign(data, data + m_table->size() * m_schema.pointSize());
+
+    m_table->clear();
+    m_tablePoints = 0;
+
+    if (!m_ring.push(m_block)) throw Cancelled();
 }
-*/
 
@@ -1,18 +1,17 @@
 #pragma once
 
-#include <condition_variable>
-#include <mutex>
+#include <cstdint>
+#include <exception>
+#include <memory>
 #include <thread>
-
-#include <pdal/pdal_types.hpp>
+#include <vector>
 
 #include "read-queries/base.hpp"
+#include "util/block-ring.hpp"
 
 namespace pdal
 {
-    class PointView;
     class Reader;
-    class StageFactory;
 }
 
 namespace entwine
@@ -21,33 +20,49 @@ namespace entwine
 }
 
 class SourceManager;
+class TaskPool;
 
 class UnindexedReadQuery : public ReadQuery
 {
 public:
+    // The source is read on a thread of our own, which fills fixed-size
+    // blocks of points into a bounded ring ahead of our consumer.  It waits
+    // only when the ring is full.
     UnindexedReadQuery(
             const entwine::Schema& schema,
-            bool compress,
+            CompressionMode compress,
+            TaskPool& compressionPool,
             SourceManager& sourceManager);
+
     ~UnindexedReadQuery();
 
+    virtual void cancel() override;
+
 private:
     virtual bool readSome(ItcBuffer& buffer) override;
     virtual uint64_t numPoints() const override;
 
+    // From our reader's thread.
+    void produce();
+    void addPoint();
+    void flush();
+
     std::unique_ptr<pdal::Reader> m_reader;
-    std::size_t m_numPoints;
+    std::unique_ptr<entwine::SimplePointTable> m_table;
 
-    bool m_hasChunk;
-    std::size_t m_producerIndex;
-    std::size_t m_consumerIndex;
+    // Points completed by our reader since our table was last flushed, and
+    // the block into which they are flushed.
+    std::size_t m_tablePoints;
+    std::vector<char> m_block;
 
-    std::unique_ptr<entwine::SimplePointTable> m_table;
-    const entwine::Schema& m_schema;
+    BlockRing m_ring;
+
+    // Set by our producer before it finishes.
+    std::exception_ptr m_error;
+
+    // Points handed to our consumer.
+    std::uint64_t m_numPoints;
 
-    std::mutex m_mutex;
-    std::condition_variable m_cv;
-    bool m_first;
     std::thread m_executor;
 };
 
@@ -1,5 +1,9 @@
+#include <algorithm>
 #include <fstream>
 #include <iostream>
+#include <mutex>
+#include <sstream>
+#include <utility>
 
 #include <glob.h>
 
@@ -19,17 +23,54 @@
 
 #include "read-queries/entwine.hpp"
 #include "read-queries/unindexed.hpp"
+#include "types/query-limits.hpp"
+#include "util/binary-hierarchy.hpp"
 #include "util/buffer-pool.hpp"
+#include "util/path-search.hpp"
+#include "util/task-pool.hpp"
+#include "util/transcoder.hpp"
 
 #include "session.hpp"
 
 namespace
 {
-    /*
+    // Names come from our clients and are appended to our paths, so they
+    // mustn't be able to climb out of them.  Nested names are fine.
+    bool contained(const std::string& name)
+    {
+        if (name.empty() || name.front() == '/') return false;
+
+        std::size_t begin(0);
+
+        while (begin <= name.size())
+        {
+            std::size_t end(name.find('/', begin));
+            if (end == std::string::npos) end = name.size();
+
+            if (name.compare(begin, end - begin, "..") == 0) return false;
+
+            begin = end + 1;
+        }
+
+        return true;
+    }
+
     std::vector<std::string> resolve(
             const std::vector<std::string>& dirs,
             const std::string& name)
     {
+        std::vector<std::string> results;
+
+        // Names come from our clients, so don't let them glob for files or
+        // escape our paths.
+        if (
+                dirs.empty() ||
+                !contained(name) ||
+                name.find_first_of("*?[\\") != std::string::npos)
+        {
+            return results;
+        }
+
         glob_t buffer;
         for (std::size_t i(0); i < dirs.size(); ++i)
         {
@@ -39,7 +80,6 @@ namespace
             glob((dirs[i] + "/" + name + ".*").c_str(), flags, 0, &buffer);
         }
 
-        std::vector<std::string> results;
         for (std::size_t i(0); i < buffer.gl_pathc; ++i)
         {
             results.push_back(buffer.gl_pathv[i]);
@@ -49,7 +89,153 @@ namespace
 
         return results;
     }
-    */
+
+    // Per resource.
+    const std::size_t hierarchyCacheBytes(32 * 1024 * 1024);
+
+    // Number of hierarchy levels queried to estimate the size of a read.
+    const std::size_t estimateDepth(4);
+
+    // Depth to which unbounded reads are extrapolated.
+    const std::size_t maxEstimateDepth(64);
+
+    // Read estimates remembered per resource.
+    const std::size_t maxEstimates(1024);
+
+    // Rough size of the manifest entry for each indexed file.
+    const std::size_t manifestEntryBytes(256);
+
+    // Split a range of depths into consecutive slices, one depth apiece, up
+    // to the given number of slices, the last of which takes any remaining
+    // depths.  An end of zero leaves the range, and its last slice, open.
+    std::vector<std::pair<std::size_t, std::size_t>> sliceDepths(
+            const std::size_t begin,
+            const std::size_t end,
+            const std::size_t count)
+    {
+        std::vector<std::pair<std::size_t, std::size_t>> slices;
+        std::size_t depth(begin);
+
+        while (slices.size() + 1 < count && (!end || depth + 1 < end))
+        {
+            slices.emplace_back(depth, depth + 1);
+            ++depth;
+        }
+
+        slices.emplace_back(depth, end);
+        return slices;
+    }
+
+    bool toValueType(const pdal::Dimension::Type type, ValueType& result)
+    {
+        switch (type)
+        {
+            case pdal::Dimension::Type::Signed8:
+                result = ValueType::Int8; return true;
+            case pdal::Dimension::Type::Signed16:
+                result = ValueType::Int16; return true;
+            case pdal::Dimension::Type::Signed32:
+                result = ValueType::Int32; return true;
+            case pdal::Dimension::Type::Signed64:
+                result = ValueType::Int64; return true;
+            case pdal::Dimension::Type::Unsigned8:
+                result = ValueType::Uint8; return true;
+            case pdal::Dimension::Type::Unsigned16:
+                result = ValueType::Uint16; return true;
+            case pdal::Dimension::Type::Unsigned32:
+                result = ValueType::Uint32; return true;
+            case pdal::Dimension::Type::Unsigned64:
+                result = ValueType::Uint64; return true;
+            case pdal::Dimension::Type::Float:
+                result = ValueType::Float; return true;
+            case pdal::Dimension::Type::Double:
+                result = ValueType::Double; return true;
+            default:
+                return false;
+        }
+    }
+
+    // Compile a conversion from the native schema of an index to the
+    // requested one, so the index may be read in its native schema, which
+    // avoids its generic per-dimension conversion.  Returns null if there is
+    // nothing to convert, or if the conversion should be left to the index.
+    std::unique_ptr<Transcoder> makeTranscoder(
+            const entwine::Schema& native,
+            const entwine::Schema& schema,
+            const double scale,
+            const entwine::Point& offset)
+    {
+        std::unique_ptr<Transcoder> transcoder;
+
+        const bool offsetting(offset.x || offset.y || offset.z);
+
+        if (schema == native && !scale && !offsetting) return transcoder;
+
+        // An offset without a scale is left to the index.
+        if (!scale && offsetting) return transcoder;
+
+        std::vector<Transcoder::Field> fields;
+        std::size_t outPos(0);
+
+        for (const entwine::DimInfo& out : schema.dims())
+        {
+            std::size_t inPos(0);
+            const entwine::DimInfo* in(nullptr);
+
+            for (const entwine::DimInfo& candidate : native.dims())
+            {
+                if (candidate.name() == out.name())
+                {
+                    in = &candidate;
+                    break;
+                }
+
+                inPos += candidate.size();
+            }
+
+            ValueType inType;
+            ValueType outType;
+
+            // Leave dimensions we don't have, and unusual types, to the
+            // index.
+            if (
+                    !in ||
+                    !toValueType(in->type(), inType) ||
+                    !toValueType(out.type(), outType) ||
+                    sizeOf(inType) != in->size() ||
+                    sizeOf(outType) != out.size())
+            {
+                return transcoder;
+            }
+
+            const std::string& name(out.name());
+            const bool spatial(name == "X" || name == "Y" || name == "Z");
+
+            const double dimOffset(
+                    name == "X" ? offset.x :
+                    name == "Y" ? offset.y :
+                    name == "Z" ? offset.z : 0);
+
+            fields.emplace_back(
+                    inType,
+                    inPos,
+                    outType,
+                    outPos,
+                    spatial && scale,
+                    dimOffset);
+
+            outPos += out.size();
+        }
+
+        transcoder.reset(
+                new Transcoder(
+                    native.pointSize(),
+                    schema.pointSize(),
+                    fields,
+                    scale ? scale : 1));
+
+        return transcoder;
+    }
 
     std::string getTypeString(const entwine::Structure& structure)
     {
@@ -71,12 +257,30 @@ namespace
 
 Session::Session(
         pdal::StageFactory& stageFactory,
-        std::mutex& factoryMutex)
+        std::mutex& factoryMutex,
+        TaskPool& compressionPool,
+        TaskPool& prefetchPool,
+        TaskPool& discoveryPool,
+        TaskPool& preloadPool)
     : m_stageFactory(stageFactory)
     , m_factoryMutex(factoryMutex)
+    , m_compressionPool(compressionPool)
+    , m_prefetchPool(prefetchPool)
+    , m_discoveryPool(discoveryPool)
+    , m_preloadPool(preloadPool)
     , m_initOnce()
+    , m_name()
+    , m_path()
+    , m_footprint(sizeof(Session))
     , m_source()
     , m_entwine()
+    , m_info()
+    , m_preloading(false)
+    , m_pins()
+    , m_hierarchyCache(hierarchyCacheBytes)
+    , m_estimateMutex()
+    , m_estimates()
+    , m_estimateOrder()
 { }
 
 Session::~Session()
@@ -86,16 +290,22 @@ bool Session::initialize(
         const std::string& name,
         std::vector<std::string> paths,
         entwine::OuterScope& outerScope,
-        std::shared_ptr<entwine::Cache> cache)
+        std::shared_ptr<entwine::Cache> cache,
+        const std::string& hint)
 {
-    m_initOnce.ensure([this, &name, &paths, &cache, &outerScope]()
+    m_initOnce.ensure([this, &name, &paths, &cache, &outerScope, &hint]()
     {
         std::cout << "Discovering " << name << std::endl;
+        m_name = name;
 
-        if (resolveIndex(name, paths, outerScope, cache))
+        if (resolveIndex(name, paths, hint, outerScope, cache))
         {
             std::cout << "\tIndex for " << name << " found" << std::endl;
 
+            std::string path(m_path);
+            if (path.size() && path.back() != '/') path.push_back('/');
+            m_pins.reset(new CachingDriver::Pins(path + name));
+
             Json::Value json;
             const entwine::Metadata& metadata(m_entwine->metadata());
 
@@ -112,6 +322,10 @@ bool Session::initialize(
                     metadata.structure().nullDepthEnd());
 
             m_info = json.toStyledString();
+
+            m_footprint += m_info.size() +
+                metadata.manifest().size() * manifestEntryBytes +
+                baseBytes();
         }
         else if (resolveSource(name, paths))
         {
@@ -146,13 +360,54 @@ std::string Session::hierarchy(
         const entwine::Bounds& bounds,
         const std::size_t depthBegin,
         const std::size_t depthEnd,
-        const bool vertical) const
+        const bool vertical,
+        const bool binary) const
 {
     if (indexed())
     {
-        Json::FastWriter writer;
-        return writer.write(
-                m_entwine->hierarchy(bounds, depthBegin, depthEnd, vertical));
+        if (vertical && binary)
+        {
+            throw std::runtime_error("Binary hierarchies may not be vertical");
+        }
+
+        std::string result;
+
+        if (!m_hierarchyCache.get(
+                    bounds,
+                    depthBegin,
+                    depthEnd,
+                    vertical,
+                    binary,
+                    result))
+        {
+            Json::Value json(
+                    m_entwine->hierarchy(
+                        bounds,
+                        depthBegin,
+                        depthEnd,
+                        vertical));
+
+            if (binary)
+            {
+                result = BinaryHierarchy::encode(json, depthEnd - depthBegin);
+            }
+            else
+            {
+                Json::FastWriter writer;
+                result = writer.write(json);
+            }
+
+            m_hierarchyCache.insert(
+                    bounds,
+                    depthBegin,
+                    depthEnd,
+                    vertical,
+                    binary,
+                    std::move(json),
+                    result);
+        }
+
+        return result;
     }
     else
     {
@@ -162,7 +417,7 @@ std::string Session::hierarchy(
 
 std::shared_ptr<ReadQuery> Session::query(
         const entwine::Schema& schema,
-        const bool compress)
+        const CompressionMode compress)
 {
     if (sourced())
     {
@@ -170,6 +425,7 @@ std::shared_ptr<ReadQuery> Session::query(
                 new UnindexedReadQuery(
                     schema,
                     compress,
+                    m_compressionPool,
                     *m_source));
     }
     else
@@ -180,26 +436,49 @@ std::shared_ptr<ReadQuery> Session::query(
 
 std::shared_ptr<ReadQuery> Session::query(
         const entwine::Schema& schema,
-        const bool compress,
+        const CompressionMode compress,
         const double scale,
         const entwine::Point& offset,
         const entwine::Bounds* bounds,
         const std::size_t depthBegin,
-        const std::size_t depthEnd)
+        const std::size_t depthEnd,
+        const QueryLimits& limits)
 {
     if (indexed())
     {
+        const entwine::Schema& native(m_entwine->metadata().schema());
+
+        std::unique_ptr<Transcoder> transcoder(
+                makeTranscoder(native, schema, scale, offset));
+
+        // Each depth is its own set of chunks, so separate depths may be
+        // fetched concurrently, as many at a time as we may prefetch.
+        std::vector<std::unique_ptr<entwine::Query>> queries;
+
+        for (const auto& slice :
+                sliceDepths(depthBegin, depthEnd, limits.prefetch()))
+        {
+            // If we're transcoding, read points from the index as they are
+            // stored.
+            queries.push_back(
+                    m_entwine->query(
+                        transcoder ? native : schema,
+                        bounds ? *bounds : m_entwine->metadata().bounds(),
+                        slice.first,
+                        slice.second,
+                        transcoder ? 0 : scale,
+                        transcoder ? entwine::Point() : offset));
+        }
+
         return std::shared_ptr<ReadQuery>(
                 new EntwineReadQuery(
                     schema,
                     compress,
-                    m_entwine->query(
-                        schema,
-                        bounds ? *bounds : m_entwine->metadata().bounds(),
-                        depthBegin,
-                        depthEnd,
-                        scale,
-                        offset)));
+                    std::move(queries),
+                    std::move(transcoder),
+                    m_compressionPool,
+                    m_prefetchPool,
+                    limits.prefetch()));
     }
     else
     {
@@ -207,6 +486,210 @@ std::shared_ptr<ReadQuery> Session::query(
     }
 }
 
+std::uint64_t Session::estimatePoints(
+        const entwine::Bounds* bounds,
+        const std::size_t depthBegin,
+        const std::size_t depthEnd) const
+{
+    if (!indexed()) throw WrongQueryType();
+
+    const entwine::Metadata& metadata(m_entwine->metadata());
+    const double total(metadata.manifest().pointStats().inserts());
+
+    const std::size_t end(depthEnd ? depthEnd : depthBegin + maxEstimateDepth);
+    if (end <= depthBegin) return 0;
+
+    const entwine::Bounds& queryBounds(bounds ? *bounds : metadata.bounds());
+
+    std::ostringstream ss;
+    ss.precision(17);
+    ss <<
+        queryBounds.min().x << ',' << queryBounds.min().y << ',' <<
+        queryBounds.min().z << ',' << queryBounds.max().x << ',' <<
+        queryBounds.max().y << ',' << queryBounds.max().z << ',' <<
+        depthBegin << ',' << depthEnd;
+
+    const std::string key(ss.str());
+
+    std::unique_lock<std::mutex> lock(m_estimateMutex);
+    auto it(m_estimates.find(key));
+    if (it != m_estimates.end()) return it->second;
+    lock.unlock();
+
+    const std::size_t sampled(std::min(end - depthBegin, estimateDepth));
+
+    // Our hierarchy cache is for clients, so query the index directly.
+    const std::vector<std::uint64_t> levels(
+            BinaryHierarchy::levels(
+                BinaryHierarchy::encode(
+                    m_entwine->hierarchy(
+                        queryBounds,
+                        depthBegin,
+                        depthBegin + sampled,
+                        false),
+                    sampled),
+                sampled));
+
+    double estimate(0);
+    for (const std::uint64_t n : levels) estimate += n;
+
+    // Assume the growth from each level to the next continues, which can't
+    // exceed the number of children per node.
+    if (levels.size() >= 2 && levels[levels.size() - 2])
+    {
+        const double growth(
+                std::min(
+                    std::max(
+                        static_cast<double>(levels.back()) /
+                            levels[levels.size() - 2],
+                        1.0),
+                    8.0));
+
+        double level(levels.back());
+
+        for (
+                std::size_t depth(depthBegin + sampled);
+                depth < end && estimate < total;
+                ++depth)
+        {
+            level *= growth;
+            estimate += level;
+        }
+    }
+
+    const std::uint64_t result(std::min(estimate, total));
+
+    lock.lock();
+
+    if (m_estimates.insert(std::make_pair(key, result)).second)
+    {
+        m_estimateOrder.push_back(key);
+
+        if (m_estimateOrder.size() > maxEstimates)
+        {
+            m_estimates.erase(m_estimateOrder.front());
+            m_estimateOrder.pop_front();
+        }
+    }
+
+    return result;
+}
+
+void Session::preload(const std::size_t coldDepths)
+{
+    if (!indexed() || m_preloading.exchange(true)) return;
+
+    // Keep ourselves alive, and unevictable, until we're done.
+    std::shared_ptr<Session> self(shared_from_this());
+
+    m_preloadPool.add([self, coldDepths]()->void
+    {
+        try
+        {
+            self->warm(coldDepths);
+        }
+        catch (const std::exception& e)
+        {
+            std::cout << "Could not preload " << self->name() << ": " <<
+                e.what() << std::endl;
+        }
+        catch (...)
+        {
+            std::cout << "Could not preload " << self->name() << std::endl;
+        }
+    });
+}
+
+void Session::warm(const std::size_t coldDepths)
+{
+    const entwine::Metadata& metadata(m_entwine->metadata());
+    const entwine::Schema& schema(metadata.schema());
+    const entwine::Structure& structure(metadata.structure());
+
+    const std::size_t coldBegin(structure.coldDepthBegin());
+    const std::size_t coldEnd(coldBegin + coldDepths);
+
+    // Read everything in a depth range, in our native schema, which fetches
+    // each of its chunks into the chunk cache.
+    auto drain([](entwine::Query& query)->void
+    {
+        std::vector<char> data;
+
+        while (!query.done())
+        {
+            data.clear();
+            query.next(data);
+        }
+    });
+
+    auto query([this, &metadata, &schema](
+                std::size_t begin,
+                std::size_t end)->std::unique_ptr<entwine::Query>
+    {
+        return m_entwine->query(
+                schema,
+                metadata.bounds(),
+                begin,
+                end,
+                0,
+                entwine::Point());
+    });
+
+    // Our base depths are held by our index itself once loaded, and are
+    // already part of our footprint.
+    drain(*query(0, coldBegin));
+
+    // Our cold chunks are released back to the chunk cache as each query
+    // finishes, so we pin them as they are fetched.
+    if (coldDepths)
+    {
+        m_pins->capture(true);
+
+        try
+        {
+            drain(*query(coldBegin, coldEnd));
+        }
+        catch (...)
+        {
+            m_pins->capture(false);
+            throw;
+        }
+
+        m_pins->capture(false);
+    }
+
+    std::cout << "Preloaded " << m_name << ", pinning " <<
+        m_pins->chunks() << " chunks (" << m_pins->bytes() <<
+        " bytes) through depth " << coldEnd << std::endl;
+}
+
+std::size_t Session::baseBytes() const
+{
+    const entwine::Metadata& metadata(m_entwine->metadata());
+    const entwine::Structure& structure(metadata.structure());
+
+    // Querying our hierarchy here would hold up every open, so bound the
+    // base by its nodes instead: each depth holds at most one point for each
+    // of its (2^dimensions)^depth nodes.  Tubular indexes may hold more, for
+    // which this is an underestimate.
+    const std::uint64_t numPoints(metadata.manifest().pointStats().inserts());
+    const std::uint64_t factor(1ull << structure.dimensions());
+
+    std::uint64_t nodes(0);
+    std::uint64_t width(1);
+
+    for (
+            std::size_t depth(0);
+            depth < structure.baseDepthEnd() && nodes < numPoints;
+            ++depth)
+    {
+        if (depth >= structure.nullDepthEnd()) nodes += width;
+        width *= factor;
+    }
+
+    return std::min(nodes, numPoints) * metadata.schema().pointSize();
+}
+
 const entwine::Schema& Session::schema() const
 {
     check();
@@ -218,35 +701,41 @@ const entwine::Schema& Session::schema() const
 bool Session::resolveIndex(
         const std::string& name,
         const std::vector<std::string>& paths,
+        const std::string& hint,
         entwine::OuterScope& outerScope,
         std::shared_ptr<entwine::Cache> cache)
 {
-    for (std::string path : paths)
+    if (!contained(name)) return false;
+
+    PathSearch<entwine::Reader> search(
+            m_discoveryPool,
+            paths,
+            hint,
+            [name, &outerScope, cache](std::string path)
+                ->std::unique_ptr<entwine::Reader>
+            {
+                if (path.size() && path.back() != '/') path.push_back('/');
+                path += name;
+
+                entwine::arbiter::Endpoint endpoint(
+                        outerScope.getArbiterPtr()->getEndpoint(path));
+
+                return std::unique_ptr<entwine::Reader>(
+                        new entwine::Reader(endpoint, *cache));
+            });
+
+    // Take the first success in the order of our paths, which means waiting
+    // on those before it to fail.
+    for (std::size_t i(0); i < paths.size() && !m_entwine; ++i)
     {
         std::string err;
+        m_entwine = search.wait(i, err);
 
-        try
-        {
-            if (path.size() && path.back() != '/') path.push_back('/');
-            entwine::arbiter::Endpoint endpoint(
-                    outerScope.getArbiterPtr()->getEndpoint(path + name));
-            m_entwine.reset(new entwine::Reader(endpoint, *cache));
-        }
-        catch (const std::runtime_error& e)
-        {
-            err = e.what();
-        }
-        catch (...)
-        {
-            err = "unknown error";
-            m_entwine.reset(0);
-        }
-
-        std::cout << "\tTried resolving index at " << path << ": ";
+        std::cout << "\tTried resolving index at " << paths[i] << ": ";
         if (m_entwine)
         {
             std::cout << "SUCCESS" << std::endl;
-            break;
+            m_path = paths[i];
         }
         else
         {
@@ -261,8 +750,6 @@ bool Session::resolveSource(
         const std::string& name,
         const std::vector<std::string>& paths)
 {
-    return false;
-    /*
     const auto sources(resolve(paths, name));
 
     if (sources.size() > 1)
@@ -308,6 +795,5 @@ bool Session::resolveSource(
     }
 
     return sourced();
-    */
 }
 
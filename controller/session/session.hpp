@@ -1,11 +1,17 @@
 #pragma once
 
+#include <atomic>
 #include <cstdint>
+#include <deque>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
 #include "types/source-manager.hpp"
+#include "util/caching-driver.hpp"
+#include "util/hierarchy-cache.hpp"
 #include "util/once.hpp"
 
 namespace pdal
@@ -19,11 +25,16 @@ namespace entwine
     class Bounds;
     class Cache;
     class OuterScope;
+    class Point;
+    class Query;
     class Reader;
     class Schema;
 }
 
+enum class CompressionMode;
+class QueryLimits;
 class ReadQuery;
+class TaskPool;
 
 class WrongQueryType : public std::runtime_error
 {
@@ -33,43 +44,101 @@ public:
     { }
 };
 
-class Session
+class Session : public std::enable_shared_from_this<Session>
 {
 public:
-    Session(pdal::StageFactory& stageFactory, std::mutex& factoryMutex);
+    Session(
+            pdal::StageFactory& stageFactory,
+            std::mutex& factoryMutex,
+            TaskPool& compressionPool,
+            TaskPool& prefetchPool,
+            TaskPool& discoveryPool,
+            TaskPool& preloadPool);
     ~Session();
 
     // Returns true if initialization was successful.  If false, this session
     // should not be used.
+    //
+    // Our paths are searched in order of priority.  The hint, if it is one
+    // of them, is probed first, but is only taken if no path ahead of it
+    // holds the resource.
     bool initialize(
             const std::string& name,
             std::vector<std::string> paths,
             entwine::OuterScope& outerScope,
-            std::shared_ptr<entwine::Cache> cache);
+            std::shared_ptr<entwine::Cache> cache,
+            const std::string& hint = std::string());
+
+    // Name of the resource backing this session, valid after initialization.
+    const std::string& name() const { return m_name; }
+
+    // The search path at which our index was found, valid after
+    // initialization.  Empty if there is no index.
+    const std::string& path() const { return m_path; }
+
+    // Approximate bytes held by this session: our metadata, the base depths
+    // held by our index, our pinned chunks, and our cached hierarchies.
+    std::size_t footprint() const
+    {
+        return
+            m_footprint.load() +
+            pinnedBytes() +
+            m_hierarchyCache.stats().bytes;
+    }
+
+    // Load our base depths, and our first coldDepths cold depths, in the
+    // background on the preload pool.  The chunks of those cold depths are
+    // pinned in memory until we are destroyed, so the chunk cache may evict
+    // them but never has to fetch them again.  Chunks which the chunk cache
+    // already holds aren't fetched, and so aren't pinned.  Only the first
+    // call has any effect.
+    void preload(std::size_t coldDepths);
+
+    std::size_t pinnedBytes() const
+    {
+        return m_pins ? m_pins->bytes() : 0;
+    }
 
     // Returns stringified JSON response.
     std::string info() const;
+
+    // Returns stringified JSON, or if binary is set, the encoding of
+    // BinaryHierarchy.
     std::string hierarchy(
             const entwine::Bounds& bounds,
             std::size_t depthBegin,
             std::size_t depthEnd,
-            bool vertical) const;
+            bool vertical,
+            bool binary) const;
+
+    HierarchyCache::Stats hierarchyCacheStats() const
+    {
+        return m_hierarchyCache.stats();
+    }
 
     // Read a full unindexed data set.
     std::shared_ptr<ReadQuery> query(
             const entwine::Schema& schema,
-            bool compress);
+            CompressionMode compress);
 
     // Read quad-tree indexed data with a bounding box query and min/max tree
     // depths to search.
     std::shared_ptr<ReadQuery> query(
             const entwine::Schema& schema,
-            bool compress,
+            CompressionMode compress,
             double scale,
             const entwine::Point& offset,
             const entwine::Bounds* bounds,
             std::size_t depthBegin,
-            std::size_t depthEnd);
+            std::size_t depthEnd,
+            const QueryLimits& limits);
+
+    // Estimate the number of points selected by an indexed query, from the
+    // first few levels of its hierarchy.  Deeper levels are extrapolated.
+    std::uint64_t estimatePoints(
+            const entwine::Bounds* bounds,
+            std::size_t depthBegin,
+            std::size_t depthEnd) const;
 
     const entwine::Schema& schema() const;
 
@@ -77,6 +146,7 @@ private:
     bool resolveIndex(
             const std::string& name,
             const std::vector<std::string>& paths,
+            const std::string& hint,
             entwine::OuterScope& outerScope,
             std::shared_ptr<entwine::Cache> cache);
 
@@ -86,6 +156,13 @@ private:
 
     void resolveInfo();
 
+    // Estimated bytes of the base depths held by our index, from our
+    // metadata.
+    std::size_t baseBytes() const;
+
+    // Runs on the preload pool.
+    void warm(std::size_t coldDepths);
+
     bool indexed() const { return m_entwine.get(); }
     bool sourced() const { return m_source.get(); }
 
@@ -99,11 +176,31 @@ private:
 
     pdal::StageFactory& m_stageFactory;
     std::mutex& m_factoryMutex;
+    TaskPool& m_compressionPool;
+    TaskPool& m_prefetchPool;
+    TaskPool& m_discoveryPool;
+    TaskPool& m_preloadPool;
 
     Once m_initOnce;
+    std::string m_name;
+    std::string m_path;
+    std::atomic<std::size_t> m_footprint;
     std::unique_ptr<SourceManager> m_source;
     std::unique_ptr<entwine::Reader> m_entwine;
     std::string m_info;
+    std::atomic<bool> m_preloading;
+
+    // Set along with our index, and released with us.
+    std::unique_ptr<CachingDriver::Pins> m_pins;
+
+    mutable HierarchyCache m_hierarchyCache;
+
+    // Recent read estimates by their parameters, oldest first.  These are
+    // kept apart from our hierarchy cache, so that estimating every read
+    // doesn't crowd out the hierarchies requested by clients.
+    mutable std::mutex m_estimateMutex;
+    mutable std::map<std::string, std::uint64_t> m_estimates;
+    mutable std::deque<std::string> m_estimateOrder;
 
     // Disallow copy/assignment.
     Session(const Session&);
@@ -0,0 +1,99 @@
+#include "types/query-limits.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <entwine/third/json/json.hpp>
+
+namespace
+{
+    const std::size_t defaultPipelineDepth(2);
+    const std::size_t defaultPrefetch(2);
+    const std::size_t defaultResponseCacheMb(128);
+    const std::size_t defaultBatchKb(1024);
+    const std::size_t defaultMaxBatchKb(4096);
+    const std::size_t defaultMaxReads(64);
+    const std::size_t defaultMaxReadsPerResource(32);
+    const std::size_t defaultMaxReadMillionPoints(512);
+    const std::size_t defaultMaxResourceMillionPoints(256);
+    const std::size_t defaultMaxQueuedReads(256);
+    const double defaultQueueAgingSeconds(5);
+
+    const std::uint64_t million(1000000);
+
+    std::size_t getSize(
+            const Json::Value& json,
+            const std::string& key,
+            const std::size_t fallback,
+            const std::size_t min = 0)
+    {
+        if (!json.isMember(key)) return fallback;
+
+        const Json::UInt64 value(json[key].asUInt64());
+        return value < min ? min : value;
+    }
+}
+
+QueryLimits::QueryLimits()
+    : m_pipelineDepth(defaultPipelineDepth)
+    , m_prefetch(defaultPrefetch)
+    , m_responseCacheBytes(defaultResponseCacheMb * 1024 * 1024)
+    , m_batchBytes(defaultBatchKb * 1024)
+    , m_maxBatchBytes(defaultMaxBatchKb * 1024)
+    , m_maxReads(defaultMaxReads)
+    , m_maxReadsPerResource(defaultMaxReadsPerResource)
+    , m_maxReadPoints(defaultMaxReadMillionPoints * million)
+    , m_maxResourcePoints(defaultMaxResourceMillionPoints * million)
+    , m_maxQueuedReads(defaultMaxQueuedReads)
+    , m_queueAgingSeconds(defaultQueueAgingSeconds)
+{ }
+
+QueryLimits::QueryLimits(const Json::Value& json)
+    : m_pipelineDepth(
+            getSize(json, "pipelineDepth", defaultPipelineDepth, 1))
+    , m_prefetch(getSize(json, "prefetch", defaultPrefetch))
+    , m_responseCacheBytes(
+            getSize(json, "responseCacheMb", defaultResponseCacheMb) *
+            1024 * 1024)
+    , m_batchBytes(getSize(json, "batchKb", defaultBatchKb) * 1024)
+    , m_maxBatchBytes(getSize(json, "maxBatchKb", defaultMaxBatchKb) * 1024)
+    , m_maxReads(getSize(json, "maxReads", defaultMaxReads))
+    , m_maxReadsPerResource(
+            getSize(json, "maxReadsPerResource", defaultMaxReadsPerResource))
+    , m_maxReadPoints(
+            getSize(
+                json,
+                "maxReadMillionPoints",
+                defaultMaxReadMillionPoints) * million)
+    , m_maxResourcePoints(
+            getSize(
+                json,
+                "maxResourceMillionPoints",
+                defaultMaxResourceMillionPoints) * million)
+    , m_maxQueuedReads(getSize(json, "maxQueuedReads", defaultMaxQueuedReads))
+    , m_queueAgingSeconds(
+            json.isMember("queueAgingSeconds") ?
+                std::max(json["queueAgingSeconds"].asDouble(), 0.0) :
+                defaultQueueAgingSeconds)
+{
+    if (m_maxBatchBytes && m_batchBytes > m_maxBatchBytes)
+    {
+        m_batchBytes = m_maxBatchBytes;
+    }
+}
+
+QueryLimits QueryLimits::parse(const std::string& s)
+{
+    if (s.empty()) return QueryLimits();
+
+    Json::Reader reader;
+    Json::Value json;
+
+    if (!reader.parse(s, json, false) || !json.isObject())
+    {
+        throw std::runtime_error(
+                "Bad queryLimits entry:" + reader.getFormattedErrorMessages());
+    }
+
+    return QueryLimits(json);
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace Json
+{
+    class Value;
+}
+
+// Per-query tuning values, taken from the "queryLimits" entry of the
+// Greyhound configuration.  Entries missing from the configuration take their
+// defaults.
+class QueryLimits
+{
+public:
+    QueryLimits();
+    explicit QueryLimits(const Json::Value& json);
+
+    // Parse from stringified JSON.  An empty string results in the defaults.
+    static QueryLimits parse(const std::string& json);
+
+    // Maximum number of read buffers that may be in flight for a single query
+    // between the worker producing them and JS-land consuming them.  A depth
+    // of 1 results in lockstep reading.
+    std::size_t pipelineDepth() const { return m_pipelineDepth; }
+
+    // Number of chunks an indexed query may fetch ahead of its consumer, and
+    // of depths whose chunks it may fetch concurrently.  If zero, chunks are
+    // fetched synchronously as they are read.
+    std::size_t prefetch() const { return m_prefetch; }
+
+    // Memory budget, in bytes, for caching finished read responses across
+    // all resources.  If zero, responses are not cached.
+    std::size_t responseCacheBytes() const { return m_responseCacheBytes; }
+
+    // Reads are coalesced to produce buffers of about this many bytes of
+    // uncompressed points.  If zero, each chunk is sent as it is read.
+    std::size_t batchBytes() const { return m_batchBytes; }
+
+    // Reads producing more than this many bytes of uncompressed points are
+    // split across buffers.  If zero, chunks are never split.
+    std::size_t maxBatchBytes() const { return m_maxBatchBytes; }
+
+    // Admission limits for read queries.  Reads beyond these limits are
+    // queued, cheapest first, and reads beyond maxQueuedReads are rejected.
+    // Costs are estimated numbers of points.  For each, zero means no limit.
+    //
+    // A single read whose cost exceeds a cost limit may still run, but only
+    // alone.
+    std::size_t maxReads() const { return m_maxReads; }
+    std::size_t maxReadsPerResource() const { return m_maxReadsPerResource; }
+    std::uint64_t maxReadPoints() const { return m_maxReadPoints; }
+    std::uint64_t maxResourcePoints() const { return m_maxResourcePoints; }
+    std::size_t maxQueuedReads() const { return m_maxQueuedReads; }
+
+    // A queued read's cost is halved for every this many seconds it has
+    // waited, so expensive reads are not starved.  If zero, queued reads are
+    // run strictly cheapest first.
+    double queueAgingSeconds() const { return m_queueAgingSeconds; }
+
+private:
+    std::size_t m_pipelineDepth;
+    std::size_t m_prefetch;
+    std::size_t m_responseCacheBytes;
+    std::size_t m_batchBytes;
+    std::size_t m_maxBatchBytes;
+
+    std::size_t m_maxReads;
+    std::size_t m_maxReadsPerResource;
+    std::uint64_t m_maxReadPoints;
+    std::uint64_t m_maxResourcePoints;
+    std::size_t m_maxQueuedReads;
+    double m_queueAgingSeconds;
+};
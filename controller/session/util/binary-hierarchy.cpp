@@ -0,0 +1,162 @@
+#include "binary-hierarchy.hpp"
+
+#include <cstdint>
+#include <stdexcept>
+
+#include <entwine/third/json/json.hpp>
+
+namespace
+{
+    const char* const octants[] =
+    {
+        "nwu", "nwd", "neu", "ned", "swu", "swd", "seu", "sed"
+    };
+
+    const char* const quadrants[] = { "nw", "ne", "sw", "se" };
+
+    // Children are either all octants or all quadrants, so find any child to
+    // see which.
+    std::size_t dimensions(const Json::Value& node)
+    {
+        for (const std::string& key : node.getMemberNames())
+        {
+            if (key.size() == 3) return 3;
+            else if (key.size() == 2) return 2;
+        }
+
+        for (const std::string& key : node.getMemberNames())
+        {
+            if (node[key].isObject())
+            {
+                const std::size_t result(dimensions(node[key]));
+                if (result) return result;
+            }
+        }
+
+        return 0;
+    }
+
+    void writeVarint(std::string& out, std::uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+            value >>= 7;
+        }
+
+        out.push_back(static_cast<char>(value));
+    }
+
+    std::uint64_t readVarint(const std::string& data, std::size_t& pos)
+    {
+        std::uint64_t value(0);
+        std::size_t shift(0);
+
+        while (true)
+        {
+            if (pos >= data.size() || shift >= 64)
+            {
+                throw std::runtime_error("Invalid binary hierarchy");
+            }
+
+            const unsigned char byte(data[pos++]);
+            value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+            shift += 7;
+
+            if (!(byte & 0x80)) return value;
+        }
+    }
+
+    void write(
+            std::string& out,
+            const Json::Value& node,
+            const std::size_t depth,
+            const char* const* dirs,
+            const std::size_t numDirs)
+    {
+        writeVarint(out, node.isMember("n") ? node["n"].asUInt64() : 0);
+
+        if (depth <= 1) return;
+
+        unsigned char mask(0);
+
+        for (std::size_t i(0); i < numDirs; ++i)
+        {
+            if (node.isMember(dirs[i])) mask |= 1 << i;
+        }
+
+        out.push_back(static_cast<char>(mask));
+
+        for (std::size_t i(0); i < numDirs; ++i)
+        {
+            if (mask & (1 << i))
+            {
+                write(out, node[dirs[i]], depth - 1, dirs, numDirs);
+            }
+        }
+    }
+}
+
+std::string BinaryHierarchy::encode(
+        const Json::Value& tree,
+        const std::size_t depth)
+{
+    std::string result;
+    if (!depth) return result;
+
+    const bool octree(dimensions(tree) != 2);
+
+    result.push_back(static_cast<char>(octree ? 3 : 2));
+
+    write(
+            result,
+            tree,
+            depth,
+            octree ? octants : quadrants,
+            octree ? 8 : 4);
+
+    return result;
+}
+
+std::vector<std::uint64_t> BinaryHierarchy::levels(
+        const std::string& data,
+        const std::size_t depth)
+{
+    std::vector<std::uint64_t> result;
+    if (data.empty() || !depth) return result;
+
+    result.resize(depth, 0);
+
+    const std::size_t numDirs(data[0] == 2 ? 4 : 8);
+    std::size_t pos(1);
+
+    // Levels of the nodes remaining to be read.  Siblings are at the same
+    // level, so the order in which they're pushed doesn't matter.
+    std::vector<std::size_t> pending(1, 0);
+
+    while (!pending.empty())
+    {
+        const std::size_t level(pending.back());
+        pending.pop_back();
+
+        result[level] += readVarint(data, pos);
+
+        if (level + 1 < depth)
+        {
+            if (pos >= data.size())
+            {
+                throw std::runtime_error("Invalid binary hierarchy");
+            }
+
+            const unsigned char mask(data[pos++]);
+
+            for (std::size_t i(0); i < numDirs; ++i)
+            {
+                if (mask & (1 << i)) pending.push_back(level + 1);
+            }
+        }
+    }
+
+    return result;
+}
+
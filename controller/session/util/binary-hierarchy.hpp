@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Json
+{
+    class Value;
+}
+
+// Packs a hierarchy tree into a compact binary form, which is much smaller
+// than its JSON equivalent and requires no parsing in JS-land.
+//
+// The first byte is the number of bisected dimensions: 3 for octree-style
+// hierarchies, or 2 if Z is not bisected.  Nodes follow in pre-order, each
+// written as its point count as an unsigned LEB128 varint, followed - unless
+// the node is at the final depth - by a byte whose bits flag which children
+// are present.  Child bits are ordered nwu, nwd, neu, ned, swu, swd, seu, sed
+// for octrees, or nw, ne, sw, se otherwise.  Present children follow their
+// parent in bit order.
+class BinaryHierarchy
+{
+public:
+    // Encode the first "depth" levels of the given tree, which must be in
+    // the nested layout of a hierarchy that isn't vertical.
+    static std::string encode(const Json::Value& tree, std::size_t depth);
+
+    // Decode the total point count of each of the first "depth" levels of an
+    // encoded tree.
+    static std::vector<std::uint64_t> levels(
+            const std::string& data,
+            std::size_t depth);
+};
+
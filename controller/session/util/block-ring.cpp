@@ -0,0 +1,107 @@
+#include "block-ring.hpp"
+
+#include <stdexcept>
+
+BlockRing::BlockRing(const std::size_t slots)
+    : m_slots(slots)
+    , m_head(0)
+    , m_tail(0)
+    , m_finished(false)
+    , m_cancelled(false)
+    , m_waiters(0)
+    , m_mutex()
+    , m_cv()
+{
+    if (!slots) throw std::runtime_error("BlockRing must have a slot");
+}
+
+bool BlockRing::push(std::vector<char>& block)
+{
+    wait(&BlockRing::canPush);
+    if (m_cancelled.load()) return false;
+
+    const std::size_t tail(m_tail.load(std::memory_order_relaxed));
+
+    block.swap(m_slots[tail % m_slots.size()]);
+    block.clear();
+
+    m_tail.store(tail + 1);
+    notify();
+
+    return true;
+}
+
+void BlockRing::finish()
+{
+    m_finished.store(true);
+    notify();
+}
+
+bool BlockRing::pop(std::vector<char>& block)
+{
+    wait(&BlockRing::canPop);
+    if (m_cancelled.load() || exhausted()) return false;
+
+    const std::size_t head(m_head.load(std::memory_order_relaxed));
+
+    block.clear();
+    block.swap(m_slots[head % m_slots.size()]);
+
+    m_head.store(head + 1);
+    notify();
+
+    return true;
+}
+
+bool BlockRing::exhausted() const
+{
+    // Our producer finishes after its last push, so once we've seen it
+    // finish, we've seen all of its blocks.
+    return m_finished.load() && empty();
+}
+
+void BlockRing::cancel()
+{
+    m_cancelled.store(true);
+    notify();
+}
+
+bool BlockRing::empty() const
+{
+    return m_head.load() == m_tail.load();
+}
+
+bool BlockRing::canPush() const
+{
+    return m_cancelled.load() || m_tail.load() - m_head.load() < m_slots.size();
+}
+
+bool BlockRing::canPop() const
+{
+    return m_cancelled.load() || m_finished.load() || !empty();
+}
+
+void BlockRing::wait(bool (BlockRing::*ready)() const)
+{
+    if ((this->*ready)()) return;
+
+    // Registering as a waiter before checking again, under the lock, ensures
+    // that the other side either sees us waiting or has already made us
+    // ready.
+    ++m_waiters;
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_cv.wait(lock, [this, ready]()->bool { return (this->*ready)(); });
+
+    --m_waiters;
+}
+
+void BlockRing::notify()
+{
+    if (m_waiters.load())
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_cv.notify_all();
+    }
+}
+
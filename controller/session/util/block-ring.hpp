@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+// A bounded single-producer, single-consumer queue of data blocks.  Blocks
+// are swapped in and out of a fixed set of slots rather than copied, so the
+// storage of consumed blocks is recycled by the producer.
+//
+// Neither side takes a lock unless the ring is full or empty, in which case
+// it waits for the other side.
+class BlockRing
+{
+public:
+    explicit BlockRing(std::size_t slots);
+
+    // Producer.  Swap a block into the ring, receiving an empty block in
+    // exchange, waiting while the ring is full.  Returns false, without
+    // taking the block, if the consumer has cancelled.
+    bool push(std::vector<char>& block);
+
+    // Producer.  No more blocks will be pushed.
+    void finish();
+
+    // Consumer.  Swap the next block out of the ring, in exchange for one
+    // whose storage may be reused, waiting while the ring is empty.  Returns
+    // false if the ring is finished and drained, or cancelled.
+    bool pop(std::vector<char>& block);
+
+    // Consumer.  True once the ring is finished and drained.  Anything our
+    // producer wrote before finishing is then visible to us.
+    bool exhausted() const;
+
+    // Consumer, from any thread.  Any waiting or future push() will fail.
+    void cancel();
+
+private:
+    bool empty() const;
+    bool canPush() const;
+    bool canPop() const;
+
+    // Wait, if necessary, until the given condition holds.
+    void wait(bool (BlockRing::*ready)() const);
+    void notify();
+
+    std::vector<std::vector<char>> m_slots;
+
+    // Positions of the next block to be popped and pushed, which only ever
+    // increase, each written by one side only.
+    std::atomic<std::size_t> m_head;
+    std::atomic<std::size_t> m_tail;
+
+    std::atomic<bool> m_finished;
+    std::atomic<bool> m_cancelled;
+
+    std::atomic<std::size_t> m_waiters;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+
+    // Disallow copy/assignment.
+    BlockRing(const BlockRing&);
+    BlockRing& operator=(const BlockRing&);
+};
+
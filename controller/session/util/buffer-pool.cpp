@@ -1,11 +1,52 @@
 #include "buffer-pool.hpp"
 
-ItcBuffer::ItcBuffer(std::size_t id)
+#include <algorithm>
+#include <stdexcept>
+
+namespace
+{
+    const std::uint32_t nil(0xFFFFFFFF);
+
+    std::uint32_t idOf(std::uint64_t head) { return head & 0xFFFFFFFF; }
+    std::uint64_t tagOf(std::uint64_t head) { return head >> 32; }
+
+    std::uint64_t makeHead(std::uint32_t id, std::uint64_t tag)
+    {
+        return (tag << 32) | id;
+    }
+
+    // High-water capacity targets for our size classes, and the share of the
+    // pool's buffers that each class receives.  Most chunks land in the
+    // smaller classes, but dense chunks may run to many megabytes.
+    struct SizeClassInfo
+    {
+        std::size_t target;
+        std::size_t share;
+    };
+
+    const std::size_t shareTotal(8);
+    const SizeClassInfo sizeClassInfo[] =
+    {
+        { 1 << 19, 4 },     // 512 KB.
+        { 1 << 22, 3 },     // 4 MB.
+        { 1 << 25, 1 }      // 32 MB.
+    };
+
+    const std::size_t numSizeClasses(
+            sizeof(sizeClassInfo) / sizeof(SizeClassInfo));
+
+    std::uint64_t micros(std::chrono::steady_clock::duration d)
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(d)
+            .count();
+    }
+}
+
+ItcBuffer::ItcBuffer(const std::size_t id, const std::size_t sizeClass)
     : m_buffer()
     , m_id(id)
-    , m_mutex()
-    , m_cv()
-    , m_available(true)
+    , m_sizeClass(sizeClass)
+    , m_retained(0)
 { }
 
 std::size_t ItcBuffer::push(const char* data, const std::size_t size)
@@ -31,36 +72,223 @@ char* ItcBuffer::data()
 
 ///////////////////////////////////////////////////////////////////////////////
 
-ItcBufferPool::ItcBufferPool(std::size_t numBuffers)
-    : m_available(numBuffers)
-    , m_buffers()
+ItcBufferPool::SizeClass::SizeClass(
+        const std::size_t target,
+        const std::size_t begin,
+        const std::size_t end)
+    : target(target)
+    , begin(begin)
+    , end(end)
+    , head(makeHead(nil, 0))
+{ }
+
+ItcBufferPool::ItcBufferPool(
+        const std::size_t numBuffers,
+        const std::chrono::milliseconds timeout)
+    : m_buffers()
+    , m_sizeClasses()
+    , m_next(new std::atomic<std::uint32_t>[numBuffers])
+    , m_timeout(timeout)
+    , m_acquires(0)
+    , m_waits(0)
+    , m_timeouts(0)
+    , m_waitMicros(0)
+    , m_bytesRetained(0)
+    , m_inUse(0)
+    , m_peakInUse(0)
+    , m_waiters(0)
     , m_mutex()
     , m_cv()
 {
-    for (std::size_t i(0); i < numBuffers; ++i)
+    if (numBuffers < numSizeClasses || numBuffers >= nil)
+    {
+        throw std::runtime_error("Invalid buffer pool size");
+    }
+
+    std::size_t begin(0);
+
+    for (std::size_t i(0); i < numSizeClasses; ++i)
     {
-        m_available[i] = i;
-        m_buffers.insert(std::make_pair(
-                    i,
-                    std::shared_ptr<ItcBuffer>(new ItcBuffer(i))));
+        const SizeClassInfo& info(sizeClassInfo[i]);
+
+        const std::size_t end(
+                i + 1 < numSizeClasses ?
+                    begin + std::max<std::size_t>(
+                        numBuffers * info.share / shareTotal, 1) :
+                    numBuffers);
+
+        m_sizeClasses.emplace_back(new SizeClass(info.target, begin, end));
+
+        for (std::size_t id(begin); id < end; ++id)
+        {
+            m_buffers.emplace_back(new ItcBuffer(id, i));
+            push(*m_sizeClasses.back(), id);
+        }
+
+        begin = end;
     }
 }
 
-std::shared_ptr<ItcBuffer> ItcBufferPool::acquire()
+std::shared_ptr<ItcBuffer> ItcBufferPool::acquire(const std::size_t sizeHint)
 {
-    std::unique_lock<std::mutex> lock(m_mutex);
-    m_cv.wait(lock, [this]()->bool { return !m_available.empty(); });
-    std::shared_ptr<ItcBuffer> itcBuffer(m_buffers[m_available.back()]);
-    m_available.pop_back();
-    lock.unlock();
-    return itcBuffer;
+    ++m_acquires;
+
+    std::shared_ptr<ItcBuffer> buffer(tryAcquire(sizeHint));
+    if (!buffer) buffer = await(sizeHint);
+
+    const std::size_t inUse(++m_inUse);
+    std::size_t peak(m_peakInUse.load());
+
+    while (inUse > peak && !m_peakInUse.compare_exchange_weak(peak, inUse))
+    { }
+
+    return buffer;
 }
 
 void ItcBufferPool::release(std::shared_ptr<ItcBuffer> buffer)
 {
+    if (!buffer) return;
+
+    buffer->resize(0);
+    trim(*buffer);
+
+    const std::size_t retained(buffer->capacity());
+    m_bytesRetained += retained;
+    m_bytesRetained -= buffer->m_retained;
+    buffer->m_retained = retained;
+
+    --m_inUse;
+    push(*m_sizeClasses[buffer->sizeClass()], buffer->id());
+
+    if (m_waiters.load())
+    {
+        // Taking the lock ensures that a waiter is either already waiting on
+        // our condition variable, or has yet to check the free lists.
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_cv.notify_one();
+    }
+}
+
+ItcBufferPool::Stats ItcBufferPool::stats() const
+{
+    Stats stats;
+
+    stats.acquires = m_acquires.load();
+    stats.waits = m_waits.load();
+    stats.timeouts = m_timeouts.load();
+    stats.waitMicros = m_waitMicros.load();
+    stats.bytesRetained = m_bytesRetained.load();
+    stats.inUse = m_inUse.load();
+    stats.peakInUse = m_peakInUse.load();
+    stats.numBuffers = m_buffers.size();
+
+    return stats;
+}
+
+std::shared_ptr<ItcBuffer> ItcBufferPool::tryAcquire(
+        const std::size_t sizeHint)
+{
+    // Start with the smallest class that fits our hint, then look at larger
+    // classes, and finally fall back to smaller ones.
+    std::size_t first(0);
+    while (
+            first + 1 < m_sizeClasses.size() &&
+            m_sizeClasses[first]->target < sizeHint)
+    {
+        ++first;
+    }
+
+    std::size_t id(0);
+
+    for (std::size_t i(first); i < m_sizeClasses.size(); ++i)
+    {
+        if (pop(*m_sizeClasses[i], id)) return m_buffers[id];
+    }
+
+    for (std::size_t i(first); i > 0; --i)
+    {
+        if (pop(*m_sizeClasses[i - 1], id)) return m_buffers[id];
+    }
+
+    return std::shared_ptr<ItcBuffer>();
+}
+
+std::shared_ptr<ItcBuffer> ItcBufferPool::await(const std::size_t sizeHint)
+{
+    ++m_waits;
+
+    const auto start(std::chrono::steady_clock::now());
+    const auto deadline(start + m_timeout);
+
+    std::shared_ptr<ItcBuffer> buffer;
+
     std::unique_lock<std::mutex> lock(m_mutex);
-    m_available.push_back(buffer->id());
+    ++m_waiters;
+
+    while (!(buffer = tryAcquire(sizeHint)))
+    {
+        if (m_cv.wait_until(lock, deadline) == std::cv_status::timeout)
+        {
+            buffer = tryAcquire(sizeHint);
+            break;
+        }
+    }
+
+    --m_waiters;
     lock.unlock();
-    m_cv.notify_one();
+
+    m_waitMicros += micros(std::chrono::steady_clock::now() - start);
+
+    if (!buffer)
+    {
+        ++m_timeouts;
+        throw std::runtime_error("Timed out waiting for a read buffer");
+    }
+
+    return buffer;
+}
+
+bool ItcBufferPool::pop(SizeClass& sizeClass, std::size_t& id)
+{
+    std::uint64_t head(sizeClass.head.load());
+
+    while (idOf(head) != nil)
+    {
+        const std::uint32_t next(m_next[idOf(head)].load());
+
+        if (sizeClass.head.compare_exchange_weak(
+                    head,
+                    makeHead(next, tagOf(head) + 1)))
+        {
+            id = idOf(head);
+            return true;
+        }
+    }
+
+    return false;
 }
 
+void ItcBufferPool::push(SizeClass& sizeClass, const std::size_t id)
+{
+    std::uint64_t head(sizeClass.head.load());
+
+    do
+    {
+        m_next[id].store(idOf(head));
+    }
+    while (!sizeClass.head.compare_exchange_weak(
+                head,
+                makeHead(id, tagOf(head) + 1)));
+}
+
+void ItcBufferPool::trim(ItcBuffer& buffer) const
+{
+    const std::size_t target(m_sizeClasses[buffer.sizeClass()]->target);
+
+    if (buffer.capacity() > target)
+    {
+        std::vector<char> trimmed;
+        trimmed.reserve(target);
+        buffer.vecRef().swap(trimmed);
+    }
+}
@@ -1,11 +1,13 @@
 #pragma once
 
-#include <map>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <memory>
 #include <mutex>
 #include <vector>
-#include <memory>
-#include <cstring>
-#include <condition_variable>
 
 class ItcBufferPool;
 
@@ -21,6 +23,7 @@ public:
     std::size_t push(const char* data, std::size_t size);
 
     std::size_t size() const;
+    std::size_t capacity() const { return m_buffer.capacity(); }
     void resize(std::size_t);
 
     const std::vector<char>& vecRef() const { return m_buffer; }
@@ -28,35 +31,100 @@ public:
     char* data();
 
 private:
-    ItcBuffer(std::size_t id);
+    ItcBuffer(std::size_t id, std::size_t sizeClass);
 
     std::size_t id() const { return m_id; }
+    std::size_t sizeClass() const { return m_sizeClass; }
 
     std::vector<char> m_buffer;
     const std::size_t m_id;
+    const std::size_t m_sizeClass;
 
-    std::mutex m_mutex;
-    std::condition_variable m_cv;
-    bool m_available;
+    // Capacity of this buffer as of its last release, used to keep a running
+    // total of the bytes held by the pool.
+    std::size_t m_retained;
 };
 
+// A fixed set of buffers, grouped into size classes, each class with its own
+// lock-free free list.  Acquisition never takes a lock unless every buffer is
+// in use, in which case the caller waits - up to a timeout - for a release.
 class ItcBufferPool
 {
 public:
-    ItcBufferPool(std::size_t numBuffers);
-
-    std::shared_ptr<ItcBuffer> acquire();
+    struct Stats
+    {
+        Stats()
+            : acquires(0)
+            , waits(0)
+            , timeouts(0)
+            , waitMicros(0)
+            , bytesRetained(0)
+            , inUse(0)
+            , peakInUse(0)
+            , numBuffers(0)
+        { }
+
+        std::uint64_t acquires;
+        std::uint64_t waits;
+        std::uint64_t timeouts;
+        std::uint64_t waitMicros;
+        std::uint64_t bytesRetained;
+        std::size_t inUse;
+        std::size_t peakInUse;
+        std::size_t numBuffers;
+    };
+
+    ItcBufferPool(
+            std::size_t numBuffers,
+            std::chrono::milliseconds timeout = std::chrono::seconds(30));
+
+    // Acquire a buffer, preferring one whose size class fits the expected
+    // number of bytes to be written to it.  Throws std::runtime_error if no
+    // buffer becomes available within our timeout.
+    std::shared_ptr<ItcBuffer> acquire(std::size_t sizeHint = 0);
     void release(std::shared_ptr<ItcBuffer> buffer);
 
+    Stats stats() const;
+
 private:
-    // If there are no buffers available, wait for one.  Otherwise return.
-    // m_mutex must be locked by the caller.
-    void await();
+    struct SizeClass
+    {
+        SizeClass(std::size_t target, std::size_t begin, std::size_t end);
+
+        // Released buffers with a capacity above this are trimmed back to it.
+        const std::size_t target;
+        const std::size_t begin;
+        const std::size_t end;
+
+        // Tagged head of the free list: the low 32 bits are a buffer ID, the
+        // high 32 bits are bumped on every update to avoid ABA problems.
+        std::atomic<std::uint64_t> head;
+    };
+
+    std::shared_ptr<ItcBuffer> tryAcquire(std::size_t sizeHint);
+    std::shared_ptr<ItcBuffer> await(std::size_t sizeHint);
+
+    bool pop(SizeClass& sizeClass, std::size_t& id);
+    void push(SizeClass& sizeClass, std::size_t id);
 
-    std::vector<std::size_t> m_available;
-    std::map<std::size_t, std::shared_ptr<ItcBuffer>> m_buffers;
+    void trim(ItcBuffer& buffer) const;
 
+    std::vector<std::shared_ptr<ItcBuffer>> m_buffers;
+    std::vector<std::unique_ptr<SizeClass>> m_sizeClasses;
+    std::unique_ptr<std::atomic<std::uint32_t>[]> m_next;
+
+    const std::chrono::milliseconds m_timeout;
+
+    std::atomic<std::uint64_t> m_acquires;
+    std::atomic<std::uint64_t> m_waits;
+    std::atomic<std::uint64_t> m_timeouts;
+    std::atomic<std::uint64_t> m_waitMicros;
+    std::atomic<std::uint64_t> m_bytesRetained;
+    std::atomic<std::size_t> m_inUse;
+    std::atomic<std::size_t> m_peakInUse;
+
+    // Only used when the pool is exhausted.
+    std::atomic<std::size_t> m_waiters;
     std::mutex m_mutex;
     std::condition_variable m_cv;
 };
-
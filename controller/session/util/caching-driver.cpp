@@ -0,0 +1,203 @@
+#include "caching-driver.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+#include "util/disk-cache.hpp"
+
+namespace
+{
+    std::atomic<std::uint64_t> chunkFetches(0);
+    std::atomic<std::uint64_t> pinHits(0);
+    std::atomic<std::uint64_t> diskHits(0);
+    std::atomic<std::uint64_t> fetches(0);
+    std::atomic<std::uint64_t> fetchedBytes(0);
+    Histogram fetchTimes;
+
+    // Every live set of pins.  Sets are registered and unregistered with
+    // this locked, so a set found here stays alive while it remains locked.
+    std::mutex pinsMutex;
+    std::vector<CachingDriver::Pins*> allPins;
+
+    // Chunks are named by their numeric IDs, possibly with a numeric suffix
+    // for partial builds.
+    bool isChunk(const std::string& path)
+    {
+        const std::size_t slash(path.rfind('/'));
+        const std::string name(
+                slash == std::string::npos ? path : path.substr(slash + 1));
+
+        return
+            !name.empty() &&
+            std::isdigit(static_cast<unsigned char>(name.front())) &&
+            std::all_of(
+                name.begin(),
+                name.end(),
+                [](const char c)->bool
+                {
+                    return std::isdigit(static_cast<unsigned char>(c)) ||
+                        c == '-';
+                });
+    }
+}
+
+CachingDriver::Pins::Pins(std::string path)
+    : m_prefix(std::move(path))
+    , m_capturing(false)
+    , m_chunks()
+    , m_bytes(0)
+    , m_mutex()
+{
+    // As the keys of our drivers, which name local paths "file".
+    if (m_prefix.find("://") == std::string::npos)
+    {
+        m_prefix = "file://" + m_prefix;
+    }
+
+    if (m_prefix.back() != '/') m_prefix.push_back('/');
+
+    std::lock_guard<std::mutex> lock(pinsMutex);
+    allPins.push_back(this);
+}
+
+CachingDriver::Pins::~Pins()
+{
+    std::lock_guard<std::mutex> lock(pinsMutex);
+    allPins.erase(std::find(allPins.begin(), allPins.end(), this));
+}
+
+void CachingDriver::Pins::capture(const bool capturing)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_capturing = capturing;
+}
+
+std::size_t CachingDriver::Pins::chunks() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_chunks.size();
+}
+
+std::size_t CachingDriver::Pins::bytes() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_bytes;
+}
+
+bool CachingDriver::Pins::get(
+        const std::string& key,
+        std::vector<char>& data) const
+{
+    if (key.compare(0, m_prefix.size(), m_prefix)) return false;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const auto it(m_chunks.find(key));
+    if (it == m_chunks.end()) return false;
+
+    data = it->second;
+    return true;
+}
+
+void CachingDriver::Pins::offer(
+        const std::string& key,
+        const std::vector<char>& data)
+{
+    if (key.compare(0, m_prefix.size(), m_prefix)) return;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_capturing || m_chunks.count(key)) return;
+
+    m_chunks[key] = data;
+    m_bytes += data.size();
+}
+
+CachingDriver::CachingDriver(
+        const entwine::arbiter::Driver& inner,
+        DiskCache* cache)
+    : m_inner(inner)
+    , m_cache(cache)
+{ }
+
+std::string CachingDriver::type() const
+{
+    return m_inner.type();
+}
+
+void CachingDriver::put(std::string path, const std::vector<char>& data) const
+{
+    m_inner.put(path, data);
+}
+
+bool CachingDriver::isRemote() const
+{
+    return m_inner.isRemote();
+}
+
+CachingDriver::Stats CachingDriver::stats()
+{
+    Stats stats;
+
+    stats.chunkFetches = chunkFetches.load();
+    stats.pinHits = pinHits.load();
+    stats.diskHits = diskHits.load();
+    stats.fetches = fetches.load();
+    stats.fetchedBytes = fetchedBytes.load();
+    stats.fetchTimes = fetchTimes.snapshot();
+
+    return stats;
+}
+
+bool CachingDriver::get(std::string path, std::vector<char>& data) const
+{
+    const bool chunk(isChunk(path));
+    const bool caching(chunk && m_cache);
+    const std::string key(chunk ? type() + "://" + path : std::string());
+
+    if (chunk)
+    {
+        ++chunkFetches;
+
+        std::lock_guard<std::mutex> lock(pinsMutex);
+        for (const Pins* pins : allPins)
+        {
+            if (pins->get(key, data))
+            {
+                ++pinHits;
+                return true;
+            }
+        }
+    }
+
+    // Fetched or not, a chunk found here may be pinned.
+    auto pin([&key, &data]()->void
+    {
+        std::lock_guard<std::mutex> lock(pinsMutex);
+        for (Pins* pins : allPins) pins->offer(key, data);
+    });
+
+    if (caching && m_cache->get(key, data))
+    {
+        ++diskHits;
+        pin();
+        return true;
+    }
+
+    const auto start(std::chrono::steady_clock::now());
+    std::unique_ptr<std::vector<char>> fetched(m_inner.tryGetBinary(path));
+    if (!fetched) return false;
+
+    fetchTimes.record(std::chrono::steady_clock::now() - start);
+    ++fetches;
+    fetchedBytes += fetched->size();
+
+    if (caching) m_cache->insert(key, *fetched);
+
+    data.swap(*fetched);
+    if (chunk) pin();
+    return true;
+}
+
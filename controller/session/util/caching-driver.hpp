@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <entwine/third/arbiter/arbiter.hpp>
+
+#include "util/histogram.hpp"
+
+class DiskCache;
+
+// An arbiter driver which wraps another, counting and timing its fetches.
+// Chunk fetches through us are misses of the in-memory chunk cache above us.
+//
+// If given a DiskCache, the chunks of remote indexes are kept there, and are
+// fetched through the other driver only when they aren't found there.  Other
+// files, like index metadata, always go to the other driver.  Chunks are
+// assumed to be immutable, so a cache must be cleared if an index is rebuilt
+// in place.
+//
+// Chunks may also be pinned in memory by index, with Pins, ahead of either.
+class CachingDriver : public entwine::arbiter::Driver
+{
+public:
+    // The chunks of one index held in memory for as long as we live, which
+    // are served from here rather than fetched.  While capturing, each chunk
+    // of our index fetched through any CachingDriver is added to us.
+    class Pins
+    {
+    public:
+        // The path of an index, with or without its type prefix.
+        explicit Pins(std::string path);
+        ~Pins();
+
+        void capture(bool capturing);
+
+        std::size_t chunks() const;
+        std::size_t bytes() const;
+
+    private:
+        friend class CachingDriver;
+
+        // Keys are type-prefixed paths.
+        bool get(const std::string& key, std::vector<char>& data) const;
+        void offer(const std::string& key, const std::vector<char>& data);
+
+        std::string m_prefix;
+        bool m_capturing;
+        std::map<std::string, std::vector<char>> m_chunks;
+        std::size_t m_bytes;
+
+        mutable std::mutex m_mutex;
+
+        // Disallow copy/assignment.
+        Pins(const Pins&);
+        Pins& operator=(const Pins&);
+    };
+
+    struct Stats
+    {
+        Stats()
+            : chunkFetches(0)
+            , pinHits(0)
+            , diskHits(0)
+            , fetches(0)
+            , fetchedBytes(0)
+            , fetchTimes()
+        { }
+
+        // Chunks requested of us, and of those, the ones found pinned and
+        // the ones found on disk.
+        std::uint64_t chunkFetches;
+        std::uint64_t pinHits;
+        std::uint64_t diskHits;
+
+        // Successful fetches of any file through the other driver.
+        std::uint64_t fetches;
+        std::uint64_t fetchedBytes;
+        Histogram::Snapshot fetchTimes;
+    };
+
+    // The cache may be null.
+    CachingDriver(const entwine::arbiter::Driver& inner, DiskCache* cache);
+
+    virtual std::string type() const;
+    virtual void put(std::string path, const std::vector<char>& data) const;
+    virtual bool isRemote() const;
+
+    // Totals across all instances.
+    static Stats stats();
+
+protected:
+    virtual bool get(std::string path, std::vector<char>& data) const;
+
+private:
+    const entwine::arbiter::Driver& m_inner;
+    DiskCache* m_cache;
+};
+
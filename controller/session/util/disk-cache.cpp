@@ -0,0 +1,373 @@
+#include "disk-cache.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+    // Partially written files contain this, and are never indexed.
+    const std::string tempMarker(".tmp-");
+
+    // Each file begins with the length of its key, then the key itself.
+    typedef std::uint32_t KeySize;
+
+    // Our files are named by 64-bit hashes in hex, and anything else in our
+    // directory is left alone.
+    bool isOurs(const std::string& file)
+    {
+        const std::size_t size(file.find(tempMarker));
+
+        return
+            (size == std::string::npos ? file.size() : size) == 16 &&
+            std::all_of(
+                file.begin(),
+                file.begin() + 16,
+                [](const char c)->bool
+                {
+                    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f');
+                });
+    }
+
+    void makeDirs(const std::string& dir)
+    {
+        for (std::size_t pos(1); pos <= dir.size(); ++pos)
+        {
+            if (pos == dir.size() || dir[pos] == '/')
+            {
+                const std::string sub(dir.substr(0, pos));
+
+                if (mkdir(sub.c_str(), 0755) && errno != EEXIST)
+                {
+                    throw std::runtime_error(
+                            "Could not create disk cache at " + dir + ": " +
+                            std::strerror(errno));
+                }
+            }
+        }
+    }
+
+    bool writeAll(const int fd, const char* data, std::size_t size)
+    {
+        while (size)
+        {
+            const ssize_t written(::write(fd, data, size));
+
+            if (written < 0)
+            {
+                if (errno == EINTR) continue;
+                return false;
+            }
+
+            data += written;
+            size -= written;
+        }
+
+        return true;
+    }
+}
+
+DiskCache::DiskCache(const std::string& dir, const std::size_t maxBytes)
+    : m_dir(dir.size() && dir.back() == '/' ? dir : dir + '/')
+    , m_maxBytes(maxBytes)
+    , m_entries()
+    , m_index()
+    , m_bytes(0)
+    , m_hits(0)
+    , m_misses(0)
+    , m_inserts(0)
+    , m_evictions(0)
+    , m_nextTemp(0)
+    , m_mutex()
+{
+    if (dir.empty()) throw std::runtime_error("No disk cache path given");
+
+    makeDirs(m_dir);
+    rebuild();
+}
+
+bool DiskCache::get(const std::string& key, std::vector<char>& data)
+{
+    const std::string file(filename(key));
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    if (!m_index.count(file))
+    {
+        ++m_misses;
+        return false;
+    }
+
+    lock.unlock();
+
+    bool found(false);
+    const int fd(open(path(file).c_str(), O_RDONLY));
+    struct stat info;
+
+    if (fd >= 0 && !fstat(fd, &info) && info.st_size > 0)
+    {
+        const std::size_t size(info.st_size);
+        void* mapped(mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0));
+
+        if (mapped != MAP_FAILED)
+        {
+            const char* pos(static_cast<const char*>(mapped));
+            KeySize keySize(0);
+
+            if (size >= sizeof(KeySize))
+            {
+                std::memcpy(&keySize, pos, sizeof(KeySize));
+            }
+
+            const std::size_t header(sizeof(KeySize) + keySize);
+
+            // A different key means that its hash collided with ours.
+            if (
+                    size >= header &&
+                    key.size() == keySize &&
+                    std::equal(key.begin(), key.end(), pos + sizeof(KeySize)))
+            {
+                data.assign(pos + header, pos + size);
+                found = true;
+
+                // Persist our recency for the next rebuild.
+                futimens(fd, nullptr);
+            }
+
+            munmap(mapped, size);
+        }
+    }
+
+    if (fd >= 0) close(fd);
+
+    lock.lock();
+
+    auto it(m_index.find(file));
+
+    if (found)
+    {
+        ++m_hits;
+        if (it != m_index.end())
+        {
+            m_entries.splice(m_entries.begin(), m_entries, it->second);
+        }
+    }
+    else
+    {
+        ++m_misses;
+
+        // The file is gone or unreadable, so forget it.  A collision leaves
+        // the other key in place.
+        if (it != m_index.end() && fd < 0)
+        {
+            m_bytes -= it->second->bytes;
+            m_entries.erase(it->second);
+            m_index.erase(it);
+        }
+    }
+
+    return found;
+}
+
+void DiskCache::insert(const std::string& key, const std::vector<char>& data)
+{
+    const std::size_t bytes(sizeof(KeySize) + key.size() + data.size());
+    if (bytes > maxEntryBytes()) return;
+
+    const std::string file(filename(key));
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_index.count(file)) return;
+    lock.unlock();
+
+    const std::string temp(
+            path(file) + tempMarker + std::to_string(getpid()) + '-' +
+            std::to_string(m_nextTemp++));
+
+    const int fd(open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644));
+    if (fd < 0) return;
+
+    const KeySize keySize(key.size());
+
+    const bool written(
+            writeAll(
+                fd,
+                reinterpret_cast<const char*>(&keySize),
+                sizeof(KeySize)) &&
+            writeAll(fd, key.data(), key.size()) &&
+            writeAll(fd, data.data(), data.size()));
+
+    if (close(fd) || !written || rename(temp.c_str(), path(file).c_str()))
+    {
+        unlink(temp.c_str());
+        return;
+    }
+
+    lock.lock();
+
+    // Identical concurrent inserts may both miss - the file is the same
+    // either way.
+    if (m_index.count(file)) return;
+
+    m_entries.emplace_front(file, bytes);
+    m_index[file] = m_entries.begin();
+    m_bytes += bytes;
+    ++m_inserts;
+
+    const std::vector<std::string> doomed(evict());
+    lock.unlock();
+
+    remove(doomed);
+}
+
+DiskCache::Stats DiskCache::stats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    Stats stats;
+    stats.hits = m_hits;
+    stats.misses = m_misses;
+    stats.inserts = m_inserts;
+    stats.evictions = m_evictions;
+    stats.bytes = m_bytes;
+    stats.entries = m_entries.size();
+    stats.maxBytes = m_maxBytes;
+
+    return stats;
+}
+
+std::string DiskCache::filename(const std::string& key)
+{
+    // FNV-1a, which unlike std::hash is stable across builds, so our files
+    // remain valid after an upgrade.
+    std::uint64_t hash(14695981039346656037ull);
+
+    for (const char c : key)
+    {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ull;
+    }
+
+    static const char digits[] = "0123456789abcdef";
+
+    std::string result(16, '0');
+    for (std::size_t i(0); i < 16; ++i)
+    {
+        result[15 - i] = digits[(hash >> (i * 4)) & 0xf];
+    }
+
+    return result;
+}
+
+std::string DiskCache::path(const std::string& file) const
+{
+    return m_dir + file;
+}
+
+void DiskCache::rebuild()
+{
+    DIR* dir(opendir(m_dir.c_str()));
+
+    if (!dir)
+    {
+        throw std::runtime_error(
+                "Could not open disk cache at " + m_dir + ": " +
+                std::strerror(errno));
+    }
+
+    struct Found
+    {
+        Found(const std::string& file, std::size_t bytes, time_t time)
+            : file(file)
+            , bytes(bytes)
+            , time(time)
+        { }
+
+        std::string file;
+        std::size_t bytes;
+        time_t time;
+    };
+
+    std::vector<Found> found;
+    std::vector<std::string> partial;
+
+    while (const dirent* entry = readdir(dir))
+    {
+        const std::string file(entry->d_name);
+        if (!isOurs(file)) continue;
+
+        struct stat info;
+        if (stat(path(file).c_str(), &info) || !S_ISREG(info.st_mode))
+        {
+            continue;
+        }
+
+        if (file.find(tempMarker) != std::string::npos)
+        {
+            partial.push_back(file);
+        }
+        else
+        {
+            found.emplace_back(file, info.st_size, info.st_mtime);
+        }
+    }
+
+    closedir(dir);
+
+    remove(partial);
+
+    std::stable_sort(
+            found.begin(),
+            found.end(),
+            [](const Found& a, const Found& b)->bool
+            {
+                return a.time > b.time;
+            });
+
+    for (const Found& f : found)
+    {
+        m_entries.emplace_back(f.file, f.bytes);
+        m_index[f.file] = std::prev(m_entries.end());
+        m_bytes += f.bytes;
+    }
+
+    // Our budget may have shrunk since our last run.
+    remove(evict());
+
+    std::cout << "Disk cache at " << m_dir << ": " << m_entries.size() <<
+        " entries, " << m_bytes << " bytes" << std::endl;
+}
+
+std::vector<std::string> DiskCache::evict()
+{
+    std::vector<std::string> doomed;
+
+    while (m_bytes > m_maxBytes && !m_entries.empty())
+    {
+        const Entry& entry(m_entries.back());
+
+        m_bytes -= entry.bytes;
+        doomed.push_back(entry.file);
+
+        m_index.erase(entry.file);
+        m_entries.pop_back();
+        ++m_evictions;
+    }
+
+    return doomed;
+}
+
+void DiskCache::remove(const std::vector<std::string>& files) const
+{
+    for (const std::string& file : files) unlink(path(file).c_str());
+}
+
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// A byte-budgeted LRU cache of immutable objects in a local directory, which
+// survives restarts.  Each object is stored in its own file, named by a hash
+// of its key and prefixed by the key itself, so hash collisions are detected.
+// Files are written in full under a temporary name before being renamed into
+// place, so a crash never leaves a partial object behind.
+//
+// Our index is rebuilt at startup from a listing of the directory alone,
+// ordered by modification time, which is refreshed on every hit.
+class DiskCache
+{
+public:
+    struct Stats
+    {
+        Stats()
+            : hits(0)
+            , misses(0)
+            , inserts(0)
+            , evictions(0)
+            , bytes(0)
+            , entries(0)
+            , maxBytes(0)
+        { }
+
+        std::uint64_t hits;
+        std::uint64_t misses;
+        std::uint64_t inserts;
+        std::uint64_t evictions;
+        std::size_t bytes;
+        std::size_t entries;
+        std::size_t maxBytes;
+    };
+
+    // Creates the directory if necessary.  Throws if it can't be used.
+    DiskCache(const std::string& dir, std::size_t maxBytes);
+
+    // Returns true, and sets the data, if this key is cached.
+    bool get(const std::string& key, std::vector<char>& data);
+
+    // Objects larger than maxEntryBytes() are not cached, so a single large
+    // object can't flush everything else.
+    void insert(const std::string& key, const std::vector<char>& data);
+
+    std::size_t maxEntryBytes() const { return m_maxBytes / 8; }
+
+    Stats stats() const;
+
+private:
+    struct Entry
+    {
+        Entry(const std::string& file, std::size_t bytes)
+            : file(file)
+            , bytes(bytes)
+        { }
+
+        std::string file;
+        std::size_t bytes;
+    };
+
+    typedef std::list<Entry> Entries;
+
+    static std::string filename(const std::string& key);
+    std::string path(const std::string& file) const;
+
+    // Index the files already in our directory, and remove any partially
+    // written ones.
+    void rebuild();
+
+    // Drop least recently used entries while we are over budget, returning
+    // their files for removal once m_mutex is unlocked.
+    std::vector<std::string> evict();
+
+    void remove(const std::vector<std::string>& files) const;
+
+    const std::string m_dir;
+    const std::size_t m_maxBytes;
+
+    // Most recently used first, indexed by file name.
+    Entries m_entries;
+    std::unordered_map<std::string, Entries::iterator> m_index;
+    std::size_t m_bytes;
+
+    std::uint64_t m_hits;
+    std::uint64_t m_misses;
+    std::uint64_t m_inserts;
+    std::uint64_t m_evictions;
+
+    std::atomic<std::uint64_t> m_nextTemp;
+
+    mutable std::mutex m_mutex;
+
+    // Disallow copy/assignment.
+    DiskCache(const DiskCache&);
+    DiskCache& operator=(const DiskCache&);
+};
+
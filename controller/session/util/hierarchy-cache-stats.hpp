@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// The statistics of a HierarchyCache, apart from the cache itself so that
+// they may be passed around without its dependencies.
+struct HierarchyCacheStats
+{
+    HierarchyCacheStats()
+        : hits(0)
+        , truncatedHits(0)
+        , subtreeHits(0)
+        , misses(0)
+        , evictions(0)
+        , bytes(0)
+        , maxBytes(0)
+    { }
+
+    std::uint64_t hits;
+    std::uint64_t truncatedHits;
+    std::uint64_t subtreeHits;
+    std::uint64_t misses;
+    std::uint64_t evictions;
+    std::size_t bytes;
+    std::size_t maxBytes;
+};
@@ -0,0 +1,354 @@
+#include "hierarchy-cache.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+#include "binary-hierarchy.hpp"
+
+namespace
+{
+    // Parsed JSON trees take several times the space of their serialized
+    // form, so account for them accordingly.
+    const std::size_t treeOverhead(4);
+
+    std::string makeKey(
+            const entwine::Bounds& bounds,
+            const std::size_t depthBegin,
+            const std::size_t depthEnd,
+            const bool vertical,
+            const bool binary = false)
+    {
+        std::ostringstream ss;
+        ss.precision(17);
+
+        const entwine::Point& min(bounds.min());
+        const entwine::Point& max(bounds.max());
+
+        ss <<
+            min.x << ',' << min.y << ',' << min.z << ',' <<
+            max.x << ',' << max.y << ',' << max.z << ',' <<
+            depthBegin << ',' << depthEnd << ',' <<
+            vertical << ',' << binary;
+
+        return ss.str();
+    }
+
+    bool near(const double a, const double b, const double extent)
+    {
+        return std::abs(a - b) <= 1e-9 * std::max(extent, 1.0);
+    }
+
+    bool same(const entwine::Bounds& a, const entwine::Bounds& b)
+    {
+        const double extent(
+                std::max(
+                    std::max(a.max().x - a.min().x, a.max().y - a.min().y),
+                    a.max().z - a.min().z));
+
+        return
+            near(a.min().x, b.min().x, extent) &&
+            near(a.min().y, b.min().y, extent) &&
+            near(a.min().z, b.min().z, extent) &&
+            near(a.max().x, b.max().x, extent) &&
+            near(a.max().y, b.max().y, extent) &&
+            near(a.max().z, b.max().z, extent);
+    }
+
+    // Walk down from the node for the bounds "current", toward the bounds
+    // "target", which must lie "levels" bisections below it.  Returns null if
+    // the target is not a subtree of this node.
+    const Json::Value* descend(
+            const Json::Value& node,
+            entwine::Bounds current,
+            const entwine::Bounds& target,
+            const std::size_t levels)
+    {
+        const Json::Value* result(&node);
+
+        const entwine::Point tmid(target.mid());
+
+        // Quadtree-style hierarchies don't bisect Z.
+        const bool splitZ(
+                target.max().z - target.min().z <
+                0.75 * (current.max().z - current.min().z));
+
+        for (std::size_t i(0); i < levels; ++i)
+        {
+            const entwine::Point mid(current.mid());
+            entwine::Point min(current.min());
+            entwine::Point max(current.max());
+
+            std::string dir;
+
+            if (tmid.y >= mid.y) { dir += 'n'; min.y = mid.y; }
+            else { dir += 's'; max.y = mid.y; }
+
+            if (tmid.x >= mid.x) { dir += 'e'; min.x = mid.x; }
+            else { dir += 'w'; max.x = mid.x; }
+
+            if (splitZ)
+            {
+                if (tmid.z >= mid.z) { dir += 'u'; min.z = mid.z; }
+                else { dir += 'd'; max.z = mid.z; }
+            }
+
+            // Empty nodes are omitted, and we can't tell an empty node from
+            // one that has been truncated away, so fall back to the index.
+            if (!result->isMember(dir)) return nullptr;
+
+            result = &(*result)[dir];
+            current = entwine::Bounds(min, max);
+        }
+
+        return same(current, target) ? result : nullptr;
+    }
+
+    Json::Value truncate(const Json::Value& node, const std::size_t levels)
+    {
+        Json::Value result(Json::objectValue);
+
+        for (const std::string& key : node.getMemberNames())
+        {
+            if (key == "n") result[key] = node[key];
+            else if (levels > 1) result[key] = truncate(node[key], levels - 1);
+        }
+
+        return result;
+    }
+}
+
+HierarchyCache::HierarchyCache(const std::size_t maxBytes)
+    : m_maxBytes(maxBytes)
+    , m_bytes(0)
+    , m_entries()
+    , m_results()
+    , m_trees()
+    , m_hits(0)
+    , m_truncatedHits(0)
+    , m_subtreeHits(0)
+    , m_misses(0)
+    , m_evictions(0)
+    , m_mutex()
+{ }
+
+bool HierarchyCache::get(
+        const entwine::Bounds& bounds,
+        const std::size_t depthBegin,
+        const std::size_t depthEnd,
+        const bool vertical,
+        const bool binary,
+        std::string& result)
+{
+    if (depthEnd <= depthBegin) return false;
+
+    const std::string key(
+            makeKey(bounds, depthBegin, depthEnd, vertical, binary));
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    auto it(m_results.find(key));
+
+    if (it != m_results.end())
+    {
+        ++m_hits;
+        touch(it->second.entry);
+        result = it->second.data;
+        return true;
+    }
+
+    // Vertical results aren't laid out as nested nodes, so only their exact
+    // results are reused.
+    bool exact(false);
+    std::shared_ptr<const Json::Value> json;
+    if (!vertical) json = find(bounds, depthBegin, depthEnd, exact);
+
+    if (!json)
+    {
+        ++m_misses;
+        return false;
+    }
+
+    if (exact) ++m_truncatedHits;
+    else ++m_subtreeHits;
+
+    // Only the requested portion of the cached tree needs to be written.
+    lock.unlock();
+
+    const std::size_t depth(depthEnd - depthBegin);
+
+    if (binary)
+    {
+        result = BinaryHierarchy::encode(*json, depth);
+    }
+    else
+    {
+        Json::FastWriter writer;
+        result = writer.write(truncate(*json, depth));
+    }
+
+    lock.lock();
+    insertResult(key, result);
+    evict();
+
+    return true;
+}
+
+void HierarchyCache::insert(
+        const entwine::Bounds& bounds,
+        const std::size_t depthBegin,
+        const std::size_t depthEnd,
+        const bool vertical,
+        const bool binary,
+        Json::Value tree,
+        const std::string& result)
+{
+    if (depthEnd <= depthBegin) return;
+
+    const std::string key(
+            makeKey(bounds, depthBegin, depthEnd, vertical, binary));
+    const std::string treeKey(makeKey(bounds, depthBegin, 0, false));
+
+    // Binary results are several times smaller than the JSON they represent.
+    const std::size_t treeBytes(
+            result.size() * treeOverhead * (binary ? 4 : 1));
+
+    std::shared_ptr<const Json::Value> json(new Json::Value(std::move(tree)));
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    insertResult(key, result);
+
+    if (vertical)
+    {
+        evict();
+        return;
+    }
+
+    auto it(m_trees.find(treeKey));
+
+    // Keep whichever tree is deeper.
+    if (it != m_trees.end())
+    {
+        if (it->second.tree.depthEnd >= depthEnd)
+        {
+            touch(it->second.entry);
+            evict();
+            return;
+        }
+
+        m_bytes -= it->second.entry->bytes;
+        m_entries.erase(it->second.entry);
+        m_trees.erase(it);
+    }
+
+    if (treeBytes <= m_maxBytes / 4)
+    {
+        m_entries.emplace_front(true, treeKey, treeBytes);
+        m_trees.insert(
+                std::make_pair(
+                    treeKey,
+                    TreeEntry(
+                        Tree(bounds, depthBegin, depthEnd, json),
+                        m_entries.begin())));
+
+        m_bytes += treeBytes;
+    }
+
+    evict();
+}
+
+HierarchyCache::Stats HierarchyCache::stats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    Stats stats;
+
+    stats.hits = m_hits;
+    stats.truncatedHits = m_truncatedHits;
+    stats.subtreeHits = m_subtreeHits;
+    stats.misses = m_misses;
+    stats.evictions = m_evictions;
+    stats.bytes = m_bytes;
+    stats.maxBytes = m_maxBytes;
+
+    return stats;
+}
+
+std::shared_ptr<const Json::Value> HierarchyCache::find(
+        const entwine::Bounds& bounds,
+        const std::size_t depthBegin,
+        const std::size_t depthEnd,
+        bool& exact)
+{
+    auto it(m_trees.find(makeKey(bounds, depthBegin, 0, false)));
+
+    if (it != m_trees.end() && it->second.tree.depthEnd >= depthEnd)
+    {
+        exact = true;
+        touch(it->second.entry);
+        return it->second.tree.json;
+    }
+
+    for (auto& p : m_trees)
+    {
+        const Tree& tree(p.second.tree);
+
+        if (
+                tree.depthBegin < depthBegin &&
+                tree.depthEnd >= depthEnd)
+        {
+            const Json::Value* node(
+                    descend(
+                        *tree.json,
+                        tree.bounds,
+                        bounds,
+                        depthBegin - tree.depthBegin));
+
+            if (node)
+            {
+                exact = false;
+                touch(p.second.entry);
+
+                // Share ownership with the full tree.
+                return std::shared_ptr<const Json::Value>(tree.json, node);
+            }
+        }
+    }
+
+    return std::shared_ptr<const Json::Value>();
+}
+
+void HierarchyCache::insertResult(
+        const std::string& key,
+        const std::string& result)
+{
+    if (m_results.count(key) || result.size() > m_maxBytes / 4) return;
+
+    m_entries.emplace_front(false, key, result.size());
+    m_results.insert(
+            std::make_pair(key, Result(result, m_entries.begin())));
+
+    m_bytes += result.size();
+}
+
+void HierarchyCache::touch(const Entries::iterator entry)
+{
+    m_entries.splice(m_entries.begin(), m_entries, entry);
+}
+
+void HierarchyCache::evict()
+{
+    while (m_bytes > m_maxBytes && !m_entries.empty())
+    {
+        const Entry& entry(m_entries.back());
+
+        if (entry.isTree) m_trees.erase(entry.key);
+        else m_results.erase(entry.key);
+
+        m_bytes -= entry.bytes;
+        m_entries.pop_back();
+        ++m_evictions;
+    }
+}
+
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include <entwine/third/json/json.hpp>
+#include <entwine/types/bounds.hpp>
+
+#include "util/hierarchy-cache-stats.hpp"
+
+// Caches hierarchy query results for a single resource.  Finished responses
+// are cached by their exact parameters.  The point count trees behind them are
+// cached too, so a request for a shallower depth range, or for the bounds of
+// any subtree of a cached tree, is answered without querying the index.
+// Vertical results are not nested trees, so only their exact responses are
+// cached.
+class HierarchyCache
+{
+public:
+    typedef HierarchyCacheStats Stats;
+
+    explicit HierarchyCache(std::size_t maxBytes);
+
+    // Returns true, and sets the result, if this query can be answered from
+    // the cache.  The result is either stringified JSON or, if binary is set,
+    // in the format of BinaryHierarchy.
+    bool get(
+            const entwine::Bounds& bounds,
+            std::size_t depthBegin,
+            std::size_t depthEnd,
+            bool vertical,
+            bool binary,
+            std::string& result);
+
+    void insert(
+            const entwine::Bounds& bounds,
+            std::size_t depthBegin,
+            std::size_t depthEnd,
+            bool vertical,
+            bool binary,
+            Json::Value tree,
+            const std::string& result);
+
+    Stats stats() const;
+
+private:
+    struct Tree
+    {
+        Tree(
+                const entwine::Bounds& bounds,
+                std::size_t depthBegin,
+                std::size_t depthEnd,
+                std::shared_ptr<const Json::Value> json)
+            : bounds(bounds)
+            , depthBegin(depthBegin)
+            , depthEnd(depthEnd)
+            , json(json)
+        { }
+
+        entwine::Bounds bounds;
+        std::size_t depthBegin;
+        std::size_t depthEnd;
+        std::shared_ptr<const Json::Value> json;
+    };
+
+    // Entries of either type, in least-recently-used order.
+    struct Entry
+    {
+        Entry(bool isTree, const std::string& key, std::size_t bytes)
+            : isTree(isTree)
+            , key(key)
+            , bytes(bytes)
+        { }
+
+        bool isTree;
+        std::string key;
+        std::size_t bytes;
+    };
+
+    typedef std::list<Entry> Entries;
+
+    struct Result
+    {
+        Result(const std::string& data, Entries::iterator entry)
+            : data(data)
+            , entry(entry)
+        { }
+
+        std::string data;
+        Entries::iterator entry;
+    };
+
+    struct TreeEntry
+    {
+        TreeEntry(const Tree& tree, Entries::iterator entry)
+            : tree(tree)
+            , entry(entry)
+        { }
+
+        Tree tree;
+        Entries::iterator entry;
+    };
+
+    // Find a cached tree containing the requested subtree to the requested
+    // depth, and extract that subtree.  m_mutex must be locked by the caller.
+    std::shared_ptr<const Json::Value> find(
+            const entwine::Bounds& bounds,
+            std::size_t depthBegin,
+            std::size_t depthEnd,
+            bool& exact);
+
+    void insertResult(const std::string& key, const std::string& result);
+
+    void touch(Entries::iterator entry);
+    void evict();
+
+    const std::size_t m_maxBytes;
+    std::size_t m_bytes;
+
+    Entries m_entries;
+    std::map<std::string, Result> m_results;
+    std::map<std::string, TreeEntry> m_trees;
+
+    std::uint64_t m_hits;
+    std::uint64_t m_truncatedHits;
+    std::uint64_t m_subtreeHits;
+    std::uint64_t m_misses;
+    std::uint64_t m_evictions;
+
+    mutable std::mutex m_mutex;
+
+    // Disallow copy/assignment.
+    HierarchyCache(const HierarchyCache&);
+    HierarchyCache& operator=(const HierarchyCache&);
+};
+
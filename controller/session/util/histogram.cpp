@@ -0,0 +1,71 @@
+#include "histogram.hpp"
+
+const std::size_t Histogram::numBuckets;
+
+Histogram::Histogram()
+    : m_count(0)
+    , m_totalMicros(0)
+    , m_maxMicros(0)
+    , m_buckets()
+{
+    for (auto& bucket : m_buckets) bucket = 0;
+}
+
+void Histogram::record(const std::uint64_t micros)
+{
+    std::size_t bucket(0);
+    while (bucket < numBuckets - 1 && micros >= upperMicros(bucket)) ++bucket;
+
+    m_buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+    m_totalMicros.fetch_add(micros, std::memory_order_relaxed);
+
+    std::uint64_t max(m_maxMicros.load(std::memory_order_relaxed));
+    while (
+            micros > max &&
+            !m_maxMicros.compare_exchange_weak(
+                max,
+                micros,
+                std::memory_order_relaxed))
+    { }
+}
+
+Histogram::Snapshot Histogram::snapshot() const
+{
+    Snapshot snapshot;
+
+    snapshot.count = m_count.load(std::memory_order_relaxed);
+    snapshot.totalMicros = m_totalMicros.load(std::memory_order_relaxed);
+    snapshot.maxMicros = m_maxMicros.load(std::memory_order_relaxed);
+
+    for (std::size_t i(0); i < numBuckets; ++i)
+    {
+        snapshot.buckets[i] = m_buckets[i].load(std::memory_order_relaxed);
+    }
+
+    return snapshot;
+}
+
+std::uint64_t Histogram::Snapshot::quantile(const double q) const
+{
+    std::uint64_t total(0);
+    for (const std::uint64_t n : buckets) total += n;
+    if (!total) return 0;
+
+    const double target(q * total);
+    std::uint64_t seen(0);
+
+    for (std::size_t i(0); i < numBuckets; ++i)
+    {
+        seen += buckets[i];
+
+        if (seen >= target && buckets[i])
+        {
+            // Our last bucket has no upper bound of its own.
+            return i < numBuckets - 1 ? upperMicros(i) : maxMicros;
+        }
+    }
+
+    return maxMicros;
+}
+
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// A latency histogram cheap enough to leave on: recording is a handful of
+// relaxed atomic increments, with no locks.  Durations are counted in
+// power-of-two buckets of microseconds.
+class Histogram
+{
+public:
+    // Bucket i counts durations below 2^i microseconds, and the last bucket
+    // counts everything else.
+    static const std::size_t numBuckets = 32;
+
+    struct Snapshot
+    {
+        Snapshot() : count(0), totalMicros(0), maxMicros(0), buckets() { }
+
+        // The upper bound, in microseconds, of the bucket containing the
+        // given quantile, in [0, 1].
+        std::uint64_t quantile(double q) const;
+
+        std::uint64_t count;
+        std::uint64_t totalMicros;
+        std::uint64_t maxMicros;
+        std::array<std::uint64_t, numBuckets> buckets;
+    };
+
+    Histogram();
+
+    void record(std::uint64_t micros);
+
+    template<typename Duration>
+    void record(const Duration& d)
+    {
+        record(
+                static_cast<std::uint64_t>(
+                    std::chrono::duration_cast<std::chrono::microseconds>(d)
+                        .count()));
+    }
+
+    // Not atomic as a whole, so concurrent records may be partially seen.
+    Snapshot snapshot() const;
+
+    static std::uint64_t upperMicros(std::size_t bucket)
+    {
+        return std::uint64_t(1) << bucket;
+    }
+
+private:
+    std::atomic<std::uint64_t> m_count;
+    std::atomic<std::uint64_t> m_totalMicros;
+    std::atomic<std::uint64_t> m_maxMicros;
+    std::array<std::atomic<std::uint64_t>, numBuckets> m_buckets;
+
+    // Disallow copy/assignment.
+    Histogram(const Histogram&);
+    Histogram& operator=(const Histogram&);
+};
+
@@ -1,7 +1,8 @@
 #pragma once
 
-#include <mutex>
 #include <condition_variable>
+#include <functional>
+#include <mutex>
 
 // The Once class allows concurrent users of a shared session to avoid
 // duplicating work, while hiding the shared aspect of the session from callers.
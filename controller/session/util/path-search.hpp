@@ -0,0 +1,149 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "util/task-pool.hpp"
+
+// A search of several paths, in order of priority, for something which may
+// be found at more than one of them.  Every path is probed at once on the
+// given pool, since each probe is mostly spent waiting on remote metadata,
+// but the result is that of the first path to succeed in order of priority.
+// Probes which haven't started by the time that result is known don't
+// bother.
+//
+// A hint, such as where the same thing was last found, only decides which
+// probe is started first.  It never outranks a path of higher priority.
+template<typename T>
+class PathSearch
+{
+public:
+    // Open whatever is at a path, or throw.
+    typedef std::function<std::unique_ptr<T>(const std::string& path)> Open;
+
+    PathSearch(
+            TaskPool& pool,
+            const std::vector<std::string>& paths,
+            const std::string& hint,
+            Open open)
+        : m_state(std::make_shared<State>(paths.size()))
+    {
+        std::vector<std::size_t> order;
+
+        for (std::size_t i(0); i < paths.size(); ++i)
+        {
+            if (paths[i] == hint) order.insert(order.begin(), i);
+            else order.push_back(i);
+        }
+
+        // Probes may outlive us, so they share our state.
+        std::shared_ptr<State> state(m_state);
+
+        for (const std::size_t i : order)
+        {
+            const std::string path(paths[i]);
+            pool.add([state, i, path, open]()->void
+            {
+                state->probe(i, path, open);
+            });
+        }
+    }
+
+    ~PathSearch()
+    {
+        std::lock_guard<std::mutex> lock(m_state->mutex);
+        m_state->found = true;
+    }
+
+    // Wait for the probe of the path at index i to finish, returning what
+    // was found there, or null with its error set.  Callers wait on each
+    // path in order until something is found, after which the probes which
+    // haven't started are abandoned.
+    std::unique_ptr<T> wait(const std::size_t i, std::string& err)
+    {
+        std::unique_lock<std::mutex> lock(m_state->mutex);
+        Probe& probe(m_state->probes[i]);
+
+        m_state->cv.wait(lock, [&probe]()->bool { return probe.done; });
+
+        err = probe.err;
+        if (probe.result) m_state->found = true;
+        return std::move(probe.result);
+    }
+
+private:
+    struct Probe
+    {
+        Probe() : result(), err(), done(false) { }
+
+        std::unique_ptr<T> result;
+        std::string err;
+        bool done;
+    };
+
+    struct State
+    {
+        explicit State(std::size_t numPaths)
+            : probes(numPaths)
+            , found(false)
+            , mutex()
+            , cv()
+        { }
+
+        void probe(std::size_t i, const std::string& path, const Open& open)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            Probe& probe(probes[i]);
+
+            if (!found)
+            {
+                lock.unlock();
+
+                std::unique_ptr<T> result;
+                std::string err;
+
+                try
+                {
+                    result = open(path);
+                    if (!result) err = "not found";
+                }
+                catch (const std::exception& e)
+                {
+                    err = e.what();
+                }
+                catch (...)
+                {
+                    err = "unknown error";
+                }
+
+                lock.lock();
+                probe.result = std::move(result);
+                probe.err = err;
+            }
+            else
+            {
+                probe.err = "cancelled";
+            }
+
+            probe.done = true;
+            cv.notify_all();
+        }
+
+        std::vector<Probe> probes;
+        bool found;
+
+        std::mutex mutex;
+        std::condition_variable cv;
+    };
+
+    std::shared_ptr<State> m_state;
+
+    // Disallow copy/assignment.
+    PathSearch(const PathSearch&);
+    PathSearch& operator=(const PathSearch&);
+};
@@ -0,0 +1,157 @@
+#include "util/prefetcher.hpp"
+
+#include "util/task-pool.hpp"
+
+Prefetcher::Prefetcher(
+        TaskPool& pool,
+        const std::vector<bool>& done,
+        const std::size_t depth,
+        const Read read)
+    : m_pool(pool)
+    , m_depth(depth)
+    , m_read(read)
+    , m_sources()
+    , m_current(0)
+    , m_reading(0)
+    , m_buffered(0)
+    , m_spare()
+    , m_cancelled(false)
+    , m_error()
+    , m_mutex()
+    , m_cv()
+{
+    // Reads refer to their sources, so these must never move.
+    m_sources.reserve(done.size());
+    for (const bool d : done) m_sources.emplace_back(d);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    skip();
+    schedule();
+}
+
+Prefetcher::~Prefetcher()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_cancelled = true;
+    m_cv.wait(lock, [this]()->bool { return !m_reading; });
+}
+
+void Prefetcher::cancel()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_cancelled = true;
+}
+
+bool Prefetcher::next(std::vector<char>& data)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (true)
+    {
+        skip();
+        schedule();
+
+        if (m_error) std::rethrow_exception(m_error);
+        if (m_current == m_sources.size()) return true;
+        if (!m_sources[m_current].ready.empty()) break;
+        if (m_cancelled && !m_reading) return true;
+
+        m_cv.wait(lock);
+    }
+
+    Source& source(m_sources[m_current]);
+
+    // Swap rather than copy, and recycle the previous storage of data for a
+    // subsequent read.
+    std::vector<char> previous;
+    previous.swap(data);
+    data.swap(source.ready.front());
+    source.ready.pop_front();
+    --m_buffered;
+
+    if (m_spare.size() < m_depth) m_spare.push_back(std::move(previous));
+
+    skip();
+    schedule();
+
+    return m_current == m_sources.size();
+}
+
+void Prefetcher::skip()
+{
+    while (m_current < m_sources.size())
+    {
+        const Source& source(m_sources[m_current]);
+        if (!source.done || !source.ready.empty()) return;
+        ++m_current;
+    }
+}
+
+void Prefetcher::schedule()
+{
+    if (m_cancelled || m_error) return;
+
+    for (std::size_t i(m_current); i < m_sources.size(); ++i)
+    {
+        if (m_reading + m_buffered >= m_depth) return;
+
+        Source& source(m_sources[i]);
+
+        if (!source.reading && !source.done)
+        {
+            source.reading = true;
+            ++m_reading;
+            m_pool.add([this, i]()->void { fetch(i); });
+        }
+    }
+}
+
+void Prefetcher::fetch(const std::size_t index)
+{
+    Source& source(m_sources[index]);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    std::vector<char> data;
+
+    if (!m_spare.empty())
+    {
+        data.swap(m_spare.back());
+        m_spare.pop_back();
+    }
+
+    lock.unlock();
+
+    bool done(false);
+    std::exception_ptr error;
+
+    try
+    {
+        data.clear();
+        done = m_read(index, data);
+    }
+    catch (...)
+    {
+        error = std::current_exception();
+    }
+
+    lock.lock();
+
+    if (error)
+    {
+        m_error = error;
+    }
+    else
+    {
+        source.ready.push_back(std::move(data));
+        ++m_buffered;
+    }
+
+    source.done = done;
+    source.reading = false;
+    --m_reading;
+    schedule();
+
+    // Notify while locked, since our destructor may be waiting to run as
+    // soon as our last read is done.
+    m_cv.notify_all();
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+class TaskPool;
+
+// Reads chunks from a sequence of sources ahead of their consumer, which
+// receives them in order: every chunk of the first source, then every chunk
+// of the next, and so on.  Separate sources are read concurrently on the
+// given pool, but each source has at most one read in progress.
+//
+// Reads in progress and chunks read but not yet delivered, across all
+// sources, are together limited to the given depth.
+class Prefetcher
+{
+public:
+    // Read the next chunk of a source into data, which arrives empty,
+    // returning true if the source has nothing more to read.  Errors are
+    // thrown, and are rethrown to the consumer.
+    typedef std::function<bool(std::size_t source, std::vector<char>& data)>
+        Read;
+
+    // Sources marked in done have nothing to read at all.  The depth must be
+    // non-zero.
+    Prefetcher(
+            TaskPool& pool,
+            const std::vector<bool>& done,
+            std::size_t depth,
+            Read read);
+
+    // Outstanding reads refer to us, so this waits for them to finish.
+    ~Prefetcher();
+
+    // Swap the next chunk into data, blocking until it has been read.  The
+    // previous contents of data may be recycled for a subsequent read.
+    // Returns true once nothing remains to be delivered, in which case data
+    // may not have been touched.
+    bool next(std::vector<char>& data);
+
+    // Stop reading.  Reads in progress are finished, after which next()
+    // reports that nothing remains.
+    void cancel();
+
+private:
+    struct Source
+    {
+        explicit Source(bool done)
+            : ready()
+            , reading(false)
+            , done(done)
+        { }
+
+        std::deque<std::vector<char>> ready;
+        bool reading;
+        bool done;
+    };
+
+    // Move on from any leading sources with nothing left to deliver.
+    // m_mutex must be locked by the caller.
+    void skip();
+
+    // Start reads while we have room for more data.  Sources are considered
+    // from the one being delivered, so that it claims any room first and
+    // can't be starved by those ahead of it.  m_mutex must be locked by the
+    // caller.
+    void schedule();
+
+    // Runs on the pool.
+    void fetch(std::size_t index);
+
+    TaskPool& m_pool;
+    const std::size_t m_depth;
+    const Read m_read;
+
+    std::vector<Source> m_sources;
+
+    // Index of the source being delivered.
+    std::size_t m_current;
+
+    // Reads in progress, and chunks read but not yet delivered.
+    std::size_t m_reading;
+    std::size_t m_buffered;
+
+    std::vector<std::vector<char>> m_spare;
+    bool m_cancelled;
+    std::exception_ptr m_error;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+
+    // Disallow copy/assignment.
+    Prefetcher(const Prefetcher&);
+    Prefetcher& operator=(const Prefetcher&);
+};
@@ -0,0 +1,113 @@
+#include "read-cache.hpp"
+
+ReadCache::ReadCache(const std::size_t maxBytes)
+    : m_maxBytes(maxBytes)
+    , m_entries()
+    , m_index()
+    , m_bytes(0)
+    , m_hits(0)
+    , m_misses(0)
+    , m_inserts(0)
+    , m_evictions(0)
+    , m_mutex()
+{ }
+
+std::shared_ptr<const ReadCache::Chunks> ReadCache::get(const std::string& key)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it(m_index.find(key));
+
+    if (it == m_index.end())
+    {
+        ++m_misses;
+        return std::shared_ptr<const Chunks>();
+    }
+
+    ++m_hits;
+    m_entries.splice(m_entries.begin(), m_entries, it->second);
+
+    return it->second->chunks;
+}
+
+void ReadCache::insert(
+        const std::string& resource,
+        const std::string& key,
+        std::unique_ptr<Chunks> chunks)
+{
+    std::size_t bytes(0);
+    for (const auto& chunk : *chunks) bytes += chunk.size();
+
+    if (!bytes || bytes > maxEntryBytes()) return;
+
+    std::shared_ptr<const Chunks> shared(chunks.release());
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // Identical concurrent reads may both miss - the first one wins.
+    if (m_index.count(key)) return;
+
+    m_entries.emplace_front(resource, key, shared, bytes);
+    m_index[key] = m_entries.begin();
+    m_bytes += bytes;
+    ++m_inserts;
+
+    evict();
+}
+
+void ReadCache::purge(const std::string& resource)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it(m_entries.begin());
+
+    while (it != m_entries.end())
+    {
+        if (it->resource == resource)
+        {
+            m_bytes -= it->bytes;
+            m_index.erase(it->key);
+            it = m_entries.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+ReadCache::Stats ReadCache::stats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    Stats stats;
+
+    stats.hits = m_hits;
+    stats.misses = m_misses;
+    stats.inserts = m_inserts;
+    stats.evictions = m_evictions;
+    stats.bytes = m_bytes;
+    stats.entries = m_entries.size();
+    stats.maxBytes = m_maxBytes;
+
+    for (const Entry& entry : m_entries)
+    {
+        stats.resourceBytes[entry.resource] += entry.bytes;
+    }
+
+    return stats;
+}
+
+void ReadCache::evict()
+{
+    while (m_bytes > m_maxBytes && !m_entries.empty())
+    {
+        const Entry& entry(m_entries.back());
+
+        m_bytes -= entry.bytes;
+        m_index.erase(entry.key);
+        m_entries.pop_back();
+        ++m_evictions;
+    }
+}
+
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// A byte-budgeted LRU cache of finished read responses.  Each entry holds the
+// exact sequence of chunks streamed for a read, including the trailing point
+// count, so a hit may be replayed without touching the backing resource.
+class ReadCache
+{
+public:
+    typedef std::vector<std::vector<char>> Chunks;
+
+    struct Stats
+    {
+        Stats()
+            : hits(0)
+            , misses(0)
+            , inserts(0)
+            , evictions(0)
+            , bytes(0)
+            , entries(0)
+            , maxBytes(0)
+            , resourceBytes()
+        { }
+
+        std::uint64_t hits;
+        std::uint64_t misses;
+        std::uint64_t inserts;
+        std::uint64_t evictions;
+        std::size_t bytes;
+        std::size_t entries;
+        std::size_t maxBytes;
+        std::map<std::string, std::size_t> resourceBytes;
+    };
+
+    // A maxBytes of zero disables caching.
+    explicit ReadCache(std::size_t maxBytes);
+
+    std::shared_ptr<const Chunks> get(const std::string& key);
+
+    // Responses larger than maxEntryBytes() are not cached, so a single large
+    // read can't flush everything else.
+    void insert(
+            const std::string& resource,
+            const std::string& key,
+            std::unique_ptr<Chunks> chunks);
+
+    // Drop every entry for the given resource.
+    void purge(const std::string& resource);
+
+    std::size_t maxEntryBytes() const { return m_maxBytes / 8; }
+
+    Stats stats() const;
+
+private:
+    struct Entry
+    {
+        Entry(
+                const std::string& resource,
+                const std::string& key,
+                std::shared_ptr<const Chunks> chunks,
+                std::size_t bytes)
+            : resource(resource)
+            , key(key)
+            , chunks(chunks)
+            , bytes(bytes)
+        { }
+
+        std::string resource;
+        std::string key;
+        std::shared_ptr<const Chunks> chunks;
+        std::size_t bytes;
+    };
+
+    typedef std::list<Entry> Entries;
+
+    // Remove least recently used entries until we are within our budget.
+    // m_mutex must be locked by the caller.
+    void evict();
+
+    const std::size_t m_maxBytes;
+
+    // Most recently used entries are at the front.
+    Entries m_entries;
+    std::unordered_map<std::string, Entries::iterator> m_index;
+    std::size_t m_bytes;
+
+    std::uint64_t m_hits;
+    std::uint64_t m_misses;
+    std::uint64_t m_inserts;
+    std::uint64_t m_evictions;
+
+    mutable std::mutex m_mutex;
+
+    // Disallow copy/assignment.
+    ReadCache(const ReadCache&);
+    ReadCache& operator=(const ReadCache&);
+};
+
@@ -0,0 +1,547 @@
+#include "read-driver.hpp"
+
+#include <cstring>
+
+#include <entwine/reader/reader.hpp>
+#include <entwine/third/json/json.hpp>
+
+#include "session.hpp"
+#include "util/buffer-pool.hpp"
+#include "util/read-scheduler.hpp"
+#include "util/task-pool.hpp"
+
+namespace
+{
+    // Maximum number of chunks read in a single step before yielding the
+    // read pool to other reads.
+    const std::size_t readsPerStep(4);
+
+    std::uint64_t microsSince(const std::chrono::steady_clock::time_point t)
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - t).count();
+    }
+}
+
+ReadDriver::ReadDriver(
+        std::shared_ptr<Session> session,
+        ItcBufferPool& itcBufferPool,
+        ReadCache& readCache,
+        TaskPool& readPool,
+        ReadScheduler& readScheduler,
+        const QueryLimits& limits,
+        Params params,
+        Sink& sink)
+    : m_session(session)
+    , m_itcBufferPool(itcBufferPool)
+    , m_readCache(readCache)
+    , m_readPool(readPool)
+    , m_readScheduler(readScheduler)
+    , m_limits(limits)
+    , m_params(std::move(params))
+    , m_sink(sink)
+    , m_code(200)
+    , m_message()
+    , m_retryAfter(0)
+    , m_readQuery()
+    , m_itcBuffer()
+    , m_sizeHint(0)
+    , m_cacheKey()
+    , m_cached()
+    , m_cachedIndex(0)
+    , m_recording()
+    , m_recordedBytes(0)
+    , m_ticket(0)
+    , m_queued()
+    , m_state(State::Query)
+    , m_parked(false)
+    , m_chunks()
+    , m_inFlight(0)
+    , m_paused(false)
+    , m_delivering(false)
+    , m_ended(false)
+    , m_created(Clock::now())
+    , m_queueMicros(0)
+    , m_queryMicros(0)
+    , m_pendingMicros(0)
+    , m_deliverMicros(0)
+    , m_deliveredBytes(0)
+    , m_deliveredChunks(0)
+    , m_terminate(false)
+    , m_mutex()
+{ }
+
+ReadDriver::~ReadDriver()
+{
+    if (m_itcBuffer) m_itcBufferPool.release(m_itcBuffer);
+    for (Chunk& chunk : m_chunks) m_itcBufferPool.release(chunk.itcBuffer);
+    if (m_ticket) m_readScheduler.release(m_ticket);
+}
+
+void ReadDriver::start()
+{
+    schedule();
+}
+
+void ReadDriver::schedule()
+{
+    std::shared_ptr<ReadDriver> self(shared_from_this());
+    m_readPool.add([self]()->void { self->step(); });
+}
+
+void ReadDriver::step()
+{
+    if (m_state == State::Query) stepQuery();
+    else stepRead();
+}
+
+void ReadDriver::stepQuery()
+{
+    try
+    {
+        // Reads served from the response cache don't need admission.
+        // Otherwise, we may have to wait our turn, in which case the
+        // scheduler steps us back here with our ticket set.
+        if (!m_ticket && !lookup() && !admit()) return;
+
+        // Our consumer may have gone away while we were queued.
+        if (ok() && !m_cached && !terminated()) run();
+    }
+    catch (entwine::InvalidQuery& e)
+    {
+        fail(400, e.what());
+    }
+    catch (WrongQueryType& e)
+    {
+        fail(400, e.what());
+    }
+    catch (std::runtime_error& e)
+    {
+        fail(500, e.what());
+    }
+    catch (...)
+    {
+        fail(500, "Error during query");
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_state = State::Init;
+    m_sink.wake();
+}
+
+void ReadDriver::stepRead()
+{
+    try
+    {
+        for (
+                std::size_t i(0);
+                i < readsPerStep && !terminated() && !finished();
+                ++i)
+        {
+            // Each chunk is given away to our consumer, so we need fresh
+            // storage for every read.  Chunks from a single query tend to be
+            // similarly sized, so the size of our previous chunk is used to
+            // pick a buffer.
+            if (!m_itcBuffer)
+            {
+                m_itcBuffer = m_itcBufferPool.acquire(m_sizeHint);
+            }
+
+            read();
+
+            // Once parked, we may be resumed at any time.
+            if (!push()) return;
+        }
+    }
+    catch (std::runtime_error& e)
+    {
+        fail(500, e.what());
+    }
+    catch (...)
+    {
+        fail(500, "Error during query");
+    }
+
+    if (terminated() || finished() || !ok()) finish();
+    else schedule();
+}
+
+bool ReadDriver::lookup()
+{
+    m_cacheKey = cacheKey();
+    if (!m_cacheKey.empty()) m_cached = m_readCache.get(m_cacheKey);
+    return static_cast<bool>(m_cached);
+}
+
+bool ReadDriver::admit()
+{
+    std::uint64_t points(0);
+
+    try
+    {
+        if (m_params.indexed)
+        {
+            points = m_session->estimatePoints(
+                    m_params.bounds.get(),
+                    m_params.depthBegin,
+                    m_params.depthEnd);
+        }
+    }
+    catch (...)
+    {
+        // Let the query itself report any problems.
+    }
+
+    // The scheduler holds its start function until our ticket is released,
+    // which happens when we are destroyed, so it mustn't keep us alive.
+    // Until we are started, we hold ourselves.
+    m_queued = shared_from_this();
+    std::weak_ptr<ReadDriver> weak(m_queued);
+
+    const ReadScheduler::Admission admission(
+            m_readScheduler.submit(
+                m_session->name(),
+                points,
+                [weak]()->void
+                {
+                    std::shared_ptr<ReadDriver> self(weak.lock());
+                    if (!self) return;
+
+                    self->m_queued.reset();
+                    self->schedule();
+                },
+                m_ticket,
+                m_retryAfter));
+
+    if (admission != ReadScheduler::Admission::Queued) m_queued.reset();
+
+    if (admission == ReadScheduler::Admission::Rejected)
+    {
+        fail(503, "Too many reads in progress");
+    }
+
+    return admission != ReadScheduler::Admission::Queued;
+}
+
+void ReadDriver::run()
+{
+    if (!m_cacheKey.empty()) m_recording.reset(new ReadCache::Chunks());
+
+    m_queueMicros = microsSince(m_created);
+    const Clock::time_point start(Clock::now());
+
+    std::shared_ptr<ReadQuery> readQuery;
+
+    if (m_params.indexed)
+    {
+        readQuery = m_session->query(
+                m_params.schema,
+                m_params.compress,
+                m_params.scale,
+                m_params.offset,
+                m_params.bounds.get(),
+                m_params.depthBegin,
+                m_params.depthEnd,
+                m_limits);
+    }
+    else
+    {
+        readQuery = m_session->query(m_params.schema, m_params.compress);
+    }
+
+    readQuery->batch(m_limits.batchBytes(), m_limits.maxBatchBytes());
+
+    m_queryMicros = microsSince(start);
+
+    // We may be terminated from the consumer's thread at any time, so
+    // publish our query under our lock, and cancel it if we were terminated
+    // while it was being built.
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_readQuery = readQuery;
+    const bool terminated(m_terminate);
+    lock.unlock();
+
+    if (terminated) readQuery->cancel();
+}
+
+void ReadDriver::read()
+{
+    if (m_cached)
+    {
+        const std::vector<char>& chunk((*m_cached)[m_cachedIndex++]);
+
+        m_itcBuffer->resize(0);
+        m_itcBuffer->push(chunk.data(), chunk.size());
+    }
+    else
+    {
+        m_readQuery->read(*m_itcBuffer);
+        record();
+    }
+}
+
+void ReadDriver::record()
+{
+    if (!m_recording) return;
+
+    m_recordedBytes += m_itcBuffer->size();
+
+    if (m_recordedBytes > m_readCache.maxEntryBytes())
+    {
+        m_recording.reset();
+        return;
+    }
+
+    m_recording->push_back(m_itcBuffer->vecRef());
+
+    // A terminated query may finish early, so only complete responses are
+    // cached.
+    if (m_readQuery->done() && !terminated())
+    {
+        m_readCache.insert(
+                m_session->name(),
+                m_cacheKey,
+                std::move(m_recording));
+    }
+}
+
+bool ReadDriver::push()
+{
+    const bool last(finished());
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_chunks.emplace_back(m_itcBuffer, last);
+    m_sizeHint = m_itcBuffer->size();
+    m_itcBuffer.reset();
+    ++m_inFlight;
+
+    m_sink.wake();
+
+    // Parking and delivery both happen under our lock, so our consumer can't
+    // miss that we need resuming.
+    if (!last && m_inFlight >= m_limits.pipelineDepth() && !m_terminate)
+    {
+        m_parked = true;
+        return false;
+    }
+
+    return true;
+}
+
+void ReadDriver::finish()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_state = State::Done;
+    m_sink.wake();
+}
+
+void ReadDriver::service()
+{
+    if (m_delivering) return;
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    const bool initializing(m_state == State::Init);
+    lock.unlock();
+
+    if (initializing) init();
+    else deliver();
+}
+
+void ReadDriver::init()
+{
+    // Our consumer may have gone away while our query was built.
+    if (!terminated())
+    {
+        m_delivering = true;
+        m_sink.status(m_code, m_message, m_retryAfter);
+        m_delivering = false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (!ok() || m_terminate)
+    {
+        m_state = State::Done;
+        m_ended = true;
+        return;
+    }
+
+    m_state = State::Read;
+    schedule();
+}
+
+void ReadDriver::deliver()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    std::deque<Chunk> chunks;
+    chunks.swap(m_chunks);
+    lock.unlock();
+
+    m_delivering = true;
+
+    std::size_t delivered(0);
+
+    for (Chunk& chunk : chunks)
+    {
+        // Hold on to the rest until we're resumed.  The chunks stay in
+        // flight, so our reading parks once the pipeline is full.
+        if (m_paused && !terminated()) break;
+
+        ++delivered;
+
+        if (terminated())
+        {
+            // Our consumer has gone away, so don't bother it with anything
+            // that was read in the meantime.
+            m_itcBufferPool.release(chunk.itcBuffer);
+            continue;
+        }
+
+        const Clock::time_point start(Clock::now());
+        m_pendingMicros += microsSince(chunk.pushed);
+        m_deliveredBytes += chunk.itcBuffer->size();
+        ++m_deliveredChunks;
+
+        if (chunk.done) m_ended = true;
+        if (!m_sink.data(chunk.itcBuffer, chunk.done)) terminate();
+
+        m_deliverMicros += microsSince(start);
+    }
+
+    m_delivering = false;
+
+    lock.lock();
+
+    // Anything held back goes ahead of whatever was pushed in the meantime.
+    m_chunks.insert(m_chunks.begin(), chunks.begin() + delivered, chunks.end());
+    m_inFlight -= delivered;
+
+    if (m_parked && (m_inFlight < m_limits.pipelineDepth() || m_terminate))
+    {
+        m_parked = false;
+        schedule();
+    }
+
+    // A read that fails once its response has begun ends with its error,
+    // after everything read beforehand has been delivered.
+    const bool failed(
+            m_state == State::Done &&
+            !ok() &&
+            !m_inFlight &&
+            !m_terminate &&
+            !m_ended);
+
+    if (!failed) return;
+
+    m_ended = true;
+    lock.unlock();
+
+    m_delivering = true;
+    m_sink.error(m_code, m_message);
+    m_delivering = false;
+}
+
+void ReadDriver::resume()
+{
+    m_paused = false;
+    service();
+}
+
+void ReadDriver::cancel()
+{
+    terminate();
+    resume();
+}
+
+bool ReadDriver::complete() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_state == State::Done && !m_inFlight;
+}
+
+bool ReadDriver::terminated() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_terminate;
+}
+
+void ReadDriver::terminate()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_terminate = true;
+    std::shared_ptr<ReadQuery> readQuery(m_readQuery);
+    lock.unlock();
+
+    if (readQuery) readQuery->cancel();
+}
+
+std::string ReadDriver::cacheKey() const
+{
+    if (!m_params.indexed) return std::string();
+
+    // Object members are written in sorted order, so equivalent reads map
+    // to the same key regardless of how their parameters were specified.
+    Json::Value json;
+
+    json["resource"] = m_session->name();
+    json["schema"] = m_params.schema.toJson();
+    json["compress"] = static_cast<Json::Int>(m_params.compress);
+    json["scale"] = m_params.scale;
+    json["offset"].append(m_params.offset.x);
+    json["offset"].append(m_params.offset.y);
+    json["offset"].append(m_params.offset.z);
+    if (m_params.bounds) json["bounds"] = m_params.bounds->toJson();
+    json["depthBegin"] = static_cast<Json::UInt64>(m_params.depthBegin);
+    json["depthEnd"] = static_cast<Json::UInt64>(m_params.depthEnd);
+
+    // Cached responses are replayed in the chunks they were recorded in, so
+    // reads batched differently mustn't share them.
+    json["batchBytes"] = static_cast<Json::UInt64>(m_limits.batchBytes());
+    json["maxBatchBytes"] =
+        static_cast<Json::UInt64>(m_limits.maxBatchBytes());
+
+    Json::FastWriter writer;
+    return writer.write(json);
+}
+
+std::string ReadDriver::timing(const ItcBuffer& last) const
+{
+    Json::Value json;
+
+    json["cached"] = static_cast<bool>(m_cached);
+    json["queueMicros"] = static_cast<Json::UInt64>(m_queueMicros);
+    json["queryMicros"] = static_cast<Json::UInt64>(m_queryMicros);
+
+    if (m_readQuery)
+    {
+        const ReadQuery::Timing t(m_readQuery->timing());
+
+        json["readMicros"] = static_cast<Json::UInt64>(t.readMicros);
+        json["chunkMicros"] = static_cast<Json::UInt64>(t.chunkMicros);
+        json["transcodeMicros"] = static_cast<Json::UInt64>(t.transcodeMicros);
+        json["compressMicros"] = static_cast<Json::UInt64>(t.compressMicros);
+    }
+
+    json["pendingMicros"] = static_cast<Json::UInt64>(m_pendingMicros);
+    json["deliverMicros"] = static_cast<Json::UInt64>(m_deliverMicros);
+    json["totalMicros"] = static_cast<Json::UInt64>(microsSince(m_created));
+
+    json["chunks"] = static_cast<Json::UInt64>(m_deliveredChunks);
+    json["bytes"] = static_cast<Json::UInt64>(m_deliveredBytes);
+
+    // Every response ends with its point count.
+    const std::vector<char>& data(last.vecRef());
+    if (data.size() >= sizeof(uint32_t))
+    {
+        uint32_t points(0);
+        std::memcpy(
+                &points,
+                data.data() + data.size() - sizeof(uint32_t),
+                sizeof(uint32_t));
+
+        json["points"] = static_cast<Json::UInt64>(points);
+    }
+
+    Json::FastWriter writer;
+    return writer.write(json);
+}
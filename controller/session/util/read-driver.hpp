@@ -0,0 +1,284 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include <entwine/types/bounds.hpp>
+#include <entwine/types/point.hpp>
+#include <entwine/types/schema.hpp>
+
+#include "read-queries/base.hpp"
+#include "types/query-limits.hpp"
+#include "util/read-cache.hpp"
+
+class ItcBuffer;
+class ItcBufferPool;
+class ReadScheduler;
+class Session;
+class TaskPool;
+
+// Drives a read query on behalf of a consumer thread, such as the Node event
+// loop or the native server's event loop.  The query is built and read in
+// short steps on the read pool, none of which wait on the consumer, and its
+// chunks are queued for the consumer, which is woken through its Sink to
+// receive them.  At most pipelineDepth chunks are in flight between the two,
+// beyond which reading is parked without holding a thread.  While paused,
+// chunks are held rather than delivered, so the pipeline fills and reading
+// parks.
+//
+// Drivers are shared by the tasks which advance them, so they must be created
+// with std::make_shared, and may outlive their consumer.  Once complete() has
+// been seen from the consumer's thread, its Sink is never used again.
+class ReadDriver : public std::enable_shared_from_this<ReadDriver>
+{
+public:
+    struct Params
+    {
+        Params()
+            : schema()
+            , compress(CompressionMode::None)
+            , scale(0)
+            , offset()
+            , indexed(false)
+            , bounds()
+            , depthBegin(0)
+            , depthEnd(0)
+        { }
+
+        entwine::Schema schema;
+        CompressionMode compress;
+        double scale;
+        entwine::Point offset;
+
+        // If not indexed, the full unindexed data set is read.
+        bool indexed;
+        std::unique_ptr<entwine::Bounds> bounds;
+        std::size_t depthBegin;
+        std::size_t depthEnd;
+    };
+
+    class Sink
+    {
+    public:
+        virtual ~Sink() { }
+
+        // Called from any thread, under the driver's lock, when it has
+        // something for the consumer, which must then call service() from its
+        // own thread.  This must not call back into the driver.
+        virtual void wake() = 0;
+
+        // The rest are called from service(), on the consumer's thread.
+
+        // Our status once our query is built, or has failed.  Unless the code
+        // is 200, nothing more is called.  If the read was cancelled in the
+        // meantime, this is never called.  The retry delay is in seconds, and
+        // is zero if unknown.
+        virtual void status(
+                int code,
+                const std::string& message,
+                std::size_t retryAfter) = 0;
+
+        // Each chunk, in order, which now belongs to the sink.  The last has
+        // done set.  Returns false if the consumer has gone away, in which
+        // case the read is cancelled.
+        virtual bool data(std::shared_ptr<ItcBuffer> buffer, bool done) = 0;
+
+        // Reading failed after our status was given.  This follows every
+        // chunk read beforehand, and nothing more is called.
+        virtual void error(int code, const std::string& message) = 0;
+    };
+
+    ReadDriver(
+            std::shared_ptr<Session> session,
+            ItcBufferPool& itcBufferPool,
+            ReadCache& readCache,
+            TaskPool& readPool,
+            ReadScheduler& readScheduler,
+            const QueryLimits& limits,
+            Params params,
+            Sink& sink);
+    ~ReadDriver();
+
+    // Begin running on the read pool.
+    void start();
+
+    // The remainder of our interface is only for use from the consumer's
+    // thread.
+
+    // Give our status or our queued chunks to our sink.  If called back into
+    // from our sink, this does nothing, since the outer call picks up where
+    // we would have.
+    void service();
+
+    // Flow control.  Resuming or cancelling delivers whatever was held.
+    void pause() { m_paused = true; }
+    void resume();
+    void cancel();
+
+    // True while our sink is being called.
+    bool delivering() const { return m_delivering; }
+
+    // True once everything we'll produce has been given to our sink, after
+    // which it is never used again.
+    bool complete() const;
+
+    // The phases of this read so far, as JSON, given its final chunk, for
+    // use from our sink as it receives that chunk.
+    std::string timing(const ItcBuffer& last) const;
+
+private:
+    enum class State
+    {
+        // Building the query, on the read pool.
+        Query,
+
+        // Waiting for the consumer to take our status.
+        Init,
+
+        // Reading chunks on the read pool, or parked.
+        Read,
+
+        // Nothing more will be read.
+        Done
+    };
+
+    typedef std::chrono::steady_clock Clock;
+
+    // Run a single step of our current state on the read pool.
+    void step();
+    void stepQuery();
+    void stepRead();
+    void schedule();
+
+    // Check the response cache for an identical read.  Returns true if its
+    // response is cached, in which case no query is needed.
+    bool lookup();
+
+    // Seek admission from the read scheduler.  Returns false if the read was
+    // queued, in which case the scheduler steps us back here with our ticket
+    // set.  If the read was rejected, our status is set.
+    bool admit();
+
+    // Build our query.
+    void run();
+
+    // Fill our buffer with the next chunk, from the cached response or from
+    // our query.
+    void read();
+
+    // Keep a copy of the chunk we just read for the response cache, and
+    // insert the response once it is complete.
+    void record();
+
+    bool finished() const
+    {
+        return m_cached ?
+            m_cachedIndex == m_cached->size() : m_readQuery->done();
+    }
+
+    // Queue our buffer for delivery.  Returns false, having parked, if the
+    // pipeline is now full.
+    bool push();
+
+    // Wake our consumer to finish up.  This must be the final access of our
+    // sink from the read pool.
+    void finish();
+
+    // From the consumer's thread.
+    void init();
+    void deliver();
+
+    bool terminated() const;
+    void terminate();
+
+    // Canonical form of this read's parameters, or an empty string if its
+    // response should not be cached.
+    std::string cacheKey() const;
+
+    void fail(int code, const std::string& message)
+    {
+        m_code = code;
+        m_message = message;
+    }
+
+    bool ok() const { return m_code == 200; }
+
+    struct Chunk
+    {
+        Chunk(std::shared_ptr<ItcBuffer> itcBuffer, bool done)
+            : itcBuffer(itcBuffer)
+            , done(done)
+            , pushed(Clock::now())
+        { }
+
+        std::shared_ptr<ItcBuffer> itcBuffer;
+        bool done;
+        Clock::time_point pushed;
+    };
+
+    std::shared_ptr<Session> m_session;
+    ItcBufferPool& m_itcBufferPool;
+    ReadCache& m_readCache;
+    TaskPool& m_readPool;
+    ReadScheduler& m_readScheduler;
+    const QueryLimits m_limits;
+    const Params m_params;
+    Sink& m_sink;
+
+    int m_code;
+    std::string m_message;
+    std::size_t m_retryAfter;
+
+    std::shared_ptr<ReadQuery> m_readQuery;
+    std::shared_ptr<ItcBuffer> m_itcBuffer;
+    std::size_t m_sizeHint;
+
+    std::string m_cacheKey;
+    std::shared_ptr<const ReadCache::Chunks> m_cached;
+    std::size_t m_cachedIndex;
+    std::unique_ptr<ReadCache::Chunks> m_recording;
+    std::size_t m_recordedBytes;
+
+    std::uint64_t m_ticket;
+
+    // Holds us while we are queued for admission, until the scheduler
+    // starts us.
+    std::shared_ptr<ReadDriver> m_queued;
+
+    State m_state;
+    bool m_parked;
+    std::deque<Chunk> m_chunks;
+    std::size_t m_inFlight;
+
+    // Only accessed from the consumer's thread.
+    bool m_paused;
+    bool m_delivering;
+
+    // Whether our sink has seen the end of our response, whether that was
+    // our final chunk or a failure.
+    bool m_ended;
+
+    // Phase timing, in microseconds.  Queueing covers everything before our
+    // query is built, including response cache lookup and admission.
+    // Pending is the time chunks spend between being read and being given to
+    // our sink, while delivering is the time spent in our sink.
+    const Clock::time_point m_created;
+    std::uint64_t m_queueMicros;
+    std::uint64_t m_queryMicros;
+    std::uint64_t m_pendingMicros;
+    std::uint64_t m_deliverMicros;
+    std::size_t m_deliveredBytes;
+    std::size_t m_deliveredChunks;
+
+    bool m_terminate;
+    mutable std::mutex m_mutex;
+
+    // Disallow copy/assignment.
+    ReadDriver(const ReadDriver&);
+    ReadDriver& operator=(const ReadDriver&);
+};
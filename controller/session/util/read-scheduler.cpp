@@ -0,0 +1,260 @@
+#include "read-scheduler.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "types/query-limits.hpp"
+
+namespace
+{
+    // Weight of each finished read in our moving average of run times.
+    const double averageWeight(0.1);
+
+    const std::size_t minRetrySeconds(1);
+    const std::size_t maxRetrySeconds(60);
+
+    template<typename Duration>
+    std::uint64_t micros(const Duration& d)
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(d)
+            .count();
+    }
+}
+
+ReadScheduler::ReadScheduler(const QueryLimits& limits)
+    : m_maxReads(limits.maxReads())
+    , m_maxReadsPerResource(limits.maxReadsPerResource())
+    , m_maxReadPoints(limits.maxReadPoints())
+    , m_maxResourcePoints(limits.maxResourcePoints())
+    , m_maxQueuedReads(limits.maxQueuedReads())
+    , m_agingSeconds(limits.queueAgingSeconds())
+    , m_nextTicket(1)
+    , m_queue()
+    , m_running()
+    , m_usage()
+    , m_total()
+    , m_averageSeconds(1)
+    , m_stats()
+    , m_mutex()
+{ }
+
+ReadScheduler::Admission ReadScheduler::submit(
+        const std::string& resource,
+        const std::uint64_t cost,
+        const std::function<void()> start,
+        std::uint64_t& ticket,
+        std::size_t& retry)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    Job job(m_nextTicket, resource, cost, start);
+
+    // Don't let new reads jump ahead of those already waiting, unless
+    // dispatch() decides that they should.
+    if (m_queue.empty() && fitsGlobal(job) && fitsResource(job))
+    {
+        ticket = m_nextTicket++;
+        begin(job);
+        return Admission::Run;
+    }
+
+    if (m_maxQueuedReads && m_queue.size() >= m_maxQueuedReads)
+    {
+        ++m_stats.rejected;
+        retry = retryAfter();
+        return Admission::Rejected;
+    }
+
+    ticket = m_nextTicket++;
+    m_queue.push_back(job);
+    ++m_stats.deferred;
+    m_stats.peakQueued = std::max(m_stats.peakQueued, m_queue.size());
+
+    std::vector<Job> started(dispatch());
+    lock.unlock();
+
+    Admission result(Admission::Queued);
+
+    for (Job& s : started)
+    {
+        if (s.ticket == ticket) result = Admission::Run;
+        else s.start();
+    }
+
+    return result;
+}
+
+void ReadScheduler::release(const std::uint64_t ticket)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    auto it(m_running.find(ticket));
+
+    if (it == m_running.end())
+    {
+        // Never started, so it must still be queued.
+        m_queue.erase(
+                std::remove_if(
+                    m_queue.begin(),
+                    m_queue.end(),
+                    [ticket](const Job& job)->bool
+                    {
+                        return job.ticket == ticket;
+                    }),
+                m_queue.end());
+        return;
+    }
+
+    const Job& job(it->second);
+
+    const double seconds(
+            std::chrono::duration<double>(Clock::now() - job.time).count());
+    m_averageSeconds += averageWeight * (seconds - m_averageSeconds);
+
+    Usage& usage(m_usage[job.resource]);
+    --usage.reads;
+    usage.points -= job.cost;
+    if (!usage.reads) m_usage.erase(job.resource);
+
+    --m_total.reads;
+    m_total.points -= job.cost;
+
+    m_running.erase(it);
+
+    std::vector<Job> started(dispatch());
+    lock.unlock();
+
+    for (Job& s : started) s.start();
+}
+
+ReadScheduler::Stats ReadScheduler::stats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    Stats stats(m_stats);
+    stats.running = m_total.reads;
+    stats.runningPoints = m_total.points;
+    stats.queued = m_queue.size();
+
+    return stats;
+}
+
+bool ReadScheduler::fitsGlobal(const Job& job) const
+{
+    if (m_maxReads && m_total.reads >= m_maxReads) return false;
+
+    return
+        !m_maxReadPoints ||
+        !m_total.reads ||
+        m_total.points + job.cost <= m_maxReadPoints;
+}
+
+bool ReadScheduler::fitsResource(const Job& job) const
+{
+    auto it(m_usage.find(job.resource));
+    if (it == m_usage.end()) return true;
+
+    const Usage& usage(it->second);
+
+    if (m_maxReadsPerResource && usage.reads >= m_maxReadsPerResource)
+    {
+        return false;
+    }
+
+    return
+        !m_maxResourcePoints ||
+        usage.points + job.cost <= m_maxResourcePoints;
+}
+
+std::vector<ReadScheduler::Job> ReadScheduler::dispatch()
+{
+    std::vector<Job> started;
+    if (m_queue.empty()) return started;
+
+    const Clock::time_point now(Clock::now());
+
+    auto aged([this, &now](const Job& job)->double
+    {
+        if (!m_agingSeconds) return job.cost;
+
+        const double waited(
+                std::chrono::duration<double>(now - job.time).count());
+
+        return job.cost / std::pow(2.0, waited / m_agingSeconds);
+    });
+
+    std::stable_sort(
+            m_queue.begin(),
+            m_queue.end(),
+            [&aged](const Job& a, const Job& b)->bool
+            {
+                return aged(a) < aged(b);
+            });
+
+    std::vector<Job> remaining;
+
+    for (std::size_t i(0); i < m_queue.size(); ++i)
+    {
+        Job& job(m_queue[i]);
+
+        // Reads held back only by their own resource's limits shouldn't
+        // hold up others.  But if the best remaining read doesn't fit our
+        // global limits, stop here and let capacity drain for it, so aged
+        // reads eventually run.
+        if (!fitsGlobal(job))
+        {
+            remaining.insert(
+                    remaining.end(),
+                    m_queue.begin() + i,
+                    m_queue.end());
+            break;
+        }
+
+        if (!fitsResource(job))
+        {
+            remaining.push_back(job);
+            continue;
+        }
+
+        const std::uint64_t waited(micros(now - job.time));
+        m_stats.waitMicros += waited;
+        m_stats.maxWaitMicros = std::max(m_stats.maxWaitMicros, waited);
+
+        begin(job);
+        started.push_back(job);
+    }
+
+    m_queue.swap(remaining);
+
+    return started;
+}
+
+void ReadScheduler::begin(Job& job)
+{
+    job.time = Clock::now();
+
+    Usage& usage(m_usage[job.resource]);
+    ++usage.reads;
+    usage.points += job.cost;
+
+    ++m_total.reads;
+    m_total.points += job.cost;
+
+    ++m_stats.admitted;
+
+    m_running.insert(std::make_pair(job.ticket, job));
+}
+
+std::size_t ReadScheduler::retryAfter() const
+{
+    // Roughly how long until the queue has drained.
+    const std::size_t slots(
+            m_maxReads ? m_maxReads : std::max<std::size_t>(m_total.reads, 1));
+    const double seconds(
+            std::ceil(m_averageSeconds * (m_queue.size() + 1) / slots));
+
+    return std::min<std::size_t>(
+            std::max<std::size_t>(seconds, minRetrySeconds),
+            maxRetrySeconds);
+}
+
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class QueryLimits;
+
+// Admission control for read queries across all resources.  Reads are
+// admitted while they fit within our concurrency and cost limits, both global
+// and per resource.  Others wait in a queue, ordered cheapest first with
+// aging, until enough running reads are released.  If the queue is full,
+// reads are rejected along with a suggested time after which to retry.
+class ReadScheduler
+{
+public:
+    struct Stats
+    {
+        Stats()
+            : admitted(0)
+            , deferred(0)
+            , rejected(0)
+            , waitMicros(0)
+            , maxWaitMicros(0)
+            , running(0)
+            , runningPoints(0)
+            , queued(0)
+            , peakQueued(0)
+        { }
+
+        // Totals.  Deferred reads were queued rather than admitted
+        // immediately, and the wait times are of those reads.
+        std::uint64_t admitted;
+        std::uint64_t deferred;
+        std::uint64_t rejected;
+        std::uint64_t waitMicros;
+        std::uint64_t maxWaitMicros;
+
+        // Current state.
+        std::size_t running;
+        std::uint64_t runningPoints;
+        std::size_t queued;
+        std::size_t peakQueued;
+    };
+
+    enum class Admission
+    {
+        // The read may run now.
+        Run,
+
+        // The read was queued, and its start function will be called once
+        // it is admitted, from whichever thread releases its capacity.
+        Queued,
+
+        // The queue is full.
+        Rejected
+    };
+
+    explicit ReadScheduler(const QueryLimits& limits);
+
+    // Submit a read of the given estimated cost.  Unless the read is
+    // rejected, the ticket is set and must be released once the read is
+    // finished, whether or not it has been started.  If the read is
+    // rejected, retryAfter is set to a suggested delay in seconds.
+    Admission submit(
+            const std::string& resource,
+            std::uint64_t cost,
+            std::function<void()> start,
+            std::uint64_t& ticket,
+            std::size_t& retryAfter);
+
+    void release(std::uint64_t ticket);
+
+    Stats stats() const;
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Job
+    {
+        Job(
+                std::uint64_t ticket,
+                const std::string& resource,
+                std::uint64_t cost,
+                std::function<void()> start)
+            : ticket(ticket)
+            , resource(resource)
+            , cost(cost)
+            , start(start)
+            , time(Clock::now())
+        { }
+
+        std::uint64_t ticket;
+        std::string resource;
+        std::uint64_t cost;
+        std::function<void()> start;
+
+        // When queued, while waiting, and when started, while running.
+        Clock::time_point time;
+    };
+
+    struct Usage
+    {
+        Usage() : reads(0), points(0) { }
+
+        std::size_t reads;
+        std::uint64_t points;
+    };
+
+    // Whether a read may run, considering only the global limits, or only
+    // the limits of its resource.
+    bool fitsGlobal(const Job& job) const;
+    bool fitsResource(const Job& job) const;
+
+    // Move admissible jobs from the queue to the running set, in order of
+    // their aged costs, and return them.  m_mutex must be locked.
+    std::vector<Job> dispatch();
+    void begin(Job& job);
+
+    std::size_t retryAfter() const;
+
+    const std::size_t m_maxReads;
+    const std::size_t m_maxReadsPerResource;
+    const std::uint64_t m_maxReadPoints;
+    const std::uint64_t m_maxResourcePoints;
+    const std::size_t m_maxQueuedReads;
+    const double m_agingSeconds;
+
+    std::uint64_t m_nextTicket;
+    std::vector<Job> m_queue;
+    std::map<std::uint64_t, Job> m_running;
+    std::map<std::string, Usage> m_usage;
+    Usage m_total;
+
+    // Moving average of the time reads spend running, in seconds.
+    double m_averageSeconds;
+
+    Stats m_stats;
+
+    mutable std::mutex m_mutex;
+
+    // Disallow copy/assignment.
+    ReadScheduler(const ReadScheduler&);
+    ReadScheduler& operator=(const ReadScheduler&);
+};
+
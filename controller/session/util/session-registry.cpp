@@ -0,0 +1,225 @@
+#include "session-registry.hpp"
+
+#include <algorithm>
+
+#include "session.hpp"
+
+namespace
+{
+    // Bounds our memory of missing resources, whose names are chosen by our
+    // clients.
+    const std::size_t maxMissing(65536);
+}
+
+SessionRegistry::SessionRegistry(
+        const std::size_t maxBytes,
+        const std::size_t missingSeconds,
+        Factory factory)
+    : m_maxBytes(maxBytes)
+    , m_missingTime(missingSeconds)
+    , m_factory(factory)
+    , m_entries()
+    , m_index()
+    , m_hints()
+    , m_missing()
+    , m_missingHits(0)
+    , m_opens(0)
+    , m_reopens(0)
+    , m_evictions(0)
+    , m_mutex()
+{ }
+
+bool SessionRegistry::missing(const std::string& name)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it(m_missing.find(name));
+    if (it == m_missing.end()) return false;
+
+    if (Clock::now() >= it->second)
+    {
+        m_missing.erase(it);
+        return false;
+    }
+
+    ++m_missingHits;
+    return true;
+}
+
+std::shared_ptr<Session> SessionRegistry::get(const std::string& name)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it(m_index.find(name));
+
+    if (it != m_index.end())
+    {
+        Entry& entry(*it->second);
+        entry.accessed = Clock::now();
+        m_entries.splice(m_entries.begin(), m_entries, it->second);
+
+        return entry.session;
+    }
+
+    ++m_opens;
+    if (m_hints.count(name)) ++m_reopens;
+
+    m_entries.emplace_front(name, m_factory());
+    m_index[name] = m_entries.begin();
+
+    return m_entries.front().session;
+}
+
+std::string SessionRegistry::hint(const std::string& name) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it(m_hints.find(name));
+    return it != m_hints.end() ? it->second : std::string();
+}
+
+std::vector<std::string> SessionRegistry::sweep(
+        const std::size_t maxIdleSeconds)
+{
+    std::vector<std::string> names;
+
+    // Destroyed after we've unlocked, since tearing down a reader may take
+    // a while.
+    std::vector<std::shared_ptr<Session>> evicted;
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    std::size_t bytes(0);
+    for (const Entry& entry : m_entries) bytes += entry.session->footprint();
+
+    const Clock::time_point now(Clock::now());
+    const std::chrono::seconds maxIdle(maxIdleSeconds);
+
+    auto it(m_entries.end());
+
+    while (it != m_entries.begin())
+    {
+        --it;
+        const Entry& entry(*it);
+
+        const bool over(m_maxBytes && bytes > m_maxBytes);
+        const bool expired(maxIdleSeconds && now - entry.accessed > maxIdle);
+
+        if (!idle(entry) || (!over && !expired)) continue;
+
+        const std::size_t footprint(entry.session->footprint());
+        bytes -= std::min(footprint, bytes);
+
+        const std::string& path(entry.session->path());
+        if (!path.empty()) m_hints[entry.name] = path;
+
+        names.push_back(entry.name);
+        evicted.push_back(entry.session);
+
+        m_index.erase(entry.name);
+        it = m_entries.erase(it);
+        ++m_evictions;
+    }
+
+    pruneMissing(now);
+
+    lock.unlock();
+
+    return names;
+}
+
+void SessionRegistry::erase(
+        const std::string& name,
+        const std::shared_ptr<Session>& session)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it(m_index.find(name));
+
+    if (it != m_index.end() && it->second->session == session)
+    {
+        m_entries.erase(it->second);
+        m_index.erase(it);
+    }
+}
+
+void SessionRegistry::miss(
+        const std::string& name,
+        const std::shared_ptr<Session>& session)
+{
+    erase(name, session);
+
+    if (!m_missingTime.count()) return;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    const Clock::time_point now(Clock::now());
+
+    if (m_missing.size() >= maxMissing) pruneMissing(now);
+    if (m_missing.size() < maxMissing) m_missing[name] = now + m_missingTime;
+}
+
+void SessionRegistry::erase(const std::string& name)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it(m_index.find(name));
+
+    if (it != m_index.end())
+    {
+        m_entries.erase(it->second);
+        m_index.erase(it);
+    }
+
+    m_hints.erase(name);
+    m_missing.erase(name);
+}
+
+SessionRegistry::Stats SessionRegistry::stats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    Stats stats;
+    stats.sessions = m_entries.size();
+    stats.maxBytes = m_maxBytes;
+    stats.opens = m_opens;
+    stats.reopens = m_reopens;
+    stats.evictions = m_evictions;
+    stats.missing = m_missing.size();
+    stats.missingHits = m_missingHits;
+
+    for (const Entry& entry : m_entries)
+    {
+        const Session& session(*entry.session);
+        Resource& resource(stats.resources[entry.name]);
+
+        resource.bytes = session.footprint();
+        resource.pinnedBytes = session.pinnedBytes();
+        resource.active = !idle(entry);
+
+        stats.bytes += resource.bytes;
+        stats.pinnedBytes += resource.pinnedBytes;
+        if (resource.active) ++stats.active;
+
+        const HierarchyCacheStats h(session.hierarchyCacheStats());
+        stats.hierarchy.hits += h.hits;
+        stats.hierarchy.truncatedHits += h.truncatedHits;
+        stats.hierarchy.subtreeHits += h.subtreeHits;
+        stats.hierarchy.misses += h.misses;
+        stats.hierarchy.evictions += h.evictions;
+        stats.hierarchy.bytes += h.bytes;
+        stats.hierarchy.maxBytes += h.maxBytes;
+    }
+
+    return stats;
+}
+
+void SessionRegistry::pruneMissing(const Clock::time_point now)
+{
+    for (auto it(m_missing.begin()); it != m_missing.end(); )
+    {
+        if (now >= it->second) it = m_missing.erase(it);
+        else ++it;
+    }
+}
+
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "util/hierarchy-cache-stats.hpp"
+
+class Session;
+
+// Owns the sessions of all resources, within a budget for their approximate
+// memory footprints.  A session is in use while anything besides the registry
+// holds it - a handle awaiting its command, or a running query - and in-use
+// sessions are never evicted.  Idle sessions are evicted, least recently used
+// first, while we are over budget.
+//
+// The path at which an evicted resource was found is remembered, so it may be
+// reopened without searching for it again.  Resources which weren't found
+// anywhere are remembered for a while too, so repeated requests for them may
+// be answered without searching.
+class SessionRegistry
+{
+public:
+    typedef std::function<std::shared_ptr<Session>()> Factory;
+
+    struct Resource
+    {
+        Resource() : bytes(0), pinnedBytes(0), active(false) { }
+
+        // An estimate, from Session::footprint(), rather than a measurement
+        // of resident memory.
+        std::size_t bytes;
+
+        // Chunks pinned by preloading, which are included in the bytes above.
+        std::size_t pinnedBytes;
+        bool active;
+    };
+
+    struct Stats
+    {
+        Stats()
+            : sessions(0)
+            , active(0)
+            , bytes(0)
+            , maxBytes(0)
+            , pinnedBytes(0)
+            , resources()
+            , hierarchy()
+            , opens(0)
+            , reopens(0)
+            , evictions(0)
+            , missing(0)
+            , missingHits(0)
+        { }
+
+        std::size_t sessions;
+        std::size_t active;
+
+        // The estimated bytes of all open resources, which are evicted once
+        // this exceeds maxBytes.
+        std::size_t bytes;
+        std::size_t maxBytes;
+
+        // Chunks pinned by preloading, which are included in the bytes above.
+        std::size_t pinnedBytes;
+
+        // Open resources by name.
+        std::map<std::string, Resource> resources;
+
+        // Summed across open resources.
+        HierarchyCacheStats hierarchy;
+
+        // Totals.  Reopens are the opens of previously evicted resources.
+        std::uint64_t opens;
+        std::uint64_t reopens;
+        std::uint64_t evictions;
+
+        // Resources currently known to be missing, and the number of
+        // requests answered by that knowledge.
+        std::size_t missing;
+        std::uint64_t missingHits;
+    };
+
+    // A maxBytes of zero means unlimited.  Missing resources are remembered
+    // for missingSeconds, or not at all if it is zero.
+    SessionRegistry(
+            std::size_t maxBytes,
+            std::size_t missingSeconds,
+            Factory factory);
+
+    // True if this resource was recently found to be missing.
+    bool missing(const std::string& name);
+
+    // Get the session for a resource, creating it if necessary.  New
+    // sessions must be initialized before use.
+    std::shared_ptr<Session> get(const std::string& name);
+
+    // The search path at which this resource was last found, or empty if
+    // unknown.
+    std::string hint(const std::string& name) const;
+
+    // Evict idle sessions while we are over budget, and those which have been
+    // idle for longer than maxIdleSeconds if it is nonzero.  Returns the names
+    // of the evicted resources.
+    std::vector<std::string> sweep(std::size_t maxIdleSeconds = 0);
+
+    // Forget a resource, if it is still backed by the given session, for
+    // example if that session failed to initialize.
+    void erase(
+            const std::string& name,
+            const std::shared_ptr<Session>& session);
+
+    // As above, for a session whose resource wasn't found, which is
+    // remembered as missing.
+    void miss(
+            const std::string& name,
+            const std::shared_ptr<Session>& session);
+
+    // Forget a resource regardless of its session.  Its session is destroyed
+    // once it is no longer in use.
+    void erase(const std::string& name);
+
+    Stats stats() const;
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Entry
+    {
+        Entry(const std::string& name, std::shared_ptr<Session> session)
+            : name(name)
+            , session(session)
+            , accessed(Clock::now())
+        { }
+
+        std::string name;
+        std::shared_ptr<Session> session;
+        Clock::time_point accessed;
+    };
+
+    typedef std::list<Entry> Entries;
+
+    // Only the registry can hand out new references to a session, so one
+    // which only we hold can't come into use while m_mutex is locked.
+    static bool idle(const Entry& entry)
+    {
+        return entry.session.use_count() == 1;
+    }
+
+    // Drop expired entries from m_missing.  m_mutex must be locked.
+    void pruneMissing(Clock::time_point now);
+
+    const std::size_t m_maxBytes;
+    const std::chrono::seconds m_missingTime;
+    const Factory m_factory;
+
+    // Most recently used first.
+    Entries m_entries;
+    std::unordered_map<std::string, Entries::iterator> m_index;
+
+    // Search paths of evicted resources.
+    std::unordered_map<std::string, std::string> m_hints;
+
+    // Expiration times of missing resources.
+    std::unordered_map<std::string, Clock::time_point> m_missing;
+    std::uint64_t m_missingHits;
+
+    std::uint64_t m_opens;
+    std::uint64_t m_reopens;
+    std::uint64_t m_evictions;
+
+    mutable std::mutex m_mutex;
+
+    // Disallow copy/assignment.
+    SessionRegistry(const SessionRegistry&);
+    SessionRegistry& operator=(const SessionRegistry&);
+};
+
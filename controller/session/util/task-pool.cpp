@@ -0,0 +1,64 @@
+#include "task-pool.hpp"
+
+#include <iostream>
+
+TaskPool::TaskPool(const std::size_t numThreads)
+    : m_threads()
+    , m_tasks()
+    , m_stop(false)
+    , m_mutex()
+    , m_cv()
+{
+    for (std::size_t i(0); i < numThreads; ++i)
+    {
+        m_threads.emplace_back([this]()->void { work(); });
+    }
+}
+
+TaskPool::~TaskPool()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_stop = true;
+    lock.unlock();
+    m_cv.notify_all();
+
+    for (auto& t : m_threads) t.join();
+}
+
+void TaskPool::add(std::function<void()> task)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_tasks.push_back(task);
+    lock.unlock();
+    m_cv.notify_one();
+}
+
+std::size_t TaskPool::queued() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_tasks.size();
+}
+
+void TaskPool::work()
+{
+    while (true)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cv.wait(lock, [this]()->bool { return m_stop || !m_tasks.empty(); });
+
+        if (m_tasks.empty()) return;
+
+        std::function<void()> task(std::move(m_tasks.front()));
+        m_tasks.pop_front();
+        lock.unlock();
+
+        try
+        {
+            task();
+        }
+        catch (...)
+        {
+            std::cout << "Exception escaped from pooled task" << std::endl;
+        }
+    }
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads running queued tasks in FIFO order.  Tasks
+// must not throw - any exceptions escaping a task are swallowed.
+class TaskPool
+{
+public:
+    explicit TaskPool(std::size_t numThreads);
+    ~TaskPool();
+
+    void add(std::function<void()> task);
+
+    std::size_t numThreads() const { return m_threads.size(); }
+
+    // Tasks waiting for a thread.
+    std::size_t queued() const;
+
+private:
+    void work();
+
+    std::vector<std::thread> m_threads;
+    std::deque<std::function<void()>> m_tasks;
+    bool m_stop;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cv;
+
+    // Disallow copy/assignment.
+    TaskPool(const TaskPool&);
+    TaskPool& operator=(const TaskPool&);
+};
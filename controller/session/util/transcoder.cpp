@@ -0,0 +1,836 @@
+#include "transcoder.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    typedef Transcoder::Op Op;
+    typedef Transcoder::Kind Kind;
+
+    // Small enough that a block of input and output points stays in cache
+    // while each of our operations runs over it.
+    const std::size_t blockPoints(256);
+
+    template<typename T> T load(const char* pos)
+    {
+        T value;
+        std::memcpy(&value, pos, sizeof(T));
+        return value;
+    }
+
+    template<typename T> void store(char* pos, const T value)
+    {
+        std::memcpy(pos, &value, sizeof(T));
+    }
+
+    template<typename T> bool isNegative(const T value, std::true_type)
+    {
+        return value < 0;
+    }
+
+    template<typename T> bool isNegative(const T, std::false_type)
+    {
+        return false;
+    }
+
+    // Like PDAL, which converts points for the index, values which don't fit
+    // their output type are an error rather than being clamped.
+    void outOfRange()
+    {
+        throw std::runtime_error("Value out of range for requested type");
+    }
+
+    // Round half away from zero, exactly as PDAL does.
+    double sround(const double value)
+    {
+        return value > 0 ? std::floor(value + 0.5) : std::ceil(value - 0.5);
+    }
+
+    template<typename Out> Out roundTo(const double value)
+    {
+        typedef std::numeric_limits<Out> Limits;
+
+        const double rounded(sround(value));
+
+        // The upper limit of 64-bit types isn't representable, but adding one
+        // rounds it up to the exclusive bound.  NaN fails both checks.
+        if (
+                !(rounded >= static_cast<double>(Limits::min())) ||
+                !(rounded < static_cast<double>(Limits::max()) + 1.0))
+        {
+            outOfRange();
+        }
+
+        return static_cast<Out>(rounded);
+    }
+
+    template<typename Out, typename In> Out narrow(const In value)
+    {
+        typedef std::numeric_limits<Out> Limits;
+
+        if (isNegative(value, std::is_signed<In>()))
+        {
+            if (
+                    !Limits::is_signed ||
+                    static_cast<std::int64_t>(value) <
+                        static_cast<std::int64_t>(Limits::min()))
+            {
+                outOfRange();
+            }
+        }
+        else if (
+                static_cast<std::uint64_t>(value) >
+                static_cast<std::uint64_t>(Limits::max()))
+        {
+            outOfRange();
+        }
+
+        return static_cast<Out>(value);
+    }
+
+    template<typename Out> Out toFloating(const double value)
+    {
+        if (
+                sizeof(Out) < sizeof(double) &&
+                !(std::abs(value) <= std::numeric_limits<Out>::max()))
+        {
+            outOfRange();
+        }
+
+        return static_cast<Out>(value);
+    }
+
+    template<
+        typename Out,
+        typename In,
+        bool outFloating = std::is_floating_point<Out>::value,
+        bool inFloating = std::is_floating_point<In>::value>
+    struct Convert;
+
+    template<typename Out, typename In>
+    struct Convert<Out, In, true, true>
+    {
+        static Out apply(const In value) { return toFloating<Out>(value); }
+    };
+
+    template<typename Out, typename In>
+    struct Convert<Out, In, true, false>
+    {
+        static Out apply(const In value) { return static_cast<Out>(value); }
+    };
+
+    template<typename Out, typename In>
+    struct Convert<Out, In, false, true>
+    {
+        static Out apply(const In value) { return roundTo<Out>(value); }
+    };
+
+    template<typename Out, typename In>
+    struct Convert<Out, In, false, false>
+    {
+        static Out apply(const In value) { return narrow<Out>(value); }
+    };
+
+    template<typename T> struct TypeOf;
+
+    template<> struct TypeOf<int8_t>
+    {
+        static ValueType get() { return ValueType::Int8; }
+    };
+
+    template<> struct TypeOf<int16_t>
+    {
+        static ValueType get() { return ValueType::Int16; }
+    };
+
+    template<> struct TypeOf<int32_t>
+    {
+        static ValueType get() { return ValueType::Int32; }
+    };
+
+    template<> struct TypeOf<int64_t>
+    {
+        static ValueType get() { return ValueType::Int64; }
+    };
+
+    template<> struct TypeOf<uint8_t>
+    {
+        static ValueType get() { return ValueType::Uint8; }
+    };
+
+    template<> struct TypeOf<uint16_t>
+    {
+        static ValueType get() { return ValueType::Uint16; }
+    };
+
+    template<> struct TypeOf<uint32_t>
+    {
+        static ValueType get() { return ValueType::Uint32; }
+    };
+
+    template<> struct TypeOf<uint64_t>
+    {
+        static ValueType get() { return ValueType::Uint64; }
+    };
+
+    template<> struct TypeOf<float>
+    {
+        static ValueType get() { return ValueType::Float; }
+    };
+
+    template<> struct TypeOf<double>
+    {
+        static ValueType get() { return ValueType::Double; }
+    };
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Per-point operations, shared by our planned kernels and fast paths.
+
+    template<typename In, typename Out>
+    void convertOne(const Op& op, const char* in, char* out, double scale)
+    {
+        in += op.inPos;
+        out += op.outPos;
+
+        if (op.scaled)
+        {
+            const double value(
+                    (static_cast<double>(load<In>(in)) - op.offset[0]) / scale);
+
+            store(out, Convert<Out, double>::apply(value));
+        }
+        else
+        {
+            store(out, Convert<Out, In>::apply(load<In>(in)));
+        }
+    }
+
+    void xyzFloat(const Op& op, const char* in, char* out, double scale)
+    {
+        in += op.inPos;
+        out += op.outPos;
+
+#if defined(__SSE2__)
+        __m128d xy(_mm_loadu_pd(reinterpret_cast<const double*>(in)));
+        __m128d z(_mm_load_sd(reinterpret_cast<const double*>(in + 16)));
+
+        if (op.scaled)
+        {
+            const __m128d s(_mm_set1_pd(scale));
+            xy = _mm_div_pd(
+                    _mm_sub_pd(xy, _mm_set_pd(op.offset[1], op.offset[0])),
+                    s);
+            z = _mm_div_sd(_mm_sub_sd(z, _mm_set_sd(op.offset[2])), s);
+        }
+
+        // Anything too large for a float, or NaN, is out of range.
+        const __m128d magnitude(_mm_set1_pd(-0.0));
+        const __m128d limit(_mm_set1_pd(std::numeric_limits<float>::max()));
+
+        const int fitsXy(
+                _mm_movemask_pd(
+                    _mm_cmple_pd(_mm_andnot_pd(magnitude, xy), limit)));
+        const int fitsZ(
+                _mm_movemask_pd(
+                    _mm_cmple_sd(_mm_andnot_pd(magnitude, z), limit)));
+
+        if (fitsXy != 3 || !(fitsZ & 1)) outOfRange();
+
+        _mm_storel_pi(reinterpret_cast<__m64*>(out), _mm_cvtpd_ps(xy));
+        _mm_store_ss(
+                reinterpret_cast<float*>(out + 8),
+                _mm_cvtsd_ss(_mm_setzero_ps(), z));
+#else
+        for (std::size_t i(0); i < 3; ++i)
+        {
+            double value(load<double>(in + i * 8));
+            if (op.scaled) value = (value - op.offset[i]) / scale;
+            store(out + i * 4, toFloating<float>(value));
+        }
+#endif
+    }
+
+    void xyzInt32(const Op& op, const char* in, char* out, double scale)
+    {
+        in += op.inPos;
+        out += op.outPos;
+
+#if defined(__SSE2__)
+        __m128d xy(_mm_loadu_pd(reinterpret_cast<const double*>(in)));
+        __m128d z(_mm_load_sd(reinterpret_cast<const double*>(in + 16)));
+
+        if (op.scaled)
+        {
+            const __m128d s(_mm_set1_pd(scale));
+            xy = _mm_div_pd(
+                    _mm_sub_pd(xy, _mm_set_pd(op.offset[1], op.offset[0])),
+                    s);
+            z = _mm_div_sd(_mm_sub_sd(z, _mm_set_sd(op.offset[2])), s);
+        }
+
+        // Round half away from zero by adding a half with the sign of each
+        // value, then truncating.  Adding a half to the magnitude is exactly
+        // what PDAL's rounding does, and truncation then matches its floor
+        // or ceiling.
+        const __m128d sign(_mm_set1_pd(-0.0));
+        const __m128d half(_mm_set1_pd(0.5));
+
+        xy = _mm_add_pd(xy, _mm_or_pd(_mm_and_pd(xy, sign), half));
+        z = _mm_add_sd(z, _mm_or_pd(_mm_and_pd(z, sign), half));
+
+        // Anything that doesn't truncate into range, or NaN, is out of range.
+        const __m128d lo(_mm_set1_pd(-2147483649.0));
+        const __m128d hi(_mm_set1_pd(2147483648.0));
+
+        const int fitsXy(
+                _mm_movemask_pd(
+                    _mm_and_pd(_mm_cmpgt_pd(xy, lo), _mm_cmplt_pd(xy, hi))));
+        const int fitsZ(
+                _mm_movemask_pd(
+                    _mm_and_pd(_mm_cmpgt_sd(z, lo), _mm_cmplt_sd(z, hi))));
+
+        if (fitsXy != 3 || !(fitsZ & 1)) outOfRange();
+
+        _mm_storel_epi64(
+                reinterpret_cast<__m128i*>(out),
+                _mm_cvttpd_epi32(xy));
+        store<int32_t>(out + 8, _mm_cvttsd_si32(z));
+#else
+        for (std::size_t i(0); i < 3; ++i)
+        {
+            double value(load<double>(in + i * 8));
+            if (op.scaled) value = (value - op.offset[i]) / scale;
+            store(out + i * 4, roundTo<int32_t>(value));
+        }
+#endif
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Planned kernels, each running a single operation over many points.
+
+    template<std::size_t N>
+    void copyFixed(
+            const Op& op,
+            const char* in,
+            const std::size_t inStride,
+            char* out,
+            const std::size_t outStride,
+            const std::size_t numPoints,
+            double)
+    {
+        in += op.inPos;
+        out += op.outPos;
+
+        for (std::size_t i(0); i < numPoints; ++i)
+        {
+            std::memcpy(out, in, N);
+            in += inStride;
+            out += outStride;
+        }
+    }
+
+    void copyAny(
+            const Op& op,
+            const char* in,
+            const std::size_t inStride,
+            char* out,
+            const std::size_t outStride,
+            const std::size_t numPoints,
+            double)
+    {
+        in += op.inPos;
+        out += op.outPos;
+
+        for (std::size_t i(0); i < numPoints; ++i)
+        {
+            std::memcpy(out, in, op.size);
+            in += inStride;
+            out += outStride;
+        }
+    }
+
+    template<typename In, typename Out>
+    void convert(
+            const Op& op,
+            const char* in,
+            const std::size_t inStride,
+            char* out,
+            const std::size_t outStride,
+            const std::size_t numPoints,
+            const double scale)
+    {
+        for (std::size_t i(0); i < numPoints; ++i)
+        {
+            convertOne<In, Out>(op, in, out, scale);
+            in += inStride;
+            out += outStride;
+        }
+    }
+
+    template<void (*f)(const Op&, const char*, char*, double)>
+    void xyz(
+            const Op& op,
+            const char* in,
+            const std::size_t inStride,
+            char* out,
+            const std::size_t outStride,
+            const std::size_t numPoints,
+            const double scale)
+    {
+        for (std::size_t i(0); i < numPoints; ++i)
+        {
+            f(op, in, out, scale);
+            in += inStride;
+            out += outStride;
+        }
+    }
+
+    template<typename In>
+    Transcoder::Kernel pickConvert(const ValueType out)
+    {
+        switch (out)
+        {
+            case ValueType::Int8:   return &convert<In, int8_t>;
+            case ValueType::Int16:  return &convert<In, int16_t>;
+            case ValueType::Int32:  return &convert<In, int32_t>;
+            case ValueType::Int64:  return &convert<In, int64_t>;
+            case ValueType::Uint8:  return &convert<In, uint8_t>;
+            case ValueType::Uint16: return &convert<In, uint16_t>;
+            case ValueType::Uint32: return &convert<In, uint32_t>;
+            case ValueType::Uint64: return &convert<In, uint64_t>;
+            case ValueType::Float:  return &convert<In, float>;
+            case ValueType::Double: return &convert<In, double>;
+        }
+
+        throw std::runtime_error("Invalid output type");
+    }
+
+    Transcoder::Kernel pickConvert(const ValueType in, const ValueType out)
+    {
+        switch (in)
+        {
+            case ValueType::Int8:   return pickConvert<int8_t>(out);
+            case ValueType::Int16:  return pickConvert<int16_t>(out);
+            case ValueType::Int32:  return pickConvert<int32_t>(out);
+            case ValueType::Int64:  return pickConvert<int64_t>(out);
+            case ValueType::Uint8:  return pickConvert<uint8_t>(out);
+            case ValueType::Uint16: return pickConvert<uint16_t>(out);
+            case ValueType::Uint32: return pickConvert<uint32_t>(out);
+            case ValueType::Uint64: return pickConvert<uint64_t>(out);
+            case ValueType::Float:  return pickConvert<float>(out);
+            case ValueType::Double: return pickConvert<double>(out);
+        }
+
+        throw std::runtime_error("Invalid input type");
+    }
+
+    Transcoder::Kernel pickCopy(const std::size_t size)
+    {
+        switch (size)
+        {
+            case 1:     return &copyFixed<1>;
+            case 2:     return &copyFixed<2>;
+            case 4:     return &copyFixed<4>;
+            case 6:     return &copyFixed<6>;
+            case 8:     return &copyFixed<8>;
+            case 12:    return &copyFixed<12>;
+            case 16:    return &copyFixed<16>;
+            case 24:    return &copyFixed<24>;
+            default:    return &copyAny;
+        }
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Fast paths for entire layouts, with every operation inlined into a
+    // single loop over the points.
+
+    struct XyzFloatStep
+    {
+        static bool matches(const Op& op) { return op.kind == Kind::XyzFloat; }
+
+        static void apply(const Op& op, const char* in, char* out, double s)
+        {
+            xyzFloat(op, in, out, s);
+        }
+    };
+
+    struct XyzInt32Step
+    {
+        static bool matches(const Op& op) { return op.kind == Kind::XyzInt32; }
+
+        static void apply(const Op& op, const char* in, char* out, double s)
+        {
+            xyzInt32(op, in, out, s);
+        }
+    };
+
+    template<std::size_t N>
+    struct CopyStep
+    {
+        static bool matches(const Op& op)
+        {
+            return op.kind == Kind::Copy && op.size == N;
+        }
+
+        static void apply(const Op& op, const char* in, char* out, double)
+        {
+            std::memcpy(out + op.outPos, in + op.inPos, N);
+        }
+    };
+
+    template<typename In, typename Out>
+    struct ConvertStep
+    {
+        static bool matches(const Op& op)
+        {
+            return
+                op.kind == Kind::Convert &&
+                op.inType == TypeOf<In>::get() &&
+                op.outType == TypeOf<Out>::get();
+        }
+
+        static void apply(const Op& op, const char* in, char* out, double s)
+        {
+            convertOne<In, Out>(op, in, out, s);
+        }
+    };
+
+    template<typename... Steps> struct Fused;
+
+    template<> struct Fused<>
+    {
+        static bool matches(const std::vector<Op>& ops, const std::size_t i)
+        {
+            return i == ops.size();
+        }
+
+        static void apply(const Op*, const char*, char*, double) { }
+    };
+
+    template<typename Step, typename... Steps> struct Fused<Step, Steps...>
+    {
+        static bool matches(const std::vector<Op>& ops, const std::size_t i = 0)
+        {
+            return
+                i < ops.size() &&
+                Step::matches(ops[i]) &&
+                Fused<Steps...>::matches(ops, i + 1);
+        }
+
+        static void apply(const Op* op, const char* in, char* out, double s)
+        {
+            Step::apply(*op, in, out, s);
+            Fused<Steps...>::apply(op + 1, in, out, s);
+        }
+
+        static void run(
+                const Transcoder& transcoder,
+                const char* in,
+                const std::size_t numPoints,
+                char* out)
+        {
+            const Op* ops(transcoder.ops().data());
+            const std::size_t inStride(transcoder.inPointSize());
+            const std::size_t outStride(transcoder.outPointSize());
+            const double scale(transcoder.scale());
+
+            for (std::size_t i(0); i < numPoints; ++i)
+            {
+                apply(ops, in, out, scale);
+                in += inStride;
+                out += outStride;
+            }
+        }
+    };
+
+    // XYZ as floats, with intensity.
+    typedef Fused<XyzFloatStep, CopyStep<2>> XyzFloatIntensity;
+
+    // XYZ as floats, with 16-bit colors narrowed to 8 bits.
+    typedef Fused<
+        XyzFloatStep,
+        ConvertStep<uint16_t, uint8_t>,
+        ConvertStep<uint16_t, uint8_t>,
+        ConvertStep<uint16_t, uint8_t>> XyzFloatRgb8;
+
+    // XYZ as scaled integers, with 16-bit colors.
+    typedef Fused<XyzInt32Step, CopyStep<6>> XyzInt32Rgb;
+
+    // XYZ only.
+    typedef Fused<XyzFloatStep> XyzFloatOnly;
+    typedef Fused<XyzInt32Step> XyzInt32Only;
+}
+
+std::size_t sizeOf(const ValueType type)
+{
+    switch (type)
+    {
+        case ValueType::Int8:   return 1;
+        case ValueType::Int16:  return 2;
+        case ValueType::Int32:  return 4;
+        case ValueType::Int64:  return 8;
+        case ValueType::Uint8:  return 1;
+        case ValueType::Uint16: return 2;
+        case ValueType::Uint32: return 4;
+        case ValueType::Uint64: return 8;
+        case ValueType::Float:  return 4;
+        case ValueType::Double: return 8;
+    }
+
+    throw std::runtime_error("Invalid value type");
+}
+
+Transcoder::Transcoder(
+        const std::size_t inPointSize,
+        const std::size_t outPointSize,
+        const std::vector<Field>& fields,
+        const double scale)
+    : m_inPointSize(inPointSize)
+    , m_outPointSize(outPointSize)
+    , m_fields(fields)
+    , m_scale(scale)
+    , m_fieldOps()
+    , m_ops()
+    , m_zeroFill(false)
+    , m_fastPath(0)
+    , m_path("planned")
+{
+    compile();
+}
+
+void Transcoder::transcode(
+        const char* in,
+        const std::size_t numPoints,
+        char* out) const
+{
+    if (m_zeroFill) std::memset(out, 0, numPoints * m_outPointSize);
+
+    if (m_fastPath)
+    {
+        m_fastPath(*this, in, numPoints, out);
+        return;
+    }
+
+    for (std::size_t begin(0); begin < numPoints; begin += blockPoints)
+    {
+        const std::size_t count(std::min(blockPoints, numPoints - begin));
+        const char* blockIn(in + begin * m_inPointSize);
+        char* blockOut(out + begin * m_outPointSize);
+
+        for (const Op& op : m_ops)
+        {
+            op.kernel(
+                    op,
+                    blockIn,
+                    m_inPointSize,
+                    blockOut,
+                    m_outPointSize,
+                    count,
+                    m_scale);
+        }
+    }
+}
+
+void Transcoder::transcode(
+        const std::vector<char>& in,
+        std::vector<char>& out) const
+{
+    const std::size_t numPoints(in.size() / m_inPointSize);
+    out.resize(numPoints * m_outPointSize);
+    transcode(in.data(), numPoints, out.data());
+}
+
+void Transcoder::transcodeGeneric(
+        const char* in,
+        const std::size_t numPoints,
+        char* out) const
+{
+    if (m_zeroFill) std::memset(out, 0, numPoints * m_outPointSize);
+
+    for (std::size_t i(0); i < numPoints; ++i)
+    {
+        for (const Op& op : m_fieldOps)
+        {
+            op.kernel(
+                    op,
+                    in,
+                    m_inPointSize,
+                    out,
+                    m_outPointSize,
+                    1,
+                    m_scale);
+        }
+
+        in += m_inPointSize;
+        out += m_outPointSize;
+    }
+}
+
+void Transcoder::compile()
+{
+    std::size_t covered(0);
+
+    for (const Field& f : m_fields)
+    {
+        if (
+                f.inPos + sizeOf(f.inType) > m_inPointSize ||
+                f.outPos + sizeOf(f.outType) > m_outPointSize)
+        {
+            throw std::runtime_error("Invalid transcoder field");
+        }
+
+        if (f.scaled && !m_scale)
+        {
+            throw std::runtime_error("Invalid transcoder scale");
+        }
+
+        covered += sizeOf(f.outType);
+
+        Op op(
+                Kind::Convert,
+                f.inPos,
+                f.outPos,
+                0,
+                f.inType,
+                f.outType,
+                f.scaled);
+
+        op.offset[0] = f.offset;
+        op.kernel = pickConvert(f.inType, f.outType);
+        m_fieldOps.push_back(op);
+    }
+
+    m_zeroFill = covered < m_outPointSize;
+
+    std::size_t i(0);
+
+    while (i < m_fields.size())
+    {
+        const Field& f(m_fields[i]);
+
+        // Look for three adjacent doubles converted to three adjacent floats
+        // or integers, typically X, Y, and Z.
+        if (
+                i + 2 < m_fields.size() &&
+                f.inType == ValueType::Double &&
+                (f.outType == ValueType::Float ||
+                    f.outType == ValueType::Int32))
+        {
+            bool triplet(true);
+
+            for (std::size_t j(1); j < 3; ++j)
+            {
+                const Field& n(m_fields[i + j]);
+
+                triplet = triplet &&
+                    n.inType == f.inType &&
+                    n.outType == f.outType &&
+                    n.scaled == f.scaled &&
+                    n.inPos == f.inPos + j * 8 &&
+                    n.outPos == f.outPos + j * 4;
+            }
+
+            if (triplet)
+            {
+                const bool isFloat(f.outType == ValueType::Float);
+
+                Op op(
+                        isFloat ? Kind::XyzFloat : Kind::XyzInt32,
+                        f.inPos,
+                        f.outPos,
+                        0,
+                        f.inType,
+                        f.outType,
+                        f.scaled);
+
+                for (std::size_t j(0); j < 3; ++j)
+                {
+                    op.offset[j] = m_fields[i + j].offset;
+                }
+
+                op.kernel = isFloat ? &xyz<xyzFloat> : &xyz<xyzInt32>;
+
+                m_ops.push_back(op);
+                i += 3;
+                continue;
+            }
+        }
+
+        if (f.inType == f.outType && !f.scaled)
+        {
+            const std::size_t size(sizeOf(f.inType));
+
+            // Extend the previous copy if this field directly follows it.
+            if (
+                    !m_ops.empty() &&
+                    m_ops.back().kind == Kind::Copy &&
+                    m_ops.back().inPos + m_ops.back().size == f.inPos &&
+                    m_ops.back().outPos + m_ops.back().size == f.outPos)
+            {
+                m_ops.back().size += size;
+            }
+            else
+            {
+                m_ops.push_back(
+                        Op(
+                            Kind::Copy,
+                            f.inPos,
+                            f.outPos,
+                            size,
+                            f.inType,
+                            f.outType,
+                            false));
+            }
+        }
+        else
+        {
+            m_ops.push_back(m_fieldOps[i]);
+        }
+
+        ++i;
+    }
+
+    for (Op& op : m_ops)
+    {
+        if (op.kind == Kind::Copy) op.kernel = pickCopy(op.size);
+    }
+
+    if (m_zeroFill) return;
+
+    if (XyzFloatIntensity::matches(m_ops))
+    {
+        m_fastPath = &XyzFloatIntensity::run;
+        m_path = "xyz-float-intensity";
+    }
+    else if (XyzFloatRgb8::matches(m_ops))
+    {
+        m_fastPath = &XyzFloatRgb8::run;
+        m_path = "xyz-float-rgb8";
+    }
+    else if (XyzInt32Rgb::matches(m_ops))
+    {
+        m_fastPath = &XyzInt32Rgb::run;
+        m_path = "xyz-int32-rgb";
+    }
+    else if (XyzFloatOnly::matches(m_ops))
+    {
+        m_fastPath = &XyzFloatOnly::run;
+        m_path = "xyz-float";
+    }
+    else if (XyzInt32Only::matches(m_ops))
+    {
+        m_fastPath = &XyzInt32Only::run;
+        m_path = "xyz-int32";
+    }
+}
+
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+enum class ValueType
+{
+    Int8,
+    Int16,
+    Int32,
+    Int64,
+    Uint8,
+    Uint16,
+    Uint32,
+    Uint64,
+    Float,
+    Double
+};
+
+std::size_t sizeOf(ValueType type);
+
+// Converts packed points from one layout to another.  The conversion is
+// compiled once into a plan: runs of identically typed dimensions become
+// single copies, X/Y/Z triplets of doubles use SIMD kernels, and everything
+// else uses a typed conversion.  A few layouts commonly requested by viewers
+// are recognized as a whole and run through fully unrolled fast paths.
+//
+// Values are converted as PDAL converts them for the index: floating point
+// values are rounded half away from zero, and a value which doesn't fit its
+// output type fails the transcode with a std::runtime_error.  Output bytes
+// not covered by any field are zeroed.
+class Transcoder
+{
+public:
+    struct Field
+    {
+        Field(
+                ValueType inType,
+                std::size_t inPos,
+                ValueType outType,
+                std::size_t outPos,
+                bool scaled = false,
+                double offset = 0)
+            : inType(inType)
+            , inPos(inPos)
+            , outType(outType)
+            , outPos(outPos)
+            , scaled(scaled)
+            , offset(offset)
+        { }
+
+        ValueType inType;
+        std::size_t inPos;
+        ValueType outType;
+        std::size_t outPos;
+
+        // If set, values are written as (value - offset) / scale.
+        bool scaled;
+        double offset;
+    };
+
+    // Fields must be given in order of their output position.  The scale is
+    // only used for scaled fields, and must be non-zero if there are any.
+    Transcoder(
+            std::size_t inPointSize,
+            std::size_t outPointSize,
+            const std::vector<Field>& fields,
+            double scale = 1);
+
+    void transcode(const char* in, std::size_t numPoints, char* out) const;
+
+    // Transcode a buffer of packed input points, resizing the output to fit.
+    void transcode(const std::vector<char>& in, std::vector<char>& out) const;
+
+    // A straightforward per-point, per-dimension conversion with identical
+    // results, for reference.
+    void transcodeGeneric(
+            const char* in,
+            std::size_t numPoints,
+            char* out) const;
+
+    std::size_t inPointSize() const { return m_inPointSize; }
+    std::size_t outPointSize() const { return m_outPointSize; }
+
+    // Name of the fast path in use, or "planned" if there is none.
+    const std::string& path() const { return m_path; }
+
+    // The remainder is only public for use by our kernels.
+    enum class Kind { Copy, Convert, XyzFloat, XyzInt32 };
+
+    struct Op;
+
+    typedef void (*Kernel)(
+            const Op& op,
+            const char* in,
+            std::size_t inStride,
+            char* out,
+            std::size_t outStride,
+            std::size_t numPoints,
+            double scale);
+
+    struct Op
+    {
+        Op(
+                Kind kind,
+                std::size_t inPos,
+                std::size_t outPos,
+                std::size_t size,
+                ValueType inType,
+                ValueType outType,
+                bool scaled)
+            : kind(kind)
+            , inPos(inPos)
+            , outPos(outPos)
+            , size(size)
+            , inType(inType)
+            , outType(outType)
+            , scaled(scaled)
+            , kernel(0)
+        {
+            offset[0] = offset[1] = offset[2] = 0;
+        }
+
+        Kind kind;
+        std::size_t inPos;
+        std::size_t outPos;
+
+        // Number of bytes copied, for copies.
+        std::size_t size;
+
+        ValueType inType;
+        ValueType outType;
+        bool scaled;
+        double offset[3];
+
+        Kernel kernel;
+    };
+
+    typedef void (*FastPath)(
+            const Transcoder& transcoder,
+            const char* in,
+            std::size_t numPoints,
+            char* out);
+
+    const std::vector<Op>& ops() const { return m_ops; }
+    double scale() const { return m_scale; }
+
+private:
+    void compile();
+
+    const std::size_t m_inPointSize;
+    const std::size_t m_outPointSize;
+    const std::vector<Field> m_fields;
+    const double m_scale;
+
+    // A single conversion per field, for our generic path.
+    std::vector<Op> m_fieldOps;
+
+    std::vector<Op> m_ops;
+    bool m_zeroFill;
+
+    FastPath m_fastPath;
+    std::string m_path;
+};
+
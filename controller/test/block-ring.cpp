@@ -0,0 +1,246 @@
+// Unit tests of BlockRing's transitions: waiting while full or empty,
+// finishing, and cancelling, along with ordered delivery between threads.
+//
+// Build and run with:
+//      make block-ring && ./block-ring
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "util/block-ring.hpp"
+
+#include "check.hpp"
+
+namespace
+{
+    // Long enough that a call which should be waiting would have returned
+    // by now if it weren't.
+    void settle()
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+
+    std::vector<char> block(const char c, const std::size_t size = 4)
+    {
+        return std::vector<char>(size, c);
+    }
+
+    void emptyWaits()
+    {
+        BlockRing ring(2);
+        CHECK(!ring.exhausted());
+
+        std::atomic<bool> popped(false);
+        std::vector<char> out;
+
+        std::thread consumer([&]()->void
+        {
+            CHECK(ring.pop(out));
+            popped = true;
+        });
+
+        settle();
+        CHECK(!popped);
+
+        std::vector<char> in(block('a'));
+        CHECK(ring.push(in));
+
+        consumer.join();
+        CHECK(popped);
+        CHECK(out == block('a'));
+    }
+
+    void fullWaits()
+    {
+        BlockRing ring(2);
+
+        // Filling the ring hands back empty blocks in exchange.
+        std::vector<char> in(block('a'));
+        CHECK(ring.push(in));
+        CHECK(in.empty());
+
+        in = block('b');
+        CHECK(ring.push(in));
+
+        std::atomic<bool> pushed(false);
+
+        std::thread producer([&]()->void
+        {
+            std::vector<char> last(block('c'));
+            CHECK(ring.push(last));
+            pushed = true;
+        });
+
+        settle();
+        CHECK(!pushed);
+
+        std::vector<char> out;
+        CHECK(ring.pop(out));
+        CHECK(out == block('a'));
+
+        producer.join();
+        CHECK(pushed);
+
+        CHECK(ring.pop(out));
+        CHECK(out == block('b'));
+        CHECK(ring.pop(out));
+        CHECK(out == block('c'));
+    }
+
+    void finishDrains()
+    {
+        BlockRing ring(4);
+
+        std::vector<char> in(block('a'));
+        CHECK(ring.push(in));
+        ring.finish();
+
+        // Blocks pushed before finishing are still delivered.
+        CHECK(!ring.exhausted());
+
+        std::vector<char> out;
+        CHECK(ring.pop(out));
+        CHECK(out == block('a'));
+
+        CHECK(ring.exhausted());
+        CHECK(!ring.pop(out));
+    }
+
+    void finishWakesConsumer()
+    {
+        BlockRing ring(2);
+        std::atomic<bool> popped(false);
+        std::atomic<bool> result(true);
+
+        std::thread consumer([&]()->void
+        {
+            std::vector<char> out;
+            result = ring.pop(out);
+            popped = true;
+        });
+
+        settle();
+        CHECK(!popped);
+
+        ring.finish();
+        consumer.join();
+
+        CHECK(!result);
+        CHECK(ring.exhausted());
+    }
+
+    void cancelWakesProducer()
+    {
+        BlockRing ring(1);
+
+        std::vector<char> in(block('a'));
+        CHECK(ring.push(in));
+
+        std::atomic<bool> pushed(false);
+        std::atomic<bool> result(true);
+        std::vector<char> last(block('b'));
+
+        std::thread producer([&]()->void
+        {
+            result = ring.push(last);
+            pushed = true;
+        });
+
+        settle();
+        CHECK(!pushed);
+
+        ring.cancel();
+        producer.join();
+
+        // A refused block is left with the producer.
+        CHECK(!result);
+        CHECK(last == block('b'));
+
+        // Neither side gets anything more.
+        in = block('c');
+        CHECK(!ring.push(in));
+        CHECK(in == block('c'));
+
+        std::vector<char> out;
+        CHECK(!ring.pop(out));
+    }
+
+    void cancelWakesConsumer()
+    {
+        BlockRing ring(2);
+        std::atomic<bool> popped(false);
+        std::atomic<bool> result(true);
+
+        std::thread consumer([&]()->void
+        {
+            std::vector<char> out;
+            result = ring.pop(out);
+            popped = true;
+        });
+
+        settle();
+        CHECK(!popped);
+
+        ring.cancel();
+        consumer.join();
+
+        CHECK(!result);
+    }
+
+    void ordered()
+    {
+        const std::size_t count(100000);
+        BlockRing ring(4);
+
+        std::thread producer([&]()->void
+        {
+            std::vector<char> in;
+
+            for (std::size_t i(0); i < count; ++i)
+            {
+                // Reuse whatever storage we're handed back.
+                in.resize(sizeof(i));
+                std::memcpy(in.data(), &i, sizeof(i));
+                CHECK(ring.push(in));
+            }
+
+            ring.finish();
+        });
+
+        std::vector<char> out;
+        std::size_t next(0);
+
+        while (ring.pop(out))
+        {
+            std::size_t i(0);
+            CHECK(out.size() == sizeof(i));
+            std::memcpy(&i, out.data(), sizeof(i));
+            CHECK(i == next);
+            ++next;
+        }
+
+        producer.join();
+
+        CHECK(next == count);
+        CHECK(ring.exhausted());
+    }
+}
+
+int main()
+{
+    emptyWaits();
+    fullWaits();
+    finishDrains();
+    finishWakesConsumer();
+    cancelWakesProducer();
+    cancelWakesConsumer();
+    ordered();
+
+    std::cout << "BlockRing: all tests passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,213 @@
+// Unit tests of ItcBufferPool: exclusive acquisition, waiting for a release
+// once exhausted, timing out, and trimming of released buffers.
+//
+// Build and run with:
+//      make buffer-pool && ./buffer-pool
+
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "util/buffer-pool.hpp"
+
+#include "check.hpp"
+
+namespace
+{
+    typedef std::chrono::steady_clock Clock;
+
+    std::size_t millisSince(const Clock::time_point start)
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+                Clock::now() - start).count();
+    }
+
+    void invalidSize()
+    {
+        bool threw(false);
+
+        try
+        {
+            // Too few to give each size class a buffer.
+            ItcBufferPool pool(1);
+        }
+        catch (const std::runtime_error&)
+        {
+            threw = true;
+        }
+
+        CHECK(threw);
+    }
+
+    void exclusive()
+    {
+        const std::size_t numBuffers(16);
+        ItcBufferPool pool(numBuffers);
+
+        std::vector<std::shared_ptr<ItcBuffer>> held;
+        std::set<ItcBuffer*> distinct;
+
+        for (std::size_t i(0); i < numBuffers; ++i)
+        {
+            // Hints for every size class, which fall back to others once
+            // their own is empty.
+            held.push_back(pool.acquire(i % 3 ? 0 : (1 << 24)));
+            distinct.insert(held.back().get());
+        }
+
+        CHECK(distinct.size() == numBuffers);
+        CHECK(pool.stats().inUse == numBuffers);
+        CHECK(pool.stats().peakInUse == numBuffers);
+        CHECK(!pool.stats().waits);
+
+        for (auto& buffer : held) pool.release(buffer);
+
+        CHECK(pool.stats().inUse == 0);
+        CHECK(pool.stats().peakInUse == numBuffers);
+        CHECK(pool.stats().acquires == numBuffers);
+    }
+
+    void timesOut()
+    {
+        const std::size_t numBuffers(4);
+        ItcBufferPool pool(numBuffers, std::chrono::milliseconds(50));
+
+        std::vector<std::shared_ptr<ItcBuffer>> held;
+        for (std::size_t i(0); i < numBuffers; ++i)
+        {
+            held.push_back(pool.acquire());
+        }
+
+        const Clock::time_point start(Clock::now());
+        bool threw(false);
+
+        try
+        {
+            pool.acquire();
+        }
+        catch (const std::runtime_error&)
+        {
+            threw = true;
+        }
+
+        CHECK(threw);
+        CHECK(millisSince(start) >= 50);
+
+        const ItcBufferPool::Stats stats(pool.stats());
+        CHECK(stats.waits == 1);
+        CHECK(stats.timeouts == 1);
+        CHECK(stats.inUse == numBuffers);
+
+        // A timeout leaves the pool usable.
+        pool.release(held.back());
+        held.back() = pool.acquire();
+        CHECK(held.back());
+
+        for (auto& buffer : held) pool.release(buffer);
+        CHECK(pool.stats().inUse == 0);
+    }
+
+    void waitsForRelease()
+    {
+        const std::size_t numBuffers(4);
+        ItcBufferPool pool(numBuffers, std::chrono::seconds(10));
+
+        std::vector<std::shared_ptr<ItcBuffer>> held;
+        for (std::size_t i(0); i < numBuffers; ++i)
+        {
+            held.push_back(pool.acquire());
+        }
+
+        ItcBuffer* const released(held.front().get());
+
+        std::thread releaser([&]()->void
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            pool.release(held.front());
+        });
+
+        std::shared_ptr<ItcBuffer> buffer(pool.acquire());
+        releaser.join();
+
+        CHECK(buffer.get() == released);
+        CHECK(pool.stats().waits == 1);
+        CHECK(pool.stats().timeouts == 0);
+
+        pool.release(buffer);
+        for (std::size_t i(1); i < held.size(); ++i) pool.release(held[i]);
+    }
+
+    void trims()
+    {
+        ItcBufferPool pool(8);
+
+        // Our smallest size class keeps at most 512 KB once released.
+        std::shared_ptr<ItcBuffer> buffer(pool.acquire(0));
+        buffer->resize(1 << 20);
+        pool.release(buffer);
+
+        CHECK(buffer->size() == 0);
+        CHECK(buffer->capacity() < (1 << 20));
+        CHECK(pool.stats().bytesRetained == buffer->capacity());
+    }
+
+    void contended()
+    {
+        const std::size_t numBuffers(8);
+        const std::size_t numThreads(16);
+        const std::size_t iterations(2000);
+
+        ItcBufferPool pool(numBuffers);
+        std::vector<std::thread> threads;
+
+        for (std::size_t t(0); t < numThreads; ++t)
+        {
+            threads.emplace_back([&pool, t, iterations]()->void
+            {
+                for (std::size_t i(0); i < iterations; ++i)
+                {
+                    std::shared_ptr<ItcBuffer> buffer(pool.acquire(i * 997));
+
+                    // No one else may touch this buffer while we hold it.
+                    const std::size_t mark(t * iterations + i);
+                    buffer->resize(sizeof(mark));
+                    std::memcpy(buffer->data(), &mark, sizeof(mark));
+                    std::this_thread::yield();
+
+                    std::size_t check(0);
+                    std::memcpy(&check, buffer->data(), sizeof(check));
+                    CHECK(check == mark);
+
+                    pool.release(buffer);
+                }
+            });
+        }
+
+        for (auto& thread : threads) thread.join();
+
+        const ItcBufferPool::Stats stats(pool.stats());
+        CHECK(stats.acquires == numThreads * iterations);
+        CHECK(stats.inUse == 0);
+        CHECK(stats.peakInUse <= numBuffers);
+        CHECK(stats.timeouts == 0);
+    }
+}
+
+int main()
+{
+    invalidSize();
+    exclusive();
+    timesOut();
+    waitsForRelease();
+    trims();
+    contended();
+
+    std::cout << "ItcBufferPool: all tests passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,126 @@
+// Unit tests of CachingDriver's pins: capturing the chunks of an index while
+// pinning, serving them without fetching, and releasing them.
+//
+// Build and run with:
+//      make caching-driver && ./caching-driver
+
+#include <cstddef>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "util/caching-driver.hpp"
+
+#include "check.hpp"
+
+namespace
+{
+    // Serves fixed contents for any path, counting its fetches by path.
+    class Remote : public entwine::arbiter::Driver
+    {
+    public:
+        Remote() : m_fetches() { }
+
+        virtual std::string type() const { return "s3"; }
+        virtual void put(std::string, const std::vector<char>&) const { }
+
+        std::size_t fetches(const std::string& path) const
+        {
+            const auto it(m_fetches.find(path));
+            return it == m_fetches.end() ? 0 : it->second;
+        }
+
+    protected:
+        virtual bool get(std::string path, std::vector<char>& data) const
+        {
+            ++m_fetches[path];
+            data.assign(path.begin(), path.end());
+            return true;
+        }
+
+    private:
+        mutable std::map<std::string, std::size_t> m_fetches;
+    };
+
+    std::vector<char> fetch(const CachingDriver& driver, const std::string& p)
+    {
+        std::unique_ptr<std::vector<char>> data(driver.tryGetBinary(p));
+        CHECK(data);
+        CHECK(*data == std::vector<char>(p.begin(), p.end()));
+        return *data;
+    }
+
+    void pinsWhileCapturing()
+    {
+        Remote remote;
+        CachingDriver driver(remote, nullptr);
+
+        std::unique_ptr<CachingDriver::Pins> pins(
+                new CachingDriver::Pins("s3://bucket/a"));
+
+        // Not yet capturing.
+        fetch(driver, "bucket/a/1");
+
+        pins->capture(true);
+        fetch(driver, "bucket/a/2");
+        fetch(driver, "bucket/a/3");
+
+        // Neither another index, even one sharing our prefix, nor a file
+        // which isn't a chunk.
+        fetch(driver, "bucket/ab/4");
+        fetch(driver, "bucket/a/entwine");
+        pins->capture(false);
+
+        fetch(driver, "bucket/a/5");
+
+        CHECK(pins->chunks() == 2);
+        CHECK(pins->bytes() == 2 * std::string("bucket/a/2").size());
+
+        const CachingDriver::Stats before(CachingDriver::stats());
+
+        for (const std::string id : { "1", "2", "3", "5" })
+        {
+            fetch(driver, "bucket/a/" + id);
+        }
+
+        // Pinned chunks are served without being fetched again.
+        CHECK(remote.fetches("bucket/a/1") == 2);
+        CHECK(remote.fetches("bucket/a/2") == 1);
+        CHECK(remote.fetches("bucket/a/3") == 1);
+        CHECK(remote.fetches("bucket/a/5") == 2);
+
+        const CachingDriver::Stats after(CachingDriver::stats());
+        CHECK(after.pinHits - before.pinHits == 2);
+        CHECK(after.chunkFetches - before.chunkFetches == 4);
+
+        // Released along with their pins.
+        pins.reset();
+        fetch(driver, "bucket/a/2");
+        CHECK(remote.fetches("bucket/a/2") == 2);
+    }
+
+    void matchesType()
+    {
+        Remote remote;
+        CachingDriver driver(remote, nullptr);
+
+        // Local paths are those of the "file" driver, not ours.
+        CachingDriver::Pins pins("bucket/a/");
+        pins.capture(true);
+
+        fetch(driver, "bucket/a/1");
+        CHECK(!pins.chunks());
+        CHECK(!pins.bytes());
+    }
+}
+
+int main()
+{
+    pinsWhileCapturing();
+    matchesType();
+
+    std::cout << "CachingDriver: all tests passed" << std::endl;
+    return 0;
+}
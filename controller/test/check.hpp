@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdlib>
+#include <iostream>
+
+// Our unit tests are built optimized, so rather than assert(), which may be
+// compiled out, failures are reported with their location and end the run.
+#define CHECK(condition) \
+    do \
+    { \
+        if (!(condition)) \
+        { \
+            std::cout << __FILE__ << ":" << __LINE__ << ": failed: " << \
+                #condition << std::endl; \
+            std::exit(1); \
+        } \
+    } \
+    while (false)
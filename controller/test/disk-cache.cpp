@@ -0,0 +1,281 @@
+// Unit tests of DiskCache: least recently used eviction within its budget,
+// rebuilding its index after a restart, and detecting hash collisions.
+//
+// Build and run with:
+//      make disk-cache && ./disk-cache
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "util/disk-cache.hpp"
+
+#include "check.hpp"
+
+namespace
+{
+    // Each entry costs its data, its key, and the key's length.
+    const std::size_t entryBytes(100);
+
+    std::vector<char> data(const char c)
+    {
+        return std::vector<char>(entryBytes - sizeof(std::uint32_t) - 1, c);
+    }
+
+    // As named by DiskCache, which we need in order to forge its files.
+    std::string filename(const std::string& key)
+    {
+        std::uint64_t hash(14695981039346656037ull);
+
+        for (const char c : key)
+        {
+            hash ^= static_cast<unsigned char>(c);
+            hash *= 1099511628211ull;
+        }
+
+        char result[17];
+        std::snprintf(
+                result,
+                sizeof(result),
+                "%016llx",
+                static_cast<unsigned long long>(hash));
+
+        return result;
+    }
+
+    bool exists(const std::string& path)
+    {
+        struct stat info;
+        return !stat(path.c_str(), &info);
+    }
+
+    void write(const std::string& path, const std::string& contents)
+    {
+        std::FILE* file(std::fopen(path.c_str(), "wb"));
+        CHECK(file);
+        CHECK(std::fwrite(contents.data(), 1, contents.size(), file) ==
+                contents.size());
+        CHECK(!std::fclose(file));
+    }
+
+    // Back-date a file, as if it were last used this many seconds ago.
+    void age(const std::string& path, const std::time_t seconds)
+    {
+        const std::time_t then(std::time(nullptr) - seconds);
+
+        struct timespec times[2];
+        times[0].tv_sec = times[1].tv_sec = then;
+        times[0].tv_nsec = times[1].tv_nsec = 0;
+
+        CHECK(!utimensat(AT_FDCWD, path.c_str(), times, 0));
+    }
+
+    // A scratch directory, removed along with its contents.
+    class Scratch
+    {
+    public:
+        Scratch()
+            : m_dir()
+        {
+            char dir[] = "/tmp/disk-cache-test-XXXXXX";
+            CHECK(mkdtemp(dir));
+            m_dir = dir;
+        }
+
+        ~Scratch()
+        {
+            clear(m_dir + "/cache");
+            rmdir((m_dir + "/cache").c_str());
+            rmdir(m_dir.c_str());
+        }
+
+        // Nested, so the cache has to create it.
+        std::string dir() const { return m_dir + "/cache/"; }
+
+    private:
+        static void clear(const std::string& dir)
+        {
+            DIR* handle(opendir(dir.c_str()));
+            if (!handle) return;
+
+            while (const dirent* entry = readdir(handle))
+            {
+                const std::string name(entry->d_name);
+                if (name != "." && name != "..")
+                {
+                    unlink((dir + '/' + name).c_str());
+                }
+            }
+
+            closedir(handle);
+        }
+
+        std::string m_dir;
+    };
+
+    void roundTrips()
+    {
+        Scratch scratch;
+        DiskCache cache(scratch.dir(), entryBytes * 8);
+
+        std::vector<char> out;
+        CHECK(!cache.get("a", out));
+
+        cache.insert("a", data('a'));
+        CHECK(cache.get("a", out));
+        CHECK(out == data('a'));
+        CHECK(exists(scratch.dir() + filename("a")));
+
+        // Too large a share of our budget to be cached.
+        cache.insert("b", std::vector<char>(entryBytes * 2, 'b'));
+        CHECK(!cache.get("b", out));
+
+        const DiskCache::Stats stats(cache.stats());
+        CHECK(stats.hits == 1);
+        CHECK(stats.misses == 2);
+        CHECK(stats.inserts == 1);
+        CHECK(stats.entries == 1);
+        CHECK(stats.bytes == entryBytes);
+    }
+
+    void evictsLeastRecentlyUsed()
+    {
+        Scratch scratch;
+        DiskCache cache(scratch.dir(), entryBytes * 8);
+
+        const std::string keys("abcdefgh");
+        for (const char c : keys) cache.insert(std::string(1, c), data(c));
+
+        CHECK(cache.stats().bytes == entryBytes * 8);
+        CHECK(!cache.stats().evictions);
+
+        // Touching "a" leaves "b" as our least recently used.
+        std::vector<char> out;
+        CHECK(cache.get("a", out));
+
+        cache.insert("i", data('i'));
+
+        const DiskCache::Stats stats(cache.stats());
+        CHECK(stats.evictions == 1);
+        CHECK(stats.entries == 8);
+        CHECK(stats.bytes == entryBytes * 8);
+
+        CHECK(!cache.get("b", out));
+        CHECK(!exists(scratch.dir() + filename("b")));
+        CHECK(cache.get("a", out));
+        CHECK(cache.get("i", out));
+    }
+
+    void rebuilds()
+    {
+        Scratch scratch;
+
+        {
+            DiskCache cache(scratch.dir(), entryBytes * 8);
+            cache.insert("a", data('a'));
+            cache.insert("b", data('b'));
+            cache.insert("c", data('c'));
+        }
+
+        // Recency is kept in modification times, so "a" is the oldest.
+        age(scratch.dir() + filename("a"), 30);
+        age(scratch.dir() + filename("b"), 20);
+        age(scratch.dir() + filename("c"), 10);
+
+        // Left behind by a crash mid-insert, and by someone else.
+        const std::string partial(
+                scratch.dir() + filename("d") + ".tmp-1-0");
+        const std::string foreign(scratch.dir() + "notes.txt");
+        write(partial, "partial");
+        write(foreign, "foreign");
+
+        {
+            DiskCache cache(scratch.dir(), entryBytes * 8);
+
+            const DiskCache::Stats stats(cache.stats());
+            CHECK(stats.entries == 3);
+            CHECK(stats.bytes == entryBytes * 3);
+
+            std::vector<char> out;
+            CHECK(cache.get("b", out));
+            CHECK(out == data('b'));
+        }
+
+        CHECK(!exists(partial));
+        CHECK(exists(foreign));
+
+        // Our budget has shrunk, and "a" is still our least recently used.
+        {
+            DiskCache cache(scratch.dir(), entryBytes * 2);
+
+            const DiskCache::Stats stats(cache.stats());
+            CHECK(stats.entries == 2);
+            CHECK(stats.evictions == 1);
+
+            std::vector<char> out;
+            CHECK(!cache.get("a", out));
+            CHECK(cache.get("b", out));
+            CHECK(cache.get("c", out));
+        }
+
+        CHECK(!exists(scratch.dir() + filename("a")));
+    }
+
+    void detectsCollisions()
+    {
+        Scratch scratch;
+
+        {
+            // Creates our directory.
+            DiskCache cache(scratch.dir(), entryBytes * 8);
+        }
+
+        // Forge a file at the name of "a" which holds another key, as if
+        // their hashes collided.
+        const std::string other("z");
+        const std::uint32_t keySize(other.size());
+
+        write(
+                scratch.dir() + filename("a"),
+                std::string(
+                    reinterpret_cast<const char*>(&keySize),
+                    sizeof(keySize)) +
+                other +
+                "zzzz");
+
+        DiskCache cache(scratch.dir(), entryBytes * 8);
+        CHECK(cache.stats().entries == 1);
+
+        std::vector<char> out;
+        CHECK(!cache.get("a", out));
+        CHECK(out.empty());
+
+        // The other key is left in place, and not overwritten by ours.
+        cache.insert("a", data('a'));
+        CHECK(!cache.get("a", out));
+        CHECK(exists(scratch.dir() + filename("a")));
+        CHECK(cache.stats().entries == 1);
+        CHECK(cache.stats().misses == 2);
+    }
+}
+
+int main()
+{
+    roundTrips();
+    evictsLeastRecentlyUsed();
+    rebuilds();
+    detectsCollisions();
+
+    std::cout << "DiskCache: all tests passed" << std::endl;
+    return 0;
+}
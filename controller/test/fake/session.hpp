@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include "util/hierarchy-cache-stats.hpp"
+
+// Stands in for the Session of the session directory, for tests of the
+// components which only need its bookkeeping.  Include this directory ahead
+// of the session directory to use it.
+class Session
+{
+public:
+    Session() : m_footprint(0), m_pinnedBytes(0), m_path() { }
+
+    void footprint(const std::size_t bytes) { m_footprint = bytes; }
+    void pinnedBytes(const std::size_t bytes) { m_pinnedBytes = bytes; }
+    void path(const std::string& path) { m_path = path; }
+
+    std::size_t footprint() const { return m_footprint; }
+    std::size_t pinnedBytes() const { return m_pinnedBytes; }
+    const std::string& path() const { return m_path; }
+
+    HierarchyCacheStats hierarchyCacheStats() const
+    {
+        return HierarchyCacheStats();
+    }
+
+private:
+    std::size_t m_footprint;
+    std::size_t m_pinnedBytes;
+    std::string m_path;
+
+    // Disallow copy/assignment.
+    Session(const Session&);
+    Session& operator=(const Session&);
+};
@@ -0,0 +1,200 @@
+// Unit tests of PathSearch: priority among several paths holding the same
+// thing, hints, failures, and abandoning probes.
+//
+// Build and run with:
+//      make path-search && ./path-search
+
+#include <condition_variable>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "util/path-search.hpp"
+#include "util/task-pool.hpp"
+
+#include "check.hpp"
+
+namespace
+{
+    typedef std::vector<std::string> Paths;
+    typedef PathSearch<std::string> Search;
+
+    // Holds up a pool's only thread until opened, so that everything queued
+    // behind it runs in the order it was queued.
+    class Gate
+    {
+    public:
+        explicit Gate(TaskPool& pool)
+            : m_open(false)
+            , m_mutex()
+            , m_cv()
+        {
+            pool.add([this]()->void
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_cv.wait(lock, [this]()->bool { return m_open; });
+            });
+        }
+
+        void open()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_open = true;
+            m_cv.notify_all();
+        }
+
+    private:
+        bool m_open;
+        std::mutex m_mutex;
+        std::condition_variable m_cv;
+    };
+
+    // Opens the paths which hold our resource, recording the order of the
+    // paths it was asked to open.
+    class Holders
+    {
+    public:
+        explicit Holders(const Paths& holders)
+            : m_holders(holders.begin(), holders.end())
+            , m_opened()
+            , m_mutex()
+        { }
+
+        Search::Open open()
+        {
+            return [this](const std::string& path)->std::unique_ptr<std::string>
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_opened.push_back(path);
+
+                if (path == "broken") throw std::runtime_error("broken");
+
+                std::unique_ptr<std::string> result;
+                if (m_holders.count(path)) result.reset(new std::string(path));
+                return result;
+            };
+        }
+
+        Paths opened() const
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_opened;
+        }
+
+    private:
+        const std::set<std::string> m_holders;
+        Paths m_opened;
+        mutable std::mutex m_mutex;
+    };
+
+    // Wait on each path in turn, as Session does, returning the index of
+    // the first to hold our resource.
+    std::size_t find(Search& search, const Paths& paths, Paths& errs)
+    {
+        for (std::size_t i(0); i < paths.size(); ++i)
+        {
+            std::string err;
+            std::unique_ptr<std::string> result(search.wait(i, err));
+
+            if (result)
+            {
+                CHECK(*result == paths[i]);
+                return i;
+            }
+
+            errs.push_back(err);
+        }
+
+        return paths.size();
+    }
+
+    void priorityOverHint()
+    {
+        const Paths paths({ "a", "b", "c" });
+        Holders holders({ "b", "c" });
+
+        TaskPool pool(1);
+        Gate gate(pool);
+
+        // We were last found at "c", but "b" is ahead of it.
+        Search search(pool, paths, "c", holders.open());
+        gate.open();
+
+        Paths errs;
+        CHECK(find(search, paths, errs) == 1);
+        CHECK(errs == Paths({ "not found" }));
+
+        // The hint was probed first, and the others in order.
+        const Paths opened(holders.opened());
+        CHECK(opened.size() >= 2);
+        CHECK(opened[0] == "c");
+        CHECK(opened[1] == "a");
+    }
+
+    void bothHold()
+    {
+        const Paths paths({ "a", "b" });
+        Holders holders({ "a", "b" });
+
+        TaskPool pool(2);
+
+        // Both hold our resource, so the hint changes nothing.
+        for (const std::string hint : { "", "a", "b", "elsewhere" })
+        {
+            Search search(pool, paths, hint, holders.open());
+
+            Paths errs;
+            CHECK(find(search, paths, errs) == 0);
+            CHECK(errs.empty());
+        }
+    }
+
+    void failures()
+    {
+        const Paths paths({ "broken", "a", "b" });
+        Holders holders(Paths{ });
+
+        TaskPool pool(3);
+        Search search(pool, paths, "", holders.open());
+
+        Paths errs;
+        CHECK(find(search, paths, errs) == paths.size());
+        CHECK(errs == Paths({ "broken", "not found", "not found" }));
+    }
+
+    void abandons()
+    {
+        const Paths paths({ "a", "b" });
+        Holders holders({ "a", "b" });
+
+        std::unique_ptr<TaskPool> pool(new TaskPool(1));
+        Gate gate(*pool);
+
+        // Given up on before any probe starts.
+        {
+            Search search(*pool, paths, "", holders.open());
+        }
+
+        gate.open();
+
+        // Finishes everything queued.
+        pool.reset();
+
+        CHECK(holders.opened().empty());
+    }
+}
+
+int main()
+{
+    priorityOverHint();
+    bothHold();
+    failures();
+    abandons();
+
+    std::cout << "PathSearch: all tests passed" << std::endl;
+    return 0;
+}
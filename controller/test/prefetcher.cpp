@@ -0,0 +1,229 @@
+// Unit tests of Prefetcher: ordered delivery across sources, keeping reads
+// in progress plus chunks awaiting delivery within its depth, errors, and
+// cancelling.
+//
+// Build and run with:
+//      make prefetcher && ./prefetcher
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "util/prefetcher.hpp"
+#include "util/task-pool.hpp"
+
+#include "check.hpp"
+
+namespace
+{
+    // Long enough for every read that may start to have finished.
+    void settle()
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    }
+
+    std::string chunk(const std::size_t source, const std::size_t index)
+    {
+        return std::to_string(source) + ":" + std::to_string(index);
+    }
+
+    // Sources of the given numbers of chunks, each chunk naming itself.
+    class Sources
+    {
+    public:
+        Sources(const std::vector<std::size_t>& sizes, std::size_t depth)
+            : m_sizes(sizes)
+            , m_depth(depth)
+            , m_read(sizes.size(), 0)
+            , m_started(0)
+            , m_delivered(0)
+            , m_failAt(sizes.size())
+        { }
+
+        std::vector<bool> done() const
+        {
+            std::vector<bool> result;
+            for (const std::size_t size : m_sizes) result.push_back(!size);
+            return result;
+        }
+
+        Prefetcher::Read read()
+        {
+            return [this](std::size_t source, std::vector<char>& data)->bool
+            {
+                // Our consumer counts a delivery only once next() returns, by
+                // which time a read in its place may have started.
+                const std::size_t started(++m_started);
+                CHECK(started - m_delivered.load() <= m_depth + 1);
+                CHECK(data.empty());
+
+                if (source == m_failAt) throw std::runtime_error("failed");
+
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+                const std::string s(chunk(source, m_read[source]++));
+                data.assign(s.begin(), s.end());
+                return m_read[source] == m_sizes[source];
+            };
+        }
+
+        void delivered() { ++m_delivered; }
+        void failAt(std::size_t source) { m_failAt = source; }
+
+        // Reads started but not yet delivered.
+        std::size_t outstanding() const { return m_started - m_delivered; }
+
+    private:
+        const std::vector<std::size_t> m_sizes;
+        const std::size_t m_depth;
+
+        // Only one read per source runs at a time.
+        std::vector<std::size_t> m_read;
+
+        std::atomic<std::size_t> m_started;
+        std::atomic<std::size_t> m_delivered;
+        std::size_t m_failAt;
+    };
+
+    void deliversInOrder()
+    {
+        const std::size_t depth(3);
+        const std::vector<std::size_t> sizes({ 3, 0, 2, 5, 0 });
+
+        TaskPool pool(4);
+        Sources sources(sizes, depth);
+        Prefetcher prefetcher(pool, sources.done(), depth, sources.read());
+
+        std::vector<std::string> expected;
+        for (std::size_t s(0); s < sizes.size(); ++s)
+        {
+            for (std::size_t i(0); i < sizes[s]; ++i)
+            {
+                expected.push_back(chunk(s, i));
+            }
+        }
+
+        std::vector<std::string> received;
+        std::vector<char> data;
+        bool done(false);
+
+        while (!done)
+        {
+            done = prefetcher.next(data);
+            sources.delivered();
+            received.emplace_back(data.begin(), data.end());
+        }
+
+        CHECK(received == expected);
+    }
+
+    void boundsDepth()
+    {
+        const std::size_t depth(4);
+        const std::vector<std::size_t> sizes({ 20, 20, 20 });
+
+        TaskPool pool(4);
+        Sources sources(sizes, depth);
+        Prefetcher prefetcher(pool, sources.done(), depth, sources.read());
+
+        std::vector<char> data;
+        std::size_t received(0);
+
+        // A consumer which stops reading leaves its prefetcher with exactly
+        // its depth of chunks, including those of the source being
+        // delivered.
+        for (std::size_t i(0); i < 3; ++i)
+        {
+            CHECK(!prefetcher.next(data));
+            sources.delivered();
+            ++received;
+        }
+
+        settle();
+        CHECK(sources.outstanding() == depth);
+
+        bool done(false);
+
+        while (!done)
+        {
+            done = prefetcher.next(data);
+            sources.delivered();
+            ++received;
+        }
+
+        CHECK(received == 60);
+        CHECK(sources.outstanding() == 0);
+    }
+
+    void deliversErrors()
+    {
+        TaskPool pool(2);
+        Sources sources({ 5, 5 }, 2);
+        sources.failAt(1);
+
+        Prefetcher prefetcher(pool, sources.done(), 2, sources.read());
+
+        std::vector<char> data;
+        bool thrown(false);
+
+        try
+        {
+            for (std::size_t i(0); i < 10; ++i) prefetcher.next(data);
+        }
+        catch (std::runtime_error&)
+        {
+            thrown = true;
+        }
+
+        CHECK(thrown);
+    }
+
+    void cancels()
+    {
+        TaskPool pool(2);
+        Sources sources({ 50, 50 }, 4);
+
+        Prefetcher prefetcher(pool, sources.done(), 4, sources.read());
+
+        std::vector<char> data;
+        CHECK(!prefetcher.next(data));
+        sources.delivered();
+
+        prefetcher.cancel();
+
+        // Chunks already read may still be delivered, but reads stop.
+        std::size_t received(0);
+        while (!prefetcher.next(data)) ++received;
+
+        CHECK(received < 98);
+    }
+
+    void allEmpty()
+    {
+        TaskPool pool(1);
+        Sources sources({ 0, 0 }, 1);
+
+        Prefetcher prefetcher(pool, sources.done(), 1, sources.read());
+
+        std::vector<char> data;
+        CHECK(prefetcher.next(data));
+        CHECK(sources.outstanding() == 0);
+    }
+}
+
+int main()
+{
+    deliversInOrder();
+    boundsDepth();
+    deliversErrors();
+    cancels();
+    allEmpty();
+
+    std::cout << "Prefetcher: all tests passed" << std::endl;
+    return 0;
+}
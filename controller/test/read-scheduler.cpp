@@ -0,0 +1,256 @@
+// Unit tests of ReadScheduler: admission within its limits, queueing
+// cheapest first, aging of queued reads, per-resource limits, and rejection
+// once its queue is full.
+//
+// Build and run with:
+//      make read-scheduler && ./read-scheduler
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "types/query-limits.hpp"
+#include "util/read-scheduler.hpp"
+
+#include "check.hpp"
+
+namespace
+{
+    typedef ReadScheduler::Admission Admission;
+
+    const std::uint64_t million(1000000);
+
+    // Everything is unlimited unless a test says otherwise.
+    QueryLimits limits(const std::string& json)
+    {
+        return QueryLimits::parse(
+                "{"
+                    "\"maxReadsPerResource\": 0,"
+                    "\"maxReadMillionPoints\": 0,"
+                    "\"maxResourceMillionPoints\": 0,"
+                    "\"maxQueuedReads\": 0,"
+                    "\"queueAgingSeconds\": 0," +
+                    json +
+                "}");
+    }
+
+    // Submits reads, recording the order in which queued reads are started.
+    class Reads
+    {
+    public:
+        explicit Reads(const QueryLimits& limits)
+            : m_scheduler(limits)
+            , m_started()
+        { }
+
+        Admission submit(
+                const std::string& name,
+                const std::string& resource,
+                const std::uint64_t cost,
+                std::uint64_t& ticket)
+        {
+            std::size_t retryAfter(0);
+
+            return m_scheduler.submit(
+                    resource,
+                    cost,
+                    [this, name]()->void { m_started.push_back(name); },
+                    ticket,
+                    retryAfter);
+        }
+
+        ReadScheduler& scheduler() { return m_scheduler; }
+        const std::vector<std::string>& started() const { return m_started; }
+
+    private:
+        ReadScheduler m_scheduler;
+        std::vector<std::string> m_started;
+    };
+
+    void admitsWithinLimits()
+    {
+        Reads reads(limits("\"maxReads\": 2"));
+        std::uint64_t a(0), b(0), c(0);
+
+        CHECK(reads.submit("a", "r", 1, a) == Admission::Run);
+        CHECK(reads.submit("b", "r", 1, b) == Admission::Run);
+        CHECK(reads.submit("c", "r", 1, c) == Admission::Queued);
+        CHECK(a && b && c && a != b && b != c);
+
+        ReadScheduler::Stats stats(reads.scheduler().stats());
+        CHECK(stats.running == 2);
+        CHECK(stats.queued == 1);
+        CHECK(stats.deferred == 1);
+
+        // Queued reads are started by whoever releases their capacity.
+        reads.scheduler().release(a);
+        CHECK(reads.started() == std::vector<std::string>({ "c" }));
+
+        reads.scheduler().release(b);
+        reads.scheduler().release(c);
+
+        stats = reads.scheduler().stats();
+        CHECK(stats.running == 0);
+        CHECK(stats.runningPoints == 0);
+        CHECK(stats.admitted == 3);
+    }
+
+    void cheapestFirst()
+    {
+        Reads reads(limits("\"maxReads\": 1"));
+        std::uint64_t a(0), b(0), c(0), d(0);
+
+        CHECK(reads.submit("a", "r", 1, a) == Admission::Run);
+        CHECK(reads.submit("b", "r", 3 * million, b) == Admission::Queued);
+        CHECK(reads.submit("c", "r", 1 * million, c) == Admission::Queued);
+        CHECK(reads.submit("d", "r", 2 * million, d) == Admission::Queued);
+
+        reads.scheduler().release(a);
+        reads.scheduler().release(c);
+        reads.scheduler().release(d);
+        reads.scheduler().release(b);
+
+        CHECK(reads.started() == std::vector<std::string>({ "c", "d", "b" }));
+    }
+
+    void aging()
+    {
+        // Each 50 ms of waiting halves a queued read's cost.
+        Reads reads(limits("\"maxReads\": 1, \"queueAgingSeconds\": 0.05"));
+        std::uint64_t a(0), b(0), c(0);
+
+        CHECK(reads.submit("a", "r", 1, a) == Admission::Run);
+        CHECK(reads.submit("b", "r", 4 * million, b) == Admission::Queued);
+
+        // After 300 ms, b's cost has aged to below 100 thousand points.
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        CHECK(reads.submit("c", "r", 1 * million, c) == Admission::Queued);
+
+        reads.scheduler().release(a);
+        reads.scheduler().release(b);
+        reads.scheduler().release(c);
+
+        CHECK(reads.started() == std::vector<std::string>({ "b", "c" }));
+    }
+
+    void noAging()
+    {
+        // The same reads without aging run strictly cheapest first.
+        Reads reads(limits("\"maxReads\": 1"));
+        std::uint64_t a(0), b(0), c(0);
+
+        CHECK(reads.submit("a", "r", 1, a) == Admission::Run);
+        CHECK(reads.submit("b", "r", 4 * million, b) == Admission::Queued);
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        CHECK(reads.submit("c", "r", 1 * million, c) == Admission::Queued);
+
+        reads.scheduler().release(a);
+        reads.scheduler().release(c);
+        reads.scheduler().release(b);
+
+        CHECK(reads.started() == std::vector<std::string>({ "c", "b" }));
+    }
+
+    void perResource()
+    {
+        Reads reads(limits("\"maxReads\": 4, \"maxReadsPerResource\": 1"));
+        std::uint64_t a(0), b(0), c(0);
+
+        CHECK(reads.submit("a", "r1", 1, a) == Admission::Run);
+        CHECK(reads.submit("b", "r1", 1, b) == Admission::Queued);
+
+        // A read held back by its own resource doesn't hold up others.
+        CHECK(reads.submit("c", "r2", 1, c) == Admission::Run);
+
+        reads.scheduler().release(a);
+        CHECK(reads.started() == std::vector<std::string>({ "b" }));
+
+        reads.scheduler().release(b);
+        reads.scheduler().release(c);
+    }
+
+    void pointLimits()
+    {
+        Reads reads(limits("\"maxReads\": 4, \"maxReadMillionPoints\": 2"));
+        std::uint64_t a(0), b(0), c(0);
+
+        // A read costing more than our limit may still run, but only alone.
+        CHECK(reads.submit("a", "r", 3 * million, a) == Admission::Run);
+        CHECK(reads.submit("b", "r", 1 * million, b) == Admission::Queued);
+
+        reads.scheduler().release(a);
+        CHECK(reads.started() == std::vector<std::string>({ "b" }));
+
+        CHECK(reads.submit("c", "r", 1 * million, c) == Admission::Run);
+        CHECK(reads.scheduler().stats().runningPoints == 2 * million);
+
+        reads.scheduler().release(b);
+        reads.scheduler().release(c);
+    }
+
+    void rejects()
+    {
+        Reads reads(limits("\"maxReads\": 1, \"maxQueuedReads\": 1"));
+        std::uint64_t a(0), b(0), c(0);
+
+        CHECK(reads.submit("a", "r", 1, a) == Admission::Run);
+        CHECK(reads.submit("b", "r", 1, b) == Admission::Queued);
+
+        std::size_t retryAfter(0);
+        const Admission admission(
+                reads.scheduler().submit(
+                    "r",
+                    1,
+                    []()->void { },
+                    c,
+                    retryAfter));
+
+        CHECK(admission == Admission::Rejected);
+        CHECK(!c);
+        CHECK(retryAfter >= 1 && retryAfter <= 60);
+        CHECK(reads.scheduler().stats().rejected == 1);
+
+        reads.scheduler().release(a);
+        reads.scheduler().release(b);
+    }
+
+    void releaseQueued()
+    {
+        Reads reads(limits("\"maxReads\": 1"));
+        std::uint64_t a(0), b(0), c(0);
+
+        CHECK(reads.submit("a", "r", 1, a) == Admission::Run);
+        CHECK(reads.submit("b", "r", 1, b) == Admission::Queued);
+        CHECK(reads.submit("c", "r", 2, c) == Admission::Queued);
+
+        // A read abandoned while queued is never started.
+        reads.scheduler().release(b);
+        CHECK(reads.scheduler().stats().queued == 1);
+
+        reads.scheduler().release(a);
+        CHECK(reads.started() == std::vector<std::string>({ "c" }));
+
+        reads.scheduler().release(c);
+        CHECK(reads.scheduler().stats().running == 0);
+    }
+}
+
+int main()
+{
+    admitsWithinLimits();
+    cheapestFirst();
+    aging();
+    noAging();
+    perResource();
+    pointLimits();
+    rejects();
+    releaseQueued();
+
+    std::cout << "ReadScheduler: all tests passed" << std::endl;
+    return 0;
+}
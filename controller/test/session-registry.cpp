@@ -0,0 +1,211 @@
+// Unit tests of SessionRegistry: sharing of sessions, least recently used
+// eviction within its budget, sparing of sessions in use, reopen hints, and
+// remembering missing resources.
+//
+// Build and run with:
+//      make session-registry && ./session-registry
+
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "session.hpp"
+#include "util/session-registry.hpp"
+
+#include "check.hpp"
+
+namespace
+{
+    typedef std::vector<std::string> Names;
+
+    std::shared_ptr<Session> create()
+    {
+        return std::make_shared<Session>();
+    }
+
+    // Open a resource, leaving it idle once our caller drops it.
+    std::shared_ptr<Session> open(
+            SessionRegistry& registry,
+            const std::string& name,
+            const std::size_t footprint)
+    {
+        std::shared_ptr<Session> session(registry.get(name));
+        session->footprint(footprint);
+        session->path("/data/" + name);
+        return session;
+    }
+
+    void shares()
+    {
+        SessionRegistry registry(0, 0, create);
+
+        std::shared_ptr<Session> a(registry.get("a"));
+        CHECK(registry.get("a") == a);
+        CHECK(registry.get("b") != a);
+
+        const SessionRegistry::Stats stats(registry.stats());
+        CHECK(stats.sessions == 2);
+        CHECK(stats.opens == 2);
+        CHECK(stats.active == 1);
+        CHECK(stats.resources.at("a").active);
+        CHECK(!stats.resources.at("b").active);
+
+        // Pinned bytes are reported apart, but are part of a footprint.
+        a->footprint(100);
+        a->pinnedBytes(60);
+
+        const SessionRegistry::Stats pinned(registry.stats());
+        CHECK(pinned.bytes == 100);
+        CHECK(pinned.pinnedBytes == 60);
+        CHECK(pinned.resources.at("a").pinnedBytes == 60);
+        CHECK(!pinned.resources.at("b").pinnedBytes);
+
+        // Without a budget, nothing is evicted.
+        CHECK(registry.sweep().empty());
+    }
+
+    void evictsLeastRecentlyUsed()
+    {
+        SessionRegistry registry(250, 0, create);
+
+        open(registry, "a", 100);
+        open(registry, "b", 100);
+        open(registry, "c", 100);
+
+        // Touching "a" leaves "b" as our least recently used.
+        registry.get("a");
+
+        CHECK(registry.stats().bytes == 300);
+        CHECK(registry.sweep() == Names({ "b" }));
+
+        const SessionRegistry::Stats stats(registry.stats());
+        CHECK(stats.sessions == 2);
+        CHECK(stats.bytes == 200);
+        CHECK(stats.evictions == 1);
+        CHECK(stats.resources.count("a") && stats.resources.count("c"));
+
+        // Within our budget, so nothing more goes.
+        CHECK(registry.sweep().empty());
+    }
+
+    void sparesActive()
+    {
+        SessionRegistry registry(150, 0, create);
+
+        std::shared_ptr<Session> a(open(registry, "a", 100));
+        open(registry, "b", 100);
+
+        // "a" is older, but in use.
+        CHECK(registry.sweep() == Names({ "b" }));
+
+        // Over budget alone, but still in use.
+        a->footprint(200);
+        CHECK(registry.sweep().empty());
+
+        a.reset();
+        CHECK(registry.sweep() == Names({ "a" }));
+        CHECK(registry.stats().sessions == 0);
+    }
+
+    void expiresIdle()
+    {
+        SessionRegistry registry(0, 0, create);
+
+        open(registry, "a", 100);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+        open(registry, "b", 100);
+
+        CHECK(registry.sweep(1) == Names({ "a" }));
+        CHECK(registry.stats().sessions == 1);
+    }
+
+    void hintsReopen()
+    {
+        SessionRegistry registry(50, 0, create);
+
+        CHECK(registry.hint("a").empty());
+
+        open(registry, "a", 100);
+        CHECK(registry.sweep() == Names({ "a" }));
+        CHECK(registry.hint("a") == "/data/a");
+
+        registry.get("a");
+
+        const SessionRegistry::Stats stats(registry.stats());
+        CHECK(stats.opens == 2);
+        CHECK(stats.reopens == 1);
+
+        // Forgetting a resource forgets where it was.
+        registry.erase("a");
+        CHECK(registry.hint("a").empty());
+        CHECK(registry.stats().sessions == 0);
+    }
+
+    void eraseChecksSession()
+    {
+        SessionRegistry registry(0, 0, create);
+
+        std::shared_ptr<Session> stale(registry.get("a"));
+        registry.erase("a");
+
+        std::shared_ptr<Session> fresh(registry.get("a"));
+
+        // A failure of the old session doesn't disturb its replacement.
+        registry.erase("a", stale);
+        CHECK(registry.get("a") == fresh);
+
+        registry.erase("a", fresh);
+        CHECK(registry.stats().sessions == 0);
+    }
+
+    void remembersMissing()
+    {
+        SessionRegistry registry(0, 1, create);
+
+        std::shared_ptr<Session> session(registry.get("a"));
+        CHECK(!registry.missing("a"));
+
+        registry.miss("a", session);
+        CHECK(registry.stats().sessions == 0);
+        CHECK(registry.missing("a"));
+        CHECK(registry.missing("a"));
+        CHECK(!registry.missing("b"));
+
+        SessionRegistry::Stats stats(registry.stats());
+        CHECK(stats.missing == 1);
+        CHECK(stats.missingHits == 2);
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+        CHECK(!registry.missing("a"));
+        CHECK(registry.stats().missing == 0);
+    }
+
+    void forgetsMissing()
+    {
+        // Without a time to remember them, missing resources are not.
+        SessionRegistry registry(0, 0, create);
+
+        registry.miss("a", registry.get("a"));
+        CHECK(!registry.missing("a"));
+        CHECK(registry.stats().missing == 0);
+    }
+}
+
+int main()
+{
+    shares();
+    evictsLeastRecentlyUsed();
+    sparesActive();
+    expiresIdle();
+    hintsReopen();
+    eraseChecksSession();
+    remembersMissing();
+    forgetsMissing();
+
+    std::cout << "SessionRegistry: all tests passed" << std::endl;
+    return 0;
+}